@@ -0,0 +1,676 @@
+#include "AccessLog.h"
+#include "File.h"
+#include "Directory.h"
+#include "Memory.h"
+#include "LTTBytes.h"
+#include "LTTTime.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+
+// Macros.
+#define ACCESS_LOG_DIR_NAME "logs"
+/* Shared with the text log, whose old files are named differently. */
+#define ACCESS_LOG_OLD_DIR_NAME "old"
+#define ACCESS_LOG_OLD_FILE_NAME_BUFFER_SIZE 64
+
+#define ACCESS_LOG_MAGIC 0x4C41544Cu // "LTAL"
+#define ACCESS_LOG_VERSION 2u
+#define ACCESS_LOG_HEADER_SIZE (4 + 4)
+
+/* Time, account, bytes in and out, the five phase times, status, method, route and end mark. */
+#define ACCESS_RECORD_SIZE (8 + 8 + 4 + 4 + (5 * 4) + 2 + 1 + 1 + 1)
+#define ACCESS_RECORD_END_MARK 0xA5
+
+/* Version 1 records had no commit time, the commit wait was counted as storage time. They can still be summarized. */
+#define ACCESS_LOG_VERSION_WITHOUT_COMMIT 1u
+#define ACCESS_RECORD_COMMIT_SIZE 4
+
+#define ACCESS_LOG_WRITE_INTERVAL_MILLISECONDS 250
+
+#define DAY_YEAR_MULTIPLIER 1000
+#define SUMMARY_TIME_CAPACITY 64
+#define SUMMARY_TIME_GROWTH 2
+
+#define ROUTE_COUNT (sizeof(s_routeNames) / sizeof(*s_routeNames))
+
+
+// Types.
+typedef struct RouteSummaryStruct
+{
+	unsigned long long* Times;
+	size_t Count;
+	size_t Capacity;
+	unsigned long long StorageTotal;
+	unsigned long long CommitTotal;
+} RouteSummary;
+
+/* Request times of every summarized file, one summary for each route. */
+typedef struct AccessSummaryStruct
+{
+	size_t RequestCount;
+	RouteSummary* Routes;
+} AccessSummary;
+
+
+// Static variables.
+/* Route IDs are indices into this list and are stored in the log, so routes may only be appended. */
+static const char* const s_routeNames[] =
+{
+	"other",
+	"account/signup",
+	"account/verify",
+	"account/login",
+	"account/edit",
+	"account/delete",
+	"post/create/create",
+	"post/create/image",
+	"post/create/finish",
+	"post/delete",
+	"post/edit",
+	"post/get",
+	"post/comment",
+	"special/stop",
+	"special/index-status",
+	"special/reindex",
+	"special/metrics"
+};
+
+static THREAD_LOCAL unsigned long long s_storageTime = 0;
+static THREAD_LOCAL int s_storageDepth = 0;
+
+
+// Static functions.
+static void EncodeRecord(unsigned char* destination, const AccessRecord* record)
+{
+	Bytes_EncodeULong(destination, record->Time);
+	Bytes_EncodeULong(destination + 8, record->AccountID);
+	Bytes_EncodeUInt(destination + 16, record->BytesIn);
+	Bytes_EncodeUInt(destination + 20, record->BytesOut);
+	Bytes_EncodeUInt(destination + 24, record->ParseTime);
+	Bytes_EncodeUInt(destination + 28, record->DispatchTime);
+	Bytes_EncodeUInt(destination + 32, record->StorageTime);
+	Bytes_EncodeUInt(destination + 36, record->CommitTime);
+	Bytes_EncodeUInt(destination + 40, record->WriteTime);
+	destination[44] = (unsigned char)record->Status;
+	destination[45] = (unsigned char)(record->Status >> 8);
+	destination[46] = (unsigned char)record->Method;
+	destination[47] = (unsigned char)record->Route;
+	destination[48] = ACCESS_RECORD_END_MARK;
+}
+
+static void DecodeRecord(const unsigned char* source, bool hasCommitTime, AccessRecord* record)
+{
+	record->Time = Bytes_DecodeULong(source);
+	record->AccountID = Bytes_DecodeULong(source + 8);
+	record->BytesIn = Bytes_DecodeUInt(source + 16);
+	record->BytesOut = Bytes_DecodeUInt(source + 20);
+	record->ParseTime = Bytes_DecodeUInt(source + 24);
+	record->DispatchTime = Bytes_DecodeUInt(source + 28);
+	record->StorageTime = Bytes_DecodeUInt(source + 32);
+	record->CommitTime = hasCommitTime ? Bytes_DecodeUInt(source + 36) : 0;
+
+	// Fields after the commit time move back in records without it.
+	size_t CommitSize = hasCommitTime ? ACCESS_RECORD_COMMIT_SIZE : 0;
+	record->WriteTime = Bytes_DecodeUInt(source + 36 + CommitSize);
+	record->Status = (unsigned int)source[40 + CommitSize] | ((unsigned int)source[41 + CommitSize] << 8);
+	record->Method = (HttpMethod)source[42 + CommitSize];
+	record->Route = source[43 + CommitSize];
+}
+
+/* Files. */
+/* Whether the file holds records of another version, which can't be appended to. */
+static bool IsOtherVersion(const char* path)
+{
+	if (!File_Exists(path))
+	{
+		return false;
+	}
+
+	Error ReturnedError;
+	FILE* File = File_Open(path, FileOpenMode_ReadBinary, &ReturnedError);
+	if (!File)
+	{
+		Error_Deconstruct(&ReturnedError);
+		return false;
+	}
+	unsigned char Header[ACCESS_LOG_HEADER_SIZE];
+	size_t ReadCount = File_Read(File, (char*)Header, ACCESS_LOG_HEADER_SIZE);
+	File_Close(File);
+	return (ReadCount == ACCESS_LOG_HEADER_SIZE) && (Bytes_DecodeUInt(Header + 4) != ACCESS_LOG_VERSION);
+}
+
+/* Opens the current file for appending and makes sure it starts with a header and ends with a whole record. */
+static Error OpenLogFile(AccessLog* self)
+{
+	Error ReturnedError;
+	self->_file = File_Open(self->_filePath, FileOpenMode_AppendBinary, &ReturnedError);
+	if (!self->_file)
+	{
+		return ReturnedError;
+	}
+
+	unsigned long long FileLength;
+	ReturnedError = File_GetLength(self->_file, &FileLength);
+	if ((ReturnedError.Code == ErrorCode_Success) && (FileLength == 0))
+	{
+		unsigned char Header[ACCESS_LOG_HEADER_SIZE];
+		Bytes_EncodeUInt(Header, ACCESS_LOG_MAGIC);
+		Bytes_EncodeUInt(Header + 4, ACCESS_LOG_VERSION);
+		ReturnedError = File_Write(self->_file, (const char*)Header, ACCESS_LOG_HEADER_SIZE);
+		FileLength = ACCESS_LOG_HEADER_SIZE;
+	}
+	else if ((ReturnedError.Code == ErrorCode_Success) && (((FileLength - ACCESS_LOG_HEADER_SIZE) % ACCESS_RECORD_SIZE) != 0))
+	{
+		// A crash left a record cut short, padding it with zeros keeps the records after it aligned and leaves it without an end mark.
+		unsigned char Padding[ACCESS_RECORD_SIZE] = { 0 };
+		size_t PaddingLength = ACCESS_RECORD_SIZE - (size_t)((FileLength - ACCESS_LOG_HEADER_SIZE) % ACCESS_RECORD_SIZE);
+		ReturnedError = File_Write(self->_file, (const char*)Padding, PaddingLength);
+		FileLength += PaddingLength;
+	}
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		File_Close(self->_file);
+		self->_file = NULL;
+		return ReturnedError;
+	}
+
+	self->_fileLength = FileLength;
+	return Error_CreateSuccess();
+}
+
+/* Number of a rotated file, false if the name isn't one of a rotated access log. */
+static bool ParseOldFileName(const char* name, unsigned int* number)
+{
+	int NameLength;
+	return (sscanf(name, ACCESS_LOG_OLD_FILE_PREFIX "%u%n", number, &NameLength) == 1)
+		&& String_Equals(name + NameLength, ACCESS_LOG_FILE_EXTENSION);
+}
+
+static int CompareFileNumbers(const void* number1, const void* number2)
+{
+	unsigned int Number1 = *(const unsigned int*)number1;
+	unsigned int Number2 = *(const unsigned int*)number2;
+	return (Number1 > Number2) - (Number1 < Number2);
+}
+
+/* Lists the numbers of the rotated files, oldest first. */
+static unsigned int* ListOldFileNumbers(const char* oldFileDirPath, size_t* count)
+{
+	*count = 0;
+	size_t NameCount;
+	char** Names = Directory_List(oldFileDirPath, &NameCount);
+	if (!Names)
+	{
+		return NULL;
+	}
+
+	unsigned int* Numbers = (unsigned int*)Memory_SafeMalloc(sizeof(unsigned int) * NameCount);
+	for (size_t i = 0; i < NameCount; i++)
+	{
+		if (ParseOldFileName(Names[i], Numbers + *count))
+		{
+			*count += 1;
+		}
+	}
+	Directory_FreeList(Names, NameCount);
+
+	qsort(Numbers, *count, sizeof(unsigned int), CompareFileNumbers);
+	return Numbers;
+}
+
+static char* GetOldFilePath(AccessLog* self, unsigned int number)
+{
+	char FileName[ACCESS_LOG_OLD_FILE_NAME_BUFFER_SIZE];
+	snprintf(FileName, sizeof(FileName), ACCESS_LOG_OLD_FILE_PREFIX "%u" ACCESS_LOG_FILE_EXTENSION, number);
+	return Directory_CombinePaths(self->_oldFileDirPath, FileName);
+}
+
+static void DeleteOldestFiles(AccessLog* self)
+{
+	size_t Count;
+	unsigned int* Numbers = ListOldFileNumbers(self->_oldFileDirPath, &Count);
+	for (size_t i = 0; (i + self->_rotation.MaxOldLogCount) < Count; i++)
+	{
+		char* Path = GetOldFilePath(self, Numbers[i]);
+		File_Delete(Path);
+		Memory_Free(Path);
+	}
+	Memory_Free(Numbers);
+}
+
+/* Moves the current file to the old log directory, the next batch starts a new one. */
+static void RotateLogFile(AccessLog* self)
+{
+	if (self->_file)
+	{
+		Error ReturnedError = File_Close(self->_file);
+		Error_Deconstruct(&ReturnedError);
+		self->_file = NULL;
+	}
+
+	Directory_Create(self->_oldFileDirPath);
+	char* OldFilePath = GetOldFilePath(self, self->_nextOldFileNumber);
+	Error ReturnedError = File_Move(self->_filePath, OldFilePath);
+	Memory_Free(OldFilePath);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		self->_nextOldFileNumber++;
+		if (self->_rotation.MaxOldLogCount > 0)
+		{
+			DeleteOldestFiles(self);
+		}
+	}
+	Error_Deconstruct(&ReturnedError);
+	self->_fileLength = 0;
+}
+
+static int GetDay(time_t time)
+{
+	struct tm* DateTime = localtime(&time);
+	return (DateTime->tm_year * DAY_YEAR_MULTIPLIER) + DateTime->tm_yday;
+}
+
+/* Ring. */
+static bool TryQueueRecord(AccessLog* self, const AccessRecord* record, long long* position)
+{
+	long long Position = Atomic_Load(&self->_enqueuePosition);
+	AccessLogSlot* Slot;
+	while (true)
+	{
+		Slot = self->_slots + (Position & (ACCESS_LOG_RING_CAPACITY - 1));
+		long long Sequence = Atomic_Load(&Slot->Sequence);
+		if ((Sequence == Position) && Atomic_CompareExchange(&self->_enqueuePosition, Position, Position + 1))
+		{
+			break;
+		}
+		if (Sequence < Position)
+		{
+			return false;
+		}
+		Position = Atomic_Load(&self->_enqueuePosition);
+	}
+
+	Slot->Record = *record;
+	Atomic_Store(&Slot->Sequence, Position + 1);
+	*position = Position;
+	return true;
+}
+
+/* A failed write loses the batch, the access log isn't worth stalling requests over. */
+static void WriteRecords(AccessLog* self, size_t recordCount)
+{
+	if (recordCount == 0)
+	{
+		return;
+	}
+
+	Error ReturnedError = self->_file ? Error_CreateSuccess() : OpenLogFile(self);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = File_Write(self->_file, (const char*)self->_writeBuffer, recordCount * ACCESS_RECORD_SIZE);
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		self->_fileLength += recordCount * ACCESS_RECORD_SIZE;
+		ReturnedError = File_Flush(self->_file);
+	}
+	Error_Deconstruct(&ReturnedError);
+}
+
+/* Takes every ready record off the ring, then writes and flushes them together. */
+static void WriteQueuedRecords(AccessLog* self)
+{
+	size_t RecordCount = 0;
+	while (RecordCount < ACCESS_LOG_RING_CAPACITY)
+	{
+		AccessLogSlot* Slot = self->_slots + (self->_dequeuePosition & (ACCESS_LOG_RING_CAPACITY - 1));
+		if (Atomic_Load(&Slot->Sequence) != (self->_dequeuePosition + 1))
+		{
+			break;
+		}
+
+		// Records of the previous day stay in its file. Threads queue records slightly out of order, so only a later day rotates.
+		int Day = self->_rotation.RotateDaily ? GetDay((time_t)Slot->Record.Time) : self->_fileDay;
+		if (Day > self->_fileDay)
+		{
+			WriteRecords(self, RecordCount);
+			RecordCount = 0;
+			RotateLogFile(self);
+			self->_fileDay = Day;
+		}
+
+		EncodeRecord(self->_writeBuffer + (RecordCount * ACCESS_RECORD_SIZE), &Slot->Record);
+		Atomic_Store(&Slot->Sequence, self->_dequeuePosition + ACCESS_LOG_RING_CAPACITY);
+		self->_dequeuePosition++;
+		RecordCount++;
+	}
+
+	WriteRecords(self, RecordCount);
+	if ((self->_rotation.MaxFileSize > 0) && (self->_fileLength >= self->_rotation.MaxFileSize))
+	{
+		RotateLogFile(self);
+	}
+}
+
+static void RunWriter(void* argument)
+{
+	AccessLog* Self = (AccessLog*)argument;
+	ThreadLock_Lock(&Self->_lock);
+	while (!Atomic_Load(&Self->_isClosing))
+	{
+		ThreadCondition_Wait(&Self->_writeCondition, &Self->_lock, ACCESS_LOG_WRITE_INTERVAL_MILLISECONDS);
+		ThreadLock_Unlock(&Self->_lock);
+		WriteQueuedRecords(Self);
+		ThreadLock_Lock(&Self->_lock);
+	}
+	ThreadLock_Unlock(&Self->_lock);
+
+	WriteQueuedRecords(Self);
+}
+
+static void WakeWriter(AccessLog* self)
+{
+	ThreadLock_Lock(&self->_lock);
+	ThreadCondition_WakeOne(&self->_writeCondition);
+	ThreadLock_Unlock(&self->_lock);
+}
+
+/* Summary. */
+static int CompareTimes(const void* time1, const void* time2)
+{
+	unsigned long long Time1 = *(const unsigned long long*)time1;
+	unsigned long long Time2 = *(const unsigned long long*)time2;
+	return (Time1 > Time2) - (Time1 < Time2);
+}
+
+static double GetPercentile(const unsigned long long* sortedTimes, size_t count, unsigned int percent)
+{
+	// Nearest rank.
+	size_t Rank = ((count * percent) + 99) / 100;
+	return (double)sortedTimes[Rank > 0 ? Rank - 1 : 0] / 1000.0;
+}
+
+static void AddRouteTime(RouteSummary* route, unsigned long long time, unsigned int storageTime, unsigned int commitTime)
+{
+	if (route->Count == route->Capacity)
+	{
+		route->Capacity = route->Capacity ? route->Capacity * SUMMARY_TIME_GROWTH : SUMMARY_TIME_CAPACITY;
+		route->Times = (unsigned long long*)Memory_SafeRealloc(route->Times, sizeof(unsigned long long) * route->Capacity);
+	}
+	route->Times[route->Count] = time;
+	route->Count++;
+	route->StorageTotal += storageTime;
+	route->CommitTotal += commitTime;
+}
+
+static Error SummarizeFile(const char* path, AccessSummary* summary)
+{
+	FileMapping Mapping;
+	Error ReturnedError = File_MapRead(path, &Mapping);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	const unsigned char* Data = (const unsigned char*)Mapping.Data;
+	unsigned int Version = (Mapping.Length >= ACCESS_LOG_HEADER_SIZE) ? Bytes_DecodeUInt(Data + 4) : 0;
+	if ((Mapping.Length < ACCESS_LOG_HEADER_SIZE) || (Bytes_DecodeUInt(Data) != ACCESS_LOG_MAGIC)
+		|| ((Version != ACCESS_LOG_VERSION) && (Version != ACCESS_LOG_VERSION_WITHOUT_COMMIT)))
+	{
+		File_Unmap(&Mapping);
+		return Error_CreateError(ErrorCode_InvalidArgument, "AccessLog_Summarize: A file isn't an access log.");
+	}
+
+	// Records cut short by a crash are left out, they lack the end mark.
+	bool HasCommitTime = Version != ACCESS_LOG_VERSION_WITHOUT_COMMIT;
+	size_t RecordSize = HasCommitTime ? ACCESS_RECORD_SIZE : (ACCESS_RECORD_SIZE - ACCESS_RECORD_COMMIT_SIZE);
+	const unsigned char* Records = Data + ACCESS_LOG_HEADER_SIZE;
+	size_t RecordCount = (Mapping.Length - ACCESS_LOG_HEADER_SIZE) / RecordSize;
+	for (size_t i = 0; i < RecordCount; i++)
+	{
+		if (Records[(i * RecordSize) + RecordSize - 1] != ACCESS_RECORD_END_MARK)
+		{
+			continue;
+		}
+
+		// The commit wait usually takes longest for requests which change something.
+		AccessRecord Record;
+		DecodeRecord(Records + (i * RecordSize), HasCommitTime, &Record);
+		unsigned int Route = Record.Route < ROUTE_COUNT ? Record.Route : ACCESS_ROUTE_OTHER;
+		unsigned long long Latency = (unsigned long long)Record.ParseTime + Record.DispatchTime + Record.CommitTime + Record.WriteTime;
+		AddRouteTime(summary->Routes + Route, Latency, Record.StorageTime, Record.CommitTime);
+		summary->RequestCount++;
+	}
+	File_Unmap(&Mapping);
+	return Error_CreateSuccess();
+}
+
+static bool IsAccessLogFileName(const char* name)
+{
+	unsigned int Number;
+	return String_Equals(name, ACCESS_LOG_FILE_NAME) || ParseOldFileName(name, &Number);
+}
+
+/* Summarizes a file, or every access log file in a directory. */
+static Error SummarizePath(const char* path, AccessSummary* summary)
+{
+	if (!Directory_Exists(path))
+	{
+		return SummarizeFile(path, summary);
+	}
+
+	size_t NameCount;
+	char** Names = Directory_List(path, &NameCount);
+	Error ReturnedError = Error_CreateSuccess();
+	for (size_t i = 0; Names && (i < NameCount) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		if (IsAccessLogFileName(Names[i]))
+		{
+			char* FilePath = Directory_CombinePaths(path, Names[i]);
+			ReturnedError = SummarizeFile(FilePath, summary);
+			Memory_Free(FilePath);
+		}
+	}
+	if (Names)
+	{
+		Directory_FreeList(Names, NameCount);
+	}
+	return ReturnedError;
+}
+
+
+// Functions.
+Error AccessLog_Construct(AccessLog* self, const char* rootDirectoryPath, unsigned int sampleInterval, const LogRotation* rotation)
+{
+	Memory_Set((char*)self, sizeof(AccessLog), 0);
+	self->_sampleInterval = sampleInterval;
+	if (sampleInterval == 0)
+	{
+		return Error_CreateSuccess();
+	}
+
+	char* LogDirPath = Directory_CombinePaths(rootDirectoryPath, ACCESS_LOG_DIR_NAME);
+	Directory_CreateAll(LogDirPath);
+	self->_filePath = Directory_CombinePaths(LogDirPath, ACCESS_LOG_FILE_NAME);
+	self->_oldFileDirPath = Directory_CombinePaths(LogDirPath, ACCESS_LOG_OLD_DIR_NAME);
+	Memory_Free(LogDirPath);
+
+	self->_rotation = *rotation;
+	self->_fileDay = GetDay(time(NULL));
+	size_t OldFileCount;
+	unsigned int* OldFileNumbers = ListOldFileNumbers(self->_oldFileDirPath, &OldFileCount);
+	self->_nextOldFileNumber = (OldFileCount > 0) ? OldFileNumbers[OldFileCount - 1] + 1 : 1;
+	Memory_Free(OldFileNumbers);
+
+	// A file left by an older version is rotated away rather than appended to.
+	if (IsOtherVersion(self->_filePath))
+	{
+		RotateLogFile(self);
+	}
+	Error ReturnedError = OpenLogFile(self);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Memory_Free((char*)self->_filePath);
+		Memory_Free((char*)self->_oldFileDirPath);
+		return ReturnedError;
+	}
+
+	ThreadLock_Construct(&self->_lock);
+	ThreadCondition_Construct(&self->_writeCondition);
+	self->_writeBuffer = (unsigned char*)Memory_SafeMalloc(ACCESS_RECORD_SIZE * ACCESS_LOG_RING_CAPACITY);
+	self->_slots = (AccessLogSlot*)Memory_SafeMalloc(sizeof(AccessLogSlot) * ACCESS_LOG_RING_CAPACITY);
+	for (long long i = 0; i < ACCESS_LOG_RING_CAPACITY; i++)
+	{
+		self->_slots[i].Sequence = i;
+	}
+
+	if (!Thread_Start(&self->_writerThread, RunWriter, self))
+	{
+		File_Close(self->_file);
+		Memory_Free(self->_slots);
+		Memory_Free(self->_writeBuffer);
+		Memory_Free((char*)self->_filePath);
+		Memory_Free((char*)self->_oldFileDirPath);
+		Memory_Set((char*)self, sizeof(AccessLog), 0);
+		return Error_CreateError(ErrorCode_IO, "Failed to start access log writer thread.");
+	}
+	return Error_CreateSuccess();
+}
+
+Error AccessLog_Deconstruct(AccessLog* self)
+{
+	if (!self->_slots)
+	{
+		return Error_CreateSuccess();
+	}
+
+	// The writer drains the ring before it returns.
+	Atomic_Store(&self->_isClosing, 1);
+	WakeWriter(self);
+	Thread_Join(&self->_writerThread);
+
+	Error ReturnedError = self->_file ? File_Close(self->_file) : Error_CreateSuccess();
+	self->_file = NULL;
+	Memory_Free(self->_slots);
+	self->_slots = NULL;
+	Memory_Free(self->_writeBuffer);
+	Memory_Free((char*)self->_filePath);
+	Memory_Free((char*)self->_oldFileDirPath);
+	return ReturnedError;
+}
+
+void AccessLog_Add(AccessLog* self, const AccessRecord* record)
+{
+	// The slots only exist while the log is enabled, the file may be missing for a moment after a failed rotation.
+	if (!self->_slots)
+	{
+		return;
+	}
+	if ((self->_sampleInterval > 1) && ((Atomic_Increment(&self->_requestCount) % self->_sampleInterval) != 0))
+	{
+		return;
+	}
+
+	long long Position;
+	if (!TryQueueRecord(self, record, &Position))
+	{
+		Atomic_Increment(&self->DroppedCount);
+		return;
+	}
+
+	// Otherwise the writer only looks at the ring every interval, a burst would fill it before then.
+	if ((Position & ((ACCESS_LOG_RING_CAPACITY / 2) - 1)) == 0)
+	{
+		WakeWriter(self);
+	}
+}
+
+unsigned int AccessLog_FindRoute(const char* target)
+{
+	while (*target == '/')
+	{
+		target++;
+	}
+
+	unsigned int Route = ACCESS_ROUTE_OTHER;
+	size_t RouteLength = 0;
+	for (unsigned int i = ACCESS_ROUTE_OTHER + 1; i < ROUTE_COUNT; i++)
+	{
+		size_t Length = strlen(s_routeNames[i]);
+		char NextCharacter = target[Length];
+		if ((Length > RouteLength) && (strncmp(target, s_routeNames[i], Length) == 0)
+			&& ((NextCharacter == '\0') || (NextCharacter == '/') || (NextCharacter == '?')))
+		{
+			Route = i;
+			RouteLength = Length;
+		}
+	}
+	return Route;
+}
+
+const char* AccessLog_GetRouteName(unsigned int route)
+{
+	return route < ROUTE_COUNT ? s_routeNames[route] : s_routeNames[ACCESS_ROUTE_OTHER];
+}
+
+unsigned long long AccessLog_BeginStorage()
+{
+	s_storageDepth++;
+	return Time_GetMicroseconds();
+}
+
+void AccessLog_EndStorage(unsigned long long startMicroseconds)
+{
+	s_storageDepth--;
+	if (s_storageDepth == 0)
+	{
+		s_storageTime += Time_GetMicroseconds() - startMicroseconds;
+	}
+}
+
+unsigned int AccessLog_TakeStorageTime()
+{
+	unsigned long long StorageTime = s_storageTime;
+	s_storageTime = 0;
+	return StorageTime > UINT_MAX ? UINT_MAX : (unsigned int)StorageTime;
+}
+
+Error AccessLog_Summarize(const char* const* paths, size_t pathCount, FILE* output)
+{
+	AccessSummary Summary;
+	Summary.RequestCount = 0;
+	Summary.Routes = (RouteSummary*)Memory_SafeMalloc(sizeof(RouteSummary) * ROUTE_COUNT);
+	Memory_Set((char*)Summary.Routes, sizeof(RouteSummary) * ROUTE_COUNT, 0);
+
+	Error ReturnedError = Error_CreateSuccess();
+	for (size_t i = 0; (i < pathCount) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		ReturnedError = SummarizePath(paths[i], &Summary);
+	}
+
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		fprintf(output, "%zu requests, times in milliseconds.\n", Summary.RequestCount);
+		fprintf(output, "%-24s %10s %10s %10s %10s %10s %12s %12s\n", "route", "count", "p50", "p90", "p99", "max", "avg storage",
+			"avg commit");
+	}
+	for (size_t i = 0; i < ROUTE_COUNT; i++)
+	{
+		RouteSummary* Route = Summary.Routes + i;
+		if ((Route->Count > 0) && (ReturnedError.Code == ErrorCode_Success))
+		{
+			qsort(Route->Times, Route->Count, sizeof(unsigned long long), CompareTimes);
+			fprintf(output, "%-24s %10zu %10.3f %10.3f %10.3f %10.3f %12.3f %12.3f\n", s_routeNames[i], Route->Count,
+				GetPercentile(Route->Times, Route->Count, 50), GetPercentile(Route->Times, Route->Count, 90),
+				GetPercentile(Route->Times, Route->Count, 99), GetPercentile(Route->Times, Route->Count, 100),
+				(double)Route->StorageTotal / (double)Route->Count / 1000.0, (double)Route->CommitTotal / (double)Route->Count / 1000.0);
+		}
+		Memory_Free(Route->Times);
+	}
+	Memory_Free(Summary.Routes);
+	return ReturnedError;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+#include <stdbool.h>
+#include <stdio.h>
+#include "LttErrors.h"
+#include "LTTThread.h"
+#include "HttpListener.h"
+#include "Logger.h"
+
+
+// Macros.
+/* Must be a power of two. */
+#define ACCESS_LOG_RING_CAPACITY 4096
+
+#define ACCESS_LOG_FILE_NAME "access.bin"
+
+/* Rotated files are moved to the old log directory as "access <number>.bin", counting up. */
+#define ACCESS_LOG_OLD_FILE_PREFIX "access "
+#define ACCESS_LOG_FILE_EXTENSION ".bin"
+
+#define ACCESS_ROUTE_OTHER 0
+
+
+// Types.
+/* One handled request. Times are in microseconds, storage time is part of the dispatch time. Commit time is the wait
+* for the changes of the request's batch to last, which comes after dispatching and before writing the response. */
+typedef struct AccessRecordStruct
+{
+	unsigned long long Time;
+	HttpMethod Method;
+	unsigned int Route;
+	unsigned int Status;
+	unsigned int BytesIn;
+	unsigned int BytesOut;
+	unsigned long long AccountID;
+
+	unsigned int ParseTime;
+	unsigned int DispatchTime;
+	unsigned int StorageTime;
+	unsigned int CommitTime;
+	unsigned int WriteTime;
+} AccessRecord;
+
+/* A ring slot, ready for the writer once its sequence is one past its position. */
+typedef struct AccessLogSlotStruct
+{
+	volatile long long Sequence;
+	AccessRecord Record;
+} AccessLogSlot;
+
+/* Appends fixed size binary records: [magic][version] followed by [time][account][bytes in][bytes out]
+* [parse][dispatch][storage][commit][write][status][method][route][end mark], numbers are stored little-endian.
+* Request threads never wait on it, a record which finds the ring full is dropped and counted instead.
+* The writer rotates the file like the text log, old files aren't compressed so that they can still be summarized. */
+typedef struct AccessLogStruct
+{
+	FILE* _file;
+	AccessLogSlot* _slots;
+	volatile long long _enqueuePosition;
+	long long _dequeuePosition;
+
+	Thread _writerThread;
+	ThreadLock _lock;
+	ThreadCondition _writeCondition;
+	volatile long long _isClosing;
+
+	/* One in this many requests is recorded, 0 records none. */
+	unsigned int _sampleInterval;
+	volatile long long _requestCount;
+	volatile long long DroppedCount;
+
+	/* Only used by the writer. The file is NULL while a rotated file couldn't be reopened. */
+	unsigned char* _writeBuffer;
+	LogRotation _rotation;
+	unsigned long long _fileLength;
+	int _fileDay;
+	unsigned int _nextOldFileNumber;
+	const char* _filePath;
+	const char* _oldFileDirPath;
+} AccessLog;
+
+
+// Functions.
+/// <summary>
+/// Opens the access log in the log directory, appending to the records of earlier runs.
+/// </summary>
+/// <param name="sampleInterval">Records one in this many requests, 0 disables the log.</param>
+/// <param name="rotation">When the file is rotated and how many old files are kept, old files are never compressed.</param>
+Error AccessLog_Construct(AccessLog* self, const char* rootDirectoryPath, unsigned int sampleInterval, const LogRotation* rotation);
+
+/// <summary>
+/// Writes the queued records and closes the file.
+/// </summary>
+Error AccessLog_Deconstruct(AccessLog* self);
+
+/// <summary>
+/// Queues the record if the request is sampled, never waits.
+/// </summary>
+void AccessLog_Add(AccessLog* self, const AccessRecord* record);
+
+/// <summary>
+/// Finds the route a request target belongs to, targets no route matches are ACCESS_ROUTE_OTHER.
+/// </summary>
+unsigned int AccessLog_FindRoute(const char* target);
+
+const char* AccessLog_GetRouteName(unsigned int route);
+
+/// <summary>
+/// Starts timing storage access for the calling thread's current request. Nested accesses are only counted once.
+/// </summary>
+/// <returns>Start time to pass to AccessLog_EndStorage.</returns>
+unsigned long long AccessLog_BeginStorage();
+
+void AccessLog_EndStorage(unsigned long long startMicroseconds);
+
+/// <summary>
+/// Returns the calling thread's storage time gathered since the last call and resets it.
+/// </summary>
+unsigned int AccessLog_TakeStorageTime();
+
+/// <summary>
+/// Reads access log files and prints request counts and latency percentiles for each route over all of them.
+/// </summary>
+/// <param name="paths">Access log files, or directories whose current and rotated access log files are read.</param>
+Error AccessLog_Summarize(const char* const* paths, size_t pathCount, FILE* output);
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "BulkLoader.h"
+#include "LTTThread.h"
+#include "Memory.h"
+
+
+// Macros.
+#define IDS_PER_CHUNK 64
+#define WORKERS_PER_PROCESSOR 2
+#define MAX_WORKER_COUNT 64
+
+
+// Types.
+typedef struct BulkLoadStruct
+{
+	const unsigned long long* IDs;
+	size_t IDCount;
+	BulkLoaderFunction Function;
+	void* Argument;
+
+	volatile long long NextChunk;
+	volatile long long IsFailed;
+	ThreadLock ErrorLock;
+	Error FirstError;
+} BulkLoad;
+
+typedef struct BulkLoadWorkerStruct
+{
+	BulkLoad* Load;
+	size_t Index;
+	Thread WorkerThread;
+	bool IsStarted;
+} BulkLoadWorker;
+
+
+// Static functions.
+static void RunWorker(void* argument)
+{
+	BulkLoadWorker* Worker = (BulkLoadWorker*)argument;
+	BulkLoad* Load = Worker->Load;
+
+	while (!Atomic_Load(&Load->IsFailed))
+	{
+		size_t Start = (size_t)(Atomic_Increment(&Load->NextChunk) - 1) * IDS_PER_CHUNK;
+		if (Start >= Load->IDCount)
+		{
+			return;
+		}
+
+		size_t End = Start + IDS_PER_CHUNK < Load->IDCount ? Start + IDS_PER_CHUNK : Load->IDCount;
+		for (size_t i = Start; i < End; i++)
+		{
+			Error ReturnedError = Load->Function(Load->IDs[i], Worker->Index, Load->Argument);
+			if (ReturnedError.Code == ErrorCode_Success)
+			{
+				continue;
+			}
+
+			ThreadLock_Lock(&Load->ErrorLock);
+			if (!Load->IsFailed)
+			{
+				Load->FirstError = ReturnedError;
+				Atomic_Store(&Load->IsFailed, 1);
+			}
+			else
+			{
+				Error_Deconstruct(&ReturnedError);
+			}
+			ThreadLock_Unlock(&Load->ErrorLock);
+			return;
+		}
+	}
+}
+
+
+// Functions.
+size_t BulkLoader_GetWorkerCount(unsigned int configuredCount)
+{
+	size_t Count = configuredCount > 0 ? configuredCount : (size_t)Thread_GetProcessorCount() * WORKERS_PER_PROCESSOR;
+	return Count < MAX_WORKER_COUNT ? Count : MAX_WORKER_COUNT;
+}
+
+Error BulkLoader_Run(const unsigned long long* ids, size_t idCount, size_t workerCount, BulkLoaderFunction function, void* argument)
+{
+	BulkLoad Load;
+	Load.IDs = ids;
+	Load.IDCount = idCount;
+	Load.Function = function;
+	Load.Argument = argument;
+	Load.NextChunk = 0;
+	Load.IsFailed = 0;
+	ThreadLock_Construct(&Load.ErrorLock);
+	Load.FirstError = Error_CreateSuccess();
+
+	// Workers past the number of chunks would have nothing to load.
+	size_t ChunkCount = (idCount + IDS_PER_CHUNK - 1) / IDS_PER_CHUNK;
+	if (workerCount > ChunkCount)
+	{
+		workerCount = ChunkCount;
+	}
+	if (workerCount == 0)
+	{
+		workerCount = 1;
+	}
+	BulkLoadWorker* Workers = (BulkLoadWorker*)Memory_SafeMalloc(sizeof(BulkLoadWorker) * workerCount);
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		Workers[i].Load = &Load;
+		Workers[i].Index = i;
+		Workers[i].IsStarted = false;
+	}
+
+	// Chunks are claimed as workers get to them, so workers which fail to start just leave more work to the others.
+	for (size_t i = 1; i < workerCount; i++)
+	{
+		Workers[i].IsStarted = Thread_Start(&Workers[i].WorkerThread, RunWorker, Workers + i);
+	}
+	RunWorker(Workers);
+
+	for (size_t i = 1; i < workerCount; i++)
+	{
+		if (Workers[i].IsStarted)
+		{
+			Thread_Join(&Workers[i].WorkerThread);
+		}
+	}
+
+	Memory_Free(Workers);
+	return Load.FirstError;
+}
\ No newline at end of file
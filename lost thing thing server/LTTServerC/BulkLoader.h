@@ -0,0 +1,27 @@
+#pragma once
+#include <stddef.h>
+#include "LttErrors.h"
+
+
+// Types.
+/// <summary>
+/// Loads a single record. Called from several worker threads at once, anything it writes should belong to the worker.
+/// </summary>
+/// <param name="workerIndex">Index of the calling worker, below the worker count the load was started with.</param>
+typedef Error (*BulkLoaderFunction)(unsigned long long id, size_t workerIndex, void* argument);
+
+
+// Functions.
+/// <summary>
+/// Number of workers to load with. Loading mostly waits on reads, so by default there are more workers than processors
+/// to keep several reads in flight on each one.
+/// </summary>
+/// <param name="configuredCount">Count from the configuration, 0 to pick one from the processor count.</param>
+size_t BulkLoader_GetWorkerCount(unsigned int configuredCount);
+
+/// <summary>
+/// Calls the function for every ID of the list on a pool of workers, the calling thread being one of them.
+/// Workers claim chunks of consecutive IDs, so reads of neighbouring records stay on the same worker.
+/// </summary>
+/// <returns>The first error returned by the function, the IDs not yet loaded by then are skipped.</returns>
+Error BulkLoader_Run(const unsigned long long* ids, size_t idCount, size_t workerCount, BulkLoaderFunction function, void* argument);
\ No newline at end of file
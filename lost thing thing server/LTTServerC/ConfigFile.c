@@ -3,6 +3,7 @@
 #include "String.h"
 #include "Memory.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include "Logger.h"
 #include "LTTErrors.h"
 #include <stddef.h>
@@ -11,6 +12,11 @@
 // Macros.
 #define DEFAULT_EMAIL_DOMAIN "marupe.edu.lv"
 #define DEFAULT_ADDRESS "127.0.0.1"
+#define DEFAULT_CACHE_MAX_DIRTY_AGE 5
+#define DEFAULT_INDEX_LOADER_THREADS 0
+#define DEFAULT_ACCESS_LOG_SAMPLE_INTERVAL 1
+#define DEFAULT_LOG_MAX_FILE_MEGABYTES 64
+#define DEFAULT_TRACE_SLOW_REQUEST_MILLISECONDS 0
 
 #define DOMAIN_LIST_CAPACITY 4
 #define DOMAIN_LIST_GROWTH 2
@@ -22,6 +28,24 @@
 
 #define KEY_ADDRESS "address"
 #define KEY_EMAIL_DOMAIN "email-domain"
+#define KEY_SEARCH_FOLD_DIACRITICS "search-fold-diacritics"
+#define KEY_DATABASE_SYNC_WRITES "database-sync-writes"
+#define KEY_DATABASE_UPGRADE_FORMAT "database-upgrade-format"
+#define KEY_DATABASE_USE_STORE "database-use-store"
+/* Replaced by the store, whose startup moves the records of the segment files into it. */
+#define KEY_DATABASE_USE_SEGMENTS "database-use-segments"
+#define KEY_CACHE_MAX_DIRTY_AGE "cache-max-dirty-age"
+#define KEY_INDEX_LOADER_THREADS "index-loader-threads"
+#define KEY_INDEX_LAZY_STARTUP "index-lazy-startup"
+#define KEY_ACCESS_LOG_SAMPLE_INTERVAL "access-log-sample-interval"
+#define KEY_LOG_MAX_FILE_MEGABYTES "log-max-file-megabytes"
+#define KEY_LOG_ROTATE_DAILY "log-rotate-daily"
+#define KEY_LOG_COMPRESS_OLD "log-compress-old"
+#define KEY_LOG_MAX_OLD_FILES "log-max-old-files"
+#define KEY_TRACE_SLOW_REQUEST_MILLISECONDS "trace-slow-request-milliseconds"
+
+#define VALUE_TRUE "true"
+#define VALUE_FALSE "false"
 
 
 // Static functions.
@@ -86,6 +110,34 @@ static Error SetAddress(ServerConfig* config, const char* address)
 	return Error_CreateSuccess();
 }
 
+static Error ParseBool(const char* value, bool* result)
+{
+	if (String_EqualsCaseInsensitive(value, VALUE_TRUE))
+	{
+		*result = true;
+	}
+	else if (String_EqualsCaseInsensitive(value, VALUE_FALSE))
+	{
+		*result = false;
+	}
+	else
+	{
+		return Error_CreateError(ErrorCode_InvalidConfigFile, "Expected \"true\" or \"false\" as a boolean value in config file.");
+	}
+	return Error_CreateSuccess();
+}
+
+static Error ParseUnsignedInt(const char* value, unsigned int* result)
+{
+	size_t ValueLength = String_LengthBytes(value);
+	if ((ValueLength == 0) || (ValueLength > 9) || !String_IsNumeric(value))
+	{
+		return Error_CreateError(ErrorCode_InvalidConfigFile, "Expected a positive whole number as a value in config file.");
+	}
+	*result = (unsigned int)strtoul(value, NULL, 10);
+	return Error_CreateSuccess();
+}
+
 static Error HandleConfigurationKeyValuePar(ServerConfig* config, Logger* logger, const char* key, const char* value)
 {
 	if (String_EqualsCaseInsensitive(key, KEY_EMAIL_DOMAIN))
@@ -100,6 +152,121 @@ static Error HandleConfigurationKeyValuePar(ServerConfig* config, Logger* logger
 			return ReturnedError;
 		}
 	}
+	else if (String_EqualsCaseInsensitive(key, KEY_SEARCH_FOLD_DIACRITICS))
+	{
+		Error ReturnedError = ParseBool(value, &config->FoldSearchDiacritics);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_DATABASE_SYNC_WRITES))
+	{
+		Error ReturnedError = ParseBool(value, &config->SyncDatabaseWrites);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_DATABASE_UPGRADE_FORMAT))
+	{
+		Error ReturnedError = ParseBool(value, &config->UpgradeDatabaseFormat);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_DATABASE_USE_STORE))
+	{
+		Error ReturnedError = ParseBool(value, &config->UseDatabaseStore);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_DATABASE_USE_SEGMENTS))
+	{
+		// Only turns the store on, so that it doesn't override the newer key.
+		bool UseSegments;
+		Error ReturnedError = ParseBool(value, &UseSegments);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+		config->UseDatabaseStore |= UseSegments;
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_CACHE_MAX_DIRTY_AGE))
+	{
+		Error ReturnedError = ParseUnsignedInt(value, &config->CacheMaxDirtyAge);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_INDEX_LOADER_THREADS))
+	{
+		Error ReturnedError = ParseUnsignedInt(value, &config->IndexLoaderThreads);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_INDEX_LAZY_STARTUP))
+	{
+		Error ReturnedError = ParseBool(value, &config->LazyIndexStartup);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_ACCESS_LOG_SAMPLE_INTERVAL))
+	{
+		Error ReturnedError = ParseUnsignedInt(value, &config->AccessLogSampleInterval);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_LOG_MAX_FILE_MEGABYTES))
+	{
+		Error ReturnedError = ParseUnsignedInt(value, &config->LogMaxFileMegabytes);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_LOG_ROTATE_DAILY))
+	{
+		Error ReturnedError = ParseBool(value, &config->LogRotateDaily);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_LOG_COMPRESS_OLD))
+	{
+		Error ReturnedError = ParseBool(value, &config->LogCompressOld);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_LOG_MAX_OLD_FILES))
+	{
+		Error ReturnedError = ParseUnsignedInt(value, &config->LogMaxOldFiles);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	else if (String_EqualsCaseInsensitive(key, KEY_TRACE_SLOW_REQUEST_MILLISECONDS))
+	{
+		Error ReturnedError = ParseUnsignedInt(value, &config->TraceSlowRequestMilliseconds);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
 	else
 	{
 		char Message[KEY_BUFFER_SIZE * 2];
@@ -157,6 +324,19 @@ static void ServerConfigConstruct(ServerConfig* config)
 	config->AcceptedDomains = (char**)Memory_SafeMalloc(sizeof(char**) * DOMAIN_LIST_CAPACITY);
 	config->_acceptedDomainCapacity = DOMAIN_LIST_CAPACITY;
 	config->Address[0] = '\0';
+	config->FoldSearchDiacritics = false;
+	config->SyncDatabaseWrites = true;
+	config->UpgradeDatabaseFormat = false;
+	config->UseDatabaseStore = false;
+	config->CacheMaxDirtyAge = DEFAULT_CACHE_MAX_DIRTY_AGE;
+	config->IndexLoaderThreads = DEFAULT_INDEX_LOADER_THREADS;
+	config->LazyIndexStartup = false;
+	config->AccessLogSampleInterval = DEFAULT_ACCESS_LOG_SAMPLE_INTERVAL;
+	config->LogMaxFileMegabytes = DEFAULT_LOG_MAX_FILE_MEGABYTES;
+	config->LogRotateDaily = false;
+	config->LogCompressOld = false;
+	config->LogMaxOldFiles = 0;
+	config->TraceSlowRequestMilliseconds = DEFAULT_TRACE_SLOW_REQUEST_MILLISECONDS;
 }
 
 
@@ -1,5 +1,6 @@
 #pragma once
 #include <stddef.h>
+#include <stdbool.h>
 #include "LttErrors.h"
 #include "LTTServerC.h"
 
@@ -16,6 +17,28 @@ typedef struct ServerConfigStruct
 	const char** AcceptedDomains;
 	size_t AcceptedDomainCount;
 	size_t _acceptedDomainCapacity;
+
+	bool FoldSearchDiacritics;
+	bool SyncDatabaseWrites;
+	bool UpgradeDatabaseFormat;
+	bool UseDatabaseStore;
+	/* Seconds a changed cached record may go unwritten before the background flusher writes it. */
+	unsigned int CacheMaxDirtyAge;
+	/* Threads reading records while the search indexes are rebuilt, 0 picks a count from the processor count. */
+	unsigned int IndexLoaderThreads;
+	/* Starts serving before the search indexes are rebuilt, the rebuild runs in the background and searches wait for it. */
+	bool LazyIndexStartup;
+	/* Records one in this many requests in the access log, 0 turns the access log off. */
+	unsigned int AccessLogSampleInterval;
+	/* Size the log file is rotated at, 0 doesn't rotate by size. */
+	unsigned int LogMaxFileMegabytes;
+	bool LogRotateDaily;
+	/* Compresses rotated log files with gzip. */
+	bool LogCompressOld;
+	/* Rotated log files kept, 0 keeps all of them. */
+	unsigned int LogMaxOldFiles;
+	/* Requests taking longer are written to the traces directory as Chrome trace event JSON, 0 turns tracing off. */
+	unsigned int TraceSlowRequestMilliseconds;
 } ServerConfig;
 
 
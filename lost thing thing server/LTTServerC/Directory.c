@@ -12,6 +12,8 @@
 // Macros.
 #define DIR_NAME_MAX_LENGTH 512
 #define EXTENSION_SPEARATOR '.'
+#define LIST_CAPACITY 16
+#define LIST_GROWTH 2
 
 
 // Functions.
@@ -130,4 +132,54 @@ char* Directory_ChangePathExtension(const char* path, const char* newExtension)
 	}
 	StringBuilder_Append(&Builder, newExtension);
 	return Builder.Data;
+}
+
+char** Directory_List(const char* path, size_t* entryCount)
+{
+	*entryCount = 0;
+	char* Pattern = Directory_CombinePaths(path, "*");
+	WIN32_FIND_DATAA FindData;
+	HANDLE FindHandle = FindFirstFileA(Pattern, &FindData);
+	Memory_Free(Pattern);
+	if (FindHandle == INVALID_HANDLE_VALUE)
+	{
+		return NULL;
+	}
+
+	size_t Capacity = LIST_CAPACITY;
+	size_t Count = 0;
+	char** Names = (char**)Memory_SafeMalloc(sizeof(char*) * Capacity);
+	do
+	{
+		if (String_Equals(FindData.cFileName, ".") || String_Equals(FindData.cFileName, ".."))
+		{
+			continue;
+		}
+
+		if (Count == Capacity)
+		{
+			Capacity *= LIST_GROWTH;
+			Names = (char**)Memory_SafeRealloc(Names, sizeof(char*) * Capacity);
+		}
+		Names[Count] = String_CreateCopy(FindData.cFileName);
+		Count++;
+	} while (FindNextFileA(FindHandle, &FindData));
+	FindClose(FindHandle);
+
+	if (Count == 0)
+	{
+		Memory_Free(Names);
+		return NULL;
+	}
+	*entryCount = Count;
+	return Names;
+}
+
+void Directory_FreeList(char** names, size_t entryCount)
+{
+	for (size_t i = 0; i < entryCount; i++)
+	{
+		Memory_Free(names[i]);
+	}
+	Memory_Free(names);
 }
\ No newline at end of file
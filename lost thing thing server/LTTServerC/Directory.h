@@ -1,6 +1,7 @@
 #pragma once
 
 #include "LTTErrors.h"
+#include <stddef.h>
 
 #define Directory_IsPathSeparator(character) (character == '\\') || (character == '/')
 #define PATH_SEPARATOR '/'
@@ -56,6 +57,19 @@ char* Directory_CombinePaths(const char* path1, const char* path2);
 /// <returns>Name of the file or directory (stored on the heap)</returns>
 char* Directory_GetName(const char* path);
 
+/// <summary>
+/// Lists the names of the files and directories directly inside a directory, with a single pass over the directory.
+/// </summary>
+/// <param name="path">A path to a directory.</param>
+/// <param name="entryCount">Receives the number of names.</param>
+/// <returns>Array of names (the array and each name are stored on the heap), NULL if there are none or the directory can't be read.</returns>
+char** Directory_List(const char* path, size_t* entryCount);
+
+/// <summary>
+/// Frees the names returned by Directory_List.
+/// </summary>
+void Directory_FreeList(char** names, size_t entryCount);
+
 /// <summary>
 /// Changes the file extension in the given path.
 /// </summary>
@@ -0,0 +1,222 @@
+#include "Epoch.h"
+#include "LTTThread.h"
+#include "Memory.h"
+#include "LttErrors.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+
+// Macros.
+#define CACHE_LINE_SIZE 64
+
+#define RETIRED_LIST_CAPACITY 64
+#define RETIRED_LIST_GROWTH 2
+
+#define COLLECT_INTERVAL 64
+
+/* Data retired during epoch N may still be read by threads which entered during epoch N, those are gone by N + 2. */
+#define EPOCHS_UNTIL_FREE 2
+
+/* Participant state holds the entered epoch shifted left by one, the lowest bit is set while the thread is inside. */
+#define STATE_ACTIVE_BIT 1
+
+
+// Types.
+typedef struct EpochParticipantStruct
+{
+	volatile long long State;
+	volatile long long IsClaimed;
+	char _padding[CACHE_LINE_SIZE - (sizeof(long long) * 2)];
+} EpochParticipant;
+
+typedef struct RetiredDataStruct
+{
+	void* Data;
+	EpochFreeFunction FreeFunction;
+	long long RetireEpoch;
+} RetiredData;
+
+
+// Static variables.
+static volatile long long s_globalEpoch = 0;
+static EpochParticipant s_participants[EPOCH_MAX_PARTICIPANTS];
+
+static ThreadLock s_retiredLock = { 0 }; // A zeroed SRWLOCK is unlocked.
+static RetiredData* s_retiredData = NULL;
+static size_t s_retiredCount = 0;
+static size_t s_retiredCapacity = 0;
+static size_t s_retiredSinceCollect = 0;
+
+static THREAD_LOCAL EpochParticipant* s_threadParticipant = NULL;
+static THREAD_LOCAL int s_nestingDepth = 0;
+
+
+// Static functions.
+static EpochParticipant* ClaimParticipant()
+{
+	for (int i = 0; i < EPOCH_MAX_PARTICIPANTS; i++)
+	{
+		if (Atomic_CompareExchange(&s_participants[i].IsClaimed, 0, 1))
+		{
+			return &s_participants[i];
+		}
+	}
+
+	Error_AbortProgram("Too many threads are reading epoch protected data.");
+	return NULL;
+}
+
+static bool TryAdvanceEpoch()
+{
+	long long CurrentEpoch = Atomic_Load(&s_globalEpoch);
+
+	for (int i = 0; i < EPOCH_MAX_PARTICIPANTS; i++)
+	{
+		if (!Atomic_Load(&s_participants[i].IsClaimed))
+		{
+			continue;
+		}
+
+		long long State = Atomic_Load(&s_participants[i].State);
+		if ((State & STATE_ACTIVE_BIT) && ((State >> 1) != CurrentEpoch))
+		{
+			return false;
+		}
+	}
+
+	return Atomic_CompareExchange(&s_globalEpoch, CurrentEpoch, CurrentEpoch + 1);
+}
+
+static void EnsureRetiredCapacity(size_t capacity)
+{
+	if (s_retiredData == NULL)
+	{
+		s_retiredCapacity = RETIRED_LIST_CAPACITY;
+		s_retiredData = (RetiredData*)Memory_SafeMalloc(sizeof(RetiredData) * s_retiredCapacity);
+	}
+
+	if (s_retiredCapacity >= capacity)
+	{
+		return;
+	}
+
+	while (s_retiredCapacity < capacity)
+	{
+		s_retiredCapacity *= RETIRED_LIST_GROWTH;
+	}
+	s_retiredData = (RetiredData*)Memory_SafeRealloc(s_retiredData, sizeof(RetiredData) * s_retiredCapacity);
+}
+
+static void FreeRetiredBefore(long long epoch)
+{
+	size_t KeptCount = 0;
+	for (size_t i = 0; i < s_retiredCount; i++)
+	{
+		if (s_retiredData[i].RetireEpoch < epoch)
+		{
+			s_retiredData[i].FreeFunction(s_retiredData[i].Data);
+			continue;
+		}
+
+		s_retiredData[KeptCount] = s_retiredData[i];
+		KeptCount++;
+	}
+	s_retiredCount = KeptCount;
+}
+
+
+// Functions.
+void Epoch_Enter()
+{
+	s_nestingDepth++;
+	if (s_nestingDepth > 1)
+	{
+		return;
+	}
+
+	if (!s_threadParticipant)
+	{
+		s_threadParticipant = ClaimParticipant();
+	}
+
+	// Epoch and active bit are published together with a full barrier, so no shared pointer is read before writers can see them.
+	Atomic_Exchange(&s_threadParticipant->State, (Atomic_Load(&s_globalEpoch) << 1) | STATE_ACTIVE_BIT);
+}
+
+void Epoch_Exit()
+{
+	s_nestingDepth--;
+	if (s_nestingDepth > 0)
+	{
+		return;
+	}
+
+	Atomic_Store(&s_threadParticipant->State, s_threadParticipant->State & ~(long long)STATE_ACTIVE_BIT);
+}
+
+void Epoch_Retire(void* data, EpochFreeFunction freeFunction)
+{
+	if (!data)
+	{
+		return;
+	}
+
+	// The unlinking store must be visible before the epoch is read, otherwise a reader could enter late and still find the data.
+	Atomic_Fence();
+	long long RetireEpoch = Atomic_Load(&s_globalEpoch);
+
+	ThreadLock_Lock(&s_retiredLock);
+
+	EnsureRetiredCapacity(s_retiredCount + 1);
+	s_retiredData[s_retiredCount].Data = data;
+	s_retiredData[s_retiredCount].FreeFunction = freeFunction;
+	s_retiredData[s_retiredCount].RetireEpoch = RetireEpoch;
+	s_retiredCount++;
+	s_retiredSinceCollect++;
+	bool IsCollectDue = s_retiredSinceCollect >= COLLECT_INTERVAL;
+
+	ThreadLock_Unlock(&s_retiredLock);
+
+	if (IsCollectDue)
+	{
+		Epoch_Collect();
+	}
+}
+
+void Epoch_Collect()
+{
+	TryAdvanceEpoch();
+
+	ThreadLock_Lock(&s_retiredLock);
+	FreeRetiredBefore(Atomic_Load(&s_globalEpoch) - EPOCHS_UNTIL_FREE + 1);
+	s_retiredSinceCollect = 0;
+	ThreadLock_Unlock(&s_retiredLock);
+}
+
+void Epoch_ReclaimAll()
+{
+	ThreadLock_Lock(&s_retiredLock);
+	for (size_t i = 0; i < s_retiredCount; i++)
+	{
+		s_retiredData[i].FreeFunction(s_retiredData[i].Data);
+	}
+	Memory_Free(s_retiredData);
+	s_retiredData = NULL;
+	s_retiredCount = 0;
+	s_retiredCapacity = 0;
+	s_retiredSinceCollect = 0;
+	ThreadLock_Unlock(&s_retiredLock);
+}
+
+void Epoch_UnregisterThread()
+{
+	if (!s_threadParticipant)
+	{
+		return;
+	}
+
+	Atomic_Store(&s_threadParticipant->State, 0);
+	Atomic_Store(&s_threadParticipant->IsClaimed, 0);
+	s_threadParticipant = NULL;
+	s_nestingDepth = 0;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+
+// Macros.
+#define EPOCH_MAX_PARTICIPANTS 128
+
+
+// Types.
+typedef void (*EpochFreeFunction)(void* data);
+
+
+// Functions.
+/// <summary>
+/// Marks the calling thread as reading shared data. Memory retired while the thread is inside stays allocated until it exits.
+/// Calls may be nested.
+/// </summary>
+void Epoch_Enter();
+
+void Epoch_Exit();
+
+/// <summary>
+/// Schedules data which has been unlinked from a shared structure to be freed once no reader can still reference it.
+/// </summary>
+/// <param name="data">The unlinked data.</param>
+/// <param name="freeFunction">The function used to free the data.</param>
+void Epoch_Retire(void* data, EpochFreeFunction freeFunction);
+
+/// <summary>
+/// Tries to advance the global epoch and frees all retired data which is no longer reachable.
+/// </summary>
+void Epoch_Collect();
+
+/// <summary>
+/// Frees all retired data. Must only be called when no other thread is reading, for example during shutdown.
+/// </summary>
+void Epoch_ReclaimAll();
+
+/// <summary>
+/// Releases the calling thread's participant slot, should be called by threads which exit before the server does.
+/// </summary>
+void Epoch_UnregisterThread();
\ No newline at end of file
@@ -7,10 +7,19 @@
 #include <String.h>
 #include <sys/stat.h>
 #include <Windows.h>
+#include <io.h>
 
 
 // Macros.
-#define MODE_STRING_LENGTH 3
+#define MODE_STRING_LENGTH 4
+
+/* Below this size a single read is cheaper than setting up a mapping. */
+#define MAPPING_MIN_FILE_SIZE (64 * 1024)
+
+#define TEMP_FILE_SUFFIX_LENGTH 32
+
+/* WriteFile and ReadFile take a 32-bit length. */
+#define MAX_SINGLE_WRITE_SIZE 0x40000000
 
 
 // Static functions.
@@ -93,6 +102,10 @@ FILE* File_Open(const char* path, File_OpenMode mode, Error* error)
 			strcpy_s(OpenMode, MODE_STRING_LENGTH, "a+");
 			break;
 
+		case FileOpenMode_ReadUpdateBinary:
+			strcpy_s(OpenMode, MODE_STRING_LENGTH, "r+b");
+			break;
+
 		default:
 			if (error)
 			{
@@ -237,4 +250,229 @@ _Bool File_Exists(const char* path)
 Error File_Move(const char* sourcePath, const char* destinationPath)
 {
 	return MoveFileA(sourcePath, destinationPath) ? Error_CreateSuccess() : Error_CreateError(ErrorCode_IO, "File_Move: Failed to move file");
+}
+
+Error File_Replace(const char* sourcePath, const char* destinationPath, _Bool flushToDisk)
+{
+	DWORD MoveFlags = MOVEFILE_REPLACE_EXISTING | (flushToDisk ? MOVEFILE_WRITE_THROUGH : 0);
+	return MoveFileExA(sourcePath, destinationPath, MoveFlags) ? Error_CreateSuccess()
+		: Error_CreateError(ErrorCode_IO, "File_Replace: Failed to replace file.");
+}
+
+Error File_GetLength(FILE* file, unsigned long long* length)
+{
+	if (_fseeki64(file, 0, SEEK_END))
+	{
+		return Error_CreateError(ErrorCode_IO, "File_GetLength: Failed to seek to file end.");
+	}
+
+	long long Length = _ftelli64(file);
+	if (Length < 0)
+	{
+		return Error_CreateError(ErrorCode_IO, "File_GetLength: Failed to tell the file's stream position.");
+	}
+
+	*length = (unsigned long long)Length;
+	return Error_CreateSuccess();
+}
+
+Error File_ReadAt(FILE* file, unsigned long long offset, char* dataBuffer, size_t count)
+{
+	if (_fseeki64(file, (long long)offset, SEEK_SET))
+	{
+		return Error_CreateError(ErrorCode_IO, "File_ReadAt: Failed to seek.");
+	}
+
+	return fread(dataBuffer, 1, count, file) == count ? Error_CreateSuccess()
+		: Error_CreateError(ErrorCode_IO, "File_ReadAt: Failed to read bytes from file.");
+}
+
+Error File_ReadPositional(FILE* file, unsigned long long offset, char* dataBuffer, size_t count)
+{
+	HANDLE Handle = (HANDLE)_get_osfhandle(_fileno(file));
+	if (Handle == INVALID_HANDLE_VALUE)
+	{
+		return Error_CreateError(ErrorCode_IO, "File_ReadPositional: Failed to get the file's handle.");
+	}
+
+	size_t Position = 0;
+	while (Position < count)
+	{
+		DWORD ChunkSize = (DWORD)((count - Position) < MAX_SINGLE_WRITE_SIZE ? (count - Position) : MAX_SINGLE_WRITE_SIZE);
+		OVERLAPPED Overlapped;
+		Memory_Set((char*)&Overlapped, sizeof(OVERLAPPED), 0);
+		Overlapped.Offset = (DWORD)(offset + Position);
+		Overlapped.OffsetHigh = (DWORD)((offset + Position) >> 32);
+
+		DWORD ReadSize;
+		if (!ReadFile(Handle, dataBuffer + Position, ChunkSize, &ReadSize, &Overlapped) || (ReadSize == 0))
+		{
+			return Error_CreateError(ErrorCode_IO, "File_ReadPositional: Failed to read bytes from file.");
+		}
+		Position += ReadSize;
+	}
+	return Error_CreateSuccess();
+}
+
+Error File_WriteAt(FILE* file, unsigned long long offset, const char* data, size_t dataLength)
+{
+	if (_fseeki64(file, (long long)offset, SEEK_SET))
+	{
+		return Error_CreateError(ErrorCode_IO, "File_WriteAt: Failed to seek.");
+	}
+
+	return fwrite(data, 1, dataLength, file) == dataLength ? Error_CreateSuccess()
+		: Error_CreateError(ErrorCode_IO, "File_WriteAt: Failed to write bytes to file.");
+}
+
+Error File_Sync(FILE* file)
+{
+	if (fflush(file))
+	{
+		return Error_CreateError(ErrorCode_IO, "File_Sync: Failed to flush file.");
+	}
+
+	HANDLE Handle = (HANDLE)_get_osfhandle(_fileno(file));
+	return (Handle != INVALID_HANDLE_VALUE) && FlushFileBuffers(Handle) ? Error_CreateSuccess()
+		: Error_CreateError(ErrorCode_IO, "File_Sync: Failed to flush file buffers to disk.");
+}
+
+Error File_Truncate(FILE* file, unsigned long long length)
+{
+	if (fflush(file))
+	{
+		return Error_CreateError(ErrorCode_IO, "File_Truncate: Failed to flush file.");
+	}
+
+	return _chsize_s(_fileno(file), (long long)length) == 0 ? Error_CreateSuccess()
+		: Error_CreateError(ErrorCode_IO, "File_Truncate: Failed to change the file's length.");
+}
+
+Error File_WriteAtomic(const char* path, const char* data, size_t dataLength, _Bool flushToDisk)
+{
+	// Unique per thread, so that concurrent writers of the same file don't share a temporary file.
+	char Suffix[TEMP_FILE_SUFFIX_LENGTH];
+	snprintf(Suffix, sizeof(Suffix), ".%lu.tmp", (unsigned long)GetCurrentThreadId());
+	size_t PathLength = String_LengthBytes(path);
+	size_t SuffixLength = String_LengthBytes(Suffix);
+	char* TempPath = (char*)Memory_SafeMalloc(PathLength + SuffixLength + 1);
+	Memory_Copy(path, TempPath, PathLength);
+	Memory_Copy(Suffix, TempPath + PathLength, SuffixLength + 1);
+
+	HANDLE File = CreateFileA(TempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		Memory_Free(TempPath);
+		return Error_CreateError(ErrorCode_IO, "File_WriteAtomic: Failed to create temporary file.");
+	}
+
+	bool IsWritten = true;
+	for (size_t Offset = 0; IsWritten && (Offset < dataLength);)
+	{
+		DWORD ChunkSize = (DWORD)((dataLength - Offset) < MAX_SINGLE_WRITE_SIZE ? (dataLength - Offset) : MAX_SINGLE_WRITE_SIZE);
+		DWORD WrittenCount;
+		IsWritten = WriteFile(File, data + Offset, ChunkSize, &WrittenCount, NULL) && (WrittenCount == ChunkSize);
+		Offset += ChunkSize;
+	}
+	if (IsWritten && flushToDisk)
+	{
+		IsWritten = FlushFileBuffers(File);
+	}
+	CloseHandle(File);
+
+	if (!IsWritten)
+	{
+		DeleteFileA(TempPath);
+		Memory_Free(TempPath);
+		return Error_CreateError(ErrorCode_IO, "File_WriteAtomic: Failed to write temporary file.");
+	}
+
+	Error ReturnedError = File_Replace(TempPath, path, flushToDisk);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		DeleteFileA(TempPath);
+		Memory_Free(TempPath);
+		return ReturnedError;
+	}
+
+	Memory_Free(TempPath);
+	return Error_CreateSuccess();
+}
+
+Error File_MapRead(const char* path, FileMapping* mapping)
+{
+	Memory_Set((char*)mapping, sizeof(FileMapping), 0);
+	mapping->Data = NULL;
+
+	HANDLE File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return Error_CreateError(ErrorCode_IO, "File_MapRead: Failed to open file.");
+	}
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize) || (FileSize.QuadPart < 0) || ((unsigned long long)FileSize.QuadPart > (size_t)-1))
+	{
+		CloseHandle(File);
+		return Error_CreateError(ErrorCode_IO, "File_MapRead: Failed to get file size.");
+	}
+
+	size_t Length = (size_t)FileSize.QuadPart;
+	if (Length == 0)
+	{
+		CloseHandle(File);
+		return Error_CreateSuccess();
+	}
+
+	if (Length < MAPPING_MIN_FILE_SIZE)
+	{
+		char* Buffer = (char*)Memory_SafeMalloc(Length);
+		DWORD ReadCount;
+		BOOL IsRead = ReadFile(File, Buffer, (DWORD)Length, &ReadCount, NULL);
+		CloseHandle(File);
+
+		if (!IsRead || (ReadCount != Length))
+		{
+			Memory_Free(Buffer);
+			return Error_CreateError(ErrorCode_IO, "File_MapRead: Failed to read file.");
+		}
+
+		mapping->_buffer = Buffer;
+		mapping->Data = Buffer;
+		mapping->Length = Length;
+		return Error_CreateSuccess();
+	}
+
+	// Copy-on-write, pages stay shared with the file cache until they are written to.
+	// The view keeps the mapping and file alive, so both handles can be closed right away.
+	HANDLE Mapping = CreateFileMappingA(File, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(File);
+	if (!Mapping)
+	{
+		return Error_CreateError(ErrorCode_IO, "File_MapRead: Failed to create file mapping.");
+	}
+
+	void* View = MapViewOfFile(Mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(Mapping);
+	if (!View)
+	{
+		return Error_CreateError(ErrorCode_IO, "File_MapRead: Failed to map view of file.");
+	}
+
+	mapping->_view = View;
+	mapping->Data = (char*)View;
+	mapping->Length = Length;
+	return Error_CreateSuccess();
+}
+
+void File_Unmap(FileMapping* mapping)
+{
+	if (mapping->_view)
+	{
+		UnmapViewOfFile(mapping->_view);
+	}
+	Memory_Free(mapping->_buffer);
+
+	Memory_Set((char*)mapping, sizeof(FileMapping), 0);
+	mapping->Data = NULL;
 }
\ No newline at end of file
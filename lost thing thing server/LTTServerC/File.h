@@ -14,11 +14,20 @@ enum File_OpenModeEnum
 	FileOpenMode_AppendBinary,
 	FileOpenMode_ReadUpdate,
 	FileOpenMode_WriteUpdate,
-	FileOpenMode_AppendUpdate
+	FileOpenMode_AppendUpdate,
+	FileOpenMode_ReadUpdateBinary
 };
 
 typedef enum File_OpenModeEnum File_OpenMode;
 
+typedef struct FileMappingStruct
+{
+	char* Data;
+	size_t Length;
+	void* _buffer;
+	void* _view;
+} FileMapping;
+
 
 // Functions.
 FILE* File_Open(const char* path, File_OpenMode mode, Error* error);
@@ -45,4 +54,52 @@ void File_Delete(const char* path);
 
 _Bool File_Exists(const char* path);
 
-Error File_Move(const char* sourcePath, const char* destinationPath);
\ No newline at end of file
+Error File_Move(const char* sourcePath, const char* destinationPath);
+
+/// <summary>
+/// Moves the file over the destination, replacing it if it exists.
+/// </summary>
+/// <param name="flushToDisk">Returns only once the move has reached the disk.</param>
+Error File_Replace(const char* sourcePath, const char* destinationPath, _Bool flushToDisk);
+
+/* Positional access, for files opened in a binary mode. The stream's position is left after the accessed bytes. */
+Error File_GetLength(FILE* file, unsigned long long* length);
+
+/// <summary>
+/// Reads exactly count bytes at the offset, failing if the file ends before that.
+/// </summary>
+Error File_ReadAt(FILE* file, unsigned long long offset, char* dataBuffer, size_t count);
+
+/// <summary>
+/// Reads exactly count bytes at the offset straight from the file, bypassing the stream, so any number of threads
+/// may read the same file at once. Data still buffered by the stream isn't seen, and the stream's next access must seek.
+/// </summary>
+Error File_ReadPositional(FILE* file, unsigned long long offset, char* dataBuffer, size_t count);
+
+Error File_WriteAt(FILE* file, unsigned long long offset, const char* data, size_t dataLength);
+
+/// <summary>
+/// Flushes the stream and waits for its data to reach the disk.
+/// </summary>
+Error File_Sync(FILE* file);
+
+/// <summary>
+/// Flushes the stream and cuts the file off at the length. The stream stays open.
+/// </summary>
+Error File_Truncate(FILE* file, unsigned long long length);
+
+/// <summary>
+/// Replaces the file's contents with the data. The data is written to a temporary file with a single call, which is
+/// then renamed over the target, so readers and crashes only ever observe the old or the new contents.
+/// </summary>
+/// <param name="flushToDisk">Waits for the data to reach the disk before renaming.</param>
+Error File_WriteAtomic(const char* path, const char* data, size_t dataLength, _Bool flushToDisk);
+
+/// <summary>
+/// Makes the whole contents of a file available in memory. Small files are read with a single call, larger ones are memory mapped.
+/// The data stays valid until File_Unmap is called. It may be modified, changes are private and never written back to the file.
+/// </summary>
+/// <param name="mapping">Receives the file's data and length.</param>
+Error File_MapRead(const char* path, FileMapping* mapping);
+
+void File_Unmap(FileMapping* mapping);
\ No newline at end of file
@@ -2,23 +2,96 @@
 #include "Memory.h"
 #include "Directory.h"
 #include "File.h"
+#include "LTTThread.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "LTTProbes.h"
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 // Macros.
 #define COMPOUND_CAPCITY_GROWHT 2
+#define GHDF_SIGNATURE_LENGTH 16
 #define GHDF_SIGNATURE_BYTES 102, 37, 143, 181, 3, 205, 123, 185, 148, 157, 98, 177, 178, 151, 43, 170
 #define UNDETERMINABLE_ENTRY_SIZE 0
 
 #define GetValueType(type) ((type) & (~GHDF_TYPE_ARRAY_BIT))
+#define IsLengthPrefixedType(type) (((type) & GHDF_TYPE_ARRAY_BIT) || ((type) == GHDFType_Compound))
 
 #define ENCODED_INT_INDICATOR_BIT 0b10000000
 #define ENCODED_INT_MASK 0b01111111
 #define ENCODED_INT_BIT_COUNT_PER_BYTE 7
+#define ENCODED_INT_MAX_BYTE_COUNT 5
 
+#define WRITE_BUFFER_DEFAULT_CAPACITY 1024
+#define WRITE_BUFFER_GROWTH 2
+/* The per-thread write buffer is kept between saves unless a large compound made it grow past this. */
+#define WRITE_BUFFER_RETAINED_CAPACITY (256 * 1024)
+
+#define ARENA_ALIGNMENT 8
+#define AlignArenaSize(size) (((size) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+/* Smallest possible entry is a one byte ID followed by a type byte. */
+#define MIN_ENCODED_ENTRY_SIZE 2
+
+
+// Types.
+typedef struct GHDFArenaBlockStruct
+{
+	struct GHDFArenaBlockStruct* Next;
+	size_t Size;
+	size_t Used;
+	size_t _padding;
+} GHDFArenaBlock;
+
+typedef struct GHDFArenaMappingStruct
+{
+	FileMapping Mapping;
+	struct GHDFArenaMappingStruct* Next;
+} GHDFArenaMapping;
+
+
+// Static variables.
+static THREAD_LOCAL GHDFBuffer s_writeBuffer = { 0 };
 
 
 // Static functions.
+/* Arena. */
+static GHDFArenaBlock* CreateArenaBlock(size_t dataSize)
+{
+	GHDFArenaBlock* Block = (GHDFArenaBlock*)Memory_SafeMalloc(sizeof(GHDFArenaBlock) + dataSize);
+	Block->Next = NULL;
+	Block->Size = dataSize;
+	Block->Used = 0;
+	return Block;
+}
+
+static Error MapFileIntoArena(const char* path, GHDFArena* arena, FileMapping** mapping)
+{
+	GHDFArenaMapping* Mapping = (GHDFArenaMapping*)GHDFArena_Allocate(arena, sizeof(GHDFArenaMapping));
+	Error ReturnedError = File_MapRead(path, &Mapping->Mapping);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	Mapping->Next = arena->_mappings;
+	arena->_mappings = Mapping;
+	*mapping = &Mapping->Mapping;
+	return Error_CreateSuccess();
+}
+
+static void UnmapArenaFiles(GHDFArena* self)
+{
+	for (GHDFArenaMapping* Mapping = self->_mappings; Mapping != NULL; Mapping = Mapping->Next)
+	{
+		File_Unmap(&Mapping->Mapping);
+	}
+	self->_mappings = NULL;
+}
+
+
 /* Compound. */
 static void EnsureCompoundCapacity(GHDFCompound* self, unsigned int capacity)
 {
@@ -27,12 +100,75 @@ static void EnsureCompoundCapacity(GHDFCompound* self, unsigned int capacity)
 		return;
 	}
 
+	unsigned int OldCapacity = self->_capacity;
 	while (self->_capacity < capacity)
 	{
 		self->_capacity *= COMPOUND_CAPCITY_GROWHT;
 	} 
 
-	self->Entries = (GHDFEntry*)Memory_SafeRealloc(self->Entries, sizeof(GHDFEntry) * self->_capacity);
+	if (!self->_arena)
+	{
+		self->Entries = (GHDFEntry*)Memory_SafeRealloc(self->Entries, sizeof(GHDFEntry) * self->_capacity);
+		return;
+	}
+
+	GHDFEntry* Entries = (GHDFEntry*)GHDFArena_Allocate(self->_arena, sizeof(GHDFEntry) * self->_capacity);
+	Memory_Copy((const char*)self->Entries, (char*)Entries, sizeof(GHDFEntry) * OldCapacity);
+	self->Entries = Entries;
+}
+
+/* Entries are kept sorted by ID, entries with equal IDs stay in the order they were added. */
+static unsigned int FindFirstEntryIndex(GHDFCompound* self, int id)
+{
+	if (self->Count == 0)
+	{
+		return 0;
+	}
+
+	// Records mostly use consecutive IDs, in which case the entry's position follows directly from its ID.
+	long long DirectIndex = (long long)id - self->Entries[0].ID;
+	if ((DirectIndex >= 0) && (DirectIndex < (long long)self->Count) && (self->Entries[DirectIndex].ID == id)
+		&& ((DirectIndex == 0) || (self->Entries[DirectIndex - 1].ID != id)))
+	{
+		return (unsigned int)DirectIndex;
+	}
+
+	unsigned int Low = 0;
+	unsigned int High = self->Count;
+	while (Low < High)
+	{
+		unsigned int Middle = Low + ((High - Low) / 2);
+		if (self->Entries[Middle].ID < id)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+	return Low;
+}
+
+static GHDFEntry* InsertEntry(GHDFCompound* self, int id)
+{
+	EnsureCompoundCapacity(self, self->Count + 1);
+
+	// Entries are usually added and decoded in ID order, so appending is the common case.
+	unsigned int Index = self->Count;
+	if ((self->Count > 0) && (self->Entries[self->Count - 1].ID > id))
+	{
+		Index = FindFirstEntryIndex(self, id);
+		while ((Index < self->Count) && (self->Entries[Index].ID == id))
+		{
+			Index++;
+		}
+		memmove(self->Entries + Index + 1, self->Entries + Index, sizeof(GHDFEntry) * (self->Count - Index));
+	}
+
+	self->Count += 1;
+	self->Entries[Index].ID = id;
+	return self->Entries + Index;
 }
 
 static void FreeSingleValue(GHDFPrimitive value, GHDFType type)
@@ -110,151 +246,204 @@ static size_t TryGetTypeSize(GHDFType type)
 
 
 /* Writing */
-static Error WriteEntry(FILE* file, GHDFEntry* entry);
+static void WriteEntry(GHDFBuffer* buffer, GHDFEntry* entry);
+
+static void EnsureBufferCapacity(GHDFBuffer* buffer, size_t capacity)
+{
+	if (buffer->_capacity >= capacity)
+	{
+		return;
+	}
+
+	if (buffer->_capacity == 0)
+	{
+		buffer->_capacity = WRITE_BUFFER_DEFAULT_CAPACITY;
+	}
+	while (buffer->_capacity < capacity)
+	{
+		buffer->_capacity *= WRITE_BUFFER_GROWTH;
+	}
+	buffer->Data = (char*)Memory_SafeRealloc(buffer->Data, buffer->_capacity);
+}
+
+static void WriteBytes(GHDFBuffer* buffer, const void* data, size_t count)
+{
+	EnsureBufferCapacity(buffer, buffer->Length + count);
+	Memory_Copy((const char*)data, buffer->Data + buffer->Length, count);
+	buffer->Length += count;
+}
+
+static void WriteByte(GHDFBuffer* buffer, unsigned char byte)
+{
+	EnsureBufferCapacity(buffer, buffer->Length + 1);
+	buffer->Data[buffer->Length] = (char)byte;
+	buffer->Length++;
+}
 
-static Error Write7BitEncodedInt(FILE* file, int integer)
+static size_t Encode7BitInt(unsigned int value, unsigned char* bytes)
 {
-	unsigned int Value = (unsigned int)integer;
+	size_t ByteCount = 0;
 
 	do
 	{
-		Error ReturnedError = File_WriteByte(file, (Value & ENCODED_INT_MASK) | (Value > ENCODED_INT_MASK ? ENCODED_INT_INDICATOR_BIT : 0));
-		if (ReturnedError.Code != ErrorCode_Success)
-		{
-			return ReturnedError;
-		}
+		bytes[ByteCount] = (value & ENCODED_INT_MASK) | (value > ENCODED_INT_MASK ? ENCODED_INT_INDICATOR_BIT : 0);
+		ByteCount++;
+		value >>= ENCODED_INT_BIT_COUNT_PER_BYTE;
+	} while (value > 0);
 
-		Value >>= ENCODED_INT_BIT_COUNT_PER_BYTE;
-	} while (Value > 0);
+	return ByteCount;
+}
 
-	return Error_CreateSuccess();
+static void Write7BitEncodedInt(GHDFBuffer* buffer, int integer)
+{
+	unsigned char Bytes[ENCODED_INT_MAX_BYTE_COUNT];
+	WriteBytes(buffer, Bytes, Encode7BitInt((unsigned int)integer, Bytes));
 }
 
-static Error WriteCompound(FILE* file, GHDFCompound* compound)
+static void FinishLengthPrefix(GHDFBuffer* buffer, size_t prefixPosition)
 {
-	Error ReturnedError = Write7BitEncodedInt(file, (unsigned int)compound->Count);
-	if (ReturnedError.Code != ErrorCode_Success)
+	size_t ValueLength = buffer->Length - prefixPosition - 1;
+	unsigned char Bytes[ENCODED_INT_MAX_BYTE_COUNT];
+	size_t ByteCount = Encode7BitInt((unsigned int)ValueLength, Bytes);
+
+	if (ByteCount > 1)
 	{
-		return ReturnedError;
+		EnsureBufferCapacity(buffer, buffer->Length + ByteCount - 1);
+		memmove(buffer->Data + prefixPosition + ByteCount, buffer->Data + prefixPosition + 1, ValueLength);
+		buffer->Length += ByteCount - 1;
 	}
+	Memory_Copy((const char*)Bytes, buffer->Data + prefixPosition, ByteCount);
+}
+
+static void WriteCompound(GHDFBuffer* buffer, GHDFCompound* compound)
+{
+	Write7BitEncodedInt(buffer, (unsigned int)compound->Count);
 
 	for (unsigned int i = 0; i < compound->Count; i++)
 	{
-		ReturnedError = WriteEntry(file, &compound->Entries[i]);
-		if (ReturnedError.Code != ErrorCode_Success)
-		{
-			return ReturnedError;
-		}
+		WriteEntry(buffer, &compound->Entries[i]);
 	}
-
-	return Error_CreateSuccess();
 }
 
-static Error WriteMetadata(FILE* file)
+static void WriteMetadata(GHDFBuffer* buffer)
 {
 	unsigned const char Signature[] = { GHDF_SIGNATURE_BYTES };
-	Error ReturnedError = File_Write(file, (const char*)Signature, sizeof(Signature));
+	WriteBytes(buffer, Signature, sizeof(Signature));
 
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	
 	int Version = GHDF_FORMAT_VERSION;
-	ReturnedError = File_Write(file, (char*)(&Version), GHDF_SIZE_INT);
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	return Error_CreateSuccess();
+	WriteBytes(buffer, &Version, GHDF_SIZE_INT);
 }
 
-static Error WriteSingleValue(FILE* file, GHDFPrimitive value, GHDFType type)
+static void WriteSingleValue(GHDFBuffer* buffer, GHDFPrimitive value, GHDFType type)
 {
-	Error ReturnedError;
 	if (GetValueType(type) == GHDFType_String)
 	{
 		unsigned int StringLength = (unsigned int)String_LengthBytes(value.String);
-		ReturnedError = Write7BitEncodedInt(file, (unsigned int)StringLength);
-		if (ReturnedError.Code != ErrorCode_Success)
-		{
-			return ReturnedError;
-		}
-		ReturnedError = File_Write(file, value.String, StringLength);
-		if (ReturnedError.Code != ErrorCode_Success)
-		{
-			return ReturnedError;
-		}
+		Write7BitEncodedInt(buffer, (unsigned int)StringLength);
+		WriteBytes(buffer, value.String, StringLength);
 	}
 	else if (GetValueType(type) == GHDFType_Compound)
 	{
-		return WriteCompound(file, value.Compound);
+		WriteCompound(buffer, value.Compound);
 	}
 	else
 	{
-		size_t Size = TryGetTypeSize(type);
-		ReturnedError = File_Write(file, (const char*)(&value), Size);
-		if (ReturnedError.Code != ErrorCode_Success)
-		{
-			return ReturnedError;
-		}
+		WriteBytes(buffer, &value, TryGetTypeSize(type));
 	}
-
-	return Error_CreateSuccess();
 }
 
-
-static Error WriteArrayValue(FILE* file, GHDFArray array, GHDFType type)
+static void WriteArrayValue(GHDFBuffer* buffer, GHDFArray array, GHDFType type)
 {
-	Error ReturnedError = Write7BitEncodedInt(file, (unsigned int)array.Size);
-	if (ReturnedError.Code != ErrorCode_Success)
+	Write7BitEncodedInt(buffer, (unsigned int)array.Size);
+
+	size_t TypeSize = TryGetTypeSize(type);
+	if (TypeSize != UNDETERMINABLE_ENTRY_SIZE)
 	{
-		return ReturnedError;
+		EnsureBufferCapacity(buffer, buffer->Length + (TypeSize * array.Size));
 	}
 
 	for (unsigned int i = 0; i < array.Size; i++)
 	{
-		ReturnedError = WriteSingleValue(file, array.Array[i], type); // Not optimal solution for writing in terms of performance.
-		if (ReturnedError.Code != ErrorCode_Success) 
-		{
-			return ReturnedError;
-		} 
+		WriteSingleValue(buffer, array.Array[i], type);
 	}
-
-	return Error_CreateSuccess();
 }
 
-static Error WriteEntry(FILE* file, GHDFEntry* entry)
+static void WriteEntry(GHDFBuffer* buffer, GHDFEntry* entry)
 {
-	Error ReturnedError = Write7BitEncodedInt(file, entry->ID);
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	ReturnedError = File_WriteByte(file, (int)entry->ValueType);
-	if (ReturnedError.Code != ErrorCode_Success)
+	Write7BitEncodedInt(buffer, entry->ID);
+	WriteByte(buffer, (unsigned char)entry->ValueType);
+
+	if (!IsLengthPrefixedType(entry->ValueType))
 	{
-		return ReturnedError;
+		WriteSingleValue(buffer, entry->Value.SingleValue, entry->ValueType);
+		return;
 	}
 
+	// The length is only known once the value is written. Most values are short, so a single byte is reserved.
+	size_t PrefixPosition = buffer->Length;
+	WriteByte(buffer, 0);
+
 	if (entry->ValueType & GHDF_TYPE_ARRAY_BIT)
 	{
-		return WriteArrayValue(file, entry->Value.ValueArray, entry->ValueType);
+		WriteArrayValue(buffer, entry->Value.ValueArray, entry->ValueType);
+	}
+	else
+	{
+		WriteSingleValue(buffer, entry->Value.SingleValue, entry->ValueType);
 	}
-	return WriteSingleValue(file, entry->Value.SingleValue, entry->ValueType);
+	FinishLengthPrefix(buffer, PrefixPosition);
 }
 
 
 
 /* Reading. */
-static Error ReadCompound(FILE* file, GHDFCompound* compound);
+static Error ReadCompound(GHDFReader* reader, GHDFCompound* compound);
+
+static void* ReaderAllocate(GHDFReader* reader, size_t size)
+{
+	return reader->_arena ? GHDFArena_Allocate(reader->_arena, size) : Memory_SafeMalloc(size);
+}
+
+static void ReaderFree(GHDFReader* reader, void* data)
+{
+	if (!reader->_arena)
+	{
+		Memory_Free(data);
+	}
+}
+
+static void ReaderConstructCompound(GHDFReader* reader, GHDFCompound* compound, unsigned int capacity)
+{
+	if (!reader->_arena)
+	{
+		GHDFCompound_Construct(compound, capacity);
+		return;
+	}
+
+	compound->_capacity = capacity > 0 ? capacity : 1;
+	compound->Entries = (GHDFEntry*)GHDFArena_Allocate(reader->_arena, sizeof(GHDFEntry) * compound->_capacity);
+	compound->Count = 0;
+	compound->_arena = reader->_arena;
+}
 
-static Error ReadMetadata(FILE* file)
+static const unsigned char* ReadBytes(GHDFReader* reader, size_t count)
+{
+	if (count > (reader->_length - reader->_position))
+	{
+		return NULL;
+	}
+
+	const unsigned char* Bytes = reader->_data + reader->_position;
+	reader->_position += count;
+	return Bytes;
+}
+
+static Error ReadMetadata(GHDFReader* reader)
 {
 	unsigned char Signature[] = { GHDF_SIGNATURE_BYTES };
-	unsigned char ReadSignature[sizeof(Signature)];
 
-	if (File_Read(file, (char*)ReadSignature, sizeof(ReadSignature)) < sizeof(ReadSignature))
+	const unsigned char* ReadSignature = ReadBytes(reader, sizeof(Signature));
+	if (!ReadSignature)
 	{
 		return Error_CreateError(ErrorCode_InvalidGHDFFile, "Failed to verify GHDF meta-data: Signature too short.");
 	}
@@ -268,94 +457,144 @@ static Error ReadMetadata(FILE* file)
 	}
 
 	int Version;
-	if (File_Read(file, (char*)(&Version), sizeof(GHDF_SIZE_INT)) != GHDF_SIZE_INT)
+	const unsigned char* VersionBytes = ReadBytes(reader, GHDF_SIZE_INT);
+	if (!VersionBytes)
 	{
 		return Error_CreateError(ErrorCode_InvalidGHDFFile, "Failed to verify GHDF meta-data: Version not an integer.");
 	}
+	Memory_Copy((const char*)VersionBytes, (char*)(&Version), GHDF_SIZE_INT);
 
-	return Version == GHDF_FORMAT_VERSION ? Error_CreateSuccess()
-		: Error_CreateError(ErrorCode_InvalidGHDFFile, "Failed to verify GHDF meta-data: Unsupported format version.");;
+	if ((Version < GHDF_OLDEST_FORMAT_VERSION) || (Version > GHDF_FORMAT_VERSION))
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "Failed to verify GHDF meta-data: Unsupported format version.");
+	}
+	reader->_version = Version;
+	return Error_CreateSuccess();
 }
 
-static Error Read7BitEncodedInt(FILE* file, int* result)
+static Error Read7BitEncodedInt(GHDFReader* reader, int* result)
 {
-	int Value = 0;
-	int LastByte;
-	int ShiftCount = 0;
+	const unsigned char* Bytes = reader->_data + reader->_position;
+	size_t RemainingByteCount = reader->_length - reader->_position;
 
-	do
+	// IDs, types, counts and short string lengths all fit into a single byte.
+	if ((RemainingByteCount > 0) && !(Bytes[0] & ENCODED_INT_INDICATOR_BIT))
 	{
-		Error ReturnedError;
-		LastByte = File_ReadByte(file, &ReturnedError);
+		*result = Bytes[0];
+		reader->_position++;
+		return Error_CreateSuccess();
+	}
 
-		if (ReturnedError.Code != ErrorCode_Success)
+	size_t MaxByteCount = RemainingByteCount < ENCODED_INT_MAX_BYTE_COUNT ? RemainingByteCount : ENCODED_INT_MAX_BYTE_COUNT;
+	unsigned int Value = 0;
+	for (size_t i = 0; i < MaxByteCount; i++)
+	{
+		Value |= (unsigned int)(Bytes[i] & ENCODED_INT_MASK) << (ENCODED_INT_BIT_COUNT_PER_BYTE * i);
+		if (!(Bytes[i] & ENCODED_INT_INDICATOR_BIT))
 		{
-			return ReturnedError;
+			*result = (int)Value;
+			reader->_position += i + 1;
+			return Error_CreateSuccess();
 		}
+	}
 
-		Value |= (LastByte & ENCODED_INT_MASK) << (ENCODED_INT_BIT_COUNT_PER_BYTE * ShiftCount);
-		ShiftCount++;
-	} while (LastByte & ENCODED_INT_INDICATOR_BIT);
-
-	*result = Value;
-	return Error_CreateSuccess();
+	return MaxByteCount < ENCODED_INT_MAX_BYTE_COUNT ? Error_CreateError(ErrorCode_InvalidGHDFFile, "Read7BitEncodedInt: Unexpected end of data.")
+		: Error_CreateError(ErrorCode_InvalidGHDFFile, "Read7BitEncodedInt: Encoded integer is too long.");
 }
 
-static Error ReadSingleValue(FILE* file, GHDFType type, GHDFPrimitive* value)
+static Error ReadSingleValue(GHDFReader* reader, GHDFType type, GHDFPrimitive* value)
 {
 	GHDFPrimitive Value;
 
 	if (type == GHDFType_Compound)
 	{
-		Value.Compound = Memory_SafeMalloc(sizeof(GHDFCompound));
-		ReadCompound(file, Value.Compound);
+		Value.Compound = ReaderAllocate(reader, sizeof(GHDFCompound));
+		Error ReturnedError = ReadCompound(reader, Value.Compound);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			ReaderFree(reader, Value.Compound);
+			return ReturnedError;
+		}
 	}
 	else if (type == GHDFType_String)
 	{
+		size_t PrefixPosition = reader->_position;
 		unsigned int StringLength;
-		Error ReturnedError = Read7BitEncodedInt(file, (int*)(&StringLength));
+		Error ReturnedError = Read7BitEncodedInt(reader, (int*)(&StringLength));
 		if (ReturnedError.Code != ErrorCode_Success)
 		{
 			return ReturnedError;
 		}
-		Value.String = (char*)Memory_SafeMalloc((sizeof(char) * StringLength) + 1);
-		if (File_Read(file, Value.String, StringLength) != StringLength)
+
+		const unsigned char* StringBytes = ReadBytes(reader, StringLength);
+		if (!StringBytes)
+		{
+			return Error_CreateError(ErrorCode_InvalidGHDFFile, "ReadSingleValue: Failed to read string.");
+		}
+
+		if (reader->_isDataDisposable)
+		{
+			/* The length prefix is at least one byte and already consumed, moving the string over it
+			* leaves room for the terminator without touching anything that is still to be read. */
+			Value.String = (char*)(reader->_data + PrefixPosition);
+			memmove(Value.String, StringBytes, StringLength);
+		}
+		else if (reader->_arena)
 		{
-			Memory_Free(Value.String);
-			return Error_CreateError(ErrorCode_IO, "ReadSingleValue: Failed to read string.");
+			Value.String = (char*)GHDFArena_Allocate(reader->_arena, (sizeof(char) * StringLength) + 1);
+			Memory_Copy((const char*)StringBytes, Value.String, StringLength);
+		}
+		else
+		{
+			Value.String = (char*)Memory_SafeMalloc((sizeof(char) * StringLength) + 1);
+			Memory_Copy((const char*)StringBytes, Value.String, StringLength);
 		}
 		Value.String[StringLength] = '\0';
 	}
 	else
 	{
 		size_t TypeSize = TryGetTypeSize(type);
-		if (File_Read(file, (char*)(&Value), TypeSize) != TypeSize)
+		const unsigned char* ValueBytes = ReadBytes(reader, TypeSize);
+		if (!ValueBytes)
 		{
-			return Error_CreateError(ErrorCode_IO, "ReadSingleValue: Failed to read value.");
+			return Error_CreateError(ErrorCode_InvalidGHDFFile, "ReadSingleValue: Failed to read value.");
 		}
+		Value.ULong = 0;
+		Memory_Copy((const char*)ValueBytes, (char*)(&Value), TypeSize);
 	}
 
 	*value = Value;
 	return Error_CreateSuccess();
 }
 
-static Error ReadArrayValue(FILE* file, GHDFType type, GHDFPrimitive** arrayPtr, unsigned int* arraySizePtr)
+static Error ReadArrayValue(GHDFReader* reader, GHDFType type, GHDFPrimitive** arrayPtr, unsigned int* arraySizePtr)
 {
 	unsigned int ArraySize;
-	Error ReturnedError = Read7BitEncodedInt(file, (int*)(&ArraySize));
+	Error ReturnedError = Read7BitEncodedInt(reader, (int*)(&ArraySize));
 
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
 
-	GHDFPrimitive* PrimitiveArray = (GHDFPrimitive*)Memory_SafeMalloc(sizeof(GHDFPrimitive) * ArraySize);
+	// Every element takes at least one byte, which bounds the allocation by the data that is actually left.
+	if (ArraySize > (reader->_length - reader->_position))
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "ReadArrayValue: Array is larger than the remaining data.");
+	}
+
+	GHDFPrimitive* PrimitiveArray = (GHDFPrimitive*)ReaderAllocate(reader, sizeof(GHDFPrimitive) * (ArraySize > 0 ? ArraySize : 1));
 	for (unsigned int i = 0; i < ArraySize; i++)
 	{
-		ReturnedError = ReadSingleValue(file, GetValueType(type), PrimitiveArray + i);
+		ReturnedError = ReadSingleValue(reader, GetValueType(type), PrimitiveArray + i);
 		if (ReturnedError.Code != ErrorCode_Success)
 		{
-			ReturnedError;
+			for (unsigned int j = 0; !reader->_arena && (j < i); j++)
+			{
+				FreeSingleValue(PrimitiveArray[j], GetValueType(type));
+			}
+			ReaderFree(reader, PrimitiveArray);
+			return ReturnedError;
 		}
 	}
 
@@ -364,11 +603,11 @@ static Error ReadArrayValue(FILE* file, GHDFType type, GHDFPrimitive** arrayPtr,
 	return Error_CreateSuccess();
 }
 
-static Error ReadEntryInfo(FILE* file, int* id, GHDFType* type)
+static Error ReadEntryInfo(GHDFReader* reader, int* id, GHDFType* type)
 {
 	int ID;
 
-	Error ReturnedError = Read7BitEncodedInt(file, &ID);
+	Error ReturnedError = Read7BitEncodedInt(reader, &ID);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
@@ -378,11 +617,12 @@ static Error ReadEntryInfo(FILE* file, int* id, GHDFType* type)
 		return Error_CreateError(ErrorCode_InvalidGHDFFile, "An ID of 0 is not allowed.");
 	}
 
-	GHDFType EntryType = File_ReadByte(file, &ReturnedError);
-	if (ReturnedError.Code != ErrorCode_Success)
+	const unsigned char* TypeByte = ReadBytes(reader, 1);
+	if (!TypeByte)
 	{
-		return ReturnedError;
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "ReadEntryInfo: Failed to read entry type.");
 	}
+	GHDFType EntryType = (GHDFType)(*TypeByte);
 	if ((GetValueType(EntryType) <= GHDFType_None) || (GetValueType(EntryType) > GHDFType_Compound))
 	{
 		char Message[128];
@@ -395,15 +635,48 @@ static Error ReadEntryInfo(FILE* file, int* id, GHDFType* type)
 	return Error_CreateSuccess();
 }
 
-static Error ReadEntryValue(FILE* file, int id, GHDFType type, GHDFCompound* compound)
+static bool HasLengthPrefix(GHDFReader* reader, GHDFType type)
 {
-	Error ReturnedError;
+	return (reader->_version >= GHDF_FORMAT_VERSION_LENGTH_PREFIXES) && IsLengthPrefixedType(type);
+}
+
+static Error ReadValueLength(GHDFReader* reader, GHDFType type, size_t* valueEnd)
+{
+	*valueEnd = reader->_length;
+	if (!HasLengthPrefix(reader, type))
+	{
+		return Error_CreateSuccess();
+	}
+
+	unsigned int ValueLength;
+	Error ReturnedError = Read7BitEncodedInt(reader, (int*)(&ValueLength));
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	if (ValueLength > (reader->_length - reader->_position))
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "ReadValueLength: Value is longer than the remaining data.");
+	}
+
+	*valueEnd = reader->_position + ValueLength;
+	return Error_CreateSuccess();
+}
+
+static Error ReadEntryValue(GHDFReader* reader, int id, GHDFType type, GHDFCompound* compound)
+{
+	size_t ValueEnd;
+	Error ReturnedError = ReadValueLength(reader, type, &ValueEnd);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
 
 	if (type & GHDF_TYPE_ARRAY_BIT)
 	{
 		GHDFPrimitive* Array;
 		unsigned int ArraySize;
-		ReturnedError = ReadArrayValue(file, type, &Array, &ArraySize);
+		ReturnedError = ReadArrayValue(reader, type, &Array, &ArraySize);
 		if (ReturnedError.Code != ErrorCode_Success)
 		{
 			return ReturnedError;
@@ -413,7 +686,7 @@ static Error ReadEntryValue(FILE* file, int id, GHDFType type, GHDFCompound* com
 	else
 	{
 		GHDFPrimitive Value;
-		ReturnedError = ReadSingleValue(file, type, &Value);
+		ReturnedError = ReadSingleValue(reader, type, &Value);
 		if (ReturnedError.Code != ErrorCode_Success)
 		{
 			return ReturnedError;
@@ -421,28 +694,20 @@ static Error ReadEntryValue(FILE* file, int id, GHDFType type, GHDFCompound* com
 		GHDFCompound_AddSingleValueEntry(compound, type, id, Value);
 	}
 
-	return Error_CreateSuccess();
-}
-
-static Error ReadEntry(FILE* file, GHDFCompound* compound)
-{
-	int ID;
-	GHDFType EntryType;
-	Error ReturnedError = ReadEntryInfo(file, &ID, &EntryType);
-	if (ReturnedError.Code != ErrorCode_Success)
+	if (HasLengthPrefix(reader, type) && (reader->_position != ValueEnd))
 	{
-		return ReturnedError;
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "ReadEntryValue: Value doesn't match its length prefix.");
 	}
-
-	return ReadEntryValue(file, ID, EntryType, compound);
+	return Error_CreateSuccess();
 }
 
-static Error ReadCompound(FILE* file, GHDFCompound* compound)
-{
-	GHDFCompound_Construct(compound, COMPOUND_DEFAULT_CAPACITY);
+/* Skipping. */
+static Error SkipEntryValue(GHDFReader* reader, GHDFType type);
 
+static Error SkipCompound(GHDFReader* reader)
+{
 	int EntryCount;
-	Error ReturnedError = Read7BitEncodedInt(file, &EntryCount);
+	Error ReturnedError = Read7BitEncodedInt(reader, &EntryCount);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
@@ -450,7 +715,15 @@ static Error ReadCompound(FILE* file, GHDFCompound* compound)
 
 	for (int i = 0; i < EntryCount; i++)
 	{
-		ReturnedError = ReadEntry(file, compound);
+		int ID;
+		GHDFType EntryType;
+		ReturnedError = ReadEntryInfo(reader, &ID, &EntryType);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+
+		ReturnedError = SkipEntryValue(reader, EntryType);
 		if (ReturnedError.Code != ErrorCode_Success)
 		{
 			return ReturnedError;
@@ -460,90 +733,380 @@ static Error ReadCompound(FILE* file, GHDFCompound* compound)
 	return Error_CreateSuccess();
 }
 
-
-// Functions.
-void GHDFCompound_Construct(GHDFCompound* self, unsigned int capacity)
+static Error SkipSingleValue(GHDFReader* reader, GHDFType type)
 {
-	if (capacity <= 0)
+	if (type == GHDFType_Compound)
 	{
-		capacity = 1;
+		return SkipCompound(reader);
 	}
 
-	self->Entries = (GHDFEntry*)Memory_SafeMalloc(sizeof(GHDFEntry) * capacity);
-	self->Count = 0;
-	self->_capacity = capacity;
-}
+	unsigned int ByteCount = (unsigned int)TryGetTypeSize(type);
+	if (type == GHDFType_String)
+	{
+		Error ReturnedError = Read7BitEncodedInt(reader, (int*)(&ByteCount));
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
 
-GHDFCompound* GHDFCompound_Construct2(unsigned int capacity)
-{
-	GHDFCompound* Compound = (GHDFCompound*)Memory_SafeMalloc(sizeof(GHDFCompound));
-	GHDFCompound_Construct(Compound, capacity);
-	return Compound;
+	return ReadBytes(reader, ByteCount) ? Error_CreateSuccess()
+		: Error_CreateError(ErrorCode_InvalidGHDFFile, "SkipSingleValue: Unexpected end of data.");
 }
 
-Error GHDFCompound_AddSingleValueEntry(GHDFCompound* self, GHDFType type, int id, GHDFPrimitive value)
+static Error SkipValue(GHDFReader* reader, GHDFType type, size_t valueEnd)
 {
-	if (id == 0)
+	// Length prefixed values are skipped in one step, older files have to be walked.
+	if (HasLengthPrefix(reader, type))
 	{
-		return Error_CreateError(ErrorCode_InvalidArgument, "GHDFCompound_AddSingleValueEntry: An ID of 0 is not allowed.");
+		reader->_position = valueEnd;
+		return Error_CreateSuccess();
 	}
 
-	EnsureCompoundCapacity(self, self->Count + 1);
-	self->Entries[self->Count].ID = id;
-	self->Entries[self->Count].Value.SingleValue = value;
-	self->Entries[self->Count].ValueType = type;
-
-	self->Count += 1;
+	if (!(type & GHDF_TYPE_ARRAY_BIT))
+	{
+		return SkipSingleValue(reader, type);
+	}
+
+	int ArraySize;
+	Error ReturnedError = Read7BitEncodedInt(reader, &ArraySize);
+	for (int i = 0; (ReturnedError.Code == ErrorCode_Success) && (i < ArraySize); i++)
+	{
+		ReturnedError = SkipSingleValue(reader, GetValueType(type));
+	}
+	return ReturnedError;
+}
+
+static Error SkipEntryValue(GHDFReader* reader, GHDFType type)
+{
+	size_t ValueEnd;
+	Error ReturnedError = ReadValueLength(reader, type, &ValueEnd);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	return SkipValue(reader, type, ValueEnd);
+}
+
+/* Lazy compounds. */
+static Error VerifyEntryType(GHDFEntryInfo* info, GHDFType expectedType)
+{
+	if (info->ValueType == expectedType)
+	{
+		return Error_CreateSuccess();
+	}
+
+	char Message[128];
+	snprintf(Message, sizeof(Message), "Expected GHDF entry of type %d with id %d, actual type is %d.",
+		(int)expectedType, info->ID, (int)info->ValueType);
+	return Error_CreateError(ErrorCode_InvalidGHDFFile, Message);
+}
+
+static Error OpenLazyCompound(GHDFReader* reader, size_t endPosition, GHDFLazyCompound* compound)
+{
+	int EntryCount;
+	Error ReturnedError = Read7BitEncodedInt(reader, &EntryCount);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	if ((EntryCount < 0) || (reader->_position > endPosition))
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "OpenLazyCompound: Invalid compound.");
+	}
+
+	compound->Count = (unsigned int)EntryCount;
+	compound->_data = (char*)(reader->_data + reader->_position);
+	compound->_length = endPosition - reader->_position;
+	compound->_version = reader->_version;
+	compound->_arena = reader->_arena;
 	return Error_CreateSuccess();
 }
 
-Error GHDFCompound_AddArrayEntry(GHDFCompound* self, GHDFType type, int id, GHDFPrimitive* valueArray, unsigned int count)
+static void ConstructLazyCompoundReader(GHDFLazyCompound* compound, GHDFReader* reader)
 {
-	if (id == 0)
+	reader->_data = (unsigned char*)compound->_data;
+	reader->_length = compound->_length;
+	reader->_position = 0;
+	reader->_version = compound->_version;
+	reader->_arena = compound->_arena;
+	// Entries may be read more than once, so strings can't be moved around in place.
+	reader->_isDataDisposable = false;
+}
+
+static bool ContainsID(const int* ids, size_t idCount, int id)
+{
+	for (size_t i = 0; i < idCount; i++)
 	{
-		return Error_CreateError(ErrorCode_InvalidArgument, "GHDFCompound_AddArrayEntry: An ID of 0 is not allowed.");
+		if (ids[i] == id)
+		{
+			return true;
+		}
 	}
+	return false;
+}
 
-	EnsureCompoundCapacity(self, self->Count + 1);
-	self->Entries[self->Count].ID = id;
-	self->Entries[self->Count].Value.ValueArray.Array = valueArray;
-	self->Entries[self->Count].Value.ValueArray.Size = count;
-	self->Entries[self->Count].ValueType = (type | GHDF_TYPE_ARRAY_BIT);
+static Error ReadEntry(GHDFReader* reader, GHDFCompound* compound)
+{
+	int ID;
+	GHDFType EntryType;
+	Error ReturnedError = ReadEntryInfo(reader, &ID, &EntryType);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	return ReadEntryValue(reader, ID, EntryType, compound);
+}
+
+static Error ReadCompound(GHDFReader* reader, GHDFCompound* compound)
+{
+	unsigned int EntryCount;
+	Error ReturnedError = GHDFReader_ReadCompoundHeader(reader, &EntryCount);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	// The exact entry count is known up front, so the entries never have to grow.
+	ReaderConstructCompound(reader, compound, EntryCount);
+
+	for (unsigned int i = 0; i < EntryCount; i++)
+	{
+		ReturnedError = ReadEntry(reader, compound);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			GHDFCompound_Deconstruct(compound);
+			return ReturnedError;
+		}
+	}
 
-	self->Count += 1;
 	return Error_CreateSuccess();
 }
 
-void GHDFCompound_RemoveEntry(GHDFCompound* self, int id)
+
+// Functions.
+/* Arena. */
+void GHDFArena_Construct(GHDFArena* self, size_t blockSize)
 {
-	long long TargetIndex = -1;
+	self->_blockSize = AlignArenaSize(blockSize > 0 ? blockSize : GHDF_ARENA_DEFAULT_BLOCK_SIZE);
+	self->_firstBlock = CreateArenaBlock(self->_blockSize);
+	self->_currentBlock = self->_firstBlock;
+	self->_mappings = NULL;
+}
+
+void* GHDFArena_Allocate(GHDFArena* self, size_t size)
+{
+	size = AlignArenaSize(size > 0 ? size : 1);
 
-	for (long long i = 0; i < (long long)self->Count; i++)
+	GHDFArenaBlock* Block = self->_currentBlock;
+	if (size > (Block->Size - Block->Used))
 	{
-		if (self->Entries[i].ID == id)
+		// Blocks emptied by a clear are reused before new ones are created.
+		while (Block->Next && (size > Block->Next->Size))
+		{
+			GHDFArenaBlock* TooSmallBlock = Block->Next;
+			Block->Next = TooSmallBlock->Next;
+			Memory_Free(TooSmallBlock);
+		}
+
+		if (!Block->Next)
 		{
-			TargetIndex = i;
-			FreeEntryMemory(self->Entries + i);
-			break;
+			Block->Next = CreateArenaBlock(size > self->_blockSize ? size : self->_blockSize);
 		}
+		Block = Block->Next;
+		Block->Used = 0;
+		self->_currentBlock = Block;
 	}
 
-	if (TargetIndex <= -1)
+	void* Data = (char*)(Block + 1) + Block->Used;
+	Block->Used += size;
+	return Data;
+}
+
+void GHDFArena_Clear(GHDFArena* self)
+{
+	UnmapArenaFiles(self);
+
+	for (GHDFArenaBlock* Block = self->_firstBlock; Block != NULL; Block = Block->Next)
+	{
+		Block->Used = 0;
+	}
+	self->_currentBlock = self->_firstBlock;
+}
+
+void GHDFArena_Deconstruct(GHDFArena* self)
+{
+	UnmapArenaFiles(self);
+
+	GHDFArenaBlock* Block = self->_firstBlock;
+	while (Block)
+	{
+		GHDFArenaBlock* NextBlock = Block->Next;
+		Memory_Free(Block);
+		Block = NextBlock;
+	}
+	self->_firstBlock = NULL;
+	self->_currentBlock = NULL;
+}
+
+/* Buffer. */
+void GHDFBuffer_Construct(GHDFBuffer* self, size_t capacity)
+{
+	self->Data = NULL;
+	self->Length = 0;
+	self->_capacity = 0;
+	EnsureBufferCapacity(self, capacity > 0 ? capacity : WRITE_BUFFER_DEFAULT_CAPACITY);
+}
+
+GHDFBuffer* GHDFBuffer_GetThreadBuffer()
+{
+	return &s_writeBuffer;
+}
+
+void GHDFBuffer_BeginFile(GHDFBuffer* buffer)
+{
+	buffer->Length = 0;
+	WriteMetadata(buffer);
+}
+
+void GHDFBuffer_WriteCompoundHeader(GHDFBuffer* buffer, unsigned int entryCount)
+{
+	Write7BitEncodedInt(buffer, (int)entryCount);
+}
+
+void GHDFBuffer_WriteValueEntry(GHDFBuffer* buffer, GHDFType type, int id, GHDFPrimitive value)
+{
+	GHDFEntry Entry;
+	Entry.ID = id;
+	Entry.ValueType = type;
+	Entry.Value.SingleValue = value;
+	WriteEntry(buffer, &Entry);
+}
+
+void GHDFBuffer_WriteArrayEntry(GHDFBuffer* buffer, GHDFType elementType, int id, const void* elements, unsigned int elementCount)
+{
+	size_t EntryStart = GHDFBuffer_BeginArrayEntry(buffer, elementType, id, elementCount);
+	WriteBytes(buffer, elements, TryGetTypeSize(elementType) * elementCount);
+	GHDFBuffer_EndEntry(buffer, EntryStart);
+}
+
+size_t GHDFBuffer_BeginArrayEntry(GHDFBuffer* buffer, GHDFType elementType, int id, unsigned int elementCount)
+{
+	Write7BitEncodedInt(buffer, id);
+	WriteByte(buffer, (unsigned char)(elementType | GHDF_TYPE_ARRAY_BIT));
+
+	size_t PrefixPosition = buffer->Length;
+	WriteByte(buffer, 0);
+	Write7BitEncodedInt(buffer, (int)elementCount);
+	return PrefixPosition;
+}
+
+void GHDFBuffer_EndEntry(GHDFBuffer* buffer, size_t entryStart)
+{
+	FinishLengthPrefix(buffer, entryStart);
+}
+
+Error GHDFBuffer_WriteToFile(GHDFBuffer* buffer, const char* path, bool syncToDisk)
+{
+	const char* Path = Directory_ChangePathExtension(path, GHDF_FILE_EXTENSION);
+
+	const char* DirectoryPath = Directory_GetParentDirectory(Path);
+	Directory_CreateAll(DirectoryPath);
+	Memory_Free((char*)DirectoryPath);
+
+	Error ReturnedError = File_WriteAtomic(Path, buffer->Data, buffer->Length, syncToDisk);
+	Memory_Free((char*)Path);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		Metrics_Add(MetricCounter_GHDFBytesWritten, buffer->Length);
+		LTT_PROBE_GHDF_WRITE(buffer->Length);
+	}
+
+	if ((buffer == &s_writeBuffer) && (s_writeBuffer._capacity > WRITE_BUFFER_RETAINED_CAPACITY))
+	{
+		GHDFBuffer_Deconstruct(&s_writeBuffer);
+	}
+	return ReturnedError;
+}
+
+void GHDFBuffer_Deconstruct(GHDFBuffer* self)
+{
+	Memory_Free(self->Data);
+	self->Data = NULL;
+	self->Length = 0;
+	self->_capacity = 0;
+}
+
+/* Compound. */
+void GHDFCompound_Construct(GHDFCompound* self, unsigned int capacity)
+{
+	if (capacity <= 0)
+	{
+		capacity = 1;
+	}
+
+	self->Entries = (GHDFEntry*)Memory_SafeMalloc(sizeof(GHDFEntry) * capacity);
+	self->Count = 0;
+	self->_capacity = capacity;
+	self->_arena = NULL;
+}
+
+GHDFCompound* GHDFCompound_Construct2(unsigned int capacity)
+{
+	GHDFCompound* Compound = (GHDFCompound*)Memory_SafeMalloc(sizeof(GHDFCompound));
+	GHDFCompound_Construct(Compound, capacity);
+	return Compound;
+}
+
+Error GHDFCompound_AddSingleValueEntry(GHDFCompound* self, GHDFType type, int id, GHDFPrimitive value)
+{
+	if (id == 0)
+	{
+		return Error_CreateError(ErrorCode_InvalidArgument, "GHDFCompound_AddSingleValueEntry: An ID of 0 is not allowed.");
+	}
+
+	GHDFEntry* Entry = InsertEntry(self, id);
+	Entry->Value.SingleValue = value;
+	Entry->ValueType = type;
+	return Error_CreateSuccess();
+}
+
+Error GHDFCompound_AddArrayEntry(GHDFCompound* self, GHDFType type, int id, GHDFPrimitive* valueArray, unsigned int count)
+{
+	if (id == 0)
+	{
+		return Error_CreateError(ErrorCode_InvalidArgument, "GHDFCompound_AddArrayEntry: An ID of 0 is not allowed.");
+	}
+
+	GHDFEntry* Entry = InsertEntry(self, id);
+	Entry->Value.ValueArray.Array = valueArray;
+	Entry->Value.ValueArray.Size = count;
+	Entry->ValueType = (type | GHDF_TYPE_ARRAY_BIT);
+	return Error_CreateSuccess();
+}
+
+void GHDFCompound_RemoveEntry(GHDFCompound* self, int id)
+{
+	unsigned int TargetIndex = FindFirstEntryIndex(self, id);
+	if ((TargetIndex >= self->Count) || (self->Entries[TargetIndex].ID != id))
 	{
 		return;
 	}
 
-	for (unsigned int i = (unsigned int)TargetIndex + 1; i < self->Count; i++)
+	if (!self->_arena)
 	{
-		self->Entries[i - 1] = self->Entries[i];
+		FreeEntryMemory(self->Entries + TargetIndex);
 	}
+	memmove(self->Entries + TargetIndex, self->Entries + TargetIndex + 1, sizeof(GHDFEntry) * (self->Count - TargetIndex - 1));
 
 	self->Count -= 1;
 }
 
 void GHDFCompound_Clear(GHDFCompound* self)
 {
-	for (unsigned int i = 0; i < self->Count; i++)
+	for (unsigned int i = 0; !self->_arena && (i < self->Count); i++)
 	{
 		FreeEntryMemory(self->Entries + i);
 	}
@@ -553,12 +1116,10 @@ void GHDFCompound_Clear(GHDFCompound* self)
 
 GHDFEntry* GHDFCompound_GetEntry(GHDFCompound* self, int id)
 {
-	for (unsigned int i = 0; i < self->Count; i++)
+	unsigned int Index = FindFirstEntryIndex(self, id);
+	if ((Index < self->Count) && (self->Entries[Index].ID == id))
 	{
-		if (self->Entries[i].ID == id)
-		{
-			return self->Entries + i;
-		}
+		return self->Entries + Index;
 	}
 
 	return NULL;
@@ -609,95 +1170,380 @@ Error GHDFCompound_GetVerifiedOptionalEntry(GHDFCompound* self, int id, GHDFEntr
 
 GHDFEntry* GHDFCompound_GetEntryOrDefault(GHDFCompound* self, int id, GHDFEntry* defaultEntry)
 {
-	for (unsigned int i = 0; i < self->Count; i++)
+	GHDFEntry* FoundEntry = GHDFCompound_GetEntry(self, id);
+	return FoundEntry ? FoundEntry : defaultEntry;
+}
+
+Error GHDFCompound_ReadFromBuffer(const char* data, size_t dataLength, GHDFCompound* emptyBaseCompound)
+{
+	// Only arena decoding writes into the data.
+	GHDFReader Reader = { (unsigned char*)data, dataLength, 0, 0, NULL, false };
+	Metrics_Add(MetricCounter_GHDFBytesRead, dataLength);
+	LTT_PROBE_GHDF_READ(dataLength);
+	TraceSpan Span = Trace_BeginSpan("GHDF decode");
+
+	Error ReturnedError = ReadMetadata(&Reader);
+	if (ReturnedError.Code == ErrorCode_Success)
 	{
-		if (self->Entries[i].ID == id)
-		{
-			return self->Entries + i;
-		}
+		ReturnedError = ReadCompound(&Reader, emptyBaseCompound);
 	}
-
-	return defaultEntry;
+	Trace_EndSpan(Span);
+	return ReturnedError;
 }
 
 Error GHDFCompound_ReadFromFile(const char* path, GHDFCompound* emptyBaseCompound)
 {
-	GHDFCompound_Construct(emptyBaseCompound, COMPOUND_DEFAULT_CAPACITY);
-
 	if (!File_Exists(path))
 	{
 		return Error_CreateError(ErrorCode_IO, "GHDFCompound_ReadFromFile: Provided GHDF file doesn't exist.");
 	}
 
+	FileMapping Mapping;
+	Error ReturnedError = File_MapRead(path, &Mapping);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	ReturnedError = GHDFCompound_ReadFromBuffer(Mapping.Data, Mapping.Length, emptyBaseCompound);
+	File_Unmap(&Mapping);
+	return ReturnedError;
+}
+
+Error GHDFCompound_ReadFromFileArena(const char* path, GHDFCompound* emptyBaseCompound, GHDFArena* arena)
+{
+	if (!File_Exists(path))
+	{
+		return Error_CreateError(ErrorCode_IO, "GHDFCompound_ReadFromFileArena: Provided GHDF file doesn't exist.");
+	}
+
+	FileMapping* Mapping;
+	Error ReturnedError = MapFileIntoArena(path, arena, &Mapping);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	GHDFReader Reader = { (unsigned char*)Mapping->Data, Mapping->Length, 0, 0, arena, true };
+	Metrics_Add(MetricCounter_GHDFBytesRead, Mapping->Length);
+	LTT_PROBE_GHDF_READ(Mapping->Length);
+	TraceSpan Span = Trace_BeginSpan("GHDF decode");
+	ReturnedError = ReadMetadata(&Reader);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = ReadCompound(&Reader, emptyBaseCompound);
+	}
+	Trace_EndSpan(Span);
+	return ReturnedError;
+}
+
+char* GHDFCompound_TakeString(GHDFCompound* self, GHDFEntry* entry)
+{
+	char* String = entry->Value.SingleValue.String;
+	if (!self->_arena)
+	{
+		entry->Value.SingleValue.String = NULL;
+	}
+	return String;
+}
+
+Error GHDFCompound_UpgradeFile(const char* path, bool syncToDisk, bool* isUpgraded)
+{
+	*isUpgraded = false;
+
 	Error ReturnedError;
 	FILE* File = File_Open(path, FileOpenMode_ReadBinary, &ReturnedError);
 	if (!File)
 	{
 		return ReturnedError;
 	}
+	unsigned char Header[GHDF_SIGNATURE_LENGTH + GHDF_SIZE_INT];
+	size_t HeaderLength = File_Read(File, (char*)Header, sizeof(Header));
+	File_Close(File);
 
-	ReturnedError = ReadMetadata(File);
+	GHDFReader Reader = { Header, HeaderLength, 0, 0, NULL, false };
+	ReturnedError = ReadMetadata(&Reader);
+	if ((ReturnedError.Code != ErrorCode_Success) || (Reader._version == GHDF_FORMAT_VERSION))
+	{
+		return ReturnedError;
+	}
+
+	GHDFCompound Compound;
+	ReturnedError = GHDFCompound_ReadFromFile(path, &Compound);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
-		File_Close(File);
 		return ReturnedError;
 	}
-	
-	ReturnedError = ReadCompound(File, emptyBaseCompound);
+	ReturnedError = GHDFCompound_WriteToFile(path, &Compound, syncToDisk);
+	GHDFCompound_Deconstruct(&Compound);
+
+	*isUpgraded = ReturnedError.Code == ErrorCode_Success;
+	return ReturnedError;
+}
+
+void GHDFCompound_WriteToBuffer(GHDFCompound* compound, GHDFBuffer* buffer)
+{
+	GHDFBuffer_BeginFile(buffer);
+	WriteCompound(buffer, compound);
+}
+
+Error GHDFCompound_WriteToFile(const char* path, GHDFCompound* compound, bool syncToDisk)
+{
+	GHDFCompound_WriteToBuffer(compound, &s_writeBuffer);
+	return GHDFBuffer_WriteToFile(&s_writeBuffer, path, syncToDisk);
+}
+
+void GHDFCompound_Deconstruct(GHDFCompound* self)
+{
+	// Arena compounds are freed together with their arena.
+	if (self->_arena)
+	{
+		return;
+	}
+
+	for (unsigned int i = 0; i < self->Count; i++)
+	{
+		FreeEntryMemory(self->Entries + i);
+	}
+
+	Memory_Free(self->Entries);
+}
+
+/* Lazy compound. */
+Error GHDFLazyCompound_Open(char* data, size_t dataLength, GHDFArena* arena, GHDFLazyCompound* compound)
+{
+	GHDFReader Reader = { (unsigned char*)data, dataLength, 0, 0, arena, false };
+	Metrics_Add(MetricCounter_GHDFBytesRead, dataLength);
+	LTT_PROBE_GHDF_READ(dataLength);
+	Error ReturnedError = ReadMetadata(&Reader);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
-		File_Close(File);
-		GHDFCompound_Deconstruct(emptyBaseCompound);
 		return ReturnedError;
 	}
 
-	File_Close(File);
+	return OpenLazyCompound(&Reader, Reader._length, compound);
+}
+
+Error GHDFLazyCompound_OpenFile(const char* path, GHDFArena* arena, GHDFLazyCompound* compound)
+{
+	if (!File_Exists(path))
+	{
+		return Error_CreateError(ErrorCode_IO, "GHDFLazyCompound_OpenFile: Provided GHDF file doesn't exist.");
+	}
+
+	FileMapping* Mapping;
+	Error ReturnedError = MapFileIntoArena(path, arena, &Mapping);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	return GHDFLazyCompound_Open(Mapping->Data, Mapping->Length, arena, compound);
+}
+
+void GHDFLazyCompound_BeginReading(GHDFLazyCompound* self, GHDFReader* reader)
+{
+	ConstructLazyCompoundReader(self, reader);
+}
+
+Error GHDFLazyCompound_ReadEntries(GHDFLazyCompound* self, const int* ids, size_t idCount, GHDFCompound* emptyCompound)
+{
+	GHDFReader Reader;
+	ConstructLazyCompoundReader(self, &Reader);
+	ReaderConstructCompound(&Reader, emptyCompound, (unsigned int)idCount);
+
+	size_t FoundCount = 0;
+	for (unsigned int i = 0; (i < self->Count) && (FoundCount < idCount); i++)
+	{
+		int ID;
+		GHDFType EntryType;
+		Error ReturnedError = ReadEntryInfo(&Reader, &ID, &EntryType);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			GHDFCompound_Deconstruct(emptyCompound);
+			return ReturnedError;
+		}
+
+		if (ContainsID(ids, idCount, ID))
+		{
+			ReturnedError = ReadEntryValue(&Reader, ID, EntryType, emptyCompound);
+			FoundCount++;
+		}
+		else
+		{
+			ReturnedError = SkipEntryValue(&Reader, EntryType);
+		}
+
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			GHDFCompound_Deconstruct(emptyCompound);
+			return ReturnedError;
+		}
+	}
+
 	return Error_CreateSuccess();
 }
 
-Error GHDFCompound_WriteToFile(const char* path, GHDFCompound* compound)
+Error GHDFLazyCompound_GetCompound(GHDFLazyCompound* self, int id, GHDFLazyCompound* subCompound, bool* isFound)
 {
-	const char* Path = Directory_ChangePathExtension(path, GHDF_FILE_EXTENSION);
+	*isFound = false;
+	GHDFReader Reader;
+	ConstructLazyCompoundReader(self, &Reader);
 
-	const char* DirectoryPath = Directory_GetParentDirectory(Path);
-	Directory_CreateAll(DirectoryPath);
-	Memory_Free((char*)DirectoryPath);
+	for (unsigned int i = 0; i < self->Count; i++)
+	{
+		int ID;
+		GHDFType EntryType;
+		Error ReturnedError = ReadEntryInfo(&Reader, &ID, &EntryType);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
 
-	File_Delete(Path);
+		if (ID != id)
+		{
+			ReturnedError = SkipEntryValue(&Reader, EntryType);
+			if (ReturnedError.Code != ErrorCode_Success)
+			{
+				return ReturnedError;
+			}
+			continue;
+		}
 
-	Error ReturnedError;
-	FILE* File = File_Open(Path, FileOpenMode_WriteBinary, &ReturnedError);
-	Memory_Free((char*)Path);
+		if (EntryType != GHDFType_Compound)
+		{
+			return Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFLazyCompound_GetCompound: Entry is not a compound.");
+		}
 
-	if (!File)
+		size_t ValueEnd;
+		ReturnedError = ReadValueLength(&Reader, EntryType, &ValueEnd);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+		ReturnedError = OpenLazyCompound(&Reader, ValueEnd, subCompound);
+		*isFound = ReturnedError.Code == ErrorCode_Success;
+		return ReturnedError;
+	}
+
+	return Error_CreateSuccess();
+}
+
+/* Reader. */
+Error GHDFReader_Open(GHDFReader* reader, const char* data, size_t dataLength, GHDFArena* arena, unsigned int* entryCount)
+{
+	reader->_data = (unsigned char*)data;
+	reader->_length = dataLength;
+	reader->_position = 0;
+	reader->_version = 0;
+	reader->_arena = arena;
+	reader->_isDataDisposable = false;
+
+	Error ReturnedError = ReadMetadata(reader);
+	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
 
-	ReturnedError = WriteMetadata(File);
+	return GHDFReader_ReadCompoundHeader(reader, entryCount);
+}
+
+Error GHDFReader_ReadCompoundHeader(GHDFReader* reader, unsigned int* entryCount)
+{
+	int EntryCount;
+	Error ReturnedError = Read7BitEncodedInt(reader, &EntryCount);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
-		File_Close(File);
 		return ReturnedError;
 	}
+	if ((EntryCount < 0) || ((size_t)EntryCount > ((reader->_length - reader->_position) / MIN_ENCODED_ENTRY_SIZE)))
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFReader_ReadCompoundHeader: Entry count is larger than the remaining data.");
+	}
 
-	ReturnedError = WriteCompound(File, compound);
+	*entryCount = (unsigned int)EntryCount;
+	return Error_CreateSuccess();
+}
+
+Error GHDFReader_ReadEntryInfo(GHDFReader* reader, GHDFEntryInfo* info)
+{
+	Error ReturnedError = ReadEntryInfo(reader, &info->ID, &info->ValueType);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
-		File_Close(File);
 		return ReturnedError;
 	}
 
-	File_Close(File);
+	return ReadValueLength(reader, info->ValueType, &info->_valueEnd);
+}
+
+Error GHDFReader_ReadValue(GHDFReader* reader, GHDFEntryInfo* info, GHDFType expectedType, GHDFPrimitive* value)
+{
+	Error ReturnedError = VerifyEntryType(info, expectedType);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	ReturnedError = ReadSingleValue(reader, expectedType, value);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	ReturnedError = GHDFReader_EndValue(reader, info);
+	if ((ReturnedError.Code != ErrorCode_Success) && !reader->_arena)
+	{
+		FreeSingleValue(*value, expectedType);
+	}
+	return ReturnedError;
+}
+
+Error GHDFReader_ReadArrayHeader(GHDFReader* reader, GHDFEntryInfo* info, GHDFType expectedElementType, unsigned int* elementCount)
+{
+	Error ReturnedError = VerifyEntryType(info, expectedElementType | GHDF_TYPE_ARRAY_BIT);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	unsigned int ElementCount;
+	ReturnedError = Read7BitEncodedInt(reader, (int*)(&ElementCount));
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	if (ElementCount > (reader->_length - reader->_position))
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFReader_ReadArrayHeader: Array is larger than the remaining data.");
+	}
+
+	*elementCount = ElementCount;
 	return Error_CreateSuccess();
 }
 
-void GHDFCompound_Deconstruct(GHDFCompound* self)
+Error GHDFReader_ReadArrayElements(GHDFReader* reader, GHDFType elementType, void* elements, unsigned int elementCount)
 {
-	for (unsigned int i = 0; i < self->Count; i++)
+	size_t ByteCount = TryGetTypeSize(elementType) * elementCount;
+	const unsigned char* Bytes = ReadBytes(reader, ByteCount);
+	if (!Bytes)
 	{
-		FreeEntryMemory(self->Entries + i);
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFReader_ReadArrayElements: Unexpected end of data.");
 	}
 
-	Memory_Free(self->Entries);
+	Memory_Copy((const char*)Bytes, (char*)elements, ByteCount);
+	return Error_CreateSuccess();
+}
+
+Error GHDFReader_SkipValue(GHDFReader* reader, GHDFEntryInfo* info)
+{
+	return SkipValue(reader, info->ValueType, info->_valueEnd);
+}
+
+Error GHDFReader_EndValue(GHDFReader* reader, GHDFEntryInfo* info)
+{
+	if (HasLengthPrefix(reader, info->ValueType) && (reader->_position != info->_valueEnd))
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFReader_EndValue: Value doesn't match its length prefix.");
+	}
+	return Error_CreateSuccess();
 }
\ No newline at end of file
@@ -11,7 +11,12 @@
 
 #define COMPOUND_DEFAULT_CAPACITY 32
 
-#define GHDF_FORMAT_VERSION 1
+#define GHDF_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+#define GHDF_FORMAT_VERSION 2
+#define GHDF_OLDEST_FORMAT_VERSION 1
+/* From this version on, compound and array entry values are prefixed with their encoded length in bytes. */
+#define GHDF_FORMAT_VERSION_LENGTH_PREFIXES 2
 
 #define GHDF_SIZE_SBYTE 1
 #define GHDF_SIZE_UBYTE 1
@@ -90,15 +95,115 @@ typedef struct GHDFEntryStruct
 	GHDFEntryValue Value;
 } GHDFEntry;
 
+/* Entries are kept sorted by ID, lookups use the ID as a direct index when IDs are consecutive and a binary search otherwise. */
 typedef struct GHDFCompoundStruct
 {
 	GHDFEntry* Entries;
 	unsigned int Count;
 	unsigned int _capacity;
+	struct GHDFArenaStruct* _arena;
 } GHDFCompound;
 
+/* Undecoded compound inside a GHDF file, entries are only decoded when asked for. */
+typedef struct GHDFLazyCompoundStruct
+{
+	unsigned int Count;
+	char* _data;
+	size_t _length;
+	int _version;
+	struct GHDFArenaStruct* _arena;
+} GHDFLazyCompound;
+
+/* Position inside encoded GHDF data, entries are decoded one at a time straight into the caller's own structures. */
+typedef struct GHDFReaderStruct
+{
+	unsigned char* _data;
+	size_t _length;
+	size_t _position;
+	int _version;
+	struct GHDFArenaStruct* _arena;
+	bool _isDataDisposable;
+} GHDFReader;
+
+typedef struct GHDFEntryInfoStruct
+{
+	int ID;
+	GHDFType ValueType;
+	size_t _valueEnd;
+} GHDFEntryInfo;
+
+/* Growable byte buffer which holds a serialized compound, can be reused between writes. */
+typedef struct GHDFBufferStruct
+{
+	char* Data;
+	size_t Length;
+	size_t _capacity;
+} GHDFBuffer;
+
+/* Bump allocator for compounds decoded with GHDFCompound_ReadFromFileArena, everything in it is freed at once. */
+typedef struct GHDFArenaStruct
+{
+	struct GHDFArenaBlockStruct* _firstBlock;
+	struct GHDFArenaBlockStruct* _currentBlock;
+	struct GHDFArenaMappingStruct* _mappings;
+	size_t _blockSize;
+} GHDFArena;
+
 
 // Functions.
+/* Arena. */
+void GHDFArena_Construct(GHDFArena* self, size_t blockSize);
+
+void* GHDFArena_Allocate(GHDFArena* self, size_t size);
+
+/// <summary>
+/// Frees everything allocated from the arena and unmaps all files decoded into it, keeping the first block for reuse.
+/// </summary>
+void GHDFArena_Clear(GHDFArena* self);
+
+void GHDFArena_Deconstruct(GHDFArena* self);
+
+/* Buffer. */
+void GHDFBuffer_Construct(GHDFBuffer* self, size_t capacity);
+
+/// <summary>
+/// The calling thread's reusable write buffer, shared with GHDFCompound_WriteToFile.
+/// </summary>
+GHDFBuffer* GHDFBuffer_GetThreadBuffer();
+
+/// <summary>
+/// Replaces the buffer's contents with the signature and version, the root compound is written after it.
+/// </summary>
+void GHDFBuffer_BeginFile(GHDFBuffer* buffer);
+
+/// <summary>
+/// Starts a compound value, exactly the given amount of entries has to be written after it.
+/// </summary>
+void GHDFBuffer_WriteCompoundHeader(GHDFBuffer* buffer, unsigned int entryCount);
+
+void GHDFBuffer_WriteValueEntry(GHDFBuffer* buffer, GHDFType type, int id, GHDFPrimitive value);
+
+/// <summary>
+/// Writes an array entry of a fixed size type straight from a packed C array.
+/// </summary>
+void GHDFBuffer_WriteArrayEntry(GHDFBuffer* buffer, GHDFType elementType, int id, const void* elements, unsigned int elementCount);
+
+/// <summary>
+/// Starts an array entry whose elements are written by the caller, for example compounds started with GHDFBuffer_WriteCompoundHeader.
+/// </summary>
+/// <returns>Position which has to be passed to GHDFBuffer_EndEntry once all elements are written.</returns>
+size_t GHDFBuffer_BeginArrayEntry(GHDFBuffer* buffer, GHDFType elementType, int id, unsigned int elementCount);
+
+void GHDFBuffer_EndEntry(GHDFBuffer* buffer, size_t entryStart);
+
+/// <summary>
+/// Replaces the file with the buffer's contents in a single write, see GHDFCompound_WriteToFile.
+/// </summary>
+Error GHDFBuffer_WriteToFile(GHDFBuffer* buffer, const char* path, bool syncToDisk);
+
+void GHDFBuffer_Deconstruct(GHDFBuffer* self);
+
+/* Compound. */
 void GHDFCompound_Construct(GHDFCompound* self, unsigned int capacity);
 
 GHDFCompound* GHDFCompound_Construct2(unsigned int capacity);
@@ -119,8 +224,117 @@ Error GHDFCompound_GetVerifiedOptionalEntry(GHDFCompound* self, int id, GHDFEntr
 
 GHDFEntry* GHDFCompound_GetEntryOrDefault(GHDFCompound* self, int id, GHDFEntry* defaultEntry);
 
-Error GHDFCompound_ReadFromFile(const char* path, GHDFCompound* emptyBaseCompound);
+/// <summary>
+/// Decodes a GHDF file which is already in memory. On failure the compound is left deconstructed.
+/// </summary>
+/// <param name="data">The file's bytes, including the signature and version.</param>
+/// <param name="dataLength">Amount of bytes, reading never goes past it.</param>
+Error GHDFCompound_ReadFromBuffer(const char* data, size_t dataLength, GHDFCompound* emptyBaseCompound);
 
-Error GHDFCompound_WriteToFile(const char* path, GHDFCompound* compound);
+Error GHDFCompound_ReadFromFile(const char* path, GHDFCompound* emptyBaseCompound);
 
-void GHDFCompound_Deconstruct(GHDFCompound* self);
\ No newline at end of file
+/// <summary>
+/// Decodes a GHDF file without allocating per value. The file stays mapped and strings point directly into it,
+/// compounds and arrays are taken from the arena. Values added to such a compound must also live in the arena.
+/// </summary>
+/// <param name="arena">Owns the decoded data until it is cleared, the compound doesn't need to be deconstructed.</param>
+Error GHDFCompound_ReadFromFileArena(const char* path, GHDFCompound* emptyBaseCompound, GHDFArena* arena);
+
+/// <summary>
+/// Rewrites a file in the current format version if it was written by an older one.
+/// </summary>
+/// <param name="isUpgraded">Set to true if the file was rewritten.</param>
+Error GHDFCompound_UpgradeFile(const char* path, bool syncToDisk, bool* isUpgraded);
+
+/// <summary>
+/// Hands a string entry's value to the caller without copying it. For regular compounds the caller becomes its owner
+/// and the entry is left empty. For arena compounds the string stays owned by the arena.
+/// </summary>
+char* GHDFCompound_TakeString(GHDFCompound* self, GHDFEntry* entry);
+
+/// <summary>
+/// Serializes the compound, including the signature and version, replacing the buffer's previous contents.
+/// </summary>
+void GHDFCompound_WriteToBuffer(GHDFCompound* compound, GHDFBuffer* buffer);
+
+/// <summary>
+/// Serializes the compound in memory and replaces the file with a single write. A crash leaves either the old
+/// or the new file, never a partial one.
+/// </summary>
+/// <param name="syncToDisk">Flushes the data to the disk before replacing the file, so it also survives a power loss.</param>
+Error GHDFCompound_WriteToFile(const char* path, GHDFCompound* compound, bool syncToDisk);
+
+void GHDFCompound_Deconstruct(GHDFCompound* self);
+
+/* Lazy compound. */
+/// <summary>
+/// Opens the root compound of a GHDF file which is already in memory without decoding any entries.
+/// </summary>
+/// <param name="data">The file's bytes, must stay valid while the lazy compound is used.</param>
+/// <param name="arena">Arena which decoded entries are placed into, NULL to allocate them normally.</param>
+Error GHDFLazyCompound_Open(char* data, size_t dataLength, GHDFArena* arena, GHDFLazyCompound* compound);
+
+/// <summary>
+/// Maps a GHDF file into the arena and opens its root compound without decoding any entries.
+/// </summary>
+Error GHDFLazyCompound_OpenFile(const char* path, GHDFArena* arena, GHDFLazyCompound* compound);
+
+/// <summary>
+/// Positions the reader at the compound's first entry, the compound's Count entries can then be read one at a time.
+/// </summary>
+void GHDFLazyCompound_BeginReading(GHDFLazyCompound* self, GHDFReader* reader);
+
+/// <summary>
+/// Decodes only the entries with the given IDs, all other entries are skipped without being decoded.
+/// Entries missing from the file are missing from the result.
+/// </summary>
+/// <param name="emptyCompound">Receives the decoded entries. Must be deconstructed unless the lazy compound uses an arena.</param>
+Error GHDFLazyCompound_ReadEntries(GHDFLazyCompound* self, const int* ids, size_t idCount, GHDFCompound* emptyCompound);
+
+/// <summary>
+/// Opens a nested compound entry without decoding it.
+/// </summary>
+/// <param name="isFound">Set to false if there is no entry with the ID.</param>
+Error GHDFLazyCompound_GetCompound(GHDFLazyCompound* self, int id, GHDFLazyCompound* subCompound, bool* isFound);
+
+/* Reader. */
+/// <summary>
+/// Opens a GHDF file which is already in memory and positions the reader at the root compound's first entry.
+/// </summary>
+/// <param name="data">The file's bytes, must stay valid while reading.</param>
+/// <param name="arena">Arena which strings are placed into, NULL to allocate them normally.</param>
+/// <param name="entryCount">Receives the root compound's entry count.</param>
+Error GHDFReader_Open(GHDFReader* reader, const char* data, size_t dataLength, GHDFArena* arena, unsigned int* entryCount);
+
+/// <summary>
+/// Reads the entry count of a compound value, its entries follow.
+/// </summary>
+Error GHDFReader_ReadCompoundHeader(GHDFReader* reader, unsigned int* entryCount);
+
+/// <summary>
+/// Reads an entry's ID and type. Its value has to be read or skipped before the next entry.
+/// </summary>
+Error GHDFReader_ReadEntryInfo(GHDFReader* reader, GHDFEntryInfo* info);
+
+/// <summary>
+/// Reads a single value entry, failing if the entry isn't of the expected type.
+/// </summary>
+Error GHDFReader_ReadValue(GHDFReader* reader, GHDFEntryInfo* info, GHDFType expectedType, GHDFPrimitive* value);
+
+/// <summary>
+/// Reads the element count of an array entry, failing if the entry isn't an array of the expected type.
+/// The elements have to be read next, followed by GHDFReader_EndValue.
+/// </summary>
+Error GHDFReader_ReadArrayHeader(GHDFReader* reader, GHDFEntryInfo* info, GHDFType expectedElementType, unsigned int* elementCount);
+
+/// <summary>
+/// Copies array elements of a fixed size type straight into a packed C array.
+/// </summary>
+Error GHDFReader_ReadArrayElements(GHDFReader* reader, GHDFType elementType, void* elements, unsigned int elementCount);
+
+Error GHDFReader_SkipValue(GHDFReader* reader, GHDFEntryInfo* info);
+
+/// <summary>
+/// Verifies that an array entry's value was read up to its end.
+/// </summary>
+Error GHDFReader_EndValue(GHDFReader* reader, GHDFEntryInfo* info);
\ No newline at end of file
@@ -0,0 +1,833 @@
+#include "GHDFSegment.h"
+#include "File.h"
+#include "Memory.h"
+#include "LTTBytes.h"
+#include "LttString.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+
+// Macros.
+#define SEGMENT_SIGNATURE "GHDFSEGM"
+#define SEGMENT_TAIL_SIGNATURE "GHDFSEGT"
+#define SEGMENT_SIGNATURE_LENGTH 8
+#define SEGMENT_FORMAT_VERSION 1
+
+/* Signature, version and reserved space. */
+#define HEADER_SIZE (SEGMENT_SIGNATURE_LENGTH + 4 + 4)
+/* ID and data length. */
+#define RECORD_HEADER_SIZE (8 + 4)
+/* Entry count, followed by entries with an ID, offset and length each. */
+#define TABLE_COUNT_SIZE 4
+#define TABLE_ENTRY_SIZE (8 + 8 + 4)
+/* Table offset, table checksum and signature. */
+#define TAIL_SIZE (8 + 4 + SEGMENT_SIGNATURE_LENGTH)
+
+#define TAIL_SCAN_CHUNK_SIZE (64 * 1024)
+
+/* Compaction only pays off once enough space is wasted. */
+#define COMPACTION_MIN_FREE_BYTES (1024 * 1024)
+
+#define RECORD_LIST_CAPACITY 64
+#define EXTENT_LIST_CAPACITY 16
+#define LIST_GROWTH 2
+
+#define COMPACTION_FILE_SUFFIX ".compact"
+
+
+// Static functions.
+/* Extent lists. */
+static void ExtentListConstruct(GHDFSegmentExtentList* list)
+{
+	list->_capacity = EXTENT_LIST_CAPACITY;
+	list->Extents = (GHDFSegmentExtent*)Memory_SafeMalloc(sizeof(GHDFSegmentExtent) * list->_capacity);
+	list->Count = 0;
+}
+
+static void ExtentListEnsureCapacity(GHDFSegmentExtentList* list, size_t capacity)
+{
+	if (list->_capacity >= capacity)
+	{
+		return;
+	}
+
+	while (list->_capacity < capacity)
+	{
+		list->_capacity *= LIST_GROWTH;
+	}
+	list->Extents = (GHDFSegmentExtent*)Memory_SafeRealloc(list->Extents, sizeof(GHDFSegmentExtent) * list->_capacity);
+}
+
+/* Keeps the list sorted by offset and merges touching extents. */
+static void ExtentListAdd(GHDFSegmentExtentList* list, unsigned long long offset, unsigned long long length)
+{
+	if (length == 0)
+	{
+		return;
+	}
+
+	size_t Index = 0;
+	while ((Index < list->Count) && (list->Extents[Index].Offset < offset))
+	{
+		Index++;
+	}
+
+	bool IsMergedWithPrevious = (Index > 0) && ((list->Extents[Index - 1].Offset + list->Extents[Index - 1].Length) == offset);
+	bool IsMergedWithNext = (Index < list->Count) && ((offset + length) == list->Extents[Index].Offset);
+
+	if (IsMergedWithPrevious && IsMergedWithNext)
+	{
+		list->Extents[Index - 1].Length += length + list->Extents[Index].Length;
+		memmove(list->Extents + Index, list->Extents + Index + 1, sizeof(GHDFSegmentExtent) * (list->Count - Index - 1));
+		list->Count--;
+	}
+	else if (IsMergedWithPrevious)
+	{
+		list->Extents[Index - 1].Length += length;
+	}
+	else if (IsMergedWithNext)
+	{
+		list->Extents[Index].Offset = offset;
+		list->Extents[Index].Length += length;
+	}
+	else
+	{
+		ExtentListEnsureCapacity(list, list->Count + 1);
+		memmove(list->Extents + Index + 1, list->Extents + Index, sizeof(GHDFSegmentExtent) * (list->Count - Index));
+		list->Extents[Index].Offset = offset;
+		list->Extents[Index].Length = length;
+		list->Count++;
+	}
+}
+
+/* First fit, lower offsets are filled first so that the end of the file frees up for compaction. */
+static bool ExtentListTake(GHDFSegmentExtentList* list, unsigned long long length, unsigned long long* offset)
+{
+	for (size_t i = 0; i < list->Count; i++)
+	{
+		if (list->Extents[i].Length < length)
+		{
+			continue;
+		}
+
+		*offset = list->Extents[i].Offset;
+		list->Extents[i].Offset += length;
+		list->Extents[i].Length -= length;
+		if (list->Extents[i].Length == 0)
+		{
+			memmove(list->Extents + i, list->Extents + i + 1, sizeof(GHDFSegmentExtent) * (list->Count - i - 1));
+			list->Count--;
+		}
+		return true;
+	}
+	return false;
+}
+
+static void ExtentListDeconstruct(GHDFSegmentExtentList* list)
+{
+	Memory_Free(list->Extents);
+}
+
+/* Records. */
+static unsigned long long GetSlotLength(GHDFSegmentRecord* record)
+{
+	return RECORD_HEADER_SIZE + (unsigned long long)record->Length;
+}
+
+static size_t FindRecordIndex(GHDFSegment* self, unsigned long long id, bool* isFound)
+{
+	size_t Low = 0;
+	size_t High = self->RecordCount;
+	while (Low < High)
+	{
+		size_t Middle = Low + ((High - Low) / 2);
+		if (self->_records[Middle].ID < id)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+
+	*isFound = (Low < self->RecordCount) && (self->_records[Low].ID == id);
+	return Low;
+}
+
+static void EnsureRecordCapacity(GHDFSegment* self, size_t capacity)
+{
+	if (self->_recordCapacity >= capacity)
+	{
+		return;
+	}
+
+	if (self->_recordCapacity == 0)
+	{
+		self->_recordCapacity = RECORD_LIST_CAPACITY;
+	}
+	while (self->_recordCapacity < capacity)
+	{
+		self->_recordCapacity *= LIST_GROWTH;
+	}
+	self->_records = (GHDFSegmentRecord*)Memory_SafeRealloc(self->_records, sizeof(GHDFSegmentRecord) * self->_recordCapacity);
+}
+
+static int CompareExtentOffsets(const void* extent1, const void* extent2)
+{
+	unsigned long long Offset1 = ((const GHDFSegmentExtent*)extent1)->Offset;
+	unsigned long long Offset2 = ((const GHDFSegmentExtent*)extent2)->Offset;
+	return (Offset1 > Offset2) - (Offset1 < Offset2);
+}
+
+/* Offset table. */
+static size_t GetTableSize(size_t recordCount)
+{
+	return TABLE_COUNT_SIZE + (recordCount * TABLE_ENTRY_SIZE) + TAIL_SIZE;
+}
+
+static unsigned char* BuildTable(GHDFSegment* self, unsigned long long tableOffset, size_t* tableSize)
+{
+	*tableSize = GetTableSize(self->RecordCount);
+	unsigned char* Table = (unsigned char*)Memory_SafeMalloc(*tableSize);
+
+	Bytes_EncodeUInt(Table, (unsigned int)self->RecordCount);
+	unsigned char* Entry = Table + TABLE_COUNT_SIZE;
+	for (size_t i = 0; i < self->RecordCount; i++, Entry += TABLE_ENTRY_SIZE)
+	{
+		Bytes_EncodeULong(Entry, self->_records[i].ID);
+		Bytes_EncodeULong(Entry + 8, self->_records[i].Offset);
+		Bytes_EncodeUInt(Entry + 16, self->_records[i].Length);
+	}
+
+	size_t EntriesSize = *tableSize - TAIL_SIZE;
+	Bytes_EncodeULong(Table + EntriesSize, tableOffset);
+	Bytes_EncodeUInt(Table + EntriesSize + 8, Bytes_Hash(Table, EntriesSize));
+	Memory_Copy(SEGMENT_TAIL_SIGNATURE, (char*)Table + EntriesSize + 12, SEGMENT_SIGNATURE_LENGTH);
+	return Table;
+}
+
+/* Rebuilds the free extents from the gaps between the records. Fails if any records overlap. */
+static bool BuildFreeExtents(GHDFSegment* self)
+{
+	self->_freeExtents.Count = 0;
+	self->_releasedExtents.Count = 0;
+	self->_liveBytes = 0;
+	if (self->RecordCount == 0)
+	{
+		ExtentListAdd(&self->_freeExtents, HEADER_SIZE, self->_tableOffset - HEADER_SIZE);
+		return true;
+	}
+
+	GHDFSegmentExtent* Slots = (GHDFSegmentExtent*)Memory_SafeMalloc(sizeof(GHDFSegmentExtent) * self->RecordCount);
+	for (size_t i = 0; i < self->RecordCount; i++)
+	{
+		Slots[i].Offset = self->_records[i].Offset;
+		Slots[i].Length = GetSlotLength(self->_records + i);
+		self->_liveBytes += Slots[i].Length;
+	}
+	qsort(Slots, self->RecordCount, sizeof(GHDFSegmentExtent), CompareExtentOffsets);
+
+	unsigned long long Position = HEADER_SIZE;
+	bool IsValid = true;
+	for (size_t i = 0; i < self->RecordCount; i++)
+	{
+		if (Slots[i].Offset < Position)
+		{
+			IsValid = false;
+			break;
+		}
+		ExtentListAdd(&self->_freeExtents, Position, Slots[i].Offset - Position);
+		Position = Slots[i].Offset + Slots[i].Length;
+	}
+	IsValid = IsValid && (Position <= self->_tableOffset);
+	if (IsValid)
+	{
+		ExtentListAdd(&self->_freeExtents, Position, self->_tableOffset - Position);
+	}
+
+	Memory_Free(Slots);
+	return IsValid;
+}
+
+/* Loads the offset table whose tail starts at the position, returns false if it isn't intact. */
+static bool TryLoadTable(GHDFSegment* self, unsigned long long tailPosition)
+{
+	unsigned char Tail[TAIL_SIZE];
+	if ((tailPosition < (HEADER_SIZE + TABLE_COUNT_SIZE))
+		|| (File_ReadAt(self->_file, tailPosition, (char*)Tail, TAIL_SIZE).Code != ErrorCode_Success)
+		|| memcmp(Tail + 12, SEGMENT_TAIL_SIGNATURE, SEGMENT_SIGNATURE_LENGTH))
+	{
+		return false;
+	}
+
+	unsigned long long TableOffset = Bytes_DecodeULong(Tail);
+	if ((TableOffset < HEADER_SIZE) || (TableOffset > (tailPosition - TABLE_COUNT_SIZE))
+		|| (((tailPosition - TableOffset - TABLE_COUNT_SIZE) % TABLE_ENTRY_SIZE) != 0))
+	{
+		return false;
+	}
+
+	size_t EntriesSize = (size_t)(tailPosition - TableOffset);
+	unsigned char* Entries = (unsigned char*)Memory_SafeMalloc(EntriesSize);
+	bool IsValid = (File_ReadAt(self->_file, TableOffset, (char*)Entries, EntriesSize).Code == ErrorCode_Success)
+		&& (Bytes_Hash(Entries, EntriesSize) == Bytes_DecodeUInt(Tail + 8))
+		&& (Bytes_DecodeUInt(Entries) == ((EntriesSize - TABLE_COUNT_SIZE) / TABLE_ENTRY_SIZE));
+
+	size_t RecordCount = IsValid ? Bytes_DecodeUInt(Entries) : 0;
+	self->RecordCount = 0;
+	EnsureRecordCapacity(self, RecordCount);
+	for (size_t i = 0; IsValid && (i < RecordCount); i++)
+	{
+		const unsigned char* Entry = Entries + TABLE_COUNT_SIZE + (i * TABLE_ENTRY_SIZE);
+		GHDFSegmentRecord* Record = self->_records + i;
+		Record->ID = Bytes_DecodeULong(Entry);
+		Record->Offset = Bytes_DecodeULong(Entry + 8);
+		Record->Length = Bytes_DecodeUInt(Entry + 16);
+		IsValid = ((i == 0) || (Record->ID > self->_records[i - 1].ID)) && (Record->Offset >= HEADER_SIZE);
+		self->RecordCount = i + 1;
+	}
+	Memory_Free(Entries);
+
+	self->_tableOffset = TableOffset;
+	self->_tableLength = (tailPosition + TAIL_SIZE) - TableOffset;
+	self->_fileLength = tailPosition + TAIL_SIZE;
+	if (!IsValid || !BuildFreeExtents(self))
+	{
+		self->RecordCount = 0;
+		return false;
+	}
+	return true;
+}
+
+/* A crash while committing leaves a partial table or unreferenced records at the end of the file,
+* the latest intact table before them is the last committed state. */
+static bool FindLatestTable(GHDFSegment* self, unsigned long long fileLength)
+{
+	if ((fileLength >= TAIL_SIZE) && TryLoadTable(self, fileLength - TAIL_SIZE))
+	{
+		return true;
+	}
+
+	char* Chunk = (char*)Memory_SafeMalloc(TAIL_SCAN_CHUNK_SIZE);
+	unsigned long long ChunkEnd = fileLength;
+	bool IsFound = false;
+	while (!IsFound && (ChunkEnd > HEADER_SIZE))
+	{
+		unsigned long long ChunkStart = (ChunkEnd - HEADER_SIZE) > TAIL_SCAN_CHUNK_SIZE ? (ChunkEnd - TAIL_SCAN_CHUNK_SIZE) : HEADER_SIZE;
+		size_t ChunkLength = (size_t)(ChunkEnd - ChunkStart);
+		if (File_ReadAt(self->_file, ChunkStart, Chunk, ChunkLength).Code != ErrorCode_Success)
+		{
+			break;
+		}
+
+		for (size_t i = ChunkLength; !IsFound && (i-- > 0);)
+		{
+			if ((Chunk[i] == SEGMENT_TAIL_SIGNATURE[0]) && (ChunkStart + i >= 12)
+				&& ((ChunkStart + i + SEGMENT_SIGNATURE_LENGTH) <= fileLength))
+			{
+				IsFound = TryLoadTable(self, ChunkStart + i - 12);
+			}
+		}
+
+		// Overlap the chunks by a signature so that signatures crossing a boundary are found.
+		ChunkEnd = ChunkStart + ((ChunkStart > HEADER_SIZE) ? SEGMENT_SIGNATURE_LENGTH : 0);
+		if (ChunkStart == HEADER_SIZE)
+		{
+			break;
+		}
+	}
+
+	Memory_Free(Chunk);
+	return IsFound;
+}
+
+static Error WriteHeader(FILE* file)
+{
+	unsigned char Header[HEADER_SIZE];
+	Memory_Set((char*)Header, HEADER_SIZE, 0);
+	Memory_Copy(SEGMENT_SIGNATURE, (char*)Header, SEGMENT_SIGNATURE_LENGTH);
+	Bytes_EncodeUInt(Header + SEGMENT_SIGNATURE_LENGTH, SEGMENT_FORMAT_VERSION);
+	return File_WriteAt(file, 0, (const char*)Header, HEADER_SIZE);
+}
+
+static Error VerifyHeader(FILE* file)
+{
+	unsigned char Header[HEADER_SIZE];
+	Error ReturnedError = File_ReadAt(file, 0, (char*)Header, HEADER_SIZE);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Error_Deconstruct(&ReturnedError);
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFSegment_Open: File is too short to be a segment.");
+	}
+	if (memcmp(Header, SEGMENT_SIGNATURE, SEGMENT_SIGNATURE_LENGTH))
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFSegment_Open: Invalid segment signature.");
+	}
+	if (Bytes_DecodeUInt(Header + SEGMENT_SIGNATURE_LENGTH) != SEGMENT_FORMAT_VERSION)
+	{
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFSegment_Open: Unsupported segment format version.");
+	}
+	return Error_CreateSuccess();
+}
+
+static Error FlushWrites(GHDFSegment* self, FILE* file)
+{
+	return self->_syncWrites ? File_Sync(file) : File_Flush(file);
+}
+
+static Error CreateEmptySegment(GHDFSegment* self, const char* path)
+{
+	Error ReturnedError;
+	FILE* File = File_Open(path, FileOpenMode_WriteBinary, &ReturnedError);
+	if (!File)
+	{
+		return ReturnedError;
+	}
+
+	self->RecordCount = 0;
+	size_t TableSize;
+	unsigned char* Table = BuildTable(self, HEADER_SIZE, &TableSize);
+	ReturnedError = WriteHeader(File);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = File_WriteAt(File, HEADER_SIZE, (const char*)Table, TableSize);
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = FlushWrites(self, File);
+	}
+	Memory_Free(Table);
+	File_Close(File);
+	return ReturnedError;
+}
+
+static bool ShouldCompact(GHDFSegment* self)
+{
+	unsigned long long WastedBytes = self->_fileLength - HEADER_SIZE - self->_liveBytes - self->_tableLength;
+	return (WastedBytes >= COMPACTION_MIN_FREE_BYTES) && (WastedBytes > self->_liveBytes);
+}
+
+static Error Commit(GHDFSegment* self)
+{
+	// Records carry no checksum, so they must be on the disk before a table which points at them can be.
+	Error ReturnedError = FlushWrites(self, self->_file);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	self->_isStreamDirty = false;
+
+	// The table always goes to the end of the file, so the latest one is found without scanning.
+	unsigned long long TableOffset = self->_fileLength;
+	size_t TableSize;
+	unsigned char* Table = BuildTable(self, TableOffset, &TableSize);
+	ReturnedError = File_WriteAt(self->_file, TableOffset, (const char*)Table, TableSize);
+	Memory_Free(Table);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = FlushWrites(self, self->_file);
+	}
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	// Only now nothing refers to the previous table and the released records anymore.
+	ExtentListAdd(&self->_freeExtents, self->_tableOffset, self->_tableLength);
+	for (size_t i = 0; i < self->_releasedExtents.Count; i++)
+	{
+		ExtentListAdd(&self->_freeExtents, self->_releasedExtents.Extents[i].Offset, self->_releasedExtents.Extents[i].Length);
+	}
+	self->_releasedExtents.Count = 0;
+
+	self->_tableOffset = TableOffset;
+	self->_tableLength = TableSize;
+	self->_fileLength = TableOffset + TableSize;
+	self->_isCommitPending = false;
+	return Error_CreateSuccess();
+}
+
+static Error Compact(GHDFSegment* self)
+{
+	size_t PathLength = String_LengthBytes(self->_path);
+	char* CompactPath = (char*)Memory_SafeMalloc(PathLength + sizeof(COMPACTION_FILE_SUFFIX));
+	Memory_Copy(self->_path, CompactPath, PathLength);
+	Memory_Copy(COMPACTION_FILE_SUFFIX, CompactPath + PathLength, sizeof(COMPACTION_FILE_SUFFIX));
+
+	Error ReturnedError;
+	FILE* CompactFile = File_Open(CompactPath, FileOpenMode_WriteBinary, &ReturnedError);
+	if (!CompactFile)
+	{
+		Memory_Free(CompactPath);
+		return ReturnedError;
+	}
+
+	// Records are copied in ID order, their new offsets are only applied once the file has replaced the old one.
+	unsigned long long* NewOffsets = (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * (self->RecordCount + 1));
+	size_t BufferSize = 0;
+	char* Buffer = NULL;
+	unsigned long long Position = HEADER_SIZE;
+	ReturnedError = WriteHeader(CompactFile);
+	for (size_t i = 0; (i < self->RecordCount) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		size_t SlotLength = (size_t)GetSlotLength(self->_records + i);
+		if (BufferSize < SlotLength)
+		{
+			BufferSize = SlotLength;
+			Buffer = (char*)Memory_SafeRealloc(Buffer, BufferSize);
+		}
+
+		ReturnedError = File_ReadAt(self->_file, self->_records[i].Offset, Buffer, SlotLength);
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			ReturnedError = File_WriteAt(CompactFile, Position, Buffer, SlotLength);
+		}
+		NewOffsets[i] = Position;
+		Position += SlotLength;
+	}
+	Memory_Free(Buffer);
+
+	GHDFSegmentRecord* OldRecords = self->_records;
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		self->_records = (GHDFSegmentRecord*)Memory_SafeMalloc(sizeof(GHDFSegmentRecord) * (self->RecordCount + 1));
+		for (size_t i = 0; i < self->RecordCount; i++)
+		{
+			self->_records[i] = OldRecords[i];
+			self->_records[i].Offset = NewOffsets[i];
+		}
+
+		size_t TableSize;
+		unsigned char* Table = BuildTable(self, Position, &TableSize);
+		ReturnedError = File_WriteAt(CompactFile, Position, (const char*)Table, TableSize);
+		Memory_Free(Table);
+		Memory_Free(self->_records);
+		self->_records = OldRecords;
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = FlushWrites(self, CompactFile);
+	}
+	File_Close(CompactFile);
+
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		File_Close(self->_file);
+		self->_file = NULL;
+		ReturnedError = File_Replace(CompactPath, self->_path, self->_syncWrites);
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			for (size_t i = 0; i < self->RecordCount; i++)
+			{
+				self->_records[i].Offset = NewOffsets[i];
+			}
+			self->_tableOffset = Position;
+			self->_tableLength = GetTableSize(self->RecordCount);
+			self->_fileLength = Position + GetTableSize(self->RecordCount);
+			self->_isCommitPending = false;
+			BuildFreeExtents(self);
+		}
+
+		// Reopened either way, on failure the old file is still in place and unchanged.
+		Error OpenError;
+		self->_file = File_Open(self->_path, FileOpenMode_ReadUpdateBinary, &OpenError);
+		self->_isStreamDirty = false;
+		if ((ReturnedError.Code == ErrorCode_Success) && !self->_file)
+		{
+			ReturnedError = OpenError;
+		}
+	}
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		File_Delete(CompactPath);
+	}
+
+	Memory_Free(NewOffsets);
+	Memory_Free(CompactPath);
+	return ReturnedError;
+}
+
+/* Takes the lock shared, flushing records which are still in the stream's buffer first. */
+static Error LockForRead(GHDFSegment* self)
+{
+	ThreadLock_LockShared(&self->_lock);
+	while (self->_isStreamDirty)
+	{
+		ThreadLock_UnlockShared(&self->_lock);
+		ThreadLock_Lock(&self->_lock);
+		Error ReturnedError = self->_isStreamDirty ? File_Flush(self->_file) : Error_CreateSuccess();
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			self->_isStreamDirty = false;
+		}
+		ThreadLock_Unlock(&self->_lock);
+
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+		ThreadLock_LockShared(&self->_lock);
+	}
+	return Error_CreateSuccess();
+}
+
+static void ReleaseSlot(GHDFSegment* self, GHDFSegmentRecord* record)
+{
+	unsigned long long SlotLength = GetSlotLength(record);
+	self->_liveBytes -= SlotLength;
+
+	// Appended after the committed table means no committed table refers to it, so it is free right away.
+	if (record->Offset >= self->_tableOffset)
+	{
+		ExtentListAdd(&self->_freeExtents, record->Offset, SlotLength);
+	}
+	else
+	{
+		ExtentListAdd(&self->_releasedExtents, record->Offset, SlotLength);
+	}
+}
+
+
+// Functions.
+Error GHDFSegment_Open(GHDFSegment* self, const char* path, bool syncWrites)
+{
+	Memory_Set((char*)self, sizeof(GHDFSegment), 0);
+	self->_syncWrites = syncWrites;
+	ExtentListConstruct(&self->_freeExtents);
+	ExtentListConstruct(&self->_releasedExtents);
+	EnsureRecordCapacity(self, RECORD_LIST_CAPACITY);
+	ThreadLock_Construct(&self->_lock);
+
+	Error ReturnedError = File_Exists(path) ? Error_CreateSuccess() : CreateEmptySegment(self, path);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		self->_file = File_Open(path, FileOpenMode_ReadUpdateBinary, &ReturnedError);
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = VerifyHeader(self->_file);
+	}
+
+	unsigned long long FileLength = 0;
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = File_GetLength(self->_file, &FileLength);
+	}
+	if ((ReturnedError.Code == ErrorCode_Success) && !FindLatestTable(self, FileLength))
+	{
+		ReturnedError = Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFSegment_Open: No intact offset table found.");
+	}
+
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		if (self->_file)
+		{
+			File_Close(self->_file);
+		}
+		ExtentListDeconstruct(&self->_freeExtents);
+		ExtentListDeconstruct(&self->_releasedExtents);
+		Memory_Free(self->_records);
+		Memory_Set((char*)self, sizeof(GHDFSegment), 0);
+		return ReturnedError;
+	}
+
+	self->_path = String_CreateCopy(path);
+	return Error_CreateSuccess();
+}
+
+bool GHDFSegment_Contains(GHDFSegment* self, unsigned long long id)
+{
+	bool IsFound;
+	ThreadLock_LockShared(&self->_lock);
+	FindRecordIndex(self, id, &IsFound);
+	ThreadLock_UnlockShared(&self->_lock);
+	return IsFound;
+}
+
+bool GHDFSegment_Find(GHDFSegment* self, unsigned long long id, GHDFSegmentRecord* record)
+{
+	bool IsFound;
+	ThreadLock_LockShared(&self->_lock);
+	size_t Index = FindRecordIndex(self, id, &IsFound);
+	if (IsFound)
+	{
+		*record = self->_records[Index];
+	}
+	ThreadLock_UnlockShared(&self->_lock);
+	return IsFound;
+}
+
+GHDFSegmentRecord GHDFSegment_GetRecord(GHDFSegment* self, size_t index)
+{
+	ThreadLock_LockShared(&self->_lock);
+	GHDFSegmentRecord Record = self->_records[index];
+	ThreadLock_UnlockShared(&self->_lock);
+	return Record;
+}
+
+Error GHDFSegment_Read(GHDFSegment* self, unsigned long long id, GHDFArena* arena, char** data, size_t* dataLength, bool* isFound)
+{
+	*data = NULL;
+	*dataLength = 0;
+
+	Error ReturnedError = LockForRead(self);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		*isFound = false;
+		return ReturnedError;
+	}
+	size_t Index = FindRecordIndex(self, id, isFound);
+	if (!*isFound)
+	{
+		ThreadLock_UnlockShared(&self->_lock);
+		return Error_CreateSuccess();
+	}
+
+	// The offset table knows the record's length, so the header and the data are read at once.
+	GHDFSegmentRecord Record = self->_records[Index];
+	size_t SlotLength = (size_t)GetSlotLength(&Record);
+	char* Slot = arena ? (char*)GHDFArena_Allocate(arena, SlotLength) : (char*)Memory_SafeMalloc(SlotLength);
+	ReturnedError = File_ReadPositional(self->_file, Record.Offset, Slot, SlotLength);
+	ThreadLock_UnlockShared(&self->_lock);
+
+	const unsigned char* Header = (const unsigned char*)Slot;
+	if ((ReturnedError.Code == ErrorCode_Success) && ((Bytes_DecodeULong(Header) != id) || (Bytes_DecodeUInt(Header + 8) != Record.Length)))
+	{
+		ReturnedError = Error_CreateError(ErrorCode_InvalidGHDFFile, "GHDFSegment_Read: Record header doesn't match the offset table.");
+	}
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		if (!arena)
+		{
+			Memory_Free(Slot);
+		}
+		return ReturnedError;
+	}
+
+	// Data outside of an arena is freed by the caller, so it has to start its allocation.
+	if (!arena)
+	{
+		memmove(Slot, Slot + RECORD_HEADER_SIZE, Record.Length);
+	}
+	*data = arena ? Slot + RECORD_HEADER_SIZE : Slot;
+	*dataLength = Record.Length;
+	return Error_CreateSuccess();
+}
+
+Error GHDFSegment_Write(GHDFSegment* self, unsigned long long id, const char* data, size_t dataLength)
+{
+	if (dataLength > UINT_MAX - RECORD_HEADER_SIZE)
+	{
+		return Error_CreateError(ErrorCode_InvalidArgument, "GHDFSegment_Write: Record is too large.");
+	}
+
+	ThreadLock_Lock(&self->_lock);
+	GHDFSegmentRecord NewRecord = { id, 0, (unsigned int)dataLength };
+	unsigned long long SlotLength = GetSlotLength(&NewRecord);
+	bool IsAppended = !ExtentListTake(&self->_freeExtents, SlotLength, &NewRecord.Offset);
+	if (IsAppended)
+	{
+		NewRecord.Offset = self->_fileLength;
+	}
+
+	unsigned char Header[RECORD_HEADER_SIZE];
+	Bytes_EncodeULong(Header, id);
+	Bytes_EncodeUInt(Header + 8, (unsigned int)dataLength);
+	Error ReturnedError = File_WriteAt(self->_file, NewRecord.Offset, (const char*)Header, RECORD_HEADER_SIZE);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = File_Write(self->_file, data, dataLength);
+	}
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		if (!IsAppended)
+		{
+			ExtentListAdd(&self->_freeExtents, NewRecord.Offset, SlotLength);
+		}
+		ThreadLock_Unlock(&self->_lock);
+		return ReturnedError;
+	}
+
+	if (IsAppended)
+	{
+		self->_fileLength += SlotLength;
+	}
+	self->_liveBytes += SlotLength;
+
+	bool IsFound;
+	size_t Index = FindRecordIndex(self, id, &IsFound);
+	if (IsFound)
+	{
+		ReleaseSlot(self, self->_records + Index);
+	}
+	else
+	{
+		EnsureRecordCapacity(self, self->RecordCount + 1);
+		memmove(self->_records + Index + 1, self->_records + Index, sizeof(GHDFSegmentRecord) * (self->RecordCount - Index));
+		self->RecordCount++;
+	}
+	self->_records[Index] = NewRecord;
+	self->_isCommitPending = true;
+	self->_isStreamDirty = true;
+
+	ThreadLock_Unlock(&self->_lock);
+	return Error_CreateSuccess();
+}
+
+Error GHDFSegment_Delete(GHDFSegment* self, unsigned long long id)
+{
+	ThreadLock_Lock(&self->_lock);
+	bool IsFound;
+	size_t Index = FindRecordIndex(self, id, &IsFound);
+	if (IsFound)
+	{
+		ReleaseSlot(self, self->_records + Index);
+		memmove(self->_records + Index, self->_records + Index + 1, sizeof(GHDFSegmentRecord) * (self->RecordCount - Index - 1));
+		self->RecordCount--;
+		self->_isCommitPending = true;
+	}
+	ThreadLock_Unlock(&self->_lock);
+	return Error_CreateSuccess();
+}
+
+Error GHDFSegment_Commit(GHDFSegment* self)
+{
+	ThreadLock_Lock(&self->_lock);
+	Error ReturnedError = Error_CreateSuccess();
+	if (ShouldCompact(self))
+	{
+		ReturnedError = Compact(self);
+	}
+	else if (self->_isCommitPending)
+	{
+		ReturnedError = Commit(self);
+	}
+	ThreadLock_Unlock(&self->_lock);
+	return ReturnedError;
+}
+
+Error GHDFSegment_Compact(GHDFSegment* self)
+{
+	ThreadLock_Lock(&self->_lock);
+	Error ReturnedError = Compact(self);
+	ThreadLock_Unlock(&self->_lock);
+	return ReturnedError;
+}
+
+Error GHDFSegment_Close(GHDFSegment* self)
+{
+	Error ReturnedError = GHDFSegment_Commit(self);
+
+	if (self->_file)
+	{
+		File_Close(self->_file);
+	}
+	ExtentListDeconstruct(&self->_freeExtents);
+	ExtentListDeconstruct(&self->_releasedExtents);
+	Memory_Free(self->_records);
+	Memory_Free((char*)self->_path);
+	Memory_Set((char*)self, sizeof(GHDFSegment), 0);
+	return ReturnedError;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "LTTErrors.h"
+#include "LTTThread.h"
+#include "GHDF.h"
+
+
+// Macros.
+#define GHDF_SEGMENT_FILE_EXTENSION ".ghdfseg"
+
+
+// Types.
+/* Location of a record's GHDF data inside the segment file. */
+typedef struct GHDFSegmentRecordStruct
+{
+	unsigned long long ID;
+	unsigned long long Offset;
+	unsigned int Length;
+} GHDFSegmentRecord;
+
+typedef struct GHDFSegmentExtentStruct
+{
+	unsigned long long Offset;
+	unsigned long long Length;
+} GHDFSegmentExtent;
+
+typedef struct GHDFSegmentExtentListStruct
+{
+	GHDFSegmentExtent* Extents;
+	size_t Count;
+	size_t _capacity;
+} GHDFSegmentExtentList;
+
+/* Packs many GHDF files into a single segment file:
+*  [header][record]...[record][offset table][tail]
+* The offset table at the end of the file lists every live record by ID. Updated records are written into free space
+* or appended, the old copy stays untouched until a new offset table is committed, so a crash at any point leaves
+* the last committed state readable. Space freed by updates and deletes is reused, compaction rewrites the file without it. */
+typedef struct GHDFSegmentStruct
+{
+	const char* _path;
+	FILE* _file;
+	bool _syncWrites;
+	/* Reads share the lock and read the file positionally, so they need written records flushed out of the stream first. */
+	ThreadLock _lock;
+	bool _isStreamDirty;
+
+	/* Sorted by ID. */
+	GHDFSegmentRecord* _records;
+	size_t RecordCount;
+	size_t _recordCapacity;
+
+	/* Sorted by offset. Released extents are still referenced by the committed offset table and only become free once the next one is committed. */
+	GHDFSegmentExtentList _freeExtents;
+	GHDFSegmentExtentList _releasedExtents;
+
+	unsigned long long _tableOffset;
+	unsigned long long _tableLength;
+	unsigned long long _fileLength;
+	unsigned long long _liveBytes;
+	bool _isCommitPending;
+} GHDFSegment;
+
+
+// Functions.
+/// <summary>
+/// Opens a segment file, creating an empty one if it doesn't exist. If the last offset table is damaged,
+/// the segment falls back to the previous intact one.
+/// </summary>
+/// <param name="syncWrites">Waits for each commit to reach the disk.</param>
+Error GHDFSegment_Open(GHDFSegment* self, const char* path, bool syncWrites);
+
+bool GHDFSegment_Contains(GHDFSegment* self, unsigned long long id);
+
+/// <summary>
+/// Looks up a record's location without reading it.
+/// </summary>
+/// <returns>false if there is no record with the ID.</returns>
+bool GHDFSegment_Find(GHDFSegment* self, unsigned long long id, GHDFSegmentRecord* record);
+
+/// <summary>
+/// Gets the record at the index, records are ordered by ID.
+/// </summary>
+GHDFSegmentRecord GHDFSegment_GetRecord(GHDFSegment* self, size_t index);
+
+/// <summary>
+/// Reads a record's GHDF data, which can be decoded with GHDFReader_Open or GHDFLazyCompound_Open.
+/// </summary>
+/// <param name="arena">Arena which the data is placed into, NULL to allocate it normally and leave freeing it to the caller.</param>
+/// <param name="isFound">Set to false if there is no record with the ID.</param>
+Error GHDFSegment_Read(GHDFSegment* self, unsigned long long id, GHDFArena* arena, char** data, size_t* dataLength, bool* isFound);
+
+/// <summary>
+/// Stores a record's GHDF data, replacing the record with the same ID. The change only survives a restart once committed.
+/// </summary>
+Error GHDFSegment_Write(GHDFSegment* self, unsigned long long id, const char* data, size_t dataLength);
+
+/// <summary>
+/// Removes a record if it exists. The change only survives a restart once committed.
+/// </summary>
+Error GHDFSegment_Delete(GHDFSegment* self, unsigned long long id);
+
+/// <summary>
+/// Writes a new offset table covering all writes and deletes so far. The segment is compacted instead
+/// once most of the file is free space.
+/// </summary>
+Error GHDFSegment_Commit(GHDFSegment* self);
+
+/// <summary>
+/// Rewrites the segment with the live records stored back to back in ID order, then replaces the file.
+/// Also commits all pending changes.
+/// </summary>
+Error GHDFSegment_Compact(GHDFSegment* self);
+
+/// <summary>
+/// Commits pending changes and closes the file.
+/// </summary>
+Error GHDFSegment_Close(GHDFSegment* self);
\ No newline at end of file
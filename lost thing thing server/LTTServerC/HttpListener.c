@@ -11,6 +11,12 @@
 #include "LttString.h"
 #include "Logger.h"
 #include "ConfigFile.h"
+#include "AccessLog.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "LTTProbes.h"
+#include "LTTTime.h"
+#include <time.h>
 
 
 // Macros.
@@ -50,6 +56,12 @@
 
 #define HTTP_PORT 80
 
+/* Requests already waiting when one is accepted are handled with it, up to this many. */
+#define MAX_QUEUED_RESPONSES 32
+
+/* A failed commit is retried at least this often while its responses are held. */
+#define COMMIT_RETRY_INTERVAL_MILLISECONDS 1000
+
 // Types.
 typedef enum SpecialActionEnum
 {
@@ -72,7 +84,8 @@ typedef enum HttpResponseCodeEnum
 	HttpResponseCode_Forbidden = 403,
 	HttpResponseCode_NotFound = 404,
 	HttpResponseCode_ImATeapot = 418,
-	HttpResponseCode_InternalServerError = 500
+	HttpResponseCode_InternalServerError = 500,
+	HttpResponseCode_ServiceUnavailable = 503
 } HttpResponseCode;
 
 typedef struct HttpResponseStruct
@@ -82,6 +95,16 @@ typedef struct HttpResponseStruct
 	StringBuilder FinalMessage;
 } HttpResponse;
 
+/* A handled request whose response waits until the changes of its batch are committed. */
+typedef struct QueuedResponseStruct
+{
+	SOCKET ClientSocket;
+	HttpResponse Response;
+	AccessRecord Access;
+	SpecialAction Action;
+	size_t RequestNumber;
+} QueuedResponse;
+
 
 // Static functions.
 static Error SetSocketError(const char* message, int wsaCode)
@@ -132,6 +155,10 @@ static void AppendResponseCode(HttpResponse* response)
 		case HttpResponseCode_InternalServerError:
 			StringBuilder_Append(&response->FinalMessage, "Internal Server Error");
 			break;
+
+		case HttpResponseCode_ServiceUnavailable:
+			StringBuilder_Append(&response->FinalMessage, "Service Unavailable");
+			break;
 	}
 }
 
@@ -434,12 +461,18 @@ static HttpResponseCode ResourceResponseToHttpResponseCode(ResourceResult result
 		case ResourceResult_ShutDownServer:
 			return HttpResponseCode_OK;
 
+		case ResourceResult_Unavailable:
+			return HttpResponseCode_ServiceUnavailable;
+
 		default:
 			return HttpResponseCode_ImATeapot;
 	}
 }
 
-static SpecialAction ExecuteValidHttpRequest(ServerContext* context, HttpClientRequest* request, HttpResponse* response)
+static SpecialAction ExecuteValidHttpRequest(ServerContext* context,
+	HttpClientRequest* request,
+	HttpResponse* response,
+	unsigned long long* accountID)
 {
 	ResourceResult Result = ResourceResult_Invalid;
 	ServerResourceRequest ResourceRequestData =
@@ -448,7 +481,8 @@ static SpecialAction ExecuteValidHttpRequest(ServerContext* context, HttpClientR
 		request->Body,
 		request->CookieArray,
 		request->CookieCount,
-		&response->Body
+		&response->Body,
+		0
 	};
 
 	if (request->Method == HttpMethod_GET)
@@ -461,6 +495,7 @@ static SpecialAction ExecuteValidHttpRequest(ServerContext* context, HttpClientR
 	}
 
 	response->Code = ResourceResponseToHttpResponseCode(Result);
+	*accountID = ResourceRequestData.AccountID;
 	return Result == ResourceResult_ShutDownServer ? SpecialAction_ShutdownServer : SpecialAction_None;
 }
 
@@ -492,59 +527,190 @@ static void HandleSpecialAction(SOCKET clientSocket, SpecialAction action, Serve
 	}
 }
 
+/* A trace which can't be written doesn't fail the request. */
+static void EndRequestTrace(ServerContext* context, const char* target)
+{
+	Error ReturnedError = Trace_EndRequest(target);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Logger_LogWarning(context->Logger, ReturnedError.Message);
+		Error_Deconstruct(&ReturnedError);
+	}
+}
+
 static Error ProcessHttpRequest(ServerContext* context,
-	SOCKET clientSocket,
 	char* unparsedRequestMessage,
+	int unparsedRequestLength,
 	HttpClientRequest* requestToBuild,
-	HttpResponse* responseToBuild,
-	ServerRuntimeData* runtimeData)
+	QueuedResponse* queued,
+	bool isCommitFailing)
 {
+	AccessRecord* Access = &queued->Access;
+	Memory_Set((char*)Access, sizeof(AccessRecord), 0);
+	Access->Time = (unsigned long long)time(NULL);
+	Access->BytesIn = (unsigned int)unparsedRequestLength;
+	unsigned long long PhaseStartTime = Time_GetMicroseconds();
+	Trace_BeginRequest();
+
 	// Parse request.
+	TraceSpan Span = Trace_BeginSpan("parse");
 	ClearHttpRequestStruct(requestToBuild);
 	Error ReturnedError = ParseHttpRequestMessage(unparsedRequestMessage, requestToBuild);
+	Trace_EndSpan(Span);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
+		EndRequestTrace(context, "");
 		return ReturnedError;
 	}
+	LTT_PROBE_REQUEST_PARSE_DONE(queued->RequestNumber, requestToBuild->Method);
+	unsigned long long PhaseEndTime = Time_GetMicroseconds();
+	Access->ParseTime = (unsigned int)(PhaseEndTime - PhaseStartTime);
+	PhaseStartTime = PhaseEndTime;
 
 	// Verify it.
-	ClearHttpResponse(responseToBuild);
-	SpecialAction RequestedAction = SpecialAction_None;
+	HttpResponse* Response = &queued->Response;
+	ClearHttpResponse(Response);
+	queued->Action = SpecialAction_None;
+
+	// Storage accessed by this thread outside of requests isn't counted.
+	AccessLog_TakeStorageTime();
+	Span = Trace_BeginSpan("dispatch");
 
 	if ((requestToBuild->HttpVersionMinor == HTTP_INVALID_VERSION) || (requestToBuild->HttpVersionMajor == HTTP_INVALID_VERSION)
 		|| (requestToBuild->Method == HttpMethod_UNKNOWN))
 	{
-		responseToBuild->Code = HttpResponseCode_BadRequest;
+		Response->Code = HttpResponseCode_BadRequest;
 	}
-	else
+	else if (isCommitFailing && (requestToBuild->Method == HttpMethod_POST))
 	{
-		RequestedAction = ExecuteValidHttpRequest(context, requestToBuild, responseToBuild);
+		// Nothing is changed until the held changes are committed.
+		Access->Route = AccessLog_FindRoute(requestToBuild->RequestTarget);
+		Response->Code = HttpResponseCode_ServiceUnavailable;
 	}
+	else
+	{
+		Access->Route = AccessLog_FindRoute(requestToBuild->RequestTarget);
+		LTT_PROBE_REQUEST_DISPATCH(queued->RequestNumber, Access->Route, requestToBuild->Method);
+		queued->Action = ExecuteValidHttpRequest(context, requestToBuild, Response, &Access->AccountID);
+	}
+	Trace_EndSpan(Span);
+	PhaseEndTime = Time_GetMicroseconds();
+	Access->DispatchTime = (unsigned int)(PhaseEndTime - PhaseStartTime);
+	Access->StorageTime = AccessLog_TakeStorageTime();
+	Access->Method = requestToBuild->Method;
+
+	// Build the response, it is sent once the batch is committed.
+	Span = Trace_BeginSpan("respond");
+	BuildHttpResponse(Response);
+	Trace_EndSpan(Span);
+	EndRequestTrace(context, requestToBuild->RequestTarget);
+	return Error_CreateSuccess();
+}
 
+static Error SendQueuedResponse(ServerContext* context, QueuedResponse* queued, ServerRuntimeData* runtimeData)
+{
 	// Respond.
-	BuildHttpResponse(responseToBuild);
-	if (send(clientSocket, responseToBuild->FinalMessage.Data, (int)responseToBuild->FinalMessage.Length, 0) == INVALID_SOCKET)
+	HttpResponse* Response = &queued->Response;
+	AccessRecord* Access = &queued->Access;
+	unsigned long long SendStartTime = Time_GetMicroseconds();
+	if (send(queued->ClientSocket, Response->FinalMessage.Data, (int)Response->FinalMessage.Length, 0) == INVALID_SOCKET)
 	{
-		closesocket(clientSocket);
-		return SetSocketError("Failed to send data to client.", WSAGetLastError());
+		Error ReturnedError = SetSocketError("Failed to send data to client.", WSAGetLastError());
+		closesocket(queued->ClientSocket);
+		return ReturnedError;
 	}
+	Access->WriteTime = (unsigned int)(Time_GetMicroseconds() - SendStartTime);
+
+	Access->Status = (unsigned int)Response->Code;
+	Access->BytesOut = (unsigned int)Response->FinalMessage.Length;
+	LTT_PROBE_RESPONSE_SENT(queued->RequestNumber, Access->Route, Access->Status, Access->BytesOut, Access->AccountID);
+	AccessLog_Add(context->AccessLog, Access);
+
+	Metrics_AddRequest(Access->Route, Access->Status);
+	Metrics_Record(MetricHistogram_ParseTime, Access->ParseTime);
+	Metrics_Record(MetricHistogram_DispatchTime, Access->DispatchTime);
+	Metrics_Record(MetricHistogram_StorageTime, Access->StorageTime);
+	Metrics_Record(MetricHistogram_CommitTime, Access->CommitTime);
+	Metrics_Record(MetricHistogram_WriteTime, Access->WriteTime);
 
 	// Handle any special actions.
-	if (RequestedAction != SpecialAction_None)
+	if (queued->Action != SpecialAction_None)
 	{
-		HandleSpecialAction(clientSocket, RequestedAction, runtimeData);
+		HandleSpecialAction(queued->ClientSocket, queued->Action, runtimeData);
 	}
 
+	// Close connection.
+	if (closesocket(queued->ClientSocket) == SOCKET_ERROR)
+	{
+		return SetSocketError("SendQueuedResponse: Failed to close the socket.", WSAGetLastError());
+	}
 	return Error_CreateSuccess();
 }
 
+/// <summary>
+/// Commits the changes of every queued request with a single sync. The changes are already applied in memory,
+/// so if the commit fails the responses are held rather than answered, until a retried commit succeeds.
+/// </summary>
+/// <param name="isRetry">Whether the previous attempt failed, only the first failure is logged.</param>
+/// <returns>Whether the responses may be sent.</returns>
+static bool CommitQueuedChanges(ServerContext* context, QueuedResponse* queue, size_t queuedCount, bool isRetry)
+{
+	unsigned long long CommitStartTime = Time_GetMicroseconds();
+	Error ReturnedError = ResourceManager_CommitChanges(context);
+	unsigned int CommitTime = (unsigned int)(Time_GetMicroseconds() - CommitStartTime);
+	for (size_t i = 0; i < queuedCount; i++)
+	{
+		queue[i].Access.CommitTime += CommitTime;
+	}
+
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		if (isRetry)
+		{
+			Logger_LogInfo(context->Logger, "Committed the held changes, accepting changes again.");
+		}
+		return true;
+	}
+	if (!isRetry)
+	{
+		Logger_LogError(context->Logger, ReturnedError.Message);
+		Logger_LogError(context->Logger, "Failed to commit changes, holding their responses and refusing changes until a retry succeeds.");
+	}
+	Error_Deconstruct(&ReturnedError);
+	return false;
+}
+
+static void SendQueuedResponses(ServerContext* context, QueuedResponse* queue, size_t queuedCount, ServerRuntimeData* runtimeData)
+{
+	for (size_t i = 0; i < queuedCount; i++)
+	{
+		Error ReturnedError = SendQueuedResponse(context, queue + i, runtimeData);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			Logger_LogError(context->Logger, ReturnedError.Message);
+			Error_Deconstruct(&ReturnedError);
+		}
+	}
+}
+
 /* Client listener. */
+/* Waits for a client to connect for at most the timeout. */
+static bool IsClientWaiting(SOCKET serverSocket, long timeoutMilliseconds)
+{
+	fd_set Sockets;
+	FD_ZERO(&Sockets);
+	FD_SET(serverSocket, &Sockets);
+	struct timeval Timeout = { timeoutMilliseconds / 1000, (timeoutMilliseconds % 1000) * 1000 };
+	return select(0, &Sockets, NULL, NULL, &Timeout) > 0;
+}
+
 static Error AcceptSingleClient(ServerContext* context, 
 	SOCKET serverSocket,
 	char* unparsedRequestMessage,
 	HttpClientRequest* requestToBuild, 
-	HttpResponse* responseToBuild,
-	ServerRuntimeData* runtimeData)
+	QueuedResponse* queued,
+	ServerRuntimeData* runtimeData,
+	bool isCommitFailing)
 {
 	// Accept client.
 	SOCKET ClientSocket;
@@ -555,10 +721,14 @@ static Error AcceptSingleClient(ServerContext* context,
 		return SetSocketError("AcceptSingleClient: Failed to accept client.", WSAGetLastError());
 	}
 	runtimeData->RequestCount += 1;
+	queued->ClientSocket = ClientSocket;
+	queued->RequestNumber = runtimeData->RequestCount;
 	DWORD SocketOptionValue = 1;
 	if (setsockopt(ClientSocket, SOL_SOCKET, SO_RCVTIMEO, &SocketOptionValue, sizeof(DWORD)))
 	{
-		return SetSocketError("AcceptSingleClient: Failed to set socket timeout option.", WSAGetLastError());
+		ReturnedError = SetSocketError("AcceptSingleClient: Failed to set socket timeout option.", WSAGetLastError());
+		closesocket(ClientSocket);
+		return ReturnedError;
 	}
 
 	int TotalReceivedLength = 0;
@@ -580,20 +750,15 @@ static Error AcceptSingleClient(ServerContext* context,
 		return ReturnedError;
 	}
 	unparsedRequestMessage[TotalReceivedLength] = '\0';
+	LTT_PROBE_REQUEST_ACCEPT(queued->RequestNumber, TotalReceivedLength);
 
 	// Process.
-	ReturnedError = ProcessHttpRequest(context, ClientSocket, unparsedRequestMessage, requestToBuild, responseToBuild, runtimeData);
+	ReturnedError = ProcessHttpRequest(context, unparsedRequestMessage, TotalReceivedLength, requestToBuild, queued, isCommitFailing);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
+		closesocket(ClientSocket);
 		return ReturnedError;
 	}
-
-	// Close connection.
-	if (closesocket(ClientSocket) == SOCKET_ERROR)
-	{
-		return SetSocketError("AcceptSingleClient: Failed to close the socket.", WSAGetLastError());
-	}
-
 	return Error_CreateSuccess();
 }
 
@@ -607,27 +772,79 @@ static void AcceptClients(ServerContext* context, SOCKET serverSocket)
 	Request.Body = (char*)Memory_SafeMalloc(REQUEST_MESSAGE_BUFFER_LENGTH);
 	Request.CookieArray = (HttpCookie*)Memory_SafeMalloc(sizeof(HttpCookie) * MAX_COOKIE_COUNT);
 
-	HttpResponse Response;
-	StringBuilder_Construct(&Response.Body, DEFAULT_STRING_BUILDER_CAPACITY);
-	StringBuilder_Construct(&Response.FinalMessage, DEFAULT_STRING_BUILDER_CAPACITY);
+	QueuedResponse* Queue = (QueuedResponse*)Memory_SafeMalloc(sizeof(QueuedResponse) * MAX_QUEUED_RESPONSES);
+	for (size_t i = 0; i < MAX_QUEUED_RESPONSES; i++)
+	{
+		StringBuilder_Construct(&Queue[i].Response.Body, DEFAULT_STRING_BUILDER_CAPACITY);
+		StringBuilder_Construct(&Queue[i].Response.FinalMessage, DEFAULT_STRING_BUILDER_CAPACITY);
+	}
 
 	ServerRuntimeData RuntimeData = { false, 0 };
 
 	// Main listening loop.
 	Logger_LogInfo(context->Logger, "Started accepting clients.");
+	// Responses of a batch whose commit failed, kept at the front of the queue.
+	size_t HeldCount = 0;
 	while (!RuntimeData.IsStopRequested)
 	{
-		Error ReturnedError = AcceptSingleClient(context, serverSocket, UnparsedRequestBuffer, &Request, &Response, &RuntimeData);
-		if (ReturnedError.Code != ErrorCode_Success)
+		// While responses are held the commit is retried even if no client arrives.
+		bool IsAccepting = (HeldCount == 0) || IsClientWaiting(serverSocket, COMMIT_RETRY_INTERVAL_MILLISECONDS);
+		if ((HeldCount == MAX_QUEUED_RESPONSES) && IsAccepting)
 		{
-			Logger_LogError(context->Logger, ReturnedError.Message);
-			Error_Deconstruct(&ReturnedError);
+			Sleep(COMMIT_RETRY_INTERVAL_MILLISECONDS);
+			IsAccepting = false;
+		}
+
+		// Requests which arrived while the previous batch was handled are handled together, their changes then share a single sync.
+		size_t QueuedCount = HeldCount;
+		while (IsAccepting)
+		{
+			Error ReturnedError = AcceptSingleClient(context, serverSocket, UnparsedRequestBuffer, &Request, Queue + QueuedCount,
+				&RuntimeData, HeldCount > 0);
+			if (ReturnedError.Code == ErrorCode_Success)
+			{
+				QueuedCount++;
+			}
+			else
+			{
+				Logger_LogError(context->Logger, ReturnedError.Message);
+				Error_Deconstruct(&ReturnedError);
+			}
+			IsAccepting = (QueuedCount < MAX_QUEUED_RESPONSES) && ((QueuedCount == HeldCount) || (Queue[QueuedCount - 1].Action == SpecialAction_None))
+				&& IsClientWaiting(serverSocket, 0);
+		}
+
+		// Requests handled while responses are held changed nothing, so they don't wait for the commit.
+		if (HeldCount > 0)
+		{
+			SendQueuedResponses(context, Queue + HeldCount, QueuedCount - HeldCount, &RuntimeData);
+			QueuedCount = HeldCount;
+		}
+		if (CommitQueuedChanges(context, Queue, QueuedCount, HeldCount > 0))
+		{
+			SendQueuedResponses(context, Queue, QueuedCount, &RuntimeData);
+			HeldCount = 0;
+		}
+		else
+		{
+			HeldCount = QueuedCount;
 		}
 	}
 	Logger_LogInfo(context->Logger, "Stopped accepting clients.");
 
+	// Held responses are left unanswered, closing the managers tries to commit their changes once more.
+	for (size_t i = 0; i < HeldCount; i++)
+	{
+		closesocket(Queue[i].ClientSocket);
+	}
+
 	// Cleanup.
-	StringBuilder_Deconstruct(&Response.Body);
+	for (size_t i = 0; i < MAX_QUEUED_RESPONSES; i++)
+	{
+		StringBuilder_Deconstruct(&Queue[i].Response.Body);
+		StringBuilder_Deconstruct(&Queue[i].Response.FinalMessage);
+	}
+	Memory_Free(Queue);
 	Memory_Free(Request.CookieArray);
 }
 
@@ -3,6 +3,7 @@
 #include "Memory.h"
 #include "LTTChar.h"
 #include "LTTMath.h"
+#include "Epoch.h"
 #include <stdbool.h>
 
 
@@ -31,17 +32,26 @@ typedef struct CodepointIDListStruct
 	size_t _capacity;
 } CodepointIDList;
 
+/* Published lists and buckets are only ever appended to past their count, which readers don't look at until the count is raised.
+ * Any other change is made to a copy which replaces the original, the original is then retired. */
+typedef struct IDListVersionStruct
+{
+	volatile long long IDCount;
+	size_t _capacity;
+	unsigned long long IDs[];
+} IDListVersion;
+
 typedef struct CodepointAmountsEntryStruct
 {
 	int Codepoint;
-	CodepointIDList* IDLists;
+	IDListVersion* volatile IDLists[MAX_TRACKED_CODEPOINT_COUNT];
 } CodepointAmountsEntry;
 
 typedef struct CodepointAmountsBucketStruct
 {
-	CodepointAmountsEntry* Entries;
-	size_t Count;
+	volatile long long Count;
 	size_t _capacity;
+	CodepointAmountsEntry* Entries[];
 } CodepointAmountsBucket;
 
 /* String codepoint count. */
@@ -187,17 +197,7 @@ static void IDHashsetRemoveID(IDHashSet* self, unsigned long long id)
 
 static bool IDHashSetContains(IDHashSet* self, unsigned long long id)
 {
-	for (int ListIndex = 0; ListIndex < ID_HASHSET_CAPACITY; ListIndex++)
-	{
-		CodepointIDList* List = &self->Lists[ListIndex];
-
-		if ((List->IDCount > 0) && (CodepointIDListContains(List, id)))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	return CodepointIDListContains(&self->Lists[id % ID_HASHSET_CAPACITY], id);
 }
 
 static unsigned long long* IDHashSetToArray(IDHashSet* self, size_t* arraySize)
@@ -253,99 +253,242 @@ static void IDHashsetDeconstruct(IDHashSet* self)
 }
 
 
-/* Codepoint amounts. */
-static void ConstructCodepointAmountsEntry(CodepointAmountsEntry* amounts, int codepoint)
+/* ID list versions. */
+static IDListVersion* CreateIDListVersion(size_t capacity)
 {
-	amounts->Codepoint = codepoint;
-	amounts->IDLists = (CodepointIDList*)Memory_SafeMalloc(sizeof(CodepointIDList) * MAX_TRACKED_CODEPOINT_COUNT);
+	IDListVersion* List = (IDListVersion*)Memory_SafeMalloc(sizeof(IDListVersion) + (sizeof(unsigned long long) * capacity));
+	List->IDCount = 0;
+	List->_capacity = capacity;
+	return List;
+}
 
-	for (int i = 0; i < MAX_TRACKED_CODEPOINT_COUNT; i++)
+static void PublishIDList(IDListVersion* volatile* slot, IDListVersion* list)
+{
+	IDListVersion* OldList = *slot;
+	Atomic_StorePointer((void* volatile*)slot, list);
+	Epoch_Retire(OldList, Memory_Free);
+}
+
+static void IDListAddID(IDListVersion* volatile* slot, unsigned long long id)
+{
+	IDListVersion* List = *slot;
+	size_t Count = List ? (size_t)List->IDCount : 0;
+
+	if (List && (Count < List->_capacity))
+	{
+		List->IDs[Count] = id;
+		Atomic_Store(&List->IDCount, (long long)(Count + 1));
+		return;
+	}
+
+	IDListVersion* NewList = CreateIDListVersion(List ? (List->_capacity * ID_LIST_GROWTH) : ID_LIST_CAPACITY);
+	if (List)
+	{
+		Memory_Copy((const char*)List->IDs, (char*)NewList->IDs, sizeof(unsigned long long) * Count);
+	}
+	NewList->IDs[Count] = id;
+	NewList->IDCount = (long long)(Count + 1);
+	PublishIDList(slot, NewList);
+}
+
+static void IDListAddRange(IDListVersion* volatile* slot, const unsigned long long* ids, size_t idCount)
+{
+	IDListVersion* List = *slot;
+	size_t Count = List ? (size_t)List->IDCount : 0;
+
+	if (List && (Count + idCount <= List->_capacity))
+	{
+		Memory_Copy((const char*)ids, (char*)(List->IDs + Count), sizeof(unsigned long long) * idCount);
+		Atomic_Store(&List->IDCount, (long long)(Count + idCount));
+		return;
+	}
+
+	size_t Capacity = List ? List->_capacity : ID_LIST_CAPACITY;
+	while (Capacity < Count + idCount)
+	{
+		Capacity *= ID_LIST_GROWTH;
+	}
+	IDListVersion* NewList = CreateIDListVersion(Capacity);
+	if (List)
 	{
-		CodepointIDListConstruct(&amounts->IDLists[i]);
+		Memory_Copy((const char*)List->IDs, (char*)NewList->IDs, sizeof(unsigned long long) * Count);
 	}
+	Memory_Copy((const char*)ids, (char*)(NewList->IDs + Count), sizeof(unsigned long long) * idCount);
+	NewList->IDCount = (long long)(Count + idCount);
+	PublishIDList(slot, NewList);
 }
 
-static void ClearCodepointEntry(CodepointAmountsEntry* entry)
+static void IDListRemoveID(IDListVersion* volatile* slot, unsigned long long id)
 {
+	IDListVersion* List = *slot;
+	if (!List)
+	{
+		return;
+	}
+
+	size_t Count = (size_t)List->IDCount;
+	size_t Index = 0;
+	while ((Index < Count) && (List->IDs[Index] != id))
+	{
+		Index++;
+	}
+	if (Index == Count)
+	{
+		return;
+	}
+
+	IDListVersion* NewList = NULL;
+	if (Count > 1)
+	{
+		NewList = CreateIDListVersion(List->_capacity);
+		Memory_Copy((const char*)List->IDs, (char*)NewList->IDs, sizeof(unsigned long long) * Index);
+		Memory_Copy((const char*)(List->IDs + Index + 1), (char*)(NewList->IDs + Index), sizeof(unsigned long long) * (Count - Index - 1));
+		NewList->IDCount = (long long)(Count - 1);
+	}
+	PublishIDList(slot, NewList);
+}
+
+
+/* Codepoint amounts. */
+static CodepointAmountsEntry* CreateCodepointAmountsEntry(int codepoint)
+{
+	CodepointAmountsEntry* Entry = (CodepointAmountsEntry*)Memory_SafeMalloc(sizeof(CodepointAmountsEntry));
+	Entry->Codepoint = codepoint;
+
 	for (int i = 0; i < MAX_TRACKED_CODEPOINT_COUNT; i++)
 	{
-		entry->IDLists[i].IDCount = 0;
+		Entry->IDLists[i] = NULL;
 	}
+	return Entry;
 }
 
 static void DeconstructCodepointEntry(CodepointAmountsEntry* entry)
 {
 	for (int i = 0; i < MAX_TRACKED_CODEPOINT_COUNT; i++)
 	{
-		CodepointIDListDeconstruct(&entry->IDLists[i]);
+		Memory_Free(entry->IDLists[i]);
 	}
 
-	Memory_Free(entry->IDLists);
+	Memory_Free(entry);
+}
+
+static size_t GetIDListIndex(size_t codepointCount)
+{
+	return Math_Clamp(codepointCount, 1, MAX_TRACKED_CODEPOINT_COUNT) - 1;
 }
 
 /* Bucket. */
-static void EnsureBucketCapacity(CodepointAmountsBucket* bucket, size_t capacity)
+static CodepointAmountsBucket* CreateBucket(size_t capacity)
 {
-	if (bucket->_capacity == 0)
+	CodepointAmountsBucket* Bucket = (CodepointAmountsBucket*)Memory_SafeMalloc(sizeof(CodepointAmountsBucket)
+		+ (sizeof(CodepointAmountsEntry*) * capacity));
+	Bucket->Count = 0;
+	Bucket->_capacity = capacity;
+	return Bucket;
+}
+
+static void DeconstructBucket(void* bucket)
+{
+	CodepointAmountsBucket* Bucket = (CodepointAmountsBucket*)bucket;
+	if (!Bucket)
 	{
-		bucket->_capacity = BUCKET_CAPACITY;
-		bucket->Entries = (CodepointAmountsEntry*)Memory_SafeMalloc(sizeof(CodepointAmountsEntry) * bucket->_capacity);
+		return;
 	}
 
-	if (bucket->_capacity >= capacity)
+	for (size_t i = 0; i < (size_t)Bucket->Count; i++)
 	{
-		return;
+		DeconstructCodepointEntry(Bucket->Entries[i]);
 	}
 
-	while (bucket->_capacity < capacity)
+	Memory_Free(Bucket);
+}
+
+static void DeconstructBucketArray(void* buckets)
+{
+	CodepointAmountsBucket* volatile* Buckets = (CodepointAmountsBucket* volatile*)buckets;
+	for (int i = 0; i < HASHMAP_CAPACITY; i++)
 	{
-		bucket->_capacity *= BUCKET_GROWTH;
+		DeconstructBucket(Buckets[i]);
 	}
-	bucket->Entries = (CodepointAmountsEntry*)Memory_SafeRealloc(bucket->Entries, sizeof(CodepointAmountsEntry) * bucket->_capacity);
+
+	Memory_Free((void*)Buckets);
 }
 
-static CodepointAmountsEntry* GetCodepointAmountsEntry(CodepointAmountsBucket* bucket, int codepoint)
+static CodepointAmountsEntry* FindCodepointAmountsEntry(CodepointAmountsBucket* bucket, int codepoint)
 {
-	for (size_t i = 0; i < bucket->Count; i++)
+	if (!bucket)
+	{
+		return NULL;
+	}
+
+	size_t Count = (size_t)Atomic_Load(&bucket->Count);
+	for (size_t i = 0; i < Count; i++)
 	{
-		if (bucket->Entries[i].Codepoint == codepoint)
+		if (bucket->Entries[i]->Codepoint == codepoint)
 		{
-			return &(bucket->Entries[i]);
+			return bucket->Entries[i];
 		}
 	}
+	return NULL;
+}
 
-	EnsureBucketCapacity(bucket, bucket->Count + 1);
-	ConstructCodepointAmountsEntry(&(bucket->Entries[bucket->Count]), codepoint);
-	bucket->Count += 1;
 
-	return &(bucket->Entries[bucket->Count - 1]);
+/* Hashmap. */
+static CodepointAmountsBucket* volatile* GetBucketSlot(IDCodepointHashMap* self, int codepoint)
+{
+	return &(self->CodepointBuckets[codepoint % HASHMAP_CAPACITY]);
 }
 
-static void ClearBucket(CodepointAmountsBucket* bucket)
+static CodepointAmountsEntry* GetOrAddCodepointAmountsEntry(IDCodepointHashMap* self, int codepoint)
 {
-	for (size_t i = 0; i < bucket->Count; i++)
+	CodepointAmountsBucket* volatile* Slot = GetBucketSlot(self, codepoint);
+	CodepointAmountsBucket* Bucket = *Slot;
+	CodepointAmountsEntry* Entry = FindCodepointAmountsEntry(Bucket, codepoint);
+	if (Entry)
 	{
-		ClearCodepointEntry(&(bucket->Entries[i]));
+		return Entry;
 	}
-}
 
-static void DeconstructBucket(CodepointAmountsBucket* bucket)
-{
-	for (size_t i = 0; i < bucket->Count; i++)
+	Entry = CreateCodepointAmountsEntry(codepoint);
+	size_t Count = Bucket ? (size_t)Bucket->Count : 0;
+	if (Bucket && (Count < Bucket->_capacity))
 	{
-		DeconstructCodepointEntry(&bucket->Entries[i]);
+		Bucket->Entries[Count] = Entry;
+		Atomic_Store(&Bucket->Count, (long long)(Count + 1));
+		return Entry;
 	}
 
-	Memory_Free(bucket->Entries);
-}
+	CodepointAmountsBucket* NewBucket = CreateBucket(Bucket ? (Bucket->_capacity * BUCKET_GROWTH) : BUCKET_CAPACITY);
+	for (size_t i = 0; i < Count; i++)
+	{
+		NewBucket->Entries[i] = Bucket->Entries[i];
+	}
+	NewBucket->Entries[Count] = Entry;
+	NewBucket->Count = (long long)(Count + 1);
+	Atomic_StorePointer((void* volatile*)Slot, NewBucket);
 
+	// The entries moved into the new bucket, only the old entry array goes away.
+	Epoch_Retire(Bucket, Memory_Free);
+	return Entry;
+}
 
-/* Hashmap. */
-static CodepointIDList* GetCodepointIDListFromHashMap(IDCodepointHashMap* self, int codepoint, size_t count)
+static void AddIDsWithCodepointCount(CodepointAmountsBucket* volatile* buckets, int codepoint, size_t minCount, IDHashSet* hashSet)
 {
-	CodepointAmountsBucket* Bucket = &(self->CodepointBuckets[codepoint % HASHMAP_CAPACITY]);
-	CodepointAmountsEntry* Entry = GetCodepointAmountsEntry(Bucket, codepoint);
-	return &(Entry->IDLists[Math_Clamp(count - 1, 0, MAX_TRACKED_CODEPOINT_COUNT)]);
+	CodepointAmountsBucket* Bucket = (CodepointAmountsBucket*)Atomic_LoadPointer((void* volatile*)&buckets[codepoint % HASHMAP_CAPACITY]);
+	CodepointAmountsEntry* Entry = FindCodepointAmountsEntry(Bucket, codepoint);
+	if (!Entry)
+	{
+		return;
+	}
+
+	for (size_t i = GetIDListIndex(minCount); i < MAX_TRACKED_CODEPOINT_COUNT; i++)
+	{
+		IDListVersion* List = (IDListVersion*)Atomic_LoadPointer((void* volatile*)&Entry->IDLists[i]);
+		if (List)
+		{
+			IDHashSetAddRange(hashSet, List->IDs, (size_t)Atomic_Load(&List->IDCount));
+		}
+	}
 }
 
 
@@ -382,7 +525,7 @@ static void IncrementCountForCodepoint(int codepoint, StringCodepointCountList*
 	list->ElementCount += 1;
 }
 
-static void CountCodepoints(const char* string, StringCodepointCountList* list, bool ignoreWhitespace)
+static void CountCodepoints(const char* string, StringCodepointCountList* list, bool ignoreWhitespace, bool foldDiacritics)
 {
 	list->ElementCount = 0;
 	list->_capacity = CODEPOINT_COUNT_LIST_DEFAULT_CAPACTY;
@@ -391,20 +534,15 @@ static void CountCodepoints(const char* string, StringCodepointCountList* list,
 	size_t Index = 0;
 	while (string[Index] != '\0')
 	{
-		char Character[MAX_UTF8_CODEPOINT_SIZE];
-		Char_CopyTo(string + Index, Character);
-		Char_ToLower(Character);
-
-		int Codepoint = Char_GetCodepoint(Character);
-
-		if (ignoreWhitespace && Char_IsWhitespace(Character))
+		int ByteCount = Char_GetByteCount(string + Index);
+		if (ignoreWhitespace && Char_IsWhitespace(string + Index))
 		{
-			Index += Char_GetByteCountCodepoint(Codepoint);
+			Index += ByteCount;
 			continue;
 		}
 
-		IncrementCountForCodepoint(Codepoint, list);
-		Index += Char_GetByteCountCodepoint(Codepoint);
+		IncrementCountForCodepoint(Char_ToSearchCodepoint(Char_GetCodepoint(string + Index), foldDiacritics), list);
+		Index += ByteCount;
 	}
 }
 
@@ -412,27 +550,31 @@ static void CountCodepoints(const char* string, StringCodepointCountList* list,
 // Functions.
 void IDCodepointHashMap_Construct(IDCodepointHashMap* self)
 {
-	self->CodepointBuckets = (CodepointAmountsBucket*)Memory_SafeMalloc(sizeof(CodepointAmountsBucket) * HASHMAP_CAPACITY);
+	self->CodepointBuckets = (CodepointAmountsBucket* volatile*)Memory_SafeMalloc(sizeof(CodepointAmountsBucket*) * HASHMAP_CAPACITY);
 
 	for (int i = 0; i < HASHMAP_CAPACITY; i++)
 	{
-		self->CodepointBuckets[i].Entries = NULL;
-		self->CodepointBuckets[i].Count = 0;
-		self->CodepointBuckets[i]._capacity = 0;
+		self->CodepointBuckets[i] = NULL;
 	}
+
+	ThreadLock_Construct(&self->WriteLock);
+	self->FoldDiacritics = false;
+	self->Generation = 0;
 }
 
 void IDCodepointHashMap_AddID(IDCodepointHashMap* self, const char* string, unsigned long long id)
 {
 	StringCodepointCountList CodepointCountList;
-	CountCodepoints(string, &CodepointCountList, true);
+	CountCodepoints(string, &CodepointCountList, true, self->FoldDiacritics);
 
+	ThreadLock_Lock(&self->WriteLock);
 	for (size_t i = 0; i < CodepointCountList.ElementCount; i++)
 	{
-		int Codepoint = CodepointCountList.Elements[i].Codepoint;
-		size_t Count = CodepointCountList.Elements[i].Count;
-		CodepointIDListAddID(GetCodepointIDListFromHashMap(self, Codepoint, Count), id);
+		CodepointAmountsEntry* Entry = GetOrAddCodepointAmountsEntry(self, CodepointCountList.Elements[i].Codepoint);
+		IDListAddID(&Entry->IDLists[GetIDListIndex(CodepointCountList.Elements[i].Count)], id);
 	}
+	Atomic_Increment(&self->Generation);
+	ThreadLock_Unlock(&self->WriteLock);
 
 	Memory_Free(CodepointCountList.Elements);
 }
@@ -440,35 +582,164 @@ void IDCodepointHashMap_AddID(IDCodepointHashMap* self, const char* string, unsi
 void IDCodepointHashMap_RemoveID(IDCodepointHashMap* self, const char* string, unsigned long long id)
 {
 	StringCodepointCountList CodepointCountList;
-	CountCodepoints(string, &CodepointCountList, true);
+	CountCodepoints(string, &CodepointCountList, true, self->FoldDiacritics);
 
+	ThreadLock_Lock(&self->WriteLock);
 	for (size_t i = 0; i < CodepointCountList.ElementCount; i++)
 	{
 		int Codepoint = CodepointCountList.Elements[i].Codepoint;
-		size_t Count = CodepointCountList.Elements[i].Count;
-		CodepointIDListRemoveID(GetCodepointIDListFromHashMap(self, Codepoint, Count), id);
+		CodepointAmountsEntry* Entry = FindCodepointAmountsEntry(*GetBucketSlot(self, Codepoint), Codepoint);
+		if (Entry)
+		{
+			IDListRemoveID(&Entry->IDLists[GetIDListIndex(CodepointCountList.Elements[i].Count)], id);
+		}
 	}
+	Atomic_Increment(&self->Generation);
+	ThreadLock_Unlock(&self->WriteLock);
 
 	Memory_Free(CodepointCountList.Elements);
 }
 
 void IDCodepointHashMap_Clear(IDCodepointHashMap* self)
 {
+	ThreadLock_Lock(&self->WriteLock);
 	for (int i = 0; i < HASHMAP_CAPACITY; i++)
 	{
-		ClearBucket(&(self->CodepointBuckets[i]));
+		CodepointAmountsBucket* OldBucket = self->CodepointBuckets[i];
+		Atomic_StorePointer((void* volatile*)&self->CodepointBuckets[i], NULL);
+		Epoch_Retire(OldBucket, DeconstructBucket);
+	}
+	Atomic_Increment(&self->Generation);
+	ThreadLock_Unlock(&self->WriteLock);
+}
+
+void IDCodepointHashMap_Merge(IDCodepointHashMap* self, IDCodepointHashMap* other)
+{
+	ThreadLock_Lock(&self->WriteLock);
+	for (int BucketIndex = 0; BucketIndex < HASHMAP_CAPACITY; BucketIndex++)
+	{
+		CodepointAmountsBucket* OtherBucket = other->CodepointBuckets[BucketIndex];
+		size_t EntryCount = OtherBucket ? (size_t)OtherBucket->Count : 0;
+
+		for (size_t EntryIndex = 0; EntryIndex < EntryCount; EntryIndex++)
+		{
+			CodepointAmountsEntry* OtherEntry = OtherBucket->Entries[EntryIndex];
+			CodepointAmountsEntry* Entry = GetOrAddCodepointAmountsEntry(self, OtherEntry->Codepoint);
+			for (int i = 0; i < MAX_TRACKED_CODEPOINT_COUNT; i++)
+			{
+				IDListVersion* OtherList = OtherEntry->IDLists[i];
+				if (OtherList && (OtherList->IDCount > 0))
+				{
+					IDListAddRange(&Entry->IDLists[i], OtherList->IDs, (size_t)OtherList->IDCount);
+				}
+			}
+		}
 	}
+	Atomic_Increment(&self->Generation);
+	ThreadLock_Unlock(&self->WriteLock);
+}
+
+void IDCodepointHashMap_Replace(IDCodepointHashMap* self, IDCodepointHashMap* replacement)
+{
+	ThreadLock_Lock(&self->WriteLock);
+	ThreadLock_Lock(&replacement->WriteLock);
+	CodepointAmountsBucket* volatile* OldBuckets = self->CodepointBuckets;
+	Atomic_StorePointer((void* volatile*)&self->CodepointBuckets, (void*)replacement->CodepointBuckets);
+	replacement->CodepointBuckets = NULL;
+	Atomic_Increment(&self->Generation);
+	ThreadLock_Unlock(&replacement->WriteLock);
+	ThreadLock_Unlock(&self->WriteLock);
+
+	// Searches which loaded the old bucket array keep reading it until they leave the epoch.
+	Epoch_Retire((void*)OldBuckets, DeconstructBucketArray);
+}
+
+unsigned long long IDCodepointHashMap_GetGeneration(IDCodepointHashMap* self)
+{
+	return (unsigned long long)Atomic_Load(&self->Generation);
+}
+
+void IDCodepointHashMap_WriteSnapshot(IDCodepointHashMap* self, IndexSnapshotWriter* writer)
+{
+	ThreadLock_Lock(&self->WriteLock);
+	IndexSnapshotWriter_WriteUInt(writer, self->FoldDiacritics);
+
+	for (int BucketIndex = 0; BucketIndex < HASHMAP_CAPACITY; BucketIndex++)
+	{
+		CodepointAmountsBucket* Bucket = self->CodepointBuckets[BucketIndex];
+		size_t EntryCount = Bucket ? (size_t)Bucket->Count : 0;
+		IndexSnapshotWriter_WriteULong(writer, EntryCount);
+
+		for (size_t EntryIndex = 0; EntryIndex < EntryCount; EntryIndex++)
+		{
+			CodepointAmountsEntry* Entry = Bucket->Entries[EntryIndex];
+			IndexSnapshotWriter_WriteUInt(writer, (unsigned int)Entry->Codepoint);
+			for (int i = 0; i < MAX_TRACKED_CODEPOINT_COUNT; i++)
+			{
+				IDListVersion* List = Entry->IDLists[i];
+				size_t IDCount = List ? (size_t)List->IDCount : 0;
+				IndexSnapshotWriter_WriteULong(writer, IDCount);
+				IndexSnapshotWriter_WriteULongs(writer, List ? List->IDs : NULL, IDCount);
+			}
+		}
+	}
+	ThreadLock_Unlock(&self->WriteLock);
+}
+
+bool IDCodepointHashMap_ReadSnapshot(IDCodepointHashMap* self, IndexSnapshotReader* reader)
+{
+	if (IndexSnapshotReader_ReadUInt(reader) != (unsigned int)self->FoldDiacritics)
+	{
+		return false;
+	}
+
+	// Entries are built at their final size and stored directly, nothing is published yet so there's nothing to retire.
+	for (int BucketIndex = 0; (BucketIndex < HASHMAP_CAPACITY) && reader->IsValid; BucketIndex++)
+	{
+		size_t EntryCount = IndexSnapshotReader_ReadCount(reader, sizeof(int) + (sizeof(unsigned long long) * MAX_TRACKED_CODEPOINT_COUNT));
+		if (EntryCount == 0)
+		{
+			continue;
+		}
+
+		CodepointAmountsBucket* Bucket = CreateBucket(Math_Max(EntryCount, BUCKET_CAPACITY));
+		self->CodepointBuckets[BucketIndex] = Bucket;
+		for (size_t EntryIndex = 0; (EntryIndex < EntryCount) && reader->IsValid; EntryIndex++)
+		{
+			CodepointAmountsEntry* Entry = CreateCodepointAmountsEntry((int)IndexSnapshotReader_ReadUInt(reader));
+			Bucket->Entries[EntryIndex] = Entry;
+			Bucket->Count = (long long)(EntryIndex + 1);
+
+			for (int i = 0; i < MAX_TRACKED_CODEPOINT_COUNT; i++)
+			{
+				size_t IDCount = IndexSnapshotReader_ReadCount(reader, sizeof(unsigned long long));
+				if (IDCount == 0)
+				{
+					continue;
+				}
+
+				IDListVersion* List = CreateIDListVersion(Math_Max(IDCount, ID_LIST_CAPACITY));
+				IndexSnapshotReader_ReadULongs(reader, List->IDs, IDCount);
+				List->IDCount = (long long)IDCount;
+				Entry->IDLists[i] = List;
+			}
+		}
+	}
+
+	Atomic_Increment(&self->Generation);
+	return reader->IsValid;
 }
 
 unsigned long long* IDCodepointHashMap_FindByString(IDCodepointHashMap* self, const char* string, bool ignoreWhitespace, size_t* arraySize)
 {
 	// Unoptimized garbage-ass algorithm.
 	StringCodepointCountList CodepointCountList;
-	CountCodepoints(string, &CodepointCountList, ignoreWhitespace);
+	CountCodepoints(string, &CodepointCountList, ignoreWhitespace, self->FoldDiacritics);
 
 	if (CodepointCountList.ElementCount == 0)
 	{
 		Memory_Free(CodepointCountList.Elements);
+		*arraySize = 0;
 		return NULL;
 	}
 
@@ -477,30 +748,20 @@ unsigned long long* IDCodepointHashMap_FindByString(IDCodepointHashMap* self, co
 	IDHashsetConstruct(&FinalIDHashSet);
 	IDHashsetConstruct(&CodepointIDHashSet);
 
-	for (size_t i = CodepointCountList.Elements[0].Count; i < MAX_TRACKED_CODEPOINT_COUNT; i++)
-	{
-		CodepointIDList* IDList = GetCodepointIDListFromHashMap(self,
-			CodepointCountList.Elements[0].Codepoint, i);
-		IDHashSetAddRange(&FinalIDHashSet, IDList->IDs, IDList->IDCount);
-	}
+	// The bucket array is loaded once, a search running while the map is replaced sees only the old or only the new contents.
+	Epoch_Enter();
+	CodepointAmountsBucket* volatile* Buckets = (CodepointAmountsBucket* volatile*)Atomic_LoadPointer((void* volatile*)&self->CodepointBuckets);
+	AddIDsWithCodepointCount(Buckets, CodepointCountList.Elements[0].Codepoint, CodepointCountList.Elements[0].Count, &FinalIDHashSet);
 
-	for (size_t CodepointIndex = 1; CodepointIndex < CodepointCountList.ElementCount; CodepointIndex++)
+	for (size_t CodepointIndex = 1; (CodepointIndex < CodepointCountList.ElementCount) && (FinalIDHashSet.Count > 0); CodepointIndex++)
 	{
-		for (size_t CountIndex = CodepointCountList.Elements[CodepointIndex].Count;
-			CountIndex < MAX_TRACKED_CODEPOINT_COUNT; CountIndex++)
-		{
-			CodepointIDList* IDList = GetCodepointIDListFromHashMap(self, CodepointCountList.Elements[CodepointIndex].Codepoint, CountIndex);
-			IDHashSetAddRange(&CodepointIDHashSet, IDList->IDs, IDList->IDCount);
-		}
+		AddIDsWithCodepointCount(Buckets, CodepointCountList.Elements[CodepointIndex].Codepoint,
+			CodepointCountList.Elements[CodepointIndex].Count, &CodepointIDHashSet);
 
 		IDHashSetIntersectWithHashset(&FinalIDHashSet, &CodepointIDHashSet);
 		IDHashSetClear(&CodepointIDHashSet);
-
-		if (FinalIDHashSet.Count == 0)
-		{
-			break;
-		}
 	}
+	Epoch_Exit();
 
 	unsigned long long* IDArray = IDHashSetToArray(&FinalIDHashSet, arraySize);
 	IDHashsetDeconstruct(&FinalIDHashSet);
@@ -511,10 +772,9 @@ unsigned long long* IDCodepointHashMap_FindByString(IDCodepointHashMap* self, co
 
 void IDCodepointHashMap_Deconstruct(IDCodepointHashMap* self)
 {
-	for (int i = 0; i < HASHMAP_CAPACITY; i++)
+	if (self->CodepointBuckets)
 	{
-		DeconstructBucket(&self->CodepointBuckets[i]);
+		DeconstructBucketArray((void*)self->CodepointBuckets);
 	}
-
-	Memory_Free(self->CodepointBuckets);
+	self->CodepointBuckets = NULL;
 }
\ No newline at end of file
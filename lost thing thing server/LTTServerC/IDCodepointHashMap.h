@@ -1,12 +1,19 @@
 #pragma once
 #include <stddef.h>
 #include <stdbool.h>
+#include "LTTThread.h"
+#include "IndexSnapshot.h"
 
 
 // Structures.
+/* Readers never lock, writers are serialized by WriteLock and publish new bucket and ID list versions.
+* Replacing the whole map publishes a new bucket array. */
 typedef struct IDCodepointHashMapStruct
 {
-	struct CodepointAmountsBucketStruct* CodepointBuckets;
+	struct CodepointAmountsBucketStruct* volatile* volatile CodepointBuckets;
+	ThreadLock WriteLock;
+	bool FoldDiacritics;
+	volatile long long Generation;
 } IDCodepointHashMap;
 
 
@@ -19,6 +26,31 @@ void IDCodepointHashMap_RemoveID(IDCodepointHashMap* self, const char* string, u
 
 void IDCodepointHashMap_Clear(IDCodepointHashMap* self);
 
+/// <summary>
+/// Adds every ID of the other map to this one, as if the strings added to the other map were added to this one.
+/// The other map isn't changed and mustn't be written to meanwhile.
+/// </summary>
+void IDCodepointHashMap_Merge(IDCodepointHashMap* self, IDCodepointHashMap* other);
+
+/// <summary>
+/// Atomically swaps in the other map's contents, searches see either all of the old contents or all of the new ones.
+/// The old contents are freed once no search reads them, the other map is left deconstructed.
+/// </summary>
+void IDCodepointHashMap_Replace(IDCodepointHashMap* self, IDCodepointHashMap* replacement);
+
+unsigned long long IDCodepointHashMap_GetGeneration(IDCodepointHashMap* self);
+
+/// <summary>
+/// Appends the map's contents to the snapshot.
+/// </summary>
+void IDCodepointHashMap_WriteSnapshot(IDCodepointHashMap* self, IndexSnapshotWriter* writer);
+
+/// <summary>
+/// Fills an empty map with contents read from the snapshot, to be called before the map is shared with readers.
+/// </summary>
+/// <returns>false if the snapshot is damaged or was written with different settings, the map should be cleared then.</returns>
+bool IDCodepointHashMap_ReadSnapshot(IDCodepointHashMap* self, IndexSnapshotReader* reader);
+
 unsigned long long* IDCodepointHashMap_FindByString(IDCodepointHashMap* self, const char* string, bool ignoreWhitespace, size_t* arraySize);
 
 void IDCodepointHashMap_Deconstruct(IDCodepointHashMap* self);
\ No newline at end of file
@@ -0,0 +1,744 @@
+#include "IDTermDictionary.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include "Memory.h"
+#include "LTTChar.h"
+#include "LTTMath.h"
+#include <stdbool.h>
+
+
+// Macros.
+#define MAX_TERM_LENGTH 32
+
+#define SHORT_TERM_MAX_LENGTH 2
+#define MEDIUM_TERM_MAX_LENGTH 5
+
+#define GENERIC_LIST_CAPACITY 4
+#define GENERIC_LIST_GROWTH 2
+
+#define NODE_STACK_CAPACITY 64
+
+
+// Types.
+typedef struct TermStruct
+{
+	int Codepoints[MAX_TERM_LENGTH];
+	int Length;
+} Term;
+
+typedef struct TermIDListStruct
+{
+	unsigned long long* IDs;
+	size_t IDCount;
+	size_t _capacity;
+} TermIDList;
+
+typedef struct TermChildStruct
+{
+	int Distance;
+	struct TermNodeStruct* Node;
+} TermChild;
+
+/* A BK-tree node, every child's term is exactly "Distance" edits away from the node's term. */
+typedef struct TermNodeStruct
+{
+	Term NodeTerm;
+	TermIDList IDs;
+
+	TermChild* Children;
+	size_t ChildCount;
+	size_t _childCapacity;
+} TermNode;
+
+typedef struct TermListStruct
+{
+	Term* Terms;
+	size_t Count;
+	size_t _capacity;
+} TermList;
+
+typedef struct TermNodeStackStruct
+{
+	TermNode** Nodes;
+	size_t Count;
+	size_t _capacity;
+} TermNodeStack;
+
+
+// Static functions.
+/* ID list. */
+static void TermIDListConstruct(TermIDList* list)
+{
+	list->IDs = NULL;
+	list->IDCount = 0;
+	list->_capacity = 0;
+}
+
+static void TermIDListEnsureCapacity(TermIDList* list, size_t capacity)
+{
+	if (list->_capacity >= capacity)
+	{
+		return;
+	}
+
+	if (list->_capacity == 0)
+	{
+		list->_capacity = GENERIC_LIST_CAPACITY;
+	}
+	while (list->_capacity < capacity)
+	{
+		list->_capacity *= GENERIC_LIST_GROWTH;
+	}
+	list->IDs = (unsigned long long*)Memory_SafeRealloc(list->IDs, sizeof(unsigned long long) * list->_capacity);
+}
+
+static void TermIDListAddID(TermIDList* list, unsigned long long id)
+{
+	TermIDListEnsureCapacity(list, list->IDCount + 1);
+	list->IDs[list->IDCount] = id;
+	list->IDCount += 1;
+}
+
+static void TermIDListAddRange(TermIDList* list, unsigned long long* ids, size_t idCount)
+{
+	TermIDListEnsureCapacity(list, list->IDCount + idCount);
+	for (size_t i = 0; i < idCount; i++)
+	{
+		list->IDs[list->IDCount + i] = ids[i];
+	}
+	list->IDCount += idCount;
+}
+
+static void TermIDListRemoveID(TermIDList* list, unsigned long long id)
+{
+	// Only a single occurrence is removed since the same ID may be added for multiple strings.
+	for (size_t i = 0; i < list->IDCount; i++)
+	{
+		if (list->IDs[i] == id)
+		{
+			list->IDs[i] = list->IDs[list->IDCount - 1];
+			list->IDCount -= 1;
+			return;
+		}
+	}
+}
+
+static int CompareIDs(const void* id1, const void* id2)
+{
+	unsigned long long ID1 = *(const unsigned long long*)id1;
+	unsigned long long ID2 = *(const unsigned long long*)id2;
+	return (ID1 > ID2) - (ID1 < ID2);
+}
+
+static void TermIDListSortUnique(TermIDList* list)
+{
+	if (list->IDCount < 2)
+	{
+		return;
+	}
+
+	qsort(list->IDs, list->IDCount, sizeof(unsigned long long), CompareIDs);
+
+	size_t UniqueCount = 1;
+	for (size_t i = 1; i < list->IDCount; i++)
+	{
+		if (list->IDs[i] != list->IDs[UniqueCount - 1])
+		{
+			list->IDs[UniqueCount] = list->IDs[i];
+			UniqueCount++;
+		}
+	}
+	list->IDCount = UniqueCount;
+}
+
+static void TermIDListIntersectSorted(TermIDList* resultList, TermIDList* listToIntersect)
+{
+	size_t ResultCount = 0;
+	size_t OtherIndex = 0;
+
+	for (size_t i = 0; (i < resultList->IDCount) && (OtherIndex < listToIntersect->IDCount); i++)
+	{
+		while ((OtherIndex < listToIntersect->IDCount) && (listToIntersect->IDs[OtherIndex] < resultList->IDs[i]))
+		{
+			OtherIndex++;
+		}
+
+		if ((OtherIndex < listToIntersect->IDCount) && (listToIntersect->IDs[OtherIndex] == resultList->IDs[i]))
+		{
+			resultList->IDs[ResultCount] = resultList->IDs[i];
+			ResultCount++;
+		}
+	}
+
+	resultList->IDCount = ResultCount;
+}
+
+static void TermIDListDeconstruct(TermIDList* list)
+{
+	Memory_Free(list->IDs);
+}
+
+
+/* Terms. */
+static void TermListEnsureCapacity(TermList* list, size_t capacity)
+{
+	if (list->_capacity >= capacity)
+	{
+		return;
+	}
+
+	while (list->_capacity < capacity)
+	{
+		list->_capacity *= GENERIC_LIST_GROWTH;
+	}
+	list->Terms = (Term*)Memory_SafeRealloc(list->Terms, sizeof(Term) * list->_capacity);
+}
+
+static void TokenizeString(const char* string, TermList* list, bool foldDiacritics)
+{
+	list->Count = 0;
+	list->_capacity = GENERIC_LIST_CAPACITY;
+	list->Terms = (Term*)Memory_SafeMalloc(sizeof(Term) * list->_capacity);
+
+	Term* CurrentTerm = NULL;
+	for (size_t Index = 0; string[Index] != '\0'; Index += Char_GetByteCount(string + Index))
+	{
+		int Codepoint = Char_GetCodepoint(string + Index);
+		if (!Char_IsLetterCodepoint(Codepoint) && !Char_IsDigit(string + Index))
+		{
+			CurrentTerm = NULL;
+			continue;
+		}
+
+		if (!CurrentTerm)
+		{
+			TermListEnsureCapacity(list, list->Count + 1);
+			CurrentTerm = list->Terms + list->Count;
+			CurrentTerm->Length = 0;
+			list->Count += 1;
+		}
+
+		// Overly long words are truncated, they still match on their prefix.
+		if (CurrentTerm->Length < MAX_TERM_LENGTH)
+		{
+			CurrentTerm->Codepoints[CurrentTerm->Length] = Char_ToSearchCodepoint(Codepoint, foldDiacritics);
+			CurrentTerm->Length += 1;
+		}
+	}
+}
+
+static int GetEditDistance(Term* term1, Term* term2)
+{
+	int PreviousRow[MAX_TERM_LENGTH + 1];
+	int CurrentRow[MAX_TERM_LENGTH + 1];
+
+	for (int i = 0; i <= term2->Length; i++)
+	{
+		PreviousRow[i] = i;
+	}
+
+	for (int i = 1; i <= term1->Length; i++)
+	{
+		CurrentRow[0] = i;
+		for (int j = 1; j <= term2->Length; j++)
+		{
+			int SubstitutionCost = term1->Codepoints[i - 1] == term2->Codepoints[j - 1] ? 0 : 1;
+			int Distance = Math_Min(PreviousRow[j] + 1, CurrentRow[j - 1] + 1);
+			CurrentRow[j] = Math_Min(Distance, PreviousRow[j - 1] + SubstitutionCost);
+		}
+
+		for (int j = 0; j <= term2->Length; j++)
+		{
+			PreviousRow[j] = CurrentRow[j];
+		}
+	}
+
+	return PreviousRow[term2->Length];
+}
+
+static int GetAllowedEditDistance(Term* term, int maxEditDistance)
+{
+	// Short words would match nearly everything with even a single edit.
+	if (term->Length <= SHORT_TERM_MAX_LENGTH)
+	{
+		return 0;
+	}
+	if (term->Length <= MEDIUM_TERM_MAX_LENGTH)
+	{
+		return Math_Min(1, maxEditDistance);
+	}
+	return maxEditDistance;
+}
+
+
+/* Tree nodes. */
+static TermNode* CreateTermNode(Term* term)
+{
+	TermNode* Node = (TermNode*)Memory_SafeMalloc(sizeof(TermNode));
+	Node->NodeTerm = *term;
+	TermIDListConstruct(&Node->IDs);
+	Node->Children = NULL;
+	Node->ChildCount = 0;
+	Node->_childCapacity = 0;
+	return Node;
+}
+
+static void TermNodeAddChild(TermNode* node, TermNode* child, int distance)
+{
+	if (node->ChildCount + 1 > node->_childCapacity)
+	{
+		node->_childCapacity = node->_childCapacity == 0 ? GENERIC_LIST_CAPACITY : node->_childCapacity * GENERIC_LIST_GROWTH;
+		node->Children = (TermChild*)Memory_SafeRealloc(node->Children, sizeof(TermChild) * node->_childCapacity);
+	}
+
+	node->Children[node->ChildCount].Distance = distance;
+	node->Children[node->ChildCount].Node = child;
+	node->ChildCount += 1;
+}
+
+static TermNode* TermNodeGetChild(TermNode* node, int distance)
+{
+	for (size_t i = 0; i < node->ChildCount; i++)
+	{
+		if (node->Children[i].Distance == distance)
+		{
+			return node->Children[i].Node;
+		}
+	}
+	return NULL;
+}
+
+static void DeconstructTermNode(TermNode* node)
+{
+	TermIDListDeconstruct(&node->IDs);
+	Memory_Free(node->Children);
+	Memory_Free(node);
+}
+
+
+/* Node stack. */
+static void NodeStackConstruct(TermNodeStack* stack)
+{
+	stack->_capacity = NODE_STACK_CAPACITY;
+	stack->Nodes = (TermNode**)Memory_SafeMalloc(sizeof(TermNode*) * stack->_capacity);
+	stack->Count = 0;
+}
+
+static void NodeStackPush(TermNodeStack* stack, TermNode* node)
+{
+	if (stack->Count + 1 > stack->_capacity)
+	{
+		stack->_capacity *= GENERIC_LIST_GROWTH;
+		stack->Nodes = (TermNode**)Memory_SafeRealloc(stack->Nodes, sizeof(TermNode*) * stack->_capacity);
+	}
+	stack->Nodes[stack->Count] = node;
+	stack->Count += 1;
+}
+
+static TermNode* NodeStackPop(TermNodeStack* stack)
+{
+	stack->Count -= 1;
+	return stack->Nodes[stack->Count];
+}
+
+static void NodeStackDeconstruct(TermNodeStack* stack)
+{
+	Memory_Free(stack->Nodes);
+}
+
+
+/* Tree. */
+static TermNode* FindOrCreateTermNode(IDTermDictionary* self, Term* term)
+{
+	if (!self->Root)
+	{
+		self->Root = CreateTermNode(term);
+		self->TermCount += 1;
+		return self->Root;
+	}
+
+	TermNode* Node = self->Root;
+	while (true)
+	{
+		int Distance = GetEditDistance(term, &Node->NodeTerm);
+		if (Distance == 0)
+		{
+			return Node;
+		}
+
+		TermNode* Child = TermNodeGetChild(Node, Distance);
+		if (!Child)
+		{
+			Child = CreateTermNode(term);
+			TermNodeAddChild(Node, Child, Distance);
+			self->TermCount += 1;
+			return Child;
+		}
+		Node = Child;
+	}
+}
+
+static TermNode* FindTermNode(IDTermDictionary* self, Term* term)
+{
+	TermNode* Node = self->Root;
+	while (Node)
+	{
+		int Distance = GetEditDistance(term, &Node->NodeTerm);
+		if (Distance == 0)
+		{
+			return Node;
+		}
+		Node = TermNodeGetChild(Node, Distance);
+	}
+	return NULL;
+}
+
+static void CollectIDsWithinDistance(IDTermDictionary* self, Term* term, int maxDistance, TermNodeStack* stack, TermIDList* foundIDs)
+{
+	if (!self->Root)
+	{
+		return;
+	}
+
+	stack->Count = 0;
+	NodeStackPush(stack, self->Root);
+
+	while (stack->Count > 0)
+	{
+		TermNode* Node = NodeStackPop(stack);
+		int Distance = GetEditDistance(term, &Node->NodeTerm);
+
+		if (Distance <= maxDistance)
+		{
+			TermIDListAddRange(foundIDs, Node->IDs.IDs, Node->IDs.IDCount);
+		}
+
+		// Triangle inequality, only children within [Distance - max, Distance + max] can be close enough.
+		for (size_t i = 0; i < Node->ChildCount; i++)
+		{
+			int ChildDistance = Node->Children[i].Distance;
+			if ((ChildDistance >= Distance - maxDistance) && (ChildDistance <= Distance + maxDistance))
+			{
+				NodeStackPush(stack, Node->Children[i].Node);
+			}
+		}
+	}
+}
+
+static void WriteTermNode(IndexSnapshotWriter* writer, TermNode* node)
+{
+	IndexSnapshotWriter_WriteUInt(writer, (unsigned int)node->NodeTerm.Length);
+	for (int i = 0; i < node->NodeTerm.Length; i++)
+	{
+		IndexSnapshotWriter_WriteUInt(writer, (unsigned int)node->NodeTerm.Codepoints[i]);
+	}
+
+	IndexSnapshotWriter_WriteULong(writer, node->IDs.IDCount);
+	IndexSnapshotWriter_WriteULongs(writer, node->IDs.IDs, node->IDs.IDCount);
+
+	IndexSnapshotWriter_WriteULong(writer, node->ChildCount);
+	for (size_t i = 0; i < node->ChildCount; i++)
+	{
+		IndexSnapshotWriter_WriteUInt(writer, (unsigned int)node->Children[i].Distance);
+	}
+}
+
+/* The node's children get their distances but no nodes, they are attached as they're read. */
+static TermNode* ReadTermNode(IndexSnapshotReader* reader)
+{
+	Term NodeTerm;
+	NodeTerm.Length = (int)IndexSnapshotReader_ReadUInt(reader);
+	if ((NodeTerm.Length < 0) || (NodeTerm.Length > MAX_TERM_LENGTH))
+	{
+		reader->IsValid = false;
+		NodeTerm.Length = 0;
+	}
+	for (int i = 0; i < NodeTerm.Length; i++)
+	{
+		NodeTerm.Codepoints[i] = (int)IndexSnapshotReader_ReadUInt(reader);
+	}
+
+	TermNode* Node = CreateTermNode(&NodeTerm);
+	size_t IDCount = IndexSnapshotReader_ReadCount(reader, sizeof(unsigned long long));
+	TermIDListEnsureCapacity(&Node->IDs, IDCount);
+	IndexSnapshotReader_ReadULongs(reader, Node->IDs.IDs, IDCount);
+	Node->IDs.IDCount = IDCount;
+
+	size_t ChildCount = IndexSnapshotReader_ReadCount(reader, sizeof(int));
+	if (ChildCount > 0)
+	{
+		Node->_childCapacity = ChildCount;
+		Node->Children = (TermChild*)Memory_SafeMalloc(sizeof(TermChild) * ChildCount);
+		for (size_t i = 0; i < ChildCount; i++)
+		{
+			Node->Children[i].Distance = (int)IndexSnapshotReader_ReadUInt(reader);
+			Node->Children[i].Node = NULL;
+		}
+	}
+	return Node;
+}
+
+static void DeconstructTree(IDTermDictionary* self)
+{
+	if (!self->Root)
+	{
+		return;
+	}
+
+	TermNodeStack Stack;
+	NodeStackConstruct(&Stack);
+	NodeStackPush(&Stack, self->Root);
+
+	while (Stack.Count > 0)
+	{
+		TermNode* Node = NodeStackPop(&Stack);
+		for (size_t i = 0; i < Node->ChildCount; i++)
+		{
+			NodeStackPush(&Stack, Node->Children[i].Node);
+		}
+		DeconstructTermNode(Node);
+	}
+
+	NodeStackDeconstruct(&Stack);
+	self->Root = NULL;
+	self->TermCount = 0;
+}
+
+
+// Functions.
+void IDTermDictionary_Construct(IDTermDictionary* self)
+{
+	self->Root = NULL;
+	self->TermCount = 0;
+	ThreadLock_Construct(&self->Lock);
+	self->FoldDiacritics = false;
+}
+
+void IDTermDictionary_AddID(IDTermDictionary* self, const char* string, unsigned long long id)
+{
+	TermList Terms;
+	TokenizeString(string, &Terms, self->FoldDiacritics);
+
+	ThreadLock_Lock(&self->Lock);
+	for (size_t i = 0; i < Terms.Count; i++)
+	{
+		TermIDListAddID(&FindOrCreateTermNode(self, Terms.Terms + i)->IDs, id);
+	}
+	ThreadLock_Unlock(&self->Lock);
+
+	Memory_Free(Terms.Terms);
+}
+
+void IDTermDictionary_RemoveID(IDTermDictionary* self, const char* string, unsigned long long id)
+{
+	TermList Terms;
+	TokenizeString(string, &Terms, self->FoldDiacritics);
+
+	ThreadLock_Lock(&self->Lock);
+	for (size_t i = 0; i < Terms.Count; i++)
+	{
+		// Emptied nodes stay in the tree since removing a BK-tree node means rebuilding its subtree.
+		TermNode* Node = FindTermNode(self, Terms.Terms + i);
+		if (Node)
+		{
+			TermIDListRemoveID(&Node->IDs, id);
+		}
+	}
+	ThreadLock_Unlock(&self->Lock);
+
+	Memory_Free(Terms.Terms);
+}
+
+void IDTermDictionary_Clear(IDTermDictionary* self)
+{
+	ThreadLock_Lock(&self->Lock);
+	DeconstructTree(self);
+	ThreadLock_Unlock(&self->Lock);
+}
+
+void IDTermDictionary_WriteSnapshot(IDTermDictionary* self, IndexSnapshotWriter* writer)
+{
+	ThreadLock_LockShared(&self->Lock);
+	IndexSnapshotWriter_WriteUInt(writer, self->FoldDiacritics);
+	IndexSnapshotWriter_WriteULong(writer, self->TermCount);
+	if (!self->Root)
+	{
+		ThreadLock_UnlockShared(&self->Lock);
+		return;
+	}
+
+	// Nodes are written depth-first with children in order, so reading can attach each node to the last unfinished parent.
+	TermNodeStack Stack;
+	NodeStackConstruct(&Stack);
+	NodeStackPush(&Stack, self->Root);
+	while (Stack.Count > 0)
+	{
+		TermNode* Node = NodeStackPop(&Stack);
+		WriteTermNode(writer, Node);
+		for (size_t i = Node->ChildCount; i > 0; i--)
+		{
+			NodeStackPush(&Stack, Node->Children[i - 1].Node);
+		}
+	}
+
+	NodeStackDeconstruct(&Stack);
+	ThreadLock_UnlockShared(&self->Lock);
+}
+
+bool IDTermDictionary_ReadSnapshot(IDTermDictionary* self, IndexSnapshotReader* reader)
+{
+	if (IndexSnapshotReader_ReadUInt(reader) != (unsigned int)self->FoldDiacritics)
+	{
+		return false;
+	}
+
+	// Each node holds at least its term length, ID count and child count.
+	size_t TermCount = IndexSnapshotReader_ReadCount(reader, sizeof(int) + (sizeof(unsigned long long) * 2));
+	if (TermCount == 0)
+	{
+		return reader->IsValid;
+	}
+
+	self->Root = ReadTermNode(reader);
+	self->TermCount = 1;
+
+	TermNodeStack Stack;
+	NodeStackConstruct(&Stack);
+	NodeStackPush(&Stack, self->Root);
+	while ((Stack.Count > 0) && reader->IsValid)
+	{
+		TermNode* Parent = Stack.Nodes[Stack.Count - 1];
+		if (Parent->ChildCount == Parent->_childCapacity)
+		{
+			NodeStackPop(&Stack);
+			continue;
+		}
+
+		TermNode* Child = ReadTermNode(reader);
+		Parent->Children[Parent->ChildCount].Node = Child;
+		Parent->ChildCount += 1;
+		self->TermCount += 1;
+		NodeStackPush(&Stack, Child);
+	}
+	NodeStackDeconstruct(&Stack);
+
+	return reader->IsValid && (self->TermCount == TermCount);
+}
+
+void IDTermDictionary_Merge(IDTermDictionary* self, IDTermDictionary* other)
+{
+	ThreadLock_LockShared(&other->Lock);
+	if (!other->Root)
+	{
+		ThreadLock_UnlockShared(&other->Lock);
+		return;
+	}
+
+	// Each distinct term is inserted once with all of its IDs, instead of once per string it appeared in.
+	TermNodeStack Stack;
+	NodeStackConstruct(&Stack);
+	NodeStackPush(&Stack, other->Root);
+
+	ThreadLock_Lock(&self->Lock);
+	while (Stack.Count > 0)
+	{
+		TermNode* OtherNode = NodeStackPop(&Stack);
+		if (OtherNode->IDs.IDCount > 0)
+		{
+			TermIDListAddRange(&FindOrCreateTermNode(self, &OtherNode->NodeTerm)->IDs, OtherNode->IDs.IDs, OtherNode->IDs.IDCount);
+		}
+		for (size_t i = 0; i < OtherNode->ChildCount; i++)
+		{
+			NodeStackPush(&Stack, OtherNode->Children[i].Node);
+		}
+	}
+	ThreadLock_Unlock(&self->Lock);
+	ThreadLock_UnlockShared(&other->Lock);
+
+	NodeStackDeconstruct(&Stack);
+}
+
+void IDTermDictionary_Replace(IDTermDictionary* self, IDTermDictionary* replacement)
+{
+	ThreadLock_Lock(&self->Lock);
+	ThreadLock_Lock(&replacement->Lock);
+	TermNode* OldRoot = self->Root;
+	size_t OldTermCount = self->TermCount;
+	self->Root = replacement->Root;
+	self->TermCount = replacement->TermCount;
+	replacement->Root = OldRoot;
+	replacement->TermCount = OldTermCount;
+	ThreadLock_Unlock(&replacement->Lock);
+	ThreadLock_Unlock(&self->Lock);
+
+	// Readers hold the lock for the whole search, none of them can still be in the old tree.
+	DeconstructTree(replacement);
+}
+
+unsigned long long* IDTermDictionary_FindByString(IDTermDictionary* self, const char* string, int maxEditDistance, size_t* arraySize)
+{
+	*arraySize = 0;
+	maxEditDistance = Math_Clamp(maxEditDistance, 0, TERM_DICTIONARY_MAX_EDIT_DISTANCE);
+
+	TermList Terms;
+	TokenizeString(string, &Terms, self->FoldDiacritics);
+
+	// The tree is small next to the codepoint maps and rarely written, so readers share a lock instead of versioning nodes.
+	ThreadLock_LockShared(&self->Lock);
+	if ((Terms.Count == 0) || !self->Root)
+	{
+		ThreadLock_UnlockShared(&self->Lock);
+		Memory_Free(Terms.Terms);
+		return NULL;
+	}
+
+	TermNodeStack Stack;
+	NodeStackConstruct(&Stack);
+	TermIDList FinalIDs;
+	TermIDList TermIDs;
+	TermIDListConstruct(&FinalIDs);
+	TermIDListConstruct(&TermIDs);
+
+	// Every query word must match some word of the string, either exactly or within the allowed edit distance.
+	for (size_t i = 0; i < Terms.Count; i++)
+	{
+		Term* QueryTerm = Terms.Terms + i;
+		TermIDs.IDCount = 0;
+		CollectIDsWithinDistance(self, QueryTerm, GetAllowedEditDistance(QueryTerm, maxEditDistance), &Stack, &TermIDs);
+		TermIDListSortUnique(&TermIDs);
+
+		if (i == 0)
+		{
+			TermIDListAddRange(&FinalIDs, TermIDs.IDs, TermIDs.IDCount);
+		}
+		else
+		{
+			TermIDListIntersectSorted(&FinalIDs, &TermIDs);
+		}
+
+		if (FinalIDs.IDCount == 0)
+		{
+			break;
+		}
+	}
+
+	ThreadLock_UnlockShared(&self->Lock);
+
+	NodeStackDeconstruct(&Stack);
+	TermIDListDeconstruct(&TermIDs);
+	Memory_Free(Terms.Terms);
+
+	if (FinalIDs.IDCount == 0)
+	{
+		TermIDListDeconstruct(&FinalIDs);
+		return NULL;
+	}
+
+	*arraySize = FinalIDs.IDCount;
+	return FinalIDs.IDs;
+}
+
+void IDTermDictionary_Deconstruct(IDTermDictionary* self)
+{
+	DeconstructTree(self);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+#include "LTTThread.h"
+#include "IndexSnapshot.h"
+
+
+// Macros.
+#define TERM_DICTIONARY_MAX_EDIT_DISTANCE 2
+
+
+// Structures.
+typedef struct IDTermDictionaryStruct
+{
+	struct TermNodeStruct* Root;
+	size_t TermCount;
+	ThreadLock Lock;
+	bool FoldDiacritics;
+} IDTermDictionary;
+
+
+// Functions.
+void IDTermDictionary_Construct(IDTermDictionary* self);
+
+void IDTermDictionary_AddID(IDTermDictionary* self, const char* string, unsigned long long id);
+
+void IDTermDictionary_RemoveID(IDTermDictionary* self, const char* string, unsigned long long id);
+
+void IDTermDictionary_Clear(IDTermDictionary* self);
+
+/// <summary>
+/// Adds every term of the other dictionary with its IDs to this one. The other dictionary isn't changed.
+/// </summary>
+void IDTermDictionary_Merge(IDTermDictionary* self, IDTermDictionary* other);
+
+/// <summary>
+/// Appends the dictionary's terms with their IDs to the snapshot, keeping the tree's shape.
+/// </summary>
+void IDTermDictionary_WriteSnapshot(IDTermDictionary* self, IndexSnapshotWriter* writer);
+
+/// <summary>
+/// Fills an empty dictionary with the tree read from the snapshot, to be called before the dictionary is shared with readers.
+/// </summary>
+/// <returns>false if the snapshot is damaged or was written with different settings, the dictionary should be cleared then.</returns>
+bool IDTermDictionary_ReadSnapshot(IDTermDictionary* self, IndexSnapshotReader* reader);
+
+/// <summary>
+/// Swaps in the other dictionary's tree in a single write, the old tree is freed and the other dictionary is left deconstructed.
+/// </summary>
+void IDTermDictionary_Replace(IDTermDictionary* self, IDTermDictionary* replacement);
+
+unsigned long long* IDTermDictionary_FindByString(IDTermDictionary* self, const char* string, int maxEditDistance, size_t* arraySize);
+
+void IDTermDictionary_Deconstruct(IDTermDictionary* self);
\ No newline at end of file
@@ -3,6 +3,8 @@
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include "LTTMath.h"
 #include "Memory.h"
+#include "Trace.h"
+#include "LTTProbes.h"
 
 #include "Image.h"
 
@@ -12,9 +14,12 @@ void Image_ScaleImageToFit(Image* image, int maxSizeOnAxis)
 	int TargetXSize = (int)(image->SizeX * Scale);
 	int TargetYSize = (int)(image->SizeY * Scale);
 
+	TraceSpan Span = Trace_BeginSpan("image resize");
 	const char* ResizedImageData = Memory_SafeMalloc(TargetXSize * TargetYSize * STBI_rgb);
 	stbir_resize(image->Data, image->SizeX, image->SizeY, 0, (void*)ResizedImageData, TargetXSize, TargetYSize,
 		0, STBIR_RGB, STBIR_TYPE_UINT8, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT);
+	Trace_EndSpan(Span);
+	LTT_PROBE_IMAGE_RESIZE(image->SizeX, image->SizeY, TargetXSize, TargetYSize);
 	Memory_Free((char*)image->Data);
 	image->Data = (const unsigned char*)ResizedImageData;
 	image->SizeX = TargetXSize;
@@ -0,0 +1,183 @@
+#include "IndexBuild.h"
+#include "LttString.h"
+#include "Memory.h"
+
+
+// Macros.
+#define REMOVAL_LIST_CAPACITY 16
+#define REMOVAL_LIST_GROWTH 2
+
+/* A record is claimed once the build has read it, it is changed once the live indexes have its newer contents. */
+#define RECORD_STATE_UNREAD 0
+#define RECORD_STATE_CLAIMED 1
+#define RECORD_STATE_CHANGED 2
+
+
+// Static functions.
+static unsigned char* FindRecordState(IndexBuild* self, unsigned long long id)
+{
+	size_t Low = 0;
+	size_t High = self->IDCount;
+	while (Low < High)
+	{
+		size_t Middle = Low + ((High - Low) / 2);
+		if (self->IDs[Middle] < id)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+	return (Low < self->IDCount) && (self->IDs[Low] == id) ? self->_recordStates + Low : NULL;
+}
+
+static void ClearRemovals(IndexBuild* self)
+{
+	for (size_t i = 0; i < self->_removalCount; i++)
+	{
+		Memory_Free(self->_removals[i].String);
+	}
+	Memory_Free(self->_removals);
+	self->_removals = NULL;
+	self->_removalCount = 0;
+	self->_removalCapacity = 0;
+}
+
+
+// Functions.
+void IndexBuild_Construct(IndexBuild* self)
+{
+	Memory_Set((char*)self, sizeof(IndexBuild), 0);
+	ThreadLock_Construct(&self->_lock);
+	self->State = IndexBuildState_Complete;
+}
+
+void IndexBuild_LockChanges(IndexBuild* self)
+{
+	ThreadLock_Lock(&self->_lock);
+}
+
+void IndexBuild_UnlockChanges(IndexBuild* self)
+{
+	ThreadLock_Unlock(&self->_lock);
+}
+
+void IndexBuild_Begin(IndexBuild* self, unsigned long long* ids, size_t idCount)
+{
+	Memory_Free(self->IDs);
+	Memory_Free(self->_recordStates);
+	self->IDs = ids;
+	self->IDCount = idCount;
+	self->_recordStates = NULL;
+	if (idCount > 0)
+	{
+		self->_recordStates = (unsigned char*)Memory_SafeMalloc(idCount);
+		Memory_Set((char*)self->_recordStates, idCount, RECORD_STATE_UNREAD);
+	}
+	Atomic_Store(&self->IndexedCount, 0);
+	Atomic_Store(&self->State, IndexBuildState_Running);
+}
+
+bool IndexBuild_ClaimRecord(IndexBuild* self, unsigned long long id)
+{
+	ThreadLock_Lock(&self->_lock);
+	unsigned char* RecordState = FindRecordState(self, id);
+	bool IsClaimed = RecordState && (*RecordState == RECORD_STATE_UNREAD);
+	if (IsClaimed)
+	{
+		*RecordState = RECORD_STATE_CLAIMED;
+	}
+	ThreadLock_Unlock(&self->_lock);
+
+	Atomic_Increment(&self->IndexedCount);
+	return IsClaimed;
+}
+
+bool IndexBuild_BeginRecordChange(IndexBuild* self, unsigned long long id)
+{
+	ThreadLock_Lock(&self->_lock);
+	if (Atomic_Load(&self->State) != IndexBuildState_Running)
+	{
+		return false;
+	}
+
+	// Records not in the list were created after the build began, only the live indexes ever have them.
+	unsigned char* RecordState = FindRecordState(self, id);
+	if (!RecordState)
+	{
+		return false;
+	}
+	bool IsRemovalDeferred = *RecordState == RECORD_STATE_CLAIMED;
+	*RecordState = RECORD_STATE_CHANGED;
+	return IsRemovalDeferred;
+}
+
+void IndexBuild_DeferRemoval(IndexBuild* self, int index, const char* string, unsigned long long id)
+{
+	if (self->_removalCount + 1 > self->_removalCapacity)
+	{
+		self->_removalCapacity = self->_removalCapacity == 0 ? REMOVAL_LIST_CAPACITY : self->_removalCapacity * REMOVAL_LIST_GROWTH;
+		self->_removals = (IndexBuildRemoval*)Memory_SafeRealloc(self->_removals, sizeof(IndexBuildRemoval) * self->_removalCapacity);
+	}
+
+	IndexBuildRemoval* Removal = self->_removals + self->_removalCount;
+	Removal->Index = index;
+	Removal->String = String_CreateCopy(string);
+	Removal->ID = id;
+	self->_removalCount++;
+}
+
+void IndexBuild_EndRecordChange(IndexBuild* self)
+{
+	ThreadLock_Unlock(&self->_lock);
+}
+
+void IndexBuild_Finish(IndexBuild* self, bool isSuccessful, IndexBuildRemovalFunction function, void* argument)
+{
+	ThreadLock_Lock(&self->_lock);
+	for (size_t i = 0; isSuccessful && (i < self->_removalCount); i++)
+	{
+		function(self->_removals[i].Index, self->_removals[i].String, self->_removals[i].ID, argument);
+	}
+	ClearRemovals(self);
+
+	Memory_Free(self->IDs);
+	Memory_Free(self->_recordStates);
+	self->IDs = NULL;
+	self->_recordStates = NULL;
+	Atomic_Store(&self->State, isSuccessful ? IndexBuildState_Complete : IndexBuildState_Failed);
+	ThreadLock_Unlock(&self->_lock);
+}
+
+IndexBuildState IndexBuild_GetState(IndexBuild* self)
+{
+	return (IndexBuildState)Atomic_Load(&self->State);
+}
+
+unsigned long long* IndexBuild_CopyIDs(IndexBuild* self, size_t* idCount)
+{
+	*idCount = 0;
+	ThreadLock_Lock(&self->_lock);
+	if ((Atomic_Load(&self->State) != IndexBuildState_Running) || (self->IDCount == 0))
+	{
+		ThreadLock_Unlock(&self->_lock);
+		return NULL;
+	}
+
+	unsigned long long* IDs = (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * self->IDCount);
+	Memory_Copy((const char*)self->IDs, (char*)IDs, sizeof(unsigned long long) * self->IDCount);
+	*idCount = self->IDCount;
+	ThreadLock_Unlock(&self->_lock);
+	return IDs;
+}
+
+void IndexBuild_Deconstruct(IndexBuild* self)
+{
+	ClearRemovals(self);
+	Memory_Free(self->IDs);
+	Memory_Free(self->_recordStates);
+	self->IDs = NULL;
+	self->_recordStates = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+#include "LTTThread.h"
+
+
+// Types.
+typedef enum IndexBuildStateEnum
+{
+	IndexBuildState_Complete,
+	IndexBuildState_Running,
+	IndexBuildState_Failed
+} IndexBuildState;
+
+/// <summary>
+/// Removes the string's ID from the index the removal was deferred for.
+/// </summary>
+typedef void (*IndexBuildRemovalFunction)(int index, const char* string, unsigned long long id, void* argument);
+
+typedef struct IndexBuildRemovalStruct
+{
+	int Index;
+	char* String;
+	unsigned long long ID;
+} IndexBuildRemoval;
+
+/* Tracks a build of indexes from a list of stored records while the indexes are already in use. Records are read into partial
+* indexes which are merged into the live ones at the end, records changed meanwhile are indexed by the change itself.
+* If a record's old contents were already read by the build, removing them from the live indexes must wait until the merge.
+* A rebuild of whole indexes merges into fresh ones instead, which changes go to as well until they replace the old ones. */
+typedef struct IndexBuildStruct
+{
+	/* Sorted IDs of the records being read, valid while the build runs. */
+	unsigned long long* IDs;
+	size_t IDCount;
+	volatile long long IndexedCount;
+	volatile long long State;
+
+	unsigned char* _recordStates;
+	ThreadLock _lock;
+	IndexBuildRemoval* _removals;
+	size_t _removalCount;
+	size_t _removalCapacity;
+} IndexBuild;
+
+
+// Functions.
+/// <summary>
+/// Constructs a build which is complete, the indexes are usable as they are.
+/// </summary>
+void IndexBuild_Construct(IndexBuild* self);
+
+/// <summary>
+/// Waits for record changes in progress and holds off new ones, so that the records can be listed and the indexes
+/// which changes go to can be switched without a change being missed.
+/// </summary>
+void IndexBuild_LockChanges(IndexBuild* self);
+
+void IndexBuild_UnlockChanges(IndexBuild* self);
+
+/// <summary>
+/// Starts tracking a build of the records, to be called while changes are locked.
+/// </summary>
+/// <param name="ids">Sorted IDs of the records to read, the build takes ownership of the array.</param>
+void IndexBuild_Begin(IndexBuild* self, unsigned long long* ids, size_t idCount);
+
+/// <summary>
+/// Called by the build once it has read the record and before adding it to the partial indexes.
+/// </summary>
+/// <returns>false if the record changed since the build began, it is already in the live indexes then and must be skipped.</returns>
+bool IndexBuild_ClaimRecord(IndexBuild* self, unsigned long long id);
+
+/// <summary>
+/// Called before the record's entries in the live indexes are changed, IndexBuild_EndRecordChange must follow.
+/// </summary>
+/// <returns>Whether the removals of the record's old contents must be deferred with IndexBuild_DeferRemoval,
+/// they must be made on the live indexes as well.</returns>
+bool IndexBuild_BeginRecordChange(IndexBuild* self, unsigned long long id);
+
+void IndexBuild_DeferRemoval(IndexBuild* self, int index, const char* string, unsigned long long id);
+
+void IndexBuild_EndRecordChange(IndexBuild* self);
+
+/// <summary>
+/// Ends the build once the partial indexes are merged, making the deferred removals if it succeeded.
+/// </summary>
+void IndexBuild_Finish(IndexBuild* self, bool isSuccessful, IndexBuildRemovalFunction function, void* argument);
+
+IndexBuildState IndexBuild_GetState(IndexBuild* self);
+
+/// <summary>
+/// Copies the IDs of the records being read, for lookups which can't wait for the build and scan the records instead.
+/// </summary>
+/// <returns>NULL if the build isn't running.</returns>
+unsigned long long* IndexBuild_CopyIDs(IndexBuild* self, size_t* idCount);
+
+void IndexBuild_Deconstruct(IndexBuild* self);
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "IndexSnapshot.h"
+#include "Memory.h"
+#include "LTTBytes.h"
+
+
+// Macros.
+#define SNAPSHOT_MAGIC 0x5849544Cu // "LTIX"
+#define SNAPSHOT_VERSION 1u
+
+/* Magic, version, generation, payload length and payload checksum. */
+#define SNAPSHOT_HEADER_SIZE (4 + 4 + 8 + 8 + 4)
+
+#define WRITER_CAPACITY 65536
+#define WRITER_GROWTH 2
+
+
+// Static functions.
+static unsigned char* ReserveBytes(IndexSnapshotWriter* self, size_t count)
+{
+	if (self->Length + count > self->_capacity)
+	{
+		while (self->Length + count > self->_capacity)
+		{
+			self->_capacity *= WRITER_GROWTH;
+		}
+		self->Data = (char*)Memory_SafeRealloc(self->Data, self->_capacity);
+	}
+
+	unsigned char* Bytes = (unsigned char*)self->Data + self->Length;
+	self->Length += count;
+	return Bytes;
+}
+
+static const unsigned char* TakeBytes(IndexSnapshotReader* self, size_t count)
+{
+	if (!self->IsValid || (count > (self->_length - self->_offset)))
+	{
+		self->IsValid = false;
+		return NULL;
+	}
+
+	const unsigned char* Bytes = self->_data + self->_offset;
+	self->_offset += count;
+	return Bytes;
+}
+
+
+// Functions.
+void IndexSnapshotWriter_Construct(IndexSnapshotWriter* self, unsigned long long generation)
+{
+	self->_capacity = WRITER_CAPACITY;
+	self->Data = (char*)Memory_SafeMalloc(self->_capacity);
+	self->_generation = generation;
+
+	// The header is filled in once the payload's length and checksum are known.
+	self->Length = SNAPSHOT_HEADER_SIZE;
+}
+
+void IndexSnapshotWriter_WriteUInt(IndexSnapshotWriter* self, unsigned int value)
+{
+	Bytes_EncodeUInt(ReserveBytes(self, 4), value);
+}
+
+void IndexSnapshotWriter_WriteULong(IndexSnapshotWriter* self, unsigned long long value)
+{
+	Bytes_EncodeULong(ReserveBytes(self, 8), value);
+}
+
+void IndexSnapshotWriter_WriteULongs(IndexSnapshotWriter* self, const unsigned long long* values, size_t count)
+{
+	unsigned char* Bytes = ReserveBytes(self, count * 8);
+	for (size_t i = 0; i < count; i++)
+	{
+		Bytes_EncodeULong(Bytes + (i * 8), values[i]);
+	}
+}
+
+Error IndexSnapshotWriter_WriteToFile(IndexSnapshotWriter* self, const char* path, bool flushToDisk)
+{
+	unsigned char* Header = (unsigned char*)self->Data;
+	size_t PayloadLength = self->Length - SNAPSHOT_HEADER_SIZE;
+	Bytes_EncodeUInt(Header, SNAPSHOT_MAGIC);
+	Bytes_EncodeUInt(Header + 4, SNAPSHOT_VERSION);
+	Bytes_EncodeULong(Header + 8, self->_generation);
+	Bytes_EncodeULong(Header + 16, PayloadLength);
+	Bytes_EncodeUInt(Header + 24, Bytes_Hash(Header + SNAPSHOT_HEADER_SIZE, PayloadLength));
+
+	return File_WriteAtomic(path, self->Data, self->Length, flushToDisk);
+}
+
+void IndexSnapshotWriter_Deconstruct(IndexSnapshotWriter* self)
+{
+	Memory_Free(self->Data);
+}
+
+bool IndexSnapshotReader_Open(IndexSnapshotReader* self, const char* path, unsigned long long generation)
+{
+	Memory_Set((char*)self, sizeof(IndexSnapshotReader), 0);
+	if (!File_Exists(path))
+	{
+		return false;
+	}
+
+	Error ReturnedError = File_MapRead(path, &self->_mapping);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Error_Deconstruct(&ReturnedError);
+		return false;
+	}
+
+	const unsigned char* Data = (const unsigned char*)self->_mapping.Data;
+	size_t Length = self->_mapping.Length;
+	if ((Length < SNAPSHOT_HEADER_SIZE) || (Bytes_DecodeUInt(Data) != SNAPSHOT_MAGIC) || (Bytes_DecodeUInt(Data + 4) != SNAPSHOT_VERSION)
+		|| (Bytes_DecodeULong(Data + 8) != generation) || (Bytes_DecodeULong(Data + 16) != (Length - SNAPSHOT_HEADER_SIZE))
+		|| (Bytes_Hash(Data + SNAPSHOT_HEADER_SIZE, Length - SNAPSHOT_HEADER_SIZE) != Bytes_DecodeUInt(Data + 24)))
+	{
+		File_Unmap(&self->_mapping);
+		return false;
+	}
+
+	self->_data = Data + SNAPSHOT_HEADER_SIZE;
+	self->_length = Length - SNAPSHOT_HEADER_SIZE;
+	self->_offset = 0;
+	self->IsValid = true;
+	return true;
+}
+
+unsigned int IndexSnapshotReader_ReadUInt(IndexSnapshotReader* self)
+{
+	const unsigned char* Bytes = TakeBytes(self, 4);
+	return Bytes ? Bytes_DecodeUInt(Bytes) : 0;
+}
+
+unsigned long long IndexSnapshotReader_ReadULong(IndexSnapshotReader* self)
+{
+	const unsigned char* Bytes = TakeBytes(self, 8);
+	return Bytes ? Bytes_DecodeULong(Bytes) : 0;
+}
+
+size_t IndexSnapshotReader_ReadCount(IndexSnapshotReader* self, size_t elementSize)
+{
+	size_t Count = (size_t)IndexSnapshotReader_ReadULong(self);
+	if (self->IsValid && (elementSize > 0) && (Count > ((self->_length - self->_offset) / elementSize)))
+	{
+		self->IsValid = false;
+	}
+	return self->IsValid ? Count : 0;
+}
+
+void IndexSnapshotReader_ReadULongs(IndexSnapshotReader* self, unsigned long long* values, size_t count)
+{
+	const unsigned char* Bytes = TakeBytes(self, count * 8);
+	for (size_t i = 0; Bytes && (i < count); i++)
+	{
+		values[i] = Bytes_DecodeULong(Bytes + (i * 8));
+	}
+}
+
+bool IndexSnapshotReader_Close(IndexSnapshotReader* self)
+{
+	bool IsFullyRead = self->IsValid && (self->_offset == self->_length);
+	File_Unmap(&self->_mapping);
+	self->IsValid = false;
+	return IsFullyRead;
+}
\ No newline at end of file
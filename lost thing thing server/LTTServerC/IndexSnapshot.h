@@ -0,0 +1,70 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "LttErrors.h"
+#include "File.h"
+
+
+// Types.
+/* Builds a snapshot file: [magic][version][generation][payload length][checksum][payload].
+* Indexes append their contents to the payload in their own format, numbers are stored little-endian. */
+typedef struct IndexSnapshotWriterStruct
+{
+	char* Data;
+	size_t Length;
+	size_t _capacity;
+	unsigned long long _generation;
+} IndexSnapshotWriter;
+
+/* Reads the payload of a mapped snapshot file in the order it was written. Reading past the end or a count which can't fit
+* in the remaining data marks the reader invalid, after which every read returns zero. */
+typedef struct IndexSnapshotReaderStruct
+{
+	FileMapping _mapping;
+	const unsigned char* _data;
+	size_t _length;
+	size_t _offset;
+	bool IsValid;
+} IndexSnapshotReader;
+
+
+// Functions.
+void IndexSnapshotWriter_Construct(IndexSnapshotWriter* self, unsigned long long generation);
+
+void IndexSnapshotWriter_WriteUInt(IndexSnapshotWriter* self, unsigned int value);
+
+void IndexSnapshotWriter_WriteULong(IndexSnapshotWriter* self, unsigned long long value);
+
+void IndexSnapshotWriter_WriteULongs(IndexSnapshotWriter* self, const unsigned long long* values, size_t count);
+
+/// <summary>
+/// Replaces the file with the snapshot, readers only ever observe a whole snapshot.
+/// </summary>
+/// <param name="flushToDisk">Waits for the snapshot to reach the disk.</param>
+Error IndexSnapshotWriter_WriteToFile(IndexSnapshotWriter* self, const char* path, bool flushToDisk);
+
+void IndexSnapshotWriter_Deconstruct(IndexSnapshotWriter* self);
+
+/// <summary>
+/// Maps the snapshot file and verifies it.
+/// </summary>
+/// <param name="generation">Generation the snapshot must have been written with, older snapshots are stale.</param>
+/// <returns>false if there is no snapshot, or it is stale or damaged. The reader doesn't need to be closed then.</returns>
+bool IndexSnapshotReader_Open(IndexSnapshotReader* self, const char* path, unsigned long long generation);
+
+unsigned int IndexSnapshotReader_ReadUInt(IndexSnapshotReader* self);
+
+unsigned long long IndexSnapshotReader_ReadULong(IndexSnapshotReader* self);
+
+/// <summary>
+/// Reads an element count, the reader becomes invalid if that many elements of the size can't follow.
+/// </summary>
+size_t IndexSnapshotReader_ReadCount(IndexSnapshotReader* self, size_t elementSize);
+
+void IndexSnapshotReader_ReadULongs(IndexSnapshotReader* self, unsigned long long* values, size_t count);
+
+/// <summary>
+/// Unmaps the file.
+/// </summary>
+/// <returns>Whether all reads were valid and the whole payload was read.</returns>
+bool IndexSnapshotReader_Close(IndexSnapshotReader* self);
\ No newline at end of file
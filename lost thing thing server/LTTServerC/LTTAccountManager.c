@@ -9,8 +9,17 @@
 #include "Directory.h"
 #include <limits.h>
 #include "Logger.h"
+#include "LTTTime.h"
 #include "ConfigFile.h"
 #include "LTTServerResourceManager.h"
+#include "LTTSchema.h"
+#include "BulkLoader.h"
+#include "AccessLog.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "LTTProbes.h"
+#include <stdlib.h>
+#include <stdint.h>
 
 
 // Macros.
@@ -22,6 +31,10 @@
 #define ENTRY_FOLDER_NAME_DIVIDER 1000
 #define ACCOUNT_ENTRIES_DIR_NAME "entries"
 #define IMAGE_ENTRIES_DIR_NAME "images"
+#define ACCOUNT_STORE_DIR_NAME "store"
+#define ACCOUNT_SEGMENT_FILE_NAME "accounts" GHDF_SEGMENT_FILE_EXTENSION
+#define MUTATION_LOG_FILE_NAME "account_mutations.wal"
+#define INDEX_SNAPSHOT_FILE_NAME "account_index.snapshot"
 
 /* List. */
 #define GENERIC_LIST_CAPACITY 8
@@ -34,6 +47,7 @@
 /* Account cache/ */
 #define ACCOUNT_CACHE_CAPACITY 256
 #define ACCOUNT_CACHE_UNLOADED_TIME -1
+#define FLUSHER_INTERVAL_MILLISECONDS 1000
 
 
 /* Account meta-info file. */
@@ -45,6 +59,20 @@
 #define ENTRY_ID_METAINFO_SESSION_ACCOUNT_ID 1 // ulong
 #define ENTRY_ID_METAINFO_SESSION_START_TIME 2 // long
 #define ENTRY_ID_METAINFO_SESSION_IDVALUES 3 // uint array of length SESSION_ID_LENGTH
+#define ENTRY_ID_METAINFO_INDEX_GENERATION 3 // ulong, MAY NOT EXIST.
+
+
+/* Mutation log. */
+#define MUTATION_LOG_CHECKPOINT_LENGTH (16 * 1024 * 1024)
+#define MUTATION_RECORD_ACCOUNT 1 // Whole account record.
+#define MUTATION_RECORD_ACCOUNT_DELETED 2 // No data.
+#define MUTATION_RECORD_SESSION 3 // Start time as long, then the ID values as uints, little-endian.
+#define SESSION_RECORD_LENGTH (8 + (4 * SESSION_ID_LENGTH))
+
+/* Indexes whose removals an index build may defer. */
+#define INDEX_NAME_MAP 0
+#define INDEX_NAME_TERMS 1
+#define INDEX_EMAIL_MAP 2
 
 
 /* Account data. */
@@ -75,14 +103,51 @@
 #define ENTRY_ID_ACCOUNT_ID 7 // ulong
 #define ENTRY_ID_ACCOUNT_IS_ADMIN 8 // bool
 
+/* Record schema, see LTTSchema.h. The password hash is a fixed size array and is encoded by hand. */
+#define ACCOUNT_SCHEMA(FIELD, LIST) \
+	FIELD(ULong, ID, ENTRY_ID_ACCOUNT_ID, "id", SCHEMA_GHDF_JSON) \
+	FIELD(String, Name, ENTRY_ID_ACCOUNT_NAME, "name", SCHEMA_GHDF_JSON) \
+	FIELD(String, Surname, ENTRY_ID_ACCOUNT_SURNAME, "surname", SCHEMA_GHDF_JSON) \
+	FIELD(String, Email, ENTRY_ID_ACCOUNT_EMAIL, "email", SCHEMA_GHDF_JSON) \
+	FIELD(Long, CreationTime, ENTRY_ID_ACCOUNT_CREATION_TIME, "creation_time", SCHEMA_GHDF_JSON) \
+	LIST(ULong, Posts, PostCount, ENTRY_ID_ACCOUNT_POSTS, "posts", SCHEMA_GHDF_JSON | SCHEMA_OPTIONAL) \
+	FIELD(Bool, IsAdmin, ENTRY_ID_ACCOUNT_IS_ADMIN, "is_admin", SCHEMA_GHDF)
+
 
 // Types.
 typedef struct CachedAccountStruct
 {
 	time_t LastAccessTime;
 	UserAccount Account;
+
+	/* Set when the account is changed, the account is only written once it is dirty. */
+	bool IsDirty;
+	time_t DirtyTime;
 } CachedAccount;
 
+typedef struct FlushedRecordStruct
+{
+	unsigned long long ID;
+	char* Data;
+	size_t Length;
+} FlushedRecord;
+
+/* Indexes of the accounts read by a single loader worker, merged into the context's indexes once all are read. */
+typedef struct AccountIndexPartStruct
+{
+	IDCodepointHashMap NameMap;
+	IDTermDictionary NameTerms;
+	IDCodepointHashMap EmailMap;
+	GHDFArena Arena;
+	size_t ReadAccountCount;
+} AccountIndexPart;
+
+typedef struct AccountIndexBuildStruct
+{
+	DBAccountContext* Context;
+	AccountIndexPart* Parts;
+} AccountIndexBuild;
+
 typedef struct UnverifiedUserAccountStruct
 {
 	int VerificationCode;
@@ -353,6 +418,15 @@ static void AccountDeconstruct(UserAccount* account)
 	}
 }
 
+/* For accounts read with ReadIndexedAccountFromDatabase, the strings belong to the arena they were decoded into. */
+static void AccountDeconstructArenaDecoded(UserAccount* account)
+{
+	account->Name = NULL;
+	account->Surname = NULL;
+	account->Email = NULL;
+	AccountDeconstruct(account);
+}
+
 static Error AccountCreateNew(DBAccountContext* context,
 	UserAccount* account,
 	const char* name,
@@ -644,107 +718,79 @@ static void RefreshSessions(DBAccountContext* context)
 
 
 /* Account loading and saving. */
-static Error ReadAccountFromCompoundFailCleanup(UserAccount* account, Error errorToReturn)
+static Error ReadPasswordHashGHDF(GHDFReader* reader, GHDFEntryInfo* info, UserAccount* record)
 {
-	AccountDeconstruct(account);
-	return errorToReturn;
-}
-
-static Error ReadAccountFromCompound(UserAccount* account, unsigned long long accountID, GHDFCompound* compound)
-{
-	GHDFEntry* Entry;
-	AccountSetDefaultValues(account);
-
-	// ID.
-	Error ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_ACCOUNT_ID, &Entry, GHDFType_ULong, "Account ID");
+	unsigned int HashLength;
+	Error ReturnedError = GHDFReader_ReadArrayHeader(reader, info, GHDFType_ULong, &HashLength);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
-	}
-	if (Entry->Value.SingleValue.ULong != accountID)
-	{
-		char Message[128];
-		snprintf(Message, sizeof(Message), "Stored and provided ID mismatch (Stored: %llu, provided: %llu)",
-			Entry->Value.SingleValue.ULong, accountID);
-		return ReadAccountFromCompoundFailCleanup(account, Error_CreateError(ErrorCode_DatabaseError, Message));
+		return ReturnedError;
 	}
-	account->ID = accountID;
-
-	// Name.
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_ACCOUNT_NAME, &Entry, GHDFType_String, "Account Name");
-	if (ReturnedError.Code != ErrorCode_Success)
+	if (HashLength != PASSWORD_HASH_LENGTH)
 	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, "Account password hash has an invalid length.");
 	}
-	account->Name = String_CreateCopy(Entry->Value.SingleValue.String);
 
-	// Surname
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_ACCOUNT_SURNAME, &Entry, GHDFType_String, "Account Surname");
+	ReturnedError = GHDFReader_ReadArrayElements(reader, GHDFType_ULong, record->PasswordHash, PASSWORD_HASH_LENGTH);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
+		return ReturnedError;
 	}
-	account->Surname = String_CreateCopy(Entry->Value.SingleValue.String);
+	return GHDFReader_EndValue(reader, info);
+}
 
-	// Email.
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_ACCOUNT_EMAIL, &Entry, GHDFType_String, "Account Email");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
-	}
-	account->Email = String_CreateCopy(Entry->Value.SingleValue.String);
+/* Decodes the account's entries straight into the struct, entries outside of the mask are skipped without being decoded.
+* On failure the account may be partially filled and still has to be deconstructed. */
+static Error ReadAccountGHDF(GHDFReader* reader,
+	unsigned int entryCount,
+	SchemaEntrySet entryMask,
+	unsigned long long accountID,
+	UserAccount* record)
+{
+	Error ReturnedError = Error_CreateSuccess();
+	SchemaEntrySet FoundEntries = 0;
 
-	// Password hash
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_ACCOUNT_PASSWORD, &Entry,
-		GHDFType_ULong | GHDF_TYPE_ARRAY_BIT, "Account Password Hash");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
-	}
-	if (Entry->Value.ValueArray.Size != PASSWORD_HASH_LENGTH)
-	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
-	}
-	for (int i = 0; i < PASSWORD_HASH_LENGTH; i++)
+	for (unsigned int i = 0; (i < entryCount) && (ReturnedError.Code == ErrorCode_Success); i++)
 	{
-		account->PasswordHash[i] = Entry->Value.ValueArray.Array[i].Long;
-	}
-
+		GHDFEntryInfo Info;
+		ReturnedError = Schema_ReadEntryInfo(reader, &Info, &FoundEntries);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			break;
+		}
 
-	// Posts.
-	ReturnedError = GHDFCompound_GetVerifiedOptionalEntry(compound, ENTRY_ID_ACCOUNT_POSTS, &Entry,
-		GHDFType_ULong | GHDF_TYPE_ARRAY_BIT, "Account Post Array");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
-	}
-	if (Entry)
-	{
-		unsigned long long* PostIDs = (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * Entry->Value.ValueArray.Size);
-		for (unsigned int i = 0; i < Entry->Value.ValueArray.Size; i++)
+		if (!SchemaEntrySet_Contains(entryMask, Info.ID))
+		{
+			ReturnedError = GHDFReader_SkipValue(reader, &Info);
+		}
+		else if (Info.ID == ENTRY_ID_ACCOUNT_PASSWORD)
+		{
+			ReturnedError = ReadPasswordHashGHDF(reader, &Info, record);
+		}
+		else ACCOUNT_SCHEMA(SCHEMA_READ_FIELD, SCHEMA_READ_LIST)
 		{
-			PostIDs[i] = Entry->Value.ValueArray.Array[i].ULong;
+			ReturnedError = GHDFReader_SkipValue(reader, &Info);
 		}
-		account->Posts = PostIDs;
-		account->PostCount = Entry->Value.ValueArray.Size;
 	}
 
-	// Creation time.
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_ACCOUNT_CREATION_TIME, &Entry, GHDFType_Long, "Account Creation Time");
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
+		return ReturnedError;
 	}
-	account->CreationTime = Entry->Value.SingleValue.Long;
 
-	// IsAdmin field.
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_ACCOUNT_IS_ADMIN, &Entry, GHDFType_Bool, "Account IsAdmin");
+	SchemaEntrySet RequiredEntries = SchemaEntryBit(ENTRY_ID_ACCOUNT_PASSWORD) ACCOUNT_SCHEMA(SCHEMA_REQUIRED_FIELD, SCHEMA_REQUIRED_LIST);
+	ReturnedError = Schema_VerifyRequiredEntries(FoundEntries, entryMask & RequiredEntries, "Account");
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
-		return ReadAccountFromCompoundFailCleanup(account, ReturnedError);
+		return ReturnedError;
 	}
-	account->IsAdmin = Entry->Value.SingleValue.Bool;
 
+	if (record->ID != accountID)
+	{
+		char Message[128];
+		snprintf(Message, sizeof(Message), "Stored and provided ID mismatch (Stored: %llu, provided: %llu)", record->ID, accountID);
+		return Error_CreateError(ErrorCode_DatabaseError, Message);
+	}
 	return Error_CreateSuccess();
 }
 
@@ -771,9 +817,58 @@ static Error ReadAccountImageFromDatabase(DBAccountContext* context, UserAccount
 	return ReturnedError;
 }
 
+static bool DecodeAccountFromDatabase(DBAccountContext* context,
+	UserAccount* account,
+	unsigned long long id,
+	const char* data,
+	size_t dataLength,
+	Error* error)
+{
+	AccountSetDefaultValues(account);
+	GHDFReader Reader;
+	unsigned int EntryCount;
+	*error = GHDFReader_Open(&Reader, data, dataLength, NULL, &EntryCount);
+	if (error->Code == ErrorCode_Success)
+	{
+		*error = ReadAccountGHDF(&Reader, EntryCount, SCHEMA_ALL_ENTRIES, id, account);
+	}
+	if (error->Code != ErrorCode_Success)
+	{
+		AccountDeconstruct(account);
+		return false;
+	}
+
+	*error = ReadAccountImageFromDatabase(context, account);
+	if (error->Code != ErrorCode_Success)
+	{
+		AccountDeconstruct(account);
+		return false;
+	}
+
+	return true;
+}
+
 static bool ReadAccountFromDatabase(DBAccountContext* context, UserAccount* account, unsigned long long id, Error* error)
 {
 	*error = Error_CreateSuccess();
+	if (context->RecordStore)
+	{
+		char* Data;
+		size_t DataLength;
+		bool IsFound;
+		*error = Store_Get(context->RecordStore, id, NULL, &Data, &DataLength, &IsFound);
+		if (error->Code != ErrorCode_Success)
+		{
+			return false;
+		}
+		if (IsFound)
+		{
+			bool IsRead = DecodeAccountFromDatabase(context, account, id, Data, DataLength, error);
+			Memory_Free(Data);
+			return IsRead;
+		}
+	}
+
 	const char* FilePath = GetPathToIDFile(context, id, ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
 	if (!File_Exists(FilePath))
 	{
@@ -781,32 +876,78 @@ static bool ReadAccountFromDatabase(DBAccountContext* context, UserAccount* acco
 		return false;
 	}
 
-	GHDFCompound Compound;
-	Error ReturnedError = GHDFCompound_ReadFromFile(FilePath, &Compound);
+	FileMapping Mapping;
+	*error = File_MapRead(FilePath, &Mapping);
 	Memory_Free((char*)FilePath);
-	if (ReturnedError.Code != ErrorCode_Success)
+	if (error->Code != ErrorCode_Success)
 	{
-		*error = ReturnedError;
 		return false;
 	}
 
-	ReturnedError = ReadAccountFromCompound(account, id, &Compound);
-	GHDFCompound_Deconstruct(&Compound);
-	if (ReturnedError.Code != ErrorCode_Success) 
-	{
-		*error = ReturnedError;
-		return false;
+	bool IsRead = DecodeAccountFromDatabase(context, account, id, Mapping.Data, Mapping.Length, error);
+	File_Unmap(&Mapping);
+	return IsRead;
+}
+
+/* Reads only what the search indices need, the rest of the file is skipped without being decoded. */
+static bool ReadIndexedAccountFromDatabase(DBAccountContext* context, UserAccount* account, unsigned long long id, GHDFArena* arena, Error* error)
+{
+	*error = Error_CreateSuccess();
+	GHDFLazyCompound LazyCompound;
+	bool IsFound = false;
+	if (context->RecordStore)
+	{
+		char* Data;
+		size_t DataLength;
+		*error = Store_Get(context->RecordStore, id, arena, &Data, &DataLength, &IsFound);
+		if ((error->Code == ErrorCode_Success) && IsFound)
+		{
+			*error = GHDFLazyCompound_Open(Data, DataLength, arena, &LazyCompound);
+		}
+		if (error->Code != ErrorCode_Success)
+		{
+			return false;
+		}
 	}
-	
-	ReturnedError = ReadAccountImageFromDatabase(context, account);
-	if (ReturnedError.Code != ErrorCode_Success)
+
+	if (!IsFound)
 	{
-		*error = ReturnedError;
-		return false;
+		const char* FilePath = GetPathToIDFile(context, id, ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
+		if (!File_Exists(FilePath))
+		{
+			Memory_Free((char*)FilePath);
+			return false;
+		}
+
+		if (context->UpgradeFileFormat)
+		{
+			// The build may run while the account is being written.
+			bool IsUpgraded;
+			ThreadLock_Lock(&context->_recordWriteLock);
+			*error = GHDFCompound_UpgradeFile(FilePath, context->SyncWrites, &IsUpgraded);
+			ThreadLock_Unlock(&context->_recordWriteLock);
+			if (error->Code != ErrorCode_Success)
+			{
+				Memory_Free((char*)FilePath);
+				return false;
+			}
+		}
+
+		*error = GHDFLazyCompound_OpenFile(FilePath, arena, &LazyCompound);
+		Memory_Free((char*)FilePath);
+		if (error->Code != ErrorCode_Success)
+		{
+			return false;
+		}
 	}
 
-	*error = Error_CreateSuccess();
-	return true;
+	AccountSetDefaultValues(account);
+	GHDFReader Reader;
+	GHDFLazyCompound_BeginReading(&LazyCompound, &Reader);
+	SchemaEntrySet EntryMask = SchemaEntryBit(ENTRY_ID_ACCOUNT_ID) | SchemaEntryBit(ENTRY_ID_ACCOUNT_NAME)
+		| SchemaEntryBit(ENTRY_ID_ACCOUNT_SURNAME) | SchemaEntryBit(ENTRY_ID_ACCOUNT_EMAIL);
+	*error = ReadAccountGHDF(&Reader, LazyCompound.Count, EntryMask, id, account);
+	return error->Code == ErrorCode_Success;
 }
 
 static Error WriteImageToDatabase(DBAccountContext* context, Image* image, unsigned long long id)
@@ -822,201 +963,677 @@ static Error WriteImageToDatabase(DBAccountContext* context, Image* image, unsig
 	return Error_CreateSuccess();
 }
 
-static Error WriteAccountToDatabase(DBAccountContext* context, UserAccount* account)
+static void WriteAccountGHDF(UserAccount* record, GHDFBuffer* buffer)
 {
-	GHDFCompound Compound;
-	GHDFCompound_Construct(&Compound, COMPOUND_DEFAULT_CAPACITY);
-	GHDFPrimitive SingleValue;
+	GHDFBuffer_WriteCompoundHeader(buffer, 1 ACCOUNT_SCHEMA(SCHEMA_COUNT_FIELD, SCHEMA_COUNT_LIST));
+	ACCOUNT_SCHEMA(SCHEMA_WRITE_FIELD, SCHEMA_WRITE_LIST)
+	GHDFBuffer_WriteArrayEntry(buffer, GHDFType_ULong, ENTRY_ID_ACCOUNT_PASSWORD, record->PasswordHash, PASSWORD_HASH_LENGTH);
+}
 
-	SingleValue.String = String_CreateCopy(account->Name);
-	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_String, ENTRY_ID_ACCOUNT_NAME, SingleValue);
-	SingleValue.String = String_CreateCopy(account->Surname);
-	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_String, ENTRY_ID_ACCOUNT_SURNAME, SingleValue);
-	SingleValue.String = String_CreateCopy(account->Email);
-	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_String, ENTRY_ID_ACCOUNT_EMAIL, SingleValue);
+/* Store writes only last once flushed, until then the mutation log holds the changes. Called with the write lock held. */
+static Error WriteAccountData(DBAccountContext* context, unsigned long long id, const char* data, size_t dataLength)
+{
+	unsigned long long StorageStartTime = AccessLog_BeginStorage();
+	const char* AccountPath = GetPathToIDFile(context, id, ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
+	Error ReturnedError;
+	if (context->RecordStore)
+	{
+		ReturnedError = Store_Put(context->RecordStore, id, data, dataLength);
+		if ((ReturnedError.Code == ErrorCode_Success) && File_Exists(AccountPath))
+		{
+			// Accounts still in their own file from before the store was enabled are moved over once written.
+			RecordIDList_Add(&context->_movedRecordIDs, id);
+		}
+	}
+	else
+	{
+		GHDFBuffer Buffer = { (char*)data, dataLength, dataLength };
+		ReturnedError = GHDFBuffer_WriteToFile(&Buffer, AccountPath, context->SyncWrites);
+	}
+	Memory_Free((char*)AccountPath);
+	AccessLog_EndStorage(StorageStartTime);
+	return ReturnedError;
+}
 
-	GHDFPrimitive* PrimitiveArray = (GHDFPrimitive*)Memory_SafeMalloc(sizeof(GHDFPrimitive) * PASSWORD_HASH_LENGTH);
-	for (int i = 0; i < PASSWORD_HASH_LENGTH; i++)
+static Error WriteAccountRecord(DBAccountContext* context, UserAccount* account)
+{
+	GHDFBuffer* Buffer = GHDFBuffer_GetThreadBuffer();
+	GHDFBuffer_BeginFile(Buffer);
+	WriteAccountGHDF(account, Buffer);
+	return WriteAccountData(context, account->ID, Buffer->Data, Buffer->Length);
+}
+
+static Error FlushAccountRecords(DBAccountContext* context)
+{
+	if (!context->RecordStore)
 	{
-		PrimitiveArray[i].ULong = account->PasswordHash[i];
+		return Error_CreateSuccess();
 	}
-	GHDFCompound_AddArrayEntry(&Compound, GHDFType_ULong, ENTRY_ID_ACCOUNT_PASSWORD, PrimitiveArray, PASSWORD_HASH_LENGTH);
 
-	if (account->PostCount > 0)
+	unsigned long long StorageStartTime = AccessLog_BeginStorage();
+	Error ReturnedError = Store_Flush(context->RecordStore);
+	if (ReturnedError.Code == ErrorCode_Success)
 	{
-		PrimitiveArray = (GHDFPrimitive*)Memory_SafeMalloc(sizeof(GHDFPrimitive) * account->PostCount);
-		for (unsigned int i = 0; i < account->PostCount; i++)
+		for (size_t i = 0; i < context->_movedRecordIDs.Count; i++)
 		{
-			PrimitiveArray[i].ULong = account->Posts[i];
+			const char* AccountPath = GetPathToIDFile(context, context->_movedRecordIDs.IDs[i], ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
+			File_Delete(AccountPath);
+			Memory_Free((char*)AccountPath);
 		}
-		GHDFCompound_AddArrayEntry(&Compound, GHDFType_ULong, ENTRY_ID_ACCOUNT_POSTS, PrimitiveArray, account->PostCount);
+		context->_movedRecordIDs.Count = 0;
 	}
-	
-	SingleValue.Long = account->CreationTime;
-	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_Long, ENTRY_ID_ACCOUNT_CREATION_TIME, SingleValue);
-	SingleValue.ULong = account->ID;
-	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_ULong, ENTRY_ID_ACCOUNT_ID, SingleValue);
-	SingleValue.Bool = account->IsAdmin;
-	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_Bool, ENTRY_ID_ACCOUNT_IS_ADMIN, SingleValue);
-
-	const char* AccountPath = GetPathToIDFile(context, account->ID, ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
-	Error ReturnedError = GHDFCompound_WriteToFile(AccountPath, &Compound);
-	Memory_Free((char*)AccountPath);
-	GHDFCompound_Deconstruct(&Compound);
+	AccessLog_EndStorage(StorageStartTime);
 	return ReturnedError;
 }
 
+static bool IsAccountInDatabase(DBAccountContext* context, unsigned long long id)
+{
+	if (context->RecordStore && Store_Contains(context->RecordStore, id))
+	{
+		return true;
+	}
+
+	const char* Path = GetPathToIDFile(context, id, ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
+	bool IsFileFound = File_Exists(Path);
+	Memory_Free((char*)Path);
+	return IsFileFound;
+}
+
 static void DeleteAccountFromDatabase(DBAccountContext* context, unsigned long long id)
 {
 	const char* Path = GetPathToIDFile(context, id, ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
 	File_Delete(Path);
 	Memory_Free((char*)Path);
+
+	if (context->RecordStore)
+	{
+		unsigned long long StorageStartTime = AccessLog_BeginStorage();
+		Error ReturnedError = Store_Delete(context->RecordStore, id);
+		AccessLog_EndStorage(StorageStartTime);
+		Error_Deconstruct(&ReturnedError);
+	}
 }
 
 
 /* Hashmap. */
-static void GenerateMetaInfoForSingleAccount(DBAccountContext* context, UserAccount* account)
+static Error SaveMetaInfo(DBAccountContext* context);
+
+static const char* GetPathToIndexSnapshot(DBAccountContext* context)
 {
-	IDCodepointHashMap_AddID(&context->NameMap, account->Name, account->ID);
-	IDCodepointHashMap_AddID(&context->NameMap, account->Surname, account->ID);
-	IDCodepointHashMap_AddID(&context->EmailMap, account->Email, account->ID);
+	return Directory_CombinePaths(context->AccountRootPath, INDEX_SNAPSHOT_FILE_NAME);
 }
 
-static Error GenerateMetaInfoForAccounts(DBAccountContext* context, size_t* readAccountCount)
+/* The saved snapshot no longer matches the indexes, moving to a new generation makes it stale without rewriting it. */
+static void MarkIndexChanged(DBAccountContext* context)
 {
-	unsigned long long MaxIDExclusive = context->AvailableAccountID;
-	size_t ReadAccounts = 0;
-	*readAccountCount = 0;
-	for (unsigned long long ID = DEFAULT_AVAILABLE_ACCOUNT_ID; ID < MaxIDExclusive; ID++)
+	ThreadLock_Lock(&context->_indexSnapshotLock);
+	if (!context->_isIndexSnapshotCurrent)
 	{
-		UserAccount Account;
-		Error ReturnedError;
-		if (!ReadAccountFromDatabase(context, &Account, ID, &ReturnedError))
-		{
-			if (ReturnedError.Code != ErrorCode_Success)
-			{
-				return ReturnedError;
-			}
-			continue;
-		}
-
-		ReadAccounts++;
-		GenerateMetaInfoForSingleAccount(context, &Account);
-
-		AccountDeconstruct(&Account);
+		ThreadLock_Unlock(&context->_indexSnapshotLock);
+		return;
 	}
 
-	*readAccountCount = ReadAccounts;
-	return Error_CreateSuccess();
+	context->_isIndexSnapshotCurrent = false;
+	context->IndexGeneration++;
+	Error ReturnedError = SaveMetaInfo(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		const char* SnapshotPath = GetPathToIndexSnapshot(context);
+		File_Delete(SnapshotPath);
+		Memory_Free((char*)SnapshotPath);
+		Error_Deconstruct(&ReturnedError);
+	}
+	ThreadLock_Unlock(&context->_indexSnapshotLock);
 }
 
-static void ClearMetaInfoForAccount(DBAccountContext* context, UserAccount* account)
+/* Writes the indexes under a new generation, which only becomes current once the meta-info holding it is saved. */
+static Error SaveIndexSnapshot(DBAccountContext* context)
 {
-	IDCodepointHashMap_RemoveID(&context->NameMap, account->Name, account->ID);
-	IDCodepointHashMap_RemoveID(&context->NameMap, account->Surname, account->ID);
-	IDCodepointHashMap_RemoveID(&context->EmailMap, account->Email, account->ID);
-}
+	// Indexes which are still being built would be loaded as if they were whole.
+	ThreadLock_Lock(&context->_indexSnapshotLock);
+	if (context->_isIndexSnapshotCurrent || (IndexBuild_GetState(&context->IndexBuilder) != IndexBuildState_Complete))
+	{
+		ThreadLock_Unlock(&context->_indexSnapshotLock);
+		return Error_CreateSuccess();
+	}
 
+	IndexSnapshotWriter Writer;
+	IndexSnapshotWriter_Construct(&Writer, context->IndexGeneration + 1);
+	IDCodepointHashMap_WriteSnapshot(&context->NameMap, &Writer);
+	IDTermDictionary_WriteSnapshot(&context->NameTerms, &Writer);
+	IDCodepointHashMap_WriteSnapshot(&context->EmailMap, &Writer);
 
-/* Account cache. */
-static void InitializeAccountCache(DBAccountContext* context)
-{
-	context->AccountCache = (CachedAccount*)Memory_SafeMalloc(sizeof(CachedAccount) * ACCOUNT_CACHE_CAPACITY);
-	for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
+	const char* SnapshotPath = GetPathToIndexSnapshot(context);
+	Error ReturnedError = IndexSnapshotWriter_WriteToFile(&Writer, SnapshotPath, context->SyncWrites);
+	Memory_Free((char*)SnapshotPath);
+	IndexSnapshotWriter_Deconstruct(&Writer);
+
+	if (ReturnedError.Code == ErrorCode_Success)
 	{
-		context->AccountCache[i].LastAccessTime = ACCOUNT_CACHE_UNLOADED_TIME;
+		context->IndexGeneration++;
+		ReturnedError = SaveMetaInfo(context);
+		context->_isIndexSnapshotCurrent = ReturnedError.Code == ErrorCode_Success;
 	}
+	ThreadLock_Unlock(&context->_indexSnapshotLock);
+	return ReturnedError;
 }
 
-static UserAccount* TryGetAccountFromCache(DBAccountContext* context, unsigned long long id)
+/* Fills the empty indexes from the snapshot if it matches the meta-info's generation. */
+static bool LoadIndexSnapshot(DBAccountContext* context)
 {
-	for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
+	const char* SnapshotPath = GetPathToIndexSnapshot(context);
+	IndexSnapshotReader Reader;
+	bool IsLoaded = IndexSnapshotReader_Open(&Reader, SnapshotPath, context->IndexGeneration);
+	Memory_Free((char*)SnapshotPath);
+	if (!IsLoaded)
 	{
-		CachedAccount* TargetCachedAccount = (context->AccountCache + i);
-		if ((TargetCachedAccount->LastAccessTime != ACCOUNT_CACHE_UNLOADED_TIME) && (TargetCachedAccount->Account.ID == id))
-		{
-			TargetCachedAccount->LastAccessTime = time(NULL);
-			return &TargetCachedAccount->Account;
-		}
+		return false;
 	}
 
-	return NULL;
-}
-
-static Error ClearCacheSpotByIndex(DBAccountContext* context, size_t index, bool saveAccount)
-{
-	CachedAccount* AccountCached = context->AccountCache + index;
-	if (AccountCached->LastAccessTime != ACCOUNT_CACHE_UNLOADED_TIME)
+	IsLoaded = IDCodepointHashMap_ReadSnapshot(&context->NameMap, &Reader)
+		&& IDTermDictionary_ReadSnapshot(&context->NameTerms, &Reader)
+		&& IDCodepointHashMap_ReadSnapshot(&context->EmailMap, &Reader);
+	IsLoaded = IndexSnapshotReader_Close(&Reader) && IsLoaded;
+	if (!IsLoaded)
 	{
-		if (saveAccount)
-		{
-			Error ReturnedError = WriteAccountToDatabase(context, &AccountCached->Account);
-			if (ReturnedError.Code != ErrorCode_Success)
-			{
-				return ReturnedError;
-			}
-		}
-		AccountDeconstruct(&AccountCached->Account);
-		AccountCached->LastAccessTime = ACCOUNT_CACHE_UNLOADED_TIME;
+		IDCodepointHashMap_Clear(&context->NameMap);
+		IDTermDictionary_Clear(&context->NameTerms);
+		IDCodepointHashMap_Clear(&context->EmailMap);
 	}
-	
-	return Error_CreateSuccess();
+
+	context->_isIndexSnapshotCurrent = IsLoaded;
+	return IsLoaded;
 }
 
-static CachedAccount* GetCacheSpotForAccount(DBAccountContext* context, Error* error)
+static void GenerateMetaInfoForSingleAccount(DBAccountContext* context, UserAccount* account)
 {
-	time_t LowestLoadTime = LLONG_MAX;
-	int LowestLoadTimeIndex = 0;
-
-	for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
+	IndexBuild_BeginRecordChange(&context->IndexBuilder, account->ID);
+	IDCodepointHashMap_AddID(&context->NameMap, account->Name, account->ID);
+	IDCodepointHashMap_AddID(&context->NameMap, account->Surname, account->ID);
+	IDTermDictionary_AddID(&context->NameTerms, account->Name, account->ID);
+	IDTermDictionary_AddID(&context->NameTerms, account->Surname, account->ID);
+	IDCodepointHashMap_AddID(&context->EmailMap, account->Email, account->ID);
+	if (context->_isReindexing)
 	{
-		if (context->AccountCache[i].LastAccessTime < LowestLoadTime)
-		{
-			LowestLoadTimeIndex = i;
-			LowestLoadTime = context->AccountCache[i].LastAccessTime;
-		}
+		IDCodepointHashMap_AddID(&context->_reindexNameMap, account->Name, account->ID);
+		IDCodepointHashMap_AddID(&context->_reindexNameMap, account->Surname, account->ID);
+		IDTermDictionary_AddID(&context->_reindexNameTerms, account->Name, account->ID);
+		IDTermDictionary_AddID(&context->_reindexNameTerms, account->Surname, account->ID);
+		IDCodepointHashMap_AddID(&context->_reindexEmailMap, account->Email, account->ID);
 	}
-
-	*error = ClearCacheSpotByIndex(context, LowestLoadTimeIndex, true);
-	return context->AccountCache + LowestLoadTimeIndex;
+	IndexBuild_EndRecordChange(&context->IndexBuilder);
+	MarkIndexChanged(context);
 }
 
-static CachedAccount* LoadAccountIntoCache(DBAccountContext* context, unsigned long long id, Error* error)
+/* Moves a changed name or surname in the name indexes. The unchanged one may share codepoints and terms with the old value,
+* so it is added again after the old value's removal. */
+static void ChangeIndexedName(DBAccountContext* context, unsigned long long id, const char* oldName, const char* newName,
+	const char* otherName)
 {
-	CachedAccount* AccountSpot = GetCacheSpotForAccount(context, error);
-	if (error->Code != ErrorCode_Success)
+	if (IndexBuild_BeginRecordChange(&context->IndexBuilder, id))
 	{
-		return NULL;
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_NAME_MAP, oldName, id);
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_NAME_TERMS, oldName, id);
 	}
-
-	if (!ReadAccountFromDatabase(context , &AccountSpot->Account, id, error))
+	IDCodepointHashMap_RemoveID(&context->NameMap, oldName, id);
+	IDTermDictionary_RemoveID(&context->NameTerms, oldName, id);
+	IDCodepointHashMap_AddID(&context->NameMap, newName, id);
+	IDCodepointHashMap_AddID(&context->NameMap, otherName, id);
+	IDTermDictionary_AddID(&context->NameTerms, newName, id);
+	IDTermDictionary_AddID(&context->NameTerms, otherName, id);
+	if (context->_isReindexing)
 	{
-		AccountSpot->LastAccessTime = ACCOUNT_CACHE_UNLOADED_TIME;
-		return NULL;
+		IDCodepointHashMap_RemoveID(&context->_reindexNameMap, oldName, id);
+		IDTermDictionary_RemoveID(&context->_reindexNameTerms, oldName, id);
+		IDCodepointHashMap_AddID(&context->_reindexNameMap, newName, id);
+		IDCodepointHashMap_AddID(&context->_reindexNameMap, otherName, id);
+		IDTermDictionary_AddID(&context->_reindexNameTerms, newName, id);
+		IDTermDictionary_AddID(&context->_reindexNameTerms, otherName, id);
 	}
-
-	AccountSpot->LastAccessTime = time(NULL);
-	*error = Error_CreateSuccess();
-	return AccountSpot;
+	IndexBuild_EndRecordChange(&context->IndexBuilder);
+	MarkIndexChanged(context);
 }
 
-static Error SaveAllCachedAccountsToDatabase(DBAccountContext* context)
+/* Deferred removals belong to the indexes the build merges into. */
+static void RemoveDeferredIndexEntry(int index, const char* string, unsigned long long id, void* argument)
 {
-	for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
+	DBAccountContext* Context = (DBAccountContext*)argument;
+	bool IsReindex = Context->_isReindexing != 0;
+	switch (index)
 	{
-		if (context->AccountCache[i].LastAccessTime == ACCOUNT_CACHE_UNLOADED_TIME)
+		case INDEX_NAME_MAP:
+			IDCodepointHashMap_RemoveID(IsReindex ? &Context->_reindexNameMap : &Context->NameMap, string, id);
+			break;
+
+		case INDEX_NAME_TERMS:
+			IDTermDictionary_RemoveID(IsReindex ? &Context->_reindexNameTerms : &Context->NameTerms, string, id);
+			break;
+
+		case INDEX_EMAIL_MAP:
+			IDCodepointHashMap_RemoveID(IsReindex ? &Context->_reindexEmailMap : &Context->EmailMap, string, id);
+			break;
+	}
+}
+
+/* Listing stored accounts. */
+static void ListAccountIDs(DBAccountContext* context, unsigned long long firstID, unsigned long long lastID, RecordIDList* list)
+{
+	char* EntriesPath = Directory_CombinePaths(context->AccountRootPath, ACCOUNT_ENTRIES_DIR_NAME);
+	RecordIDList_ListStored(list, context->RecordStore, EntriesPath, GHDF_FILE_EXTENSION, ENTRY_FOLDER_NAME_DIVIDER,
+		firstID, lastID);
+	Memory_Free(EntriesPath);
+}
+
+static Error LoadAccountIntoIndexPart(unsigned long long id, size_t workerIndex, void* argument)
+{
+	AccountIndexBuild* Build = (AccountIndexBuild*)argument;
+	AccountIndexPart* Part = Build->Parts + workerIndex;
+	if (Atomic_Load(&Build->Context->_isClosing))
+	{
+		return Error_CreateError(ErrorCode_IllegalState, "Account index build was stopped by the server closing.");
+	}
+
+	UserAccount Account;
+	Error ReturnedError;
+	if (!ReadIndexedAccountFromDatabase(Build->Context, &Account, id, &Part->Arena, &ReturnedError))
+	{
+		GHDFArena_Clear(&Part->Arena);
+		return ReturnedError;
+	}
+	Part->ReadAccountCount++;
+
+	// An account changed since the build began is already in the context's indexes.
+	if (IndexBuild_ClaimRecord(&Build->Context->IndexBuilder, id))
+	{
+		IDCodepointHashMap_AddID(&Part->NameMap, Account.Name, Account.ID);
+		IDCodepointHashMap_AddID(&Part->NameMap, Account.Surname, Account.ID);
+		IDTermDictionary_AddID(&Part->NameTerms, Account.Name, Account.ID);
+		IDTermDictionary_AddID(&Part->NameTerms, Account.Surname, Account.ID);
+		IDCodepointHashMap_AddID(&Part->EmailMap, Account.Email, Account.ID);
+	}
+
+	AccountDeconstructArenaDecoded(&Account);
+	GHDFArena_Clear(&Part->Arena);
+	return Error_CreateSuccess();
+}
+
+/* The accounts listed when the index build began are read and indexed by a pool of workers, each into its own indexes
+* so that they never wait on each other. */
+static Error GenerateMetaInfoForAccounts(DBAccountContext* context, size_t workerCount, size_t* readAccountCount)
+{
+	*readAccountCount = 0;
+	bool IsReindex = Atomic_Load(&context->_isReindexing) != 0;
+	IDCodepointHashMap* NameMap = IsReindex ? &context->_reindexNameMap : &context->NameMap;
+	IDTermDictionary* NameTerms = IsReindex ? &context->_reindexNameTerms : &context->NameTerms;
+	IDCodepointHashMap* EmailMap = IsReindex ? &context->_reindexEmailMap : &context->EmailMap;
+	AccountIndexBuild Build;
+	Build.Context = context;
+	Build.Parts = (AccountIndexPart*)Memory_SafeMalloc(sizeof(AccountIndexPart) * workerCount);
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		IDCodepointHashMap_Construct(&Build.Parts[i].NameMap);
+		IDTermDictionary_Construct(&Build.Parts[i].NameTerms);
+		IDCodepointHashMap_Construct(&Build.Parts[i].EmailMap);
+		Build.Parts[i].NameMap.FoldDiacritics = context->NameMap.FoldDiacritics;
+		Build.Parts[i].NameTerms.FoldDiacritics = context->NameTerms.FoldDiacritics;
+		Build.Parts[i].EmailMap.FoldDiacritics = context->EmailMap.FoldDiacritics;
+		GHDFArena_Construct(&Build.Parts[i].Arena, GHDF_ARENA_DEFAULT_BLOCK_SIZE);
+		Build.Parts[i].ReadAccountCount = 0;
+	}
+
+	Error ReturnedError = BulkLoader_Run(context->IndexBuilder.IDs, context->IndexBuilder.IDCount, workerCount,
+		LoadAccountIntoIndexPart, &Build);
+
+	size_t ReadAccountCount = 0;
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		AccountIndexPart* Part = Build.Parts + i;
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			IDCodepointHashMap_Merge(NameMap, &Part->NameMap);
+			IDTermDictionary_Merge(NameTerms, &Part->NameTerms);
+			IDCodepointHashMap_Merge(EmailMap, &Part->EmailMap);
+			ReadAccountCount += Part->ReadAccountCount;
+		}
+		IDCodepointHashMap_Deconstruct(&Part->NameMap);
+		IDTermDictionary_Deconstruct(&Part->NameTerms);
+		IDCodepointHashMap_Deconstruct(&Part->EmailMap);
+		GHDFArena_Deconstruct(&Part->Arena);
+	}
+	Memory_Free(Build.Parts);
+
+	// A failed reindex leaves the live indexes whole.
+	IndexBuild_Finish(&context->IndexBuilder, IsReindex || (ReturnedError.Code == ErrorCode_Success), RemoveDeferredIndexEntry, context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	MarkIndexChanged(context);
+	*readAccountCount = ReadAccountCount;
+	return Error_CreateSuccess();
+}
+
+static void ClearMetaInfoForAccount(DBAccountContext* context, UserAccount* account)
+{
+	if (IndexBuild_BeginRecordChange(&context->IndexBuilder, account->ID))
+	{
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_NAME_MAP, account->Name, account->ID);
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_NAME_MAP, account->Surname, account->ID);
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_NAME_TERMS, account->Name, account->ID);
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_NAME_TERMS, account->Surname, account->ID);
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_EMAIL_MAP, account->Email, account->ID);
+	}
+	IDCodepointHashMap_RemoveID(&context->NameMap, account->Name, account->ID);
+	IDCodepointHashMap_RemoveID(&context->NameMap, account->Surname, account->ID);
+	IDTermDictionary_RemoveID(&context->NameTerms, account->Name, account->ID);
+	IDTermDictionary_RemoveID(&context->NameTerms, account->Surname, account->ID);
+	IDCodepointHashMap_RemoveID(&context->EmailMap, account->Email, account->ID);
+	if (context->_isReindexing)
+	{
+		IDCodepointHashMap_RemoveID(&context->_reindexNameMap, account->Name, account->ID);
+		IDCodepointHashMap_RemoveID(&context->_reindexNameMap, account->Surname, account->ID);
+		IDTermDictionary_RemoveID(&context->_reindexNameTerms, account->Name, account->ID);
+		IDTermDictionary_RemoveID(&context->_reindexNameTerms, account->Surname, account->ID);
+		IDCodepointHashMap_RemoveID(&context->_reindexEmailMap, account->Email, account->ID);
+	}
+	IndexBuild_EndRecordChange(&context->IndexBuilder);
+	MarkIndexChanged(context);
+}
+
+/* Swaps the indexes filled by a reindex in for the live ones, or drops them if the reindex failed. */
+static void EndReindex(DBAccountContext* context, bool isSuccessful)
+{
+	IndexBuild_LockChanges(&context->IndexBuilder);
+	if (isSuccessful)
+	{
+		IDCodepointHashMap_Replace(&context->NameMap, &context->_reindexNameMap);
+		IDTermDictionary_Replace(&context->NameTerms, &context->_reindexNameTerms);
+		IDCodepointHashMap_Replace(&context->EmailMap, &context->_reindexEmailMap);
+	}
+	else
+	{
+		IDCodepointHashMap_Deconstruct(&context->_reindexNameMap);
+		IDTermDictionary_Deconstruct(&context->_reindexNameTerms);
+		IDCodepointHashMap_Deconstruct(&context->_reindexEmailMap);
+	}
+	Atomic_Store(&context->_isReindexing, 0);
+	IndexBuild_UnlockChanges(&context->IndexBuilder);
+
+	if (isSuccessful)
+	{
+		MarkIndexChanged(context);
+	}
+}
+
+/* Builds the indexes while the server is already serving, then saves them so that the next start can load them. */
+static void RunIndexBuild(void* argument)
+{
+	ServerContext* Server = (ServerContext*)argument;
+	DBAccountContext* Context = Server->AccountContext;
+
+	size_t ReadAccountCount;
+	bool IsReindex = Atomic_Load(&Context->_isReindexing) != 0;
+	unsigned long long ReadStartTime = Time_GetMicroseconds();
+	Error ReturnedError = GenerateMetaInfoForAccounts(Context, Context->_indexBuildWorkerCount, &ReadAccountCount);
+	if (IsReindex)
+	{
+		EndReindex(Context, ReturnedError.Code == ErrorCode_Success);
+	}
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		if (!Atomic_Load(&Context->_isClosing))
+		{
+			Logger_LogError(Server->Logger, ReturnedError.Message);
+			Logger_LogError(Server->Logger, IsReindex ? "Failed to rebuild account indexes, lookups keep using the old ones."
+				: "Failed to build account indexes, searching accounts stays unavailable.");
+		}
+		Error_Deconstruct(&ReturnedError);
+		return;
+	}
+
+	char Message[128];
+	snprintf(Message, sizeof(Message), "Read %llu accounts while %s indexes in the background (%.0f files/s).",
+		(unsigned long long)ReadAccountCount, IsReindex ? "rebuilding" : "building", Time_GetRatePerSecond(ReadAccountCount, ReadStartTime));
+	Logger_LogInfo(Server->Logger, Message);
+
+	ReturnedError = SaveIndexSnapshot(Context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Logger_LogWarning(Server->Logger, ReturnedError.Message);
+		Error_Deconstruct(&ReturnedError);
+	}
+}
+
+
+/* Account cache. */
+static void InitializeAccountCache(DBAccountContext* context)
+{
+	context->AccountCache = (CachedAccount*)Memory_SafeMalloc(sizeof(CachedAccount) * ACCOUNT_CACHE_CAPACITY);
+	for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
+	{
+		context->AccountCache[i].LastAccessTime = ACCOUNT_CACHE_UNLOADED_TIME;
+		context->AccountCache[i].IsDirty = false;
+	}
+}
+
+static UserAccount* TryGetAccountFromCache(DBAccountContext* context, unsigned long long id)
+{
+	for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
+	{
+		CachedAccount* TargetCachedAccount = (context->AccountCache + i);
+		if ((TargetCachedAccount->LastAccessTime != ACCOUNT_CACHE_UNLOADED_TIME) && (TargetCachedAccount->Account.ID == id))
+		{
+			TargetCachedAccount->LastAccessTime = time(NULL);
+			return &TargetCachedAccount->Account;
+		}
+	}
+
+	return NULL;
+}
+
+/* Must be called with the cache lock held by everything which changes a cached account.
+* Cached accounts are handed out from their cache spot, so the spot is found from the account's address. */
+static void MarkAccountDirty(DBAccountContext* context, UserAccount* account)
+{
+	uintptr_t Offset = (uintptr_t)account - (uintptr_t)&context->AccountCache[0].Account;
+	if (((Offset % sizeof(CachedAccount)) != 0) || ((Offset / sizeof(CachedAccount)) >= ACCOUNT_CACHE_CAPACITY))
+	{
+		return;
+	}
+
+	CachedAccount* AccountCached = context->AccountCache + (Offset / sizeof(CachedAccount));
+	if (!AccountCached->IsDirty)
+	{
+		AccountCached->IsDirty = true;
+		AccountCached->DirtyTime = time(NULL);
+	}
+}
+
+static Error ClearCacheSpotByIndex(DBAccountContext* context, size_t index, bool saveAccount)
+{
+	CachedAccount* AccountCached = context->AccountCache + index;
+	Error ReturnedError = Error_CreateSuccess();
+
+	ThreadLock_Lock(&context->_recordWriteLock);
+	ThreadLock_Lock(&context->_cacheLock);
+	if (AccountCached->LastAccessTime != ACCOUNT_CACHE_UNLOADED_TIME)
+	{
+		// Accounts which weren't changed since they were last written are dropped without writing anything.
+		if (saveAccount && AccountCached->IsDirty)
+		{
+			ReturnedError = WriteAccountRecord(context, &AccountCached->Account);
+		}
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			LTT_PROBE_CACHE_EVICT(LTT_PROBE_CACHE_ACCOUNT, AccountCached->Account.ID, saveAccount && AccountCached->IsDirty);
+			AccountDeconstruct(&AccountCached->Account);
+			AccountCached->LastAccessTime = ACCOUNT_CACHE_UNLOADED_TIME;
+			AccountCached->IsDirty = false;
+		}
+	}
+	ThreadLock_Unlock(&context->_cacheLock);
+	ThreadLock_Unlock(&context->_recordWriteLock);
+	
+	return ReturnedError;
+}
+
+static CachedAccount* GetCacheSpotForAccount(DBAccountContext* context, Error* error)
+{
+	time_t LowestLoadTime = LLONG_MAX;
+	int LowestLoadTimeIndex = 0;
+
+	for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
+	{
+		if (context->AccountCache[i].LastAccessTime < LowestLoadTime)
+		{
+			LowestLoadTimeIndex = i;
+			LowestLoadTime = context->AccountCache[i].LastAccessTime;
+		}
+	}
+
+	*error = ClearCacheSpotByIndex(context, LowestLoadTimeIndex, true);
+	return context->AccountCache + LowestLoadTimeIndex;
+}
+
+static CachedAccount* LoadAccountIntoCache(DBAccountContext* context, unsigned long long id, Error* error)
+{
+	CachedAccount* AccountSpot = GetCacheSpotForAccount(context, error);
+	if (error->Code != ErrorCode_Success)
+	{
+		return NULL;
+	}
+
+	UserAccount LoadedAccount;
+	unsigned long long StorageStartTime = AccessLog_BeginStorage();
+	bool IsAccountRead = ReadAccountFromDatabase(context , &LoadedAccount, id, error);
+	AccessLog_EndStorage(StorageStartTime);
+	if (!IsAccountRead)
+	{
+		return NULL;
+	}
+
+	ThreadLock_Lock(&context->_cacheLock);
+	AccountSpot->Account = LoadedAccount;
+	AccountSpot->LastAccessTime = time(NULL);
+	AccountSpot->IsDirty = false;
+	ThreadLock_Unlock(&context->_cacheLock);
+	*error = Error_CreateSuccess();
+	return AccountSpot;
+}
+
+static Error SaveAllCachedAccountsToDatabase(DBAccountContext* context)
+{
+	ThreadLock_Lock(&context->_recordWriteLock);
+	ThreadLock_Lock(&context->_cacheLock);
+
+	Error ReturnedError = Error_CreateSuccess();
+	for (int i = 0; (i < ACCOUNT_CACHE_CAPACITY) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		if ((context->AccountCache[i].LastAccessTime == ACCOUNT_CACHE_UNLOADED_TIME) || !context->AccountCache[i].IsDirty)
 		{
 			continue;
 		}
 
-		Error ReturnedError = WriteAccountToDatabase(context, &context->AccountCache[i].Account);
-		if (ReturnedError.Code != ErrorCode_Success)
+		ReturnedError = WriteAccountRecord(context, &context->AccountCache[i].Account);
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = FlushAccountRecords(context);
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
 		{
-			return ReturnedError;
+			context->AccountCache[i].IsDirty = false;
 		}
 	}
 
-	return Error_CreateSuccess();
+	ThreadLock_Unlock(&context->_cacheLock);
+	ThreadLock_Unlock(&context->_recordWriteLock);
+	return ReturnedError;
+}
+
+/* Takes every account which has been dirty for too long, then writes them all with a single flush. */
+static Error WriteOldDirtyAccounts(DBAccountContext* context)
+{
+	FlushedRecord Records[ACCOUNT_CACHE_CAPACITY];
+	size_t RecordCount = 0;
+
+	// Holding the write lock keeps evictions from writing a newer version of an account before this older one.
+	ThreadLock_Lock(&context->_recordWriteLock);
+	ThreadLock_Lock(&context->_cacheLock);
+	time_t CurrentTime = time(NULL);
+	for (int i = 0; i < ACCOUNT_CACHE_CAPACITY; i++)
+	{
+		CachedAccount* AccountCached = context->AccountCache + i;
+		if ((AccountCached->LastAccessTime == ACCOUNT_CACHE_UNLOADED_TIME) || !AccountCached->IsDirty
+			|| ((CurrentTime - AccountCached->DirtyTime) < context->MaxDirtyAge))
+		{
+			continue;
+		}
+
+		GHDFBuffer* Buffer = GHDFBuffer_GetThreadBuffer();
+		GHDFBuffer_BeginFile(Buffer);
+		WriteAccountGHDF(&AccountCached->Account, Buffer);
+		Records[RecordCount].ID = AccountCached->Account.ID;
+		Records[RecordCount].Data = (char*)Memory_SafeMalloc(Buffer->Length);
+		Records[RecordCount].Length = Buffer->Length;
+		Memory_Copy(Buffer->Data, Records[RecordCount].Data, Buffer->Length);
+		RecordCount++;
+		AccountCached->IsDirty = false;
+	}
+	ThreadLock_Unlock(&context->_cacheLock);
+
+	Error ReturnedError = Error_CreateSuccess();
+	for (size_t i = 0; (i < RecordCount) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		ReturnedError = WriteAccountData(context, Records[i].ID, Records[i].Data, Records[i].Length);
+	}
+
+	ThreadLock_Lock(&context->_cacheLock);
+	for (size_t i = 0; i < RecordCount; i++)
+	{
+		for (int CacheIndex = 0; (ReturnedError.Code != ErrorCode_Success) && (CacheIndex < ACCOUNT_CACHE_CAPACITY); CacheIndex++)
+		{
+			CachedAccount* AccountCached = context->AccountCache + CacheIndex;
+			if ((AccountCached->LastAccessTime != ACCOUNT_CACHE_UNLOADED_TIME) && (AccountCached->Account.ID == Records[i].ID))
+			{
+				MarkAccountDirty(context, &AccountCached->Account);
+			}
+		}
+		Memory_Free(Records[i].Data);
+	}
+	ThreadLock_Unlock(&context->_cacheLock);
+	ThreadLock_Unlock(&context->_recordWriteLock);
+	return ReturnedError;
+}
+
+static void RunFlusher(void* argument)
+{
+	DBAccountContext* Context = (DBAccountContext*)argument;
+
+	ThreadLock_Lock(&Context->_cacheLock);
+	while (!Atomic_Load(&Context->_isClosing))
+	{
+		ThreadCondition_Wait(&Context->_flushCondition, &Context->_cacheLock, FLUSHER_INTERVAL_MILLISECONDS);
+		ThreadLock_Unlock(&Context->_cacheLock);
+
+		// Failed accounts stay dirty and are retried on the next pass.
+		Error ReturnedError = WriteOldDirtyAccounts(Context);
+		Error_Deconstruct(&ReturnedError);
+
+		ThreadLock_Lock(&Context->_cacheLock);
+	}
+	ThreadLock_Unlock(&Context->_cacheLock);
+}
+
+static void StopFlusher(DBAccountContext* context)
+{
+	ThreadLock_Lock(&context->_cacheLock);
+	Atomic_Store(&context->_isClosing, 1);
+	ThreadCondition_WakeAll(&context->_flushCondition);
+	ThreadLock_Unlock(&context->_cacheLock);
+	Thread_Join(&context->_flushThread);
 }
 
 static Error RemoveAccountFromCacheByID(DBAccountContext* context, unsigned long long id, bool saveAccount)
@@ -1034,11 +1651,52 @@ static Error RemoveAccountFromCacheByID(DBAccountContext* context, unsigned long
 
 
 /* Searching database. */
+/* While the indexes are built in the background the email map may not have the account yet, so the accounts being read
+* by the build are scanned as well. The callers compare the found accounts' emails. */
+static unsigned long long* FindIDsByEmail(DBAccountContext* context, const char* email, size_t* idCount)
+{
+	// Listed before looking in the map, an account is in either once the build is done. A reindex keeps the map whole.
+	size_t ListedIDCount = 0;
+	unsigned long long* ListedIDs = NULL;
+	if (!Atomic_Load(&context->_isReindexing))
+	{
+		ListedIDs = IndexBuild_CopyIDs(&context->IndexBuilder, &ListedIDCount);
+	}
+	unsigned long long* IDs = IDCodepointHashMap_FindByString(&context->EmailMap, email, true, idCount);
+	if (!ListedIDs)
+	{
+		return IDs;
+	}
+
+	GHDFArena Arena;
+	GHDFArena_Construct(&Arena, GHDF_ARENA_DEFAULT_BLOCK_SIZE);
+	for (size_t i = 0; i < ListedIDCount; i++)
+	{
+		UserAccount Account;
+		Error ReturnedError;
+		if (ReadIndexedAccountFromDatabase(context, &Account, ListedIDs[i], &Arena, &ReturnedError))
+		{
+			if (String_EqualsCaseInsensitive(Account.Email, email))
+			{
+				IDs = (unsigned long long*)Memory_SafeRealloc(IDs, sizeof(unsigned long long) * (*idCount + 1));
+				IDs[*idCount] = ListedIDs[i];
+				*idCount += 1;
+			}
+			AccountDeconstructArenaDecoded(&Account);
+		}
+		Error_Deconstruct(&ReturnedError);
+		GHDFArena_Clear(&Arena);
+	}
+	GHDFArena_Deconstruct(&Arena);
+	Memory_Free(ListedIDs);
+	return IDs;
+}
+
 static bool IsEmailInDatabase(DBAccountContext* context, const char* email, Error* error)
 {
 	*error = Error_CreateSuccess();
 	size_t IDArraySize;
-	unsigned long long* IDs = IDCodepointHashMap_FindByString(&context->EmailMap, email, true, &IDArraySize);
+	unsigned long long* IDs = FindIDsByEmail(context, email, &IDArraySize);
 	if (IDArraySize == 0)
 	{
 		return false;
@@ -1066,72 +1724,197 @@ static bool IsEmailInDatabase(DBAccountContext* context, const char* email, Erro
 		}
 	}
 
-	Memory_Free(IDs);
-	return FoundEmail;
+	Memory_Free(IDs);
+	return FoundEmail;
+}
+
+static UserAccount** SearchAccountFromIDsByName(DBAccountContext* context,
+	unsigned long long* ids,
+	size_t idCount,
+	const char* name,
+	size_t* accountCount,
+	Error* error)
+{
+	UserAccount** AccountArray = (UserAccount**)Memory_SafeMalloc(sizeof(UserAccount*) * idCount);
+	size_t MatchedAccountCount = 0;
+	for (size_t i = 0; i < idCount; i++)
+	{
+		UserAccount* Account = AccountManager_GetAccountByID(context, ids[i], error);
+
+		if (error->Code != ErrorCode_Success)
+		{
+			Memory_Free(AccountArray);
+			return NULL;
+		}
+
+		char* NameSurname = String_Concatenate(Account->Name, Account->Surname);
+		char* SurnameName = String_Concatenate(Account->Surname, Account->Name);
+
+		bool IsMatch = String_IsFuzzyMatchedFolded(NameSurname, name, true, context->NameMap.FoldDiacritics)
+			|| String_IsFuzzyMatchedFolded(SurnameName, name, true, context->NameMap.FoldDiacritics);
+
+		Memory_Free(NameSurname);
+		Memory_Free(SurnameName);
+
+		if (IsMatch)
+		{
+			AccountArray[MatchedAccountCount] = Account;
+			MatchedAccountCount++;
+		}
+	}
+
+	*accountCount = MatchedAccountCount;
+	if (MatchedAccountCount == 0)
+	{
+		Memory_Free(AccountArray);
+		return NULL;
+	}
+	return AccountArray;
+}
+
+static UserAccount** AppendAccountsFromTypoIDs(DBAccountContext* context,
+	UserAccount** foundAccounts,
+	size_t* accountCount,
+	unsigned long long* typoIDs,
+	size_t typoIDCount,
+	Error* error)
+{
+	// Accounts with a name within a few typos of the query go after the exact matches.
+	size_t ExactMatchCount = *accountCount;
+	size_t MatchedAccountCount = ExactMatchCount;
+	UserAccount** AccountArray = (UserAccount**)Memory_SafeRealloc(foundAccounts,
+		sizeof(UserAccount*) * (ExactMatchCount + typoIDCount));
+
+	for (size_t i = 0; i < typoIDCount; i++)
+	{
+		bool IsAlreadyFound = false;
+		for (size_t FoundIndex = 0; FoundIndex < ExactMatchCount; FoundIndex++)
+		{
+			if (AccountArray[FoundIndex]->ID == typoIDs[i])
+			{
+				IsAlreadyFound = true;
+				break;
+			}
+		}
+		if (IsAlreadyFound)
+		{
+			continue;
+		}
+
+		UserAccount* Account = AccountManager_GetAccountByID(context, typoIDs[i], error);
+		if (error->Code != ErrorCode_Success)
+		{
+			Memory_Free(AccountArray);
+			*accountCount = 0;
+			return NULL;
+		}
+		if (Account)
+		{
+			AccountArray[MatchedAccountCount] = Account;
+			MatchedAccountCount++;
+		}
+	}
+
+	*accountCount = MatchedAccountCount;
+	if (MatchedAccountCount == 0)
+	{
+		Memory_Free(AccountArray);
+		return NULL;
+	}
+	return AccountArray;
+}
+
+static UserAccount** SearchAccountsByName(DBAccountContext* context, const char* name, size_t* accountCount, Error* error)
+{
+	size_t IDCount = 0;
+	unsigned long long* IDs = IDCodepointHashMap_FindByString(&context->NameMap, name, true, &IDCount);
+	size_t TypoIDCount = 0;
+	unsigned long long* TypoIDs = IDTermDictionary_FindByString(&context->NameTerms, name,
+		TERM_DICTIONARY_MAX_EDIT_DISTANCE, &TypoIDCount);
+
+	UserAccount** FoundAccounts = NULL;
+	if (IDCount > 0)
+	{
+		FoundAccounts = SearchAccountFromIDsByName(context, IDs, IDCount, name, accountCount, error);
+	}
+	Memory_Free(IDs);
+
+	if ((error->Code == ErrorCode_Success) && (TypoIDCount > 0))
+	{
+		FoundAccounts = AppendAccountsFromTypoIDs(context, FoundAccounts, accountCount, TypoIDs, TypoIDCount, error);
+	}
+	Memory_Free(TypoIDs);
+
+	return FoundAccounts;
 }
 
-static UserAccount** SearchAccountFromIDsByName(DBAccountContext* context,
+static UserAccount** GetAccountsFromCachedIDs(DBAccountContext* context,
 	unsigned long long* ids,
 	size_t idCount,
-	const char* name,
 	size_t* accountCount,
 	Error* error)
 {
-	UserAccount** AccountArray = (UserAccount**)Memory_SafeMalloc(sizeof(UserAccount*) * idCount);
-	size_t MatchedAccountCount = 0;
+	if (idCount == 0)
+	{
+		return NULL;
+	}
+
+	UserAccount** FoundAccounts = (UserAccount**)Memory_SafeMalloc(sizeof(UserAccount*) * idCount);
+	size_t FoundAccountCount = 0;
 	for (size_t i = 0; i < idCount; i++)
 	{
 		UserAccount* Account = AccountManager_GetAccountByID(context, ids[i], error);
-
 		if (error->Code != ErrorCode_Success)
 		{
-			Memory_Free(AccountArray);
+			Memory_Free(FoundAccounts);
 			return NULL;
 		}
-
-		char* NameSurname = String_Concatenate(Account->Name, Account->Surname);
-		char* SurnameName = String_Concatenate(Account->Surname, Account->Name);
-
-		bool IsMatch = String_IsFuzzyMatched(NameSurname, name, true)
-			|| String_IsFuzzyMatched(SurnameName, name, true);
-
-		Memory_Free(NameSurname);
-		Memory_Free(SurnameName);
-
-		if (IsMatch)
+		if (Account)
 		{
-			AccountArray[MatchedAccountCount] = Account;
-			MatchedAccountCount++;
+			FoundAccounts[FoundAccountCount] = Account;
+			FoundAccountCount++;
 		}
 	}
 
-	*accountCount = MatchedAccountCount;
-	if (MatchedAccountCount == 0)
+	if (FoundAccountCount == 0)
 	{
-		Memory_Free(AccountArray);
+		Memory_Free(FoundAccounts);
 		return NULL;
 	}
-	return AccountArray;
+	*accountCount = FoundAccountCount;
+	return FoundAccounts;
+}
+
+static void CacheFoundAccounts(DBAccountContext* context,
+	const char* name,
+	unsigned long long generation,
+	UserAccount** accounts,
+	size_t accountCount)
+{
+	unsigned long long* IDs = accountCount > 0 ? (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * accountCount) : NULL;
+	for (size_t i = 0; i < accountCount; i++)
+	{
+		IDs[i] = accounts[i]->ID;
+	}
+
+	SearchCache_Put(&context->SearchResults, SearchCacheType_AccountName, name, generation, IDs, accountCount);
+	Memory_Free(IDs);
 }
 
 static size_t FindNextAvailableAccountID(DBAccountContext* context)
 {
+	RecordIDList IDs;
+	ListAccountIDs(context, GetAccountID(context), STORE_LAST_KEY, &IDs);
+
+	// The listed IDs are sorted, so the first gap in them is the next free ID.
 	size_t SkippedAccounts = 0;
-	bool FileExists;
-	do
+	for (size_t i = 0; (i < IDs.Count) && (IDs.IDs[i] == GetAccountID(context)); i++)
 	{
-		const char* FilePath = GetPathToIDFile(context, GetAccountID(context),
-			ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
-		FileExists = File_Exists(FilePath);
-		Memory_Free((char*)FilePath);
-
-		if (FileExists)
-		{
-			context->AvailableAccountID++;
-			SkippedAccounts++;
-		}
+		context->AvailableAccountID++;
+		SkippedAccounts++;
+	}
 
-	} while (FileExists);
+	Memory_Free(IDs.IDs);
 	return SkippedAccounts;
 }
 
@@ -1141,6 +1924,7 @@ static void LoadDefaultMetaInfo(DBAccountContext* context)
 {
 	context->AvailableAccountID = DEFAULT_AVAILABLE_ACCOUNT_ID;
 	context->SessionCount = 0;
+	context->IndexGeneration = 0;
 }
 
 static Error AddSessionFromCompound(DBAccountContext* context, GHDFCompound* compound)
@@ -1202,6 +1986,19 @@ static Error ReadMetaInfoFromCompound(DBAccountContext* context, GHDFCompound* c
 	context->AvailableAccountID = Entry->Value.SingleValue.ULong;
 
 
+	// Index generation.
+	ReturnedError = GHDFCompound_GetVerifiedOptionalEntry(compound, ENTRY_ID_METAINFO_INDEX_GENERATION, &Entry, GHDFType_ULong,
+		"Meta-info index generation.");
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	if (Entry)
+	{
+		context->IndexGeneration = Entry->Value.SingleValue.ULong;
+	}
+
+
 	// Sessions.
 	ReturnedError = GHDFCompound_GetVerifiedOptionalEntry(compound,
 		ENTRY_ID_METAINFO_SESSION_ARRAY, &Entry, GHDFType_Compound | GHDF_TYPE_ARRAY_BIT,
@@ -1289,6 +2086,8 @@ static Error SaveMetaInfo(DBAccountContext* context)
 	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_ULong, ENTRY_ID_METAINFO_AVAILABLE_ID, SingleValue);
 	SingleValue.ULong = context->AvailableAccountID;
 	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_ULong, ENTRY_ID_METAINFO_SESSION_ACCOUNT_ID, SingleValue);
+	SingleValue.ULong = context->IndexGeneration;
+	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_ULong, ENTRY_ID_METAINFO_INDEX_GENERATION, SingleValue);
 
 	RefreshSessions(context);
 	if (context->SessionCount > 0)
@@ -1297,7 +2096,9 @@ static Error SaveMetaInfo(DBAccountContext* context)
 	}
 
 	const char* FilePath = Directory_CombinePaths(context->AccountRootPath, ACCOUNT_METAINFO_FILE_NAME);
-	Error ReturnedError = GHDFCompound_WriteToFile(FilePath, &Compound);
+	unsigned long long StorageStartTime = AccessLog_BeginStorage();
+	Error ReturnedError = GHDFCompound_WriteToFile(FilePath, &Compound, context->SyncWrites);
+	AccessLog_EndStorage(StorageStartTime);
 	Memory_Free((char*)FilePath);
 	GHDFCompound_Deconstruct(&Compound);
 
@@ -1305,22 +2106,234 @@ static Error SaveMetaInfo(DBAccountContext* context)
 }
 
 
+/* Mutation log. */
+static void WriteSessionRecord(SessionID* session, unsigned char* record)
+{
+	unsigned long long StartTime = (unsigned long long)session->SessionStartTime;
+	for (int i = 0; i < 8; i++)
+	{
+		record[i] = (unsigned char)(StartTime >> (i * 8));
+	}
+	for (int ValueIndex = 0; ValueIndex < SESSION_ID_LENGTH; ValueIndex++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			record[8 + (ValueIndex * 4) + i] = (unsigned char)(session->IDValues[ValueIndex] >> (i * 8));
+		}
+	}
+}
+
+static Error ReplaySession(DBAccountContext* context, unsigned long long accountID, const unsigned char* record, size_t recordLength)
+{
+	if (recordLength != SESSION_RECORD_LENGTH)
+	{
+		return Error_CreateError(ErrorCode_DatabaseError, "Session mutation record length is invalid.");
+	}
+
+	SessionID* Session = GetSessionByID(context, accountID);
+	if (!Session)
+	{
+		SessionIDListEnsureCapacity(context, context->SessionCount + 1);
+		Session = &context->ActiveSessions[context->SessionCount];
+		context->SessionCount += 1;
+	}
+
+	unsigned long long StartTime = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		StartTime |= (unsigned long long)record[i] << (i * 8);
+	}
+	Session->SessionStartTime = (time_t)StartTime;
+	Session->AccountID = accountID;
+	for (int ValueIndex = 0; ValueIndex < SESSION_ID_LENGTH; ValueIndex++)
+	{
+		unsigned int Value = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			Value |= (unsigned int)record[8 + (ValueIndex * 4) + i] << (i * 8);
+		}
+		Session->IDValues[ValueIndex] = Value;
+	}
+	return Error_CreateSuccess();
+}
+
+static Error ReplayAccountMutation(unsigned char type, unsigned long long id, const char* data, size_t dataLength, void* argument)
+{
+	DBAccountContext* Context = (DBAccountContext*)argument;
+	switch (type)
+	{
+		case MUTATION_RECORD_ACCOUNT:
+			// Accounts created just before a crash may be newer than the saved meta-info.
+			if (id >= Context->AvailableAccountID)
+			{
+				Context->AvailableAccountID = id + 1;
+			}
+			return WriteAccountData(Context, id, data, dataLength);
+
+		case MUTATION_RECORD_ACCOUNT_DELETED:
+			RemoveSessionByID(Context, id);
+			DeleteAccountFromDatabase(Context, id);
+			return Error_CreateSuccess();
+
+		case MUTATION_RECORD_SESSION:
+			return ReplaySession(Context, id, (const unsigned char*)data, dataLength);
+
+		default:
+			return Error_CreateError(ErrorCode_DatabaseError, "Unknown account mutation record type.");
+	}
+}
+
+/* Sessions only live in the meta-info, so it is saved together with the cached accounts. */
+static Error CheckpointMutationLog(DBAccountContext* context)
+{
+	Error ReturnedError = SaveAllCachedAccountsToDatabase(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	ReturnedError = SaveIndexSnapshot(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	ReturnedError = SaveMetaInfo(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	return WriteAheadLog_Reset(&context->MutationLog);
+}
+
+/* Logs the account's whole record, replaying only the newest one of each account restores it. The record is written by the next commit. */
+static void LogAccountMutation(DBAccountContext* context, UserAccount* account)
+{
+	GHDFBuffer* Buffer = GHDFBuffer_GetThreadBuffer();
+	GHDFBuffer_BeginFile(Buffer);
+	WriteAccountGHDF(account, Buffer);
+	WriteAheadLog_Append(&context->MutationLog, MUTATION_RECORD_ACCOUNT, account->ID, Buffer->Data, Buffer->Length);
+}
+
+static void LogAccountDeletion(DBAccountContext* context, unsigned long long id)
+{
+	WriteAheadLog_Append(&context->MutationLog, MUTATION_RECORD_ACCOUNT_DELETED, id, NULL, 0);
+}
+
+static void LogSessionCreation(DBAccountContext* context, SessionID* session)
+{
+	unsigned char Record[SESSION_RECORD_LENGTH];
+	WriteSessionRecord(session, Record);
+	WriteAheadLog_Append(&context->MutationLog, MUTATION_RECORD_SESSION, session->AccountID, (const char*)Record, SESSION_RECORD_LENGTH);
+}
+
+/* Replays what the log holds, the log is checkpointed once the indexes are built from the replayed database. */
+static Error OpenMutationLog(DBAccountContext* context, bool* hasReplayedMutations)
+{
+	Directory_CreateAll(context->AccountRootPath);
+	const char* LogPath = Directory_CombinePaths(context->AccountRootPath, MUTATION_LOG_FILE_NAME);
+	Error ReturnedError = WriteAheadLog_Open(&context->MutationLog, LogPath, context->SyncWrites);
+	Memory_Free((char*)LogPath);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	ReturnedError = WriteAheadLog_Replay(&context->MutationLog, ReplayAccountMutation, context);
+	*hasReplayedMutations = context->MutationLog.Length > 0;
+	return ReturnedError;
+}
+
+
+/* Segment import. */
+/* Accounts were kept in a single segment file before the store replaced it, its accounts are moved into the store once. */
+static Error ImportAccountSegment(DBAccountContext* context, Logger* logger)
+{
+	const char* SegmentPath = Directory_CombinePaths(context->AccountRootPath, ACCOUNT_SEGMENT_FILE_NAME);
+	Error ReturnedError = Error_CreateSuccess();
+	if (File_Exists(SegmentPath) && !context->RecordStore)
+	{
+		ReturnedError = Error_CreateError(ErrorCode_DatabaseError,
+			"Accounts are still in a segment file, which is only moved into the store when \"database-use-store\" is enabled.");
+	}
+	else if (File_Exists(SegmentPath))
+	{
+		size_t ImportedCount;
+		ReturnedError = Store_ImportSegment(context->RecordStore, SegmentPath, &ImportedCount);
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			char Message[128];
+			snprintf(Message, sizeof(Message), "Moved %llu accounts from the segment file into the store.", (unsigned long long)ImportedCount);
+			Logger_LogInfo(logger, Message);
+		}
+	}
+	Memory_Free((char*)SegmentPath);
+	return ReturnedError;
+}
+
+
 // Functions.
 Error AccountManager_Construct(ServerContext* serverContext)
 {
 	serverContext->AccountContext->AccountRootPath = Directory_CombinePaths(serverContext->Resources->DatabaseRootPath, DIR_NAME_ACCOUNTS);
+	serverContext->AccountContext->SyncWrites = serverContext->Configuration->SyncDatabaseWrites;
+	serverContext->AccountContext->UpgradeFileFormat = serverContext->Configuration->UpgradeDatabaseFormat;
 
 	serverContext->AccountContext->_sessionListCapacity = GENERIC_LIST_CAPACITY;
 	serverContext->AccountContext->ActiveSessions = 
 		(SessionID*)Memory_SafeMalloc(sizeof(SessionID) * serverContext->AccountContext->_sessionListCapacity);
 	serverContext->AccountContext->SessionCount = 0;
 
-	Error ReturnedError = LoadMetaInfo(serverContext->AccountContext);
+	serverContext->AccountContext->RecordStore = NULL;
+	RecordIDList_Construct(&serverContext->AccountContext->_movedRecordIDs);
+	if (serverContext->Configuration->UseDatabaseStore)
+	{
+		const char* StorePath = Directory_CombinePaths(serverContext->AccountContext->AccountRootPath, ACCOUNT_STORE_DIR_NAME);
+		Store* RecordStore = (Store*)Memory_SafeMalloc(sizeof(Store));
+		Error ReturnedError = Store_Open(RecordStore, StorePath, serverContext->AccountContext->SyncWrites);
+		Memory_Free((char*)StorePath);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			Memory_Free(RecordStore);
+			return ReturnedError;
+		}
+		serverContext->AccountContext->RecordStore = RecordStore;
+	}
+
+	Error ReturnedError = ImportAccountSegment(serverContext->AccountContext, serverContext->Logger);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	ReturnedError = LoadMetaInfo(serverContext->AccountContext);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	InitializeAccountCache(serverContext->AccountContext);
+	ThreadLock_Construct(&serverContext->AccountContext->_cacheLock);
+	ThreadLock_Construct(&serverContext->AccountContext->_recordWriteLock);
+	ThreadCondition_Construct(&serverContext->AccountContext->_flushCondition);
+	serverContext->AccountContext->_isClosing = 0;
+	serverContext->AccountContext->MaxDirtyAge = (time_t)serverContext->Configuration->CacheMaxDirtyAge;
+	ThreadLock_Construct(&serverContext->AccountContext->_indexSnapshotLock);
+	serverContext->AccountContext->_isIndexSnapshotCurrent = false;
+	IndexBuild_Construct(&serverContext->AccountContext->IndexBuilder);
+	serverContext->AccountContext->_isIndexBuildThreadStarted = false;
+	serverContext->AccountContext->_isReindexing = 0;
+	serverContext->AccountContext->_indexBuildWorkerCount = BulkLoader_GetWorkerCount(serverContext->Configuration->IndexLoaderThreads);
+	bool HasReplayedMutations;
+	ReturnedError = OpenMutationLog(serverContext->AccountContext, &HasReplayedMutations);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
+
 	IDCodepointHashMap_Construct(&serverContext->AccountContext->NameMap);
+	IDTermDictionary_Construct(&serverContext->AccountContext->NameTerms);
+	serverContext->AccountContext->NameMap.FoldDiacritics = serverContext->Configuration->FoldSearchDiacritics;
+	serverContext->AccountContext->NameTerms.FoldDiacritics = serverContext->Configuration->FoldSearchDiacritics;
+	SearchCache_Construct(&serverContext->AccountContext->SearchResults);
 	IDCodepointHashMap_Construct(&serverContext->AccountContext->EmailMap);
 
 	serverContext->AccountContext->UnverifiedAccounts = 
@@ -1328,24 +2341,79 @@ Error AccountManager_Construct(ServerContext* serverContext)
 	serverContext->AccountContext->UnverifiedAccountCount = 0;
 	serverContext->AccountContext->_unverifiedAccountCapacity = GENERIC_LIST_CAPACITY;
 
-	size_t ReadAccountCount;
-	ReturnedError = GenerateMetaInfoForAccounts(serverContext->AccountContext, &ReadAccountCount);
-	if (ReturnedError.Code != ErrorCode_Success)
+	// Replayed changes may not be in the snapshot, only a clean shutdown or checkpoint leaves the log empty.
+	char Message[128];
+	unsigned long long ReadStartTime = Time_GetMicroseconds();
+	bool IsIndexBuildLazy = false;
+	if (!HasReplayedMutations && LoadIndexSnapshot(serverContext->AccountContext))
 	{
-		return ReturnedError;
+		snprintf(Message, sizeof(Message), "Loaded account indexes from snapshot in %llu ms.", (Time_GetMicroseconds() - ReadStartTime) / 1000);
+	}
+	else
+	{
+		RecordIDList IDs;
+		ListAccountIDs(serverContext->AccountContext, DEFAULT_AVAILABLE_ACCOUNT_ID, serverContext->AccountContext->AvailableAccountID - 1, &IDs);
+		IndexBuild_LockChanges(&serverContext->AccountContext->IndexBuilder);
+		IndexBuild_Begin(&serverContext->AccountContext->IndexBuilder, IDs.IDs, IDs.Count);
+		IndexBuild_UnlockChanges(&serverContext->AccountContext->IndexBuilder);
+		if (serverContext->Configuration->LazyIndexStartup)
+		{
+			// The snapshot may still match the meta-info while missing the replayed changes, and the log is emptied below.
+			serverContext->AccountContext->IndexGeneration++;
+			IsIndexBuildLazy = true;
+			snprintf(Message, sizeof(Message), "Building indexes of %llu accounts in the background.", (unsigned long long)IDs.Count);
+		}
+		else
+		{
+			size_t ReadAccountCount;
+			ReturnedError = GenerateMetaInfoForAccounts(serverContext->AccountContext,
+				serverContext->AccountContext->_indexBuildWorkerCount, &ReadAccountCount);
+			if (ReturnedError.Code != ErrorCode_Success)
+			{
+				return ReturnedError;
+			}
+			snprintf(Message, sizeof(Message), "Read %llu accounts while creating ID hashes (%.0f files/s).", ReadAccountCount, Time_GetRatePerSecond(ReadAccountCount, ReadStartTime));
+		}
 	}
-	char Message[128];
-	snprintf(Message, sizeof(Message), "Read %llu accounts while creating ID hashes.", ReadAccountCount);
 	Logger_LogInfo(serverContext->Logger, Message);
 
-	InitializeAccountCache(serverContext->AccountContext);
+	ReturnedError = CheckpointMutationLog(serverContext->AccountContext);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
 
+	if (!Thread_Start(&serverContext->AccountContext->_flushThread, RunFlusher, serverContext->AccountContext))
+	{
+		return Error_CreateError(ErrorCode_IO, "AccountManager_Construct: Failed to start cache flusher thread.");
+	}
+	if (IsIndexBuildLazy)
+	{
+		serverContext->AccountContext->_isIndexBuildThreadStarted = Thread_Start(&serverContext->AccountContext->_indexBuildThread,
+			RunIndexBuild, serverContext);
+		if (!serverContext->AccountContext->_isIndexBuildThreadStarted)
+		{
+			return Error_CreateError(ErrorCode_IO, "AccountManager_Construct: Failed to start index build thread.");
+		}
+	}
 	return ReturnedError;
 }
 
 Error AccountManager_Deconstruct(DBAccountContext* context)
 {
-	Error ReturnedError = SaveMetaInfo(context);
+	// Stopping the flusher also stops the index build, whose indexes are then never saved.
+	StopFlusher(context);
+	if (context->_isIndexBuildThreadStarted)
+	{
+		Thread_Join(&context->_indexBuildThread);
+		context->_isIndexBuildThreadStarted = false;
+	}
+	Error ReturnedError = SaveIndexSnapshot(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	ReturnedError = SaveMetaInfo(context);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
@@ -1355,8 +2423,32 @@ Error AccountManager_Deconstruct(DBAccountContext* context)
 	{
 		return ReturnedError;
 	}
+	ReturnedError = WriteAheadLog_Reset(&context->MutationLog);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	ReturnedError = WriteAheadLog_Close(&context->MutationLog);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	if (context->RecordStore)
+	{
+		ReturnedError = Store_Close(context->RecordStore);
+		Memory_Free(context->RecordStore);
+		context->RecordStore = NULL;
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+	Memory_Free(context->_movedRecordIDs.IDs);
 	IDCodepointHashMap_Deconstruct(&context->NameMap);
+	IDTermDictionary_Deconstruct(&context->NameTerms);
+	SearchCache_Deconstruct(&context->SearchResults);
 	IDCodepointHashMap_Deconstruct(&context->EmailMap);
+	IndexBuild_Deconstruct(&context->IndexBuilder);
 	Memory_Free(context->ActiveSessions);
 	Memory_Free(context->UnverifiedAccounts);
 	Memory_Free(context->AccountCache);
@@ -1364,6 +2456,74 @@ Error AccountManager_Deconstruct(DBAccountContext* context)
 	return Error_CreateSuccess();
 }
 
+Error AccountManager_CommitMutations(DBAccountContext* context)
+{
+	Error ReturnedError = WriteAheadLog_CommitAll(&context->MutationLog);
+	if ((ReturnedError.Code == ErrorCode_Success) && (context->MutationLog.Length >= MUTATION_LOG_CHECKPOINT_LENGTH))
+	{
+		ReturnedError = CheckpointMutationLog(context);
+	}
+	return ReturnedError;
+}
+
+Error AccountManager_Reindex(ServerContext* serverContext)
+{
+	DBAccountContext* Context = serverContext->AccountContext;
+	IndexBuildState State = IndexBuild_GetState(&Context->IndexBuilder);
+	if ((State == IndexBuildState_Running) || Atomic_Load(&Context->_isReindexing))
+	{
+		return Error_CreateError(ErrorCode_IllegalState, "The account indexes are already being built.");
+	}
+	if (State == IndexBuildState_Failed)
+	{
+		return Error_CreateError(ErrorCode_IllegalState, "The account indexes failed to build at startup, the server must be restarted.");
+	}
+
+	// A finished build may still be saving its snapshot.
+	if (Context->_isIndexBuildThreadStarted)
+	{
+		Thread_Join(&Context->_indexBuildThread);
+		Context->_isIndexBuildThreadStarted = false;
+	}
+
+	IDCodepointHashMap_Construct(&Context->_reindexNameMap);
+	IDTermDictionary_Construct(&Context->_reindexNameTerms);
+	IDCodepointHashMap_Construct(&Context->_reindexEmailMap);
+	Context->_reindexNameMap.FoldDiacritics = Context->NameMap.FoldDiacritics;
+	Context->_reindexNameTerms.FoldDiacritics = Context->NameTerms.FoldDiacritics;
+	Context->_reindexEmailMap.FoldDiacritics = Context->EmailMap.FoldDiacritics;
+
+	// Accounts created while listing would otherwise be either missed or indexed twice by the fresh indexes.
+	RecordIDList IDs;
+	IndexBuild_LockChanges(&Context->IndexBuilder);
+	ListAccountIDs(Context, DEFAULT_AVAILABLE_ACCOUNT_ID, Context->AvailableAccountID - 1, &IDs);
+	Atomic_Store(&Context->_isReindexing, 1);
+	IndexBuild_Begin(&Context->IndexBuilder, IDs.IDs, IDs.Count);
+	IndexBuild_UnlockChanges(&Context->IndexBuilder);
+
+	// Renamed accounts may only be changed in the cache, the build reads the database.
+	Error ReturnedError = SaveAllCachedAccountsToDatabase(Context);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		Context->_isIndexBuildThreadStarted = Thread_Start(&Context->_indexBuildThread, RunIndexBuild, serverContext);
+		if (!Context->_isIndexBuildThreadStarted)
+		{
+			ReturnedError = Error_CreateError(ErrorCode_IO, "AccountManager_Reindex: Failed to start index build thread.");
+		}
+	}
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		IndexBuild_Finish(&Context->IndexBuilder, true, RemoveDeferredIndexEntry, Context);
+		EndReindex(Context, false);
+		return ReturnedError;
+	}
+
+	char Message[128];
+	snprintf(Message, sizeof(Message), "Rebuilding indexes of %llu accounts in the background.", (unsigned long long)IDs.Count);
+	Logger_LogInfo(serverContext->Logger, Message);
+	return Error_CreateSuccess();
+}
+
 
 /* Accounts. */
 UserAccount* AccountManager_TryCreateAccount(ServerContext* context,
@@ -1381,11 +2541,8 @@ UserAccount* AccountManager_TryCreateAccount(ServerContext* context,
 		return NULL;
 	}
 
-	const char* AccountFilePath = GetPathToIDFile(
-		context->AccountContext, GetAccountID(context->AccountContext), ACCOUNT_ENTRIES_DIR_NAME, GHDF_FILE_EXTENSION);
-	if (File_Exists(AccountFilePath))
+	if (IsAccountInDatabase(context->AccountContext, GetAccountID(context->AccountContext)))
 	{
-		Memory_Free((char*)AccountFilePath);
 		char Message[256];
 		snprintf(Message, sizeof(Message), "Account with ID %llu already exists in database (file match), but no email entry was found and "
 			"an attempt to creating this account was made. Corrupted database?", GetAccountID(context->AccountContext));
@@ -1396,7 +2553,6 @@ UserAccount* AccountManager_TryCreateAccount(ServerContext* context,
 		Logger_LogError(context->Logger, Message);
 		return NULL;
 	}
-	Memory_Free((char*)AccountFilePath);
 
 	UserAccount Account;
 	AccountSetDefaultValues(&Account);
@@ -1406,12 +2562,15 @@ UserAccount* AccountManager_TryCreateAccount(ServerContext* context,
 		return NULL;
 	}
 
-	*error = WriteAccountToDatabase(context->AccountContext, &Account);
+	ThreadLock_Lock(&context->AccountContext->_recordWriteLock);
+	*error = WriteAccountRecord(context->AccountContext, &Account);
+	ThreadLock_Unlock(&context->AccountContext->_recordWriteLock);
 	if (error->Code != ErrorCode_Success)
 	{
 		AccountDeconstruct(&Account);
 		return NULL;
 	}
+	LogAccountMutation(context->AccountContext, &Account);
 
 	GenerateMetaInfoForSingleAccount(context->AccountContext, &Account);
 	unsigned long long ID = Account.ID;
@@ -1493,26 +2652,51 @@ UserAccount* AccountManager_GetAccountByID(DBAccountContext* context, unsigned l
 
 	if (Account)
 	{
+		Metrics_Increment(MetricCounter_AccountCacheHits);
+		LTT_PROBE_CACHE_HIT(LTT_PROBE_CACHE_ACCOUNT, id);
 		return Account;
 	}
 
+	Metrics_Increment(MetricCounter_AccountCacheMisses);
+	LTT_PROBE_CACHE_MISS(LTT_PROBE_CACHE_ACCOUNT, id);
+	TraceSpan Span = Trace_BeginSpan("account cache load");
 	CachedAccount* AccountCached = LoadAccountIntoCache(context, id, error);
+	Trace_EndSpan(Span);
 	return AccountCached ? &AccountCached->Account : NULL;
 }
 
+bool AccountManager_IsSearchReady(DBAccountContext* context)
+{
+	return (IndexBuild_GetState(&context->IndexBuilder) == IndexBuildState_Complete) || Atomic_Load(&context->_isReindexing);
+}
+
 UserAccount** AccountManager_GetAccountsByName(DBAccountContext* context, const char* name, size_t* accountCount, Error* error)
 {
-	size_t IDCount;
-	unsigned long long* IDs = IDCodepointHashMap_FindByString(&context->NameMap, name, true, &IDCount);
-	if (IDCount == 0)
+	*error = Error_CreateSuccess();
+	*accountCount = 0;
+	if (!AccountManager_IsSearchReady(context))
 	{
-		*error = Error_CreateSuccess();
 		return NULL;
 	}
 
-	UserAccount** FoundAccounts = SearchAccountFromIDsByName(context, IDs, IDCount, name, accountCount, error);
-	Memory_Free(IDs);
+	// Read before searching so that a result computed against older meta info is never stored as current.
+	unsigned long long Generation = IDCodepointHashMap_GetGeneration(&context->NameMap);
+	unsigned long long* CachedIDs;
+	size_t CachedIDCount;
+	if (SearchCache_TryGet(&context->SearchResults, SearchCacheType_AccountName, name, Generation, &CachedIDs, &CachedIDCount))
+	{
+		UserAccount** CachedAccounts = GetAccountsFromCachedIDs(context, CachedIDs, CachedIDCount, accountCount, error);
+		Memory_Free(CachedIDs);
+		return CachedAccounts;
+	}
 
+	TraceSpan Span = Trace_BeginSpan("account name index query");
+	UserAccount** FoundAccounts = SearchAccountsByName(context, name, accountCount, error);
+	Trace_EndSpan(Span);
+	if (error->Code == ErrorCode_Success)
+	{
+		CacheFoundAccounts(context, name, Generation, FoundAccounts, *accountCount);
+	}
 	return FoundAccounts;
 }
 
@@ -1521,9 +2705,12 @@ UserAccount* AccountManager_GetAccountByEmail(DBAccountContext* context, const c
 	size_t IDCount;
 	*error = Error_CreateSuccess();
 
-	unsigned long long* IDs = IDCodepointHashMap_FindByString(&context->EmailMap, email, true, &IDCount);
+	TraceSpan Span = Trace_BeginSpan("account email index query");
+	unsigned long long* IDs = FindIDsByEmail(context, email, &IDCount);
+	Trace_EndSpan(Span);
 	if (IDCount == 0)
 	{
+		Memory_Free(IDs);
 		return NULL;
 	}
 
@@ -1531,8 +2718,13 @@ UserAccount* AccountManager_GetAccountByEmail(DBAccountContext* context, const c
 	for (size_t i = 0; i < IDCount; i++)
 	{
 		UserAccount* Account = AccountManager_GetAccountByID(context, IDs[i], error);
+		if (error->Code != ErrorCode_Success)
+		{
+			break;
+		}
 
-		if (String_EqualsCaseInsensitive(Account->Email, email))
+		// Accounts found by scanning may have been deleted since.
+		if (Account && String_EqualsCaseInsensitive(Account->Email, email))
 		{
 			FoundAccount = Account;
 			break;
@@ -1565,6 +2757,7 @@ Error AccountManager_DeleteAccount(ServerContext* serverContext, UserAccount* ac
 	snprintf(Message, sizeof(Message), "Deleting account with ID %llu and email %s", account->ID, account->Email);
 	Logger_LogInfo(serverContext->Logger, Message);
 
+	LogAccountDeletion(serverContext->AccountContext, account->ID);
 	RemoveSessionByID(serverContext->AccountContext, account->ID);
 	ClearMetaInfoForAccount(serverContext->AccountContext, account);
 	Error ReturnedError = RemoveAccountFromCacheByID(serverContext->AccountContext, account->ID, false);
@@ -1608,27 +2801,41 @@ bool AccountManager_IsPasswordCorrect(UserAccount* account, const char* password
 	return PasswordHashEquals(account->PasswordHash, Hash);
 }
 
-bool AccountManager_SetName(UserAccount* account, const char* name)
+bool AccountManager_SetName(DBAccountContext* context, UserAccount* account, const char* name, Error* error)
 {
+	*error = Error_CreateSuccess();
 	if (!VerifyName(name))
 	{
 		return false;
 	}
-	Memory_Free((char*)account->Name);
+	ThreadLock_Lock(&context->_cacheLock);
+	const char* OldName = account->Name;
 	account->Name = String_CreateCopy(name);
+	MarkAccountDirty(context, account);
+	ThreadLock_Unlock(&context->_cacheLock);
 
+	ChangeIndexedName(context, account->ID, OldName, account->Name, account->Surname);
+	Memory_Free((char*)OldName);
+	LogAccountMutation(context, account);
 	return true;
 }
 
-bool AccountManager_SetSurname(UserAccount* account, const char* surname)
+bool AccountManager_SetSurname(DBAccountContext* context, UserAccount* account, const char* surname, Error* error)
 {
+	*error = Error_CreateSuccess();
 	if (!VerifyName(surname))
 	{
 		return false;
 	}
-	Memory_Free((char*)account->Surname);
+	ThreadLock_Lock(&context->_cacheLock);
+	const char* OldSurname = account->Surname;
 	account->Surname = String_CreateCopy(surname);
+	MarkAccountDirty(context, account);
+	ThreadLock_Unlock(&context->_cacheLock);
 
+	ChangeIndexedName(context, account->ID, OldSurname, account->Surname, account->Name);
+	Memory_Free((char*)OldSurname);
+	LogAccountMutation(context, account);
 	return true;
 }
 
@@ -1647,8 +2854,9 @@ bool AccountManager_IsSessionAdmin(DBAccountContext* context, unsigned int* sess
 	return false;
 }
 
-SessionID* AccountManager_TryCreateSession(DBAccountContext* context, UserAccount* account, const char* password)
+SessionID* AccountManager_TryCreateSession(DBAccountContext* context, UserAccount* account, const char* password, Error* error)
 {
+	*error = Error_CreateSuccess();
 	unsigned long long PasswordHash[16];
 	GeneratePasswordHash(PasswordHash, password);
 	if (!PasswordHashEquals(PasswordHash, account->PasswordHash))
@@ -1656,12 +2864,15 @@ SessionID* AccountManager_TryCreateSession(DBAccountContext* context, UserAccoun
 		return NULL;
 	}
 
-	return CreateSession(context, account);
+	return AccountManager_CreateSession(context, account, error);
 }
 
-SessionID* AccountManager_CreateSession(DBAccountContext* context, UserAccount* account)
+SessionID* AccountManager_CreateSession(DBAccountContext* context, UserAccount* account, Error* error)
 {
-	return CreateSession(context, account);
+	SessionID* Session = CreateSession(context, account);
+	LogSessionCreation(context, Session);
+	*error = Error_CreateSuccess();
+	return Session;
 }
 
 
@@ -1711,4 +2922,13 @@ void AccountManager_DeleteAllProfileImages(ServerContext* serverContext)
 		File_Delete(FilePath);
 		Memory_Free((char*)FilePath);
 	}
+}
+
+/* JSON. */
+void AccountManager_AppendAccountJSON(UserAccount* record, StringBuilder* builder)
+{
+	bool IsFirstField;
+	Schema_BeginJSONObject(builder, &IsFirstField);
+	ACCOUNT_SCHEMA(SCHEMA_APPEND_JSON_FIELD, SCHEMA_APPEND_JSON_LIST)
+	Schema_EndJSONObject(builder);
 }
\ No newline at end of file
@@ -4,7 +4,15 @@
 #include "LTTServerC.h"
 #include <time.h>
 #include "IDCodepointHashMap.h"
+#include "IDTermDictionary.h"
+#include "SearchCache.h"
+#include "Store.h"
+#include "RecordIDList.h"
+#include "WriteAheadLog.h"
+#include "IndexBuild.h"
+#include "LTTThread.h"
 #include "Image.h"
+#include "LttString.h"
 
 
 // Macros.
@@ -45,7 +53,35 @@ typedef struct DBAccountContextStruct
 
 	unsigned long long AvailableAccountID;
 	IDCodepointHashMap NameMap;
+	IDTermDictionary NameTerms;
+	SearchCache SearchResults;
+	bool SyncWrites;
+	bool UpgradeFileFormat;
 	IDCodepointHashMap EmailMap;
+	/* The index snapshot is only loaded if it was written with the generation saved in the meta-info.
+	* The first index change after a snapshot moves to the next generation. */
+	unsigned long long IndexGeneration;
+	bool _isIndexSnapshotCurrent;
+	ThreadLock _indexSnapshotLock;
+	/* Tracks the rebuild of the indexes, which runs on its own thread when the server starts serving before it is done.
+	* Lookups by email scan the accounts meanwhile. */
+	IndexBuild IndexBuilder;
+	Thread _indexBuildThread;
+	bool _isIndexBuildThreadStarted;
+	size_t _indexBuildWorkerCount;
+	/* Fresh indexes filled by a reindex while lookups keep using the live ones. Changes made meanwhile go to both,
+	* the fresh indexes then replace the live ones at once. */
+	IDCodepointHashMap _reindexNameMap;
+	IDTermDictionary _reindexNameTerms;
+	IDCodepointHashMap _reindexEmailMap;
+	volatile long long _isReindexing;
+
+	/* Holds the account records when the store is enabled, NULL when each account has its own file. */
+	Store* RecordStore;
+	/* Accounts moved into the store from their own files, which are only deleted once the store is flushed. Guarded by the write lock. */
+	RecordIDList _movedRecordIDs;
+	/* Every change to an account and every created session is logged here until a checkpoint has flushed it to the database. */
+	WriteAheadLog MutationLog;
 
 	SessionID* ActiveSessions;
 	size_t SessionCount;
@@ -56,6 +92,14 @@ typedef struct DBAccountContextStruct
 	size_t _unverifiedAccountCapacity;
 
 	struct CachedAccountStruct* AccountCache;
+	/* Held while cached accounts are changed, loaded or evicted. Changed accounts are written by a background thread
+	* once they've been dirty for MaxDirtyAge seconds, database writes of records are serialized by the write lock. */
+	ThreadLock _cacheLock;
+	ThreadLock _recordWriteLock;
+	ThreadCondition _flushCondition;
+	Thread _flushThread;
+	volatile long long _isClosing;
+	time_t MaxDirtyAge;
 } DBAccountContext;
 
 
@@ -65,6 +109,19 @@ Error AccountManager_Construct(ServerContext* serverContext);
 
 Error AccountManager_Deconstruct(DBAccountContext* context);
 
+/// <summary>
+/// Writes the logged changes with a single sync, after which they last through a crash.
+/// The log is checkpointed once it has grown large.
+/// </summary>
+Error AccountManager_CommitMutations(DBAccountContext* context);
+
+/// <summary>
+/// Rebuilds the name and email indexes from the stored accounts in the background, lookups use the old indexes
+/// until the new ones replace them.
+/// </summary>
+/// <returns>An error if the indexes are already being built or failed to build at startup.</returns>
+Error AccountManager_Reindex(ServerContext* serverContext);
+
 
 /* Account/ */
 UserAccount* AccountManager_TryCreateAccount(ServerContext* context,
@@ -87,6 +144,11 @@ bool AccountManager_TryVerifyAccount(ServerContext* serverContext, const char* e
 
 UserAccount* AccountManager_GetAccountByID(DBAccountContext* context, unsigned long long id, Error* error);
 
+/// <summary>
+/// Whether the name index is fully built. Until it is, searching by name finds nothing. A reindex doesn't make it unready.
+/// </summary>
+bool AccountManager_IsSearchReady(DBAccountContext* context);
+
 UserAccount** AccountManager_GetAccountsByName(DBAccountContext* context, const char* name, size_t* accountCount, Error* error);
 
 UserAccount* AccountManager_GetAccountByEmail(DBAccountContext* context, const char* email, Error* error);
@@ -99,17 +161,21 @@ Error AccountManager_DeleteAllAccounts(ServerContext* serverContext);
 
 bool AccountManager_IsPasswordCorrect(UserAccount* account, const char* password);
 
-bool AccountManager_SetName(UserAccount* account, const char* name);
+/// <summary>
+/// Changes to accounts are logged and last through a crash once AccountManager_CommitMutations has returned.
+/// Name searches find the account by its new name right away.
+/// </summary>
+bool AccountManager_SetName(DBAccountContext* context, UserAccount* account, const char* name, Error* error);
 
-bool AccountManager_SetSurname(UserAccount* account, const char* surname);
+bool AccountManager_SetSurname(DBAccountContext* context, UserAccount* account, const char* surname, Error* error);
 
 
 /* Sessions. */
 bool AccountManager_IsSessionAdmin(DBAccountContext* context, unsigned int* sessionIdValues, Error* error);
 
-SessionID* AccountManager_TryCreateSession(DBAccountContext* context, UserAccount* account, const char* password);
+SessionID* AccountManager_TryCreateSession(DBAccountContext* context, UserAccount* account, const char* password, Error* error);
 
-SessionID* AccountManager_CreateSession(DBAccountContext* context, UserAccount* account);
+SessionID* AccountManager_CreateSession(DBAccountContext* context, UserAccount* account, Error* error);
 
 
 /* Profile image. */
@@ -117,4 +183,11 @@ Error AccountManager_GetProfileImage(DBAccountContext* context, unsigned long lo
 
 Error AccountManager_SetProfileImage(DBAccountContext* context, UserAccount* account, unsigned char* uploadedImageData, size_t dataLength);
 
-void AccountManager_DeleteAllProfileImages(ServerContext* context);
\ No newline at end of file
+void AccountManager_DeleteAllProfileImages(ServerContext* context);
+
+
+/* JSON. */
+/// <summary>
+/// Appends the account's public fields as a JSON object, the password hash and admin status are never included.
+/// </summary>
+void AccountManager_AppendAccountJSON(UserAccount* account, StringBuilder* builder);
\ No newline at end of file
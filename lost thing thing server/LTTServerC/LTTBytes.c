@@ -0,0 +1,57 @@
+#include "LTTBytes.h"
+
+
+// Macros.
+#define HASH_PRIME 16777619u
+
+
+// Functions.
+void Bytes_EncodeUInt(unsigned char* destination, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		destination[i] = (unsigned char)(value >> (i * 8));
+	}
+}
+
+void Bytes_EncodeULong(unsigned char* destination, unsigned long long value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		destination[i] = (unsigned char)(value >> (i * 8));
+	}
+}
+
+unsigned int Bytes_DecodeUInt(const unsigned char* source)
+{
+	unsigned int Value = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		Value |= (unsigned int)source[i] << (i * 8);
+	}
+	return Value;
+}
+
+unsigned long long Bytes_DecodeULong(const unsigned char* source)
+{
+	unsigned long long Value = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		Value |= (unsigned long long)source[i] << (i * 8);
+	}
+	return Value;
+}
+
+unsigned int Bytes_Hash(const unsigned char* data, size_t length)
+{
+	return Bytes_HashMore(BYTES_HASH_OFFSET_BASIS, data, length);
+}
+
+unsigned int Bytes_HashMore(unsigned int hash, const unsigned char* data, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		hash = (hash ^ data[i]) * HASH_PRIME;
+	}
+	return hash;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+
+
+// Macros.
+/* FNV-1a, the starting hash of Bytes_HashMore. */
+#define BYTES_HASH_OFFSET_BASIS 2166136261u
+
+
+// Functions.
+/* Binary formats on disk are little endian regardless of the platform. */
+void Bytes_EncodeUInt(unsigned char* destination, unsigned int value);
+
+void Bytes_EncodeULong(unsigned char* destination, unsigned long long value);
+
+unsigned int Bytes_DecodeUInt(const unsigned char* source);
+
+unsigned long long Bytes_DecodeULong(const unsigned char* source);
+
+/// <summary>
+/// Hashes the bytes with 32-bit FNV-1a, used as a checksum of stored data and for hash tables.
+/// </summary>
+unsigned int Bytes_Hash(const unsigned char* data, size_t length);
+
+/// <summary>
+/// Continues a hash with more bytes, hashing data in parts gives the same hash as hashing it at once.
+/// </summary>
+unsigned int Bytes_HashMore(unsigned int hash, const unsigned char* data, size_t length);
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "LTTChar.h"
+#include <stddef.h>
+#include <string.h>
 
 // https://en.wikipedia.org/wiki/List_of_Unicode_characters
 // https://en.wikipedia.org/wiki/UTF-8
@@ -11,29 +13,188 @@
 
 #define IsCodepointInRange(codepoint, lower, upper) ((lower <= codepoint) && (codepoint <= upper))
 
+/* Lookup tables. */
+#define CHAR_TABLE_CODEPOINT_LIMIT 2048 // Every one and two byte UTF-8 character.
+#define CHAR_TABLE_BLOCK_SHIFT 6
+#define CHAR_TABLE_BLOCK_SIZE (1 << CHAR_TABLE_BLOCK_SHIFT)
+#define CHAR_TABLE_BLOCK_COUNT (CHAR_TABLE_CODEPOINT_LIMIT >> CHAR_TABLE_BLOCK_SHIFT)
+
+#define CHAR_FLAG_LETTER 1
+#define CHAR_FLAG_DIGIT 2
+#define CHAR_FLAG_WHITESPACE 4
+
+
+// Types.
+typedef struct CharPropertiesStruct
+{
+	short LowerOffset;
+	short UpperOffset;
+	short SearchOffset;
+	unsigned short Flags;
+} CharProperties;
+
+typedef struct DiacriticFoldStruct
+{
+	unsigned short Codepoint;
+	unsigned short BaseCodepoint;
+} DiacriticFold;
+
+
+// Fields.
+/* Two-level table storing offsets rather than codepoints, so blocks without cased letters are stored only once. */
+static unsigned char s_blockIndices[CHAR_TABLE_BLOCK_COUNT];
+static CharProperties s_blocks[CHAR_TABLE_BLOCK_COUNT][CHAR_TABLE_BLOCK_SIZE];
+
+/* Latvian letters, lowercase forms since folding happens after lowercasing. */
+static const DiacriticFold s_diacriticFolds[] =
+{
+	{ 257, 'a' }, { 269, 'c' }, { 275, 'e' }, { 291, 'g' }, { 299, 'i' }, { 311, 'k' },
+	{ 316, 'l' }, { 326, 'n' }, { 353, 's' }, { 363, 'u' }, { 382, 'z' }
+};
+
 
 // Static functions.
-static void OffsetLetter(char* character, int direction)
+static bool IsLatinExtendedUpperCodepoint(int codepoint)
+{
+	// Latin Extended-A alternates upper and lower case, but the parity flips after the caseless letters.
+	if (IsCodepointInRange(codepoint, 256, 311) || IsCodepointInRange(codepoint, 330, 375)
+		|| IsCodepointInRange(codepoint, 386, 389))
+	{
+		return (codepoint % 2) == 0;
+	}
+	if (IsCodepointInRange(codepoint, 313, 328) || IsCodepointInRange(codepoint, 377, 382)
+		|| IsCodepointInRange(codepoint, 391, 392))
+	{
+		return (codepoint % 2) == 1;
+	}
+	return false;
+}
+
+static bool IsLatinExtendedLowerCodepoint(int codepoint)
+{
+	return !IsLatinExtendedUpperCodepoint(codepoint) && IsLatinExtendedUpperCodepoint(codepoint - 1);
+}
+
+static int GetLowerCodepointByRange(int codepoint)
 {
 	// This does not account for all letters, but fits the project's requirements.
-	int Codepoint = Char_GetCodepoint(character);
+	if (IsCodepointInRange(codepoint, 65, 90))
+	{
+		return codepoint + UTF8_ASCII_CODEPOINT_OFFSET;
+	}
+	if (IsCodepointInRange(codepoint, 192, 222) && (codepoint != 215))
+	{
+		return codepoint + UTF8_LATIN1_CODEPOINT_OFFSET;
+	}
+	if (IsLatinExtendedUpperCodepoint(codepoint))
+	{
+		return codepoint + UTF8_EXTENDED_CODEPOINT_OFFSET;
+	}
+	return codepoint;
+}
+
+static int GetUpperCodepointByRange(int codepoint)
+{
+	if (IsCodepointInRange(codepoint, 97, 122))
+	{
+		return codepoint - UTF8_ASCII_CODEPOINT_OFFSET;
+	}
+	if (IsCodepointInRange(codepoint, 224, 254) && (codepoint != 247))
+	{
+		return codepoint - UTF8_LATIN1_CODEPOINT_OFFSET;
+	}
+	if (IsLatinExtendedLowerCodepoint(codepoint))
+	{
+		return codepoint - UTF8_EXTENDED_CODEPOINT_OFFSET;
+	}
+	return codepoint;
+}
+
+static bool IsLetterByRange(int codepoint)
+{
+	return IsCodepointInRange(codepoint, 65, 90) || IsCodepointInRange(codepoint, 97, 122)
+		|| IsCodepointInRange(codepoint, 192, 214) || IsCodepointInRange(codepoint, 216, 246)
+		|| IsCodepointInRange(codepoint, 248, 687) || IsCodepointInRange(codepoint, 880, 1023);
+}
 
-	if (IsCodepointInRange(Codepoint, 65, 90))
+static int GetDiacriticBaseCodepoint(int lowerCodepoint)
+{
+	for (size_t i = 0; i < sizeof(s_diacriticFolds) / sizeof(DiacriticFold); i++)
 	{
-		Char_SetCodePoint(character, Codepoint + (UTF8_ASCII_CODEPOINT_OFFSET * direction));
+		if (s_diacriticFolds[i].Codepoint == lowerCodepoint)
+		{
+			return s_diacriticFolds[i].BaseCodepoint;
+		}
 	}
-	else if (IsCodepointInRange(Codepoint, 192, 222) && (Codepoint != 215))
+	return lowerCodepoint;
+}
+
+static void BuildTableBlock(CharProperties* block, int firstCodepoint)
+{
+	for (int i = 0; i < CHAR_TABLE_BLOCK_SIZE; i++)
 	{
-		Char_SetCodePoint(character, Codepoint + (UTF8_LATIN1_CODEPOINT_OFFSET * direction));
+		int Codepoint = firstCodepoint + i;
+		CharProperties* Properties = block + i;
+
+		int LowerCodepoint = GetLowerCodepointByRange(Codepoint);
+		Properties->LowerOffset = (short)(LowerCodepoint - Codepoint);
+		Properties->UpperOffset = (short)(GetUpperCodepointByRange(Codepoint) - Codepoint);
+		Properties->SearchOffset = (short)(GetDiacriticBaseCodepoint(LowerCodepoint) - Codepoint);
+		Properties->Flags = (IsLetterByRange(Codepoint) ? CHAR_FLAG_LETTER : 0)
+			| (IsCodepointInRange(Codepoint, '0', '9') ? CHAR_FLAG_DIGIT : 0)
+			| (IsCodepointInRange(Codepoint, 0, 32) ? CHAR_FLAG_WHITESPACE : 0);
 	}
-	else if (IsCodepointInRange(Codepoint, 256, 382) || IsCodepointInRange(Codepoint, 384, 392))
+}
+
+static inline const CharProperties* GetProperties(int codepoint)
+{
+	return &s_blocks[s_blockIndices[codepoint >> CHAR_TABLE_BLOCK_SHIFT]][codepoint & (CHAR_TABLE_BLOCK_SIZE - 1)];
+}
+
+static inline bool IsInTable(int codepoint)
+{
+	return (codepoint >= 0) && (codepoint < CHAR_TABLE_CODEPOINT_LIMIT);
+}
+
+static void OffsetLetter(char* character, int direction)
+{
+	int Codepoint = Char_GetCodepoint(character);
+	int NewCodepoint = direction == OFFSET_DIRECTION_TO_LOWER ? Char_ToLowerCodepoint(Codepoint) : Char_ToUpperCodepoint(Codepoint);
+
+	if (NewCodepoint != Codepoint)
 	{
-		Char_SetCodePoint(character, Codepoint + (UTF8_EXTENDED_CODEPOINT_OFFSET * direction));
+		Char_SetCodePoint(character, NewCodepoint);
 	}
 }
 
 
 // Functions.
+void Char_InitializeTables()
+{
+	int UniqueBlockCount = 0;
+	for (int BlockIndex = 0; BlockIndex < CHAR_TABLE_BLOCK_COUNT; BlockIndex++)
+	{
+		CharProperties* Block = s_blocks[UniqueBlockCount];
+		BuildTableBlock(Block, BlockIndex << CHAR_TABLE_BLOCK_SHIFT);
+
+		int MatchingBlock = UniqueBlockCount;
+		for (int i = 0; i < UniqueBlockCount; i++)
+		{
+			if (memcmp(s_blocks[i], Block, sizeof(CharProperties) * CHAR_TABLE_BLOCK_SIZE) == 0)
+			{
+				MatchingBlock = i;
+				break;
+			}
+		}
+
+		s_blockIndices[BlockIndex] = (unsigned char)MatchingBlock;
+		if (MatchingBlock == UniqueBlockCount)
+		{
+			UniqueBlockCount++;
+		}
+	}
+}
+
 int Char_GetByteCount(const char* character)
 {
 	const unsigned char* Character = (const unsigned char*)character;
@@ -118,6 +279,31 @@ void Char_SetCodePoint(char* character, int codepoint)
 	}
 }
 
+int Char_ToLowerCodepoint(int codepoint)
+{
+	return IsInTable(codepoint) ? codepoint + GetProperties(codepoint)->LowerOffset : codepoint;
+}
+
+int Char_ToUpperCodepoint(int codepoint)
+{
+	return IsInTable(codepoint) ? codepoint + GetProperties(codepoint)->UpperOffset : codepoint;
+}
+
+int Char_ToSearchCodepoint(int codepoint, bool foldDiacritics)
+{
+	if (!IsInTable(codepoint))
+	{
+		return codepoint;
+	}
+	const CharProperties* Properties = GetProperties(codepoint);
+	return codepoint + (foldDiacritics ? Properties->SearchOffset : Properties->LowerOffset);
+}
+
+bool Char_IsLetterCodepoint(int codepoint)
+{
+	return IsInTable(codepoint) && (GetProperties(codepoint)->Flags & CHAR_FLAG_LETTER);
+}
+
 void Char_ToUpper(char* character)
 {
 	OffsetLetter(character, OFFSET_DIRECTION_TO_UPPER);
@@ -130,11 +316,7 @@ void Char_ToLower(char* character)
 
 bool Char_IsLetter(const char* character)
 {
-	int Codepoint = Char_GetCodepoint(character);
-
-	return ((65 <= Codepoint) && (Codepoint <= 90)) || ((97 <= Codepoint) && (Codepoint <= 122))
-		|| ((192 <= Codepoint) && (Codepoint <= 214)) || ((216 <= Codepoint) && (Codepoint <= 246))
-		|| ((248 <= Codepoint) && (Codepoint <= 687)) || ((880 <= Codepoint) && (Codepoint <= 1023));
+	return Char_IsLetterCodepoint(Char_GetCodepoint(character));
 }
 
 bool Char_IsDigit(const char* character)
@@ -144,7 +326,8 @@ bool Char_IsDigit(const char* character)
 
 bool Char_IsWhitespace(const char* character)
 {
-	return (0 <= *character) && (*character <= 32);
+	int Byte = *character;
+	return (Byte >= 0) && (GetProperties(Byte)->Flags & CHAR_FLAG_WHITESPACE);
 }
 
 void Char_CopyTo(const char* source, char* destination)
@@ -159,11 +342,5 @@ void Char_CopyTo(const char* source, char* destination)
 
 bool Char_EqualsCaseInsensitive(const char* char1, const char* char2)
 {
-	char Char1Lower[MAX_UTF8_CODEPOINT_SIZE];
-	char Char2Lower[MAX_UTF8_CODEPOINT_SIZE];
-	Char_CopyTo(char1, Char1Lower);
-	Char_CopyTo(char2, Char2Lower);
-	Char_ToLower(Char1Lower);
-	Char_ToLower(Char2Lower);
-	return Char_GetCodepoint(Char1Lower) == Char_GetCodepoint(Char2Lower);
+	return Char_ToLowerCodepoint(Char_GetCodepoint(char1)) == Char_ToLowerCodepoint(Char_GetCodepoint(char2));
 }
\ No newline at end of file
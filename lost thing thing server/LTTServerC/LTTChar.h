@@ -30,6 +30,12 @@
 
 
 // Functions.
+/// <summary>
+/// Builds the character class tables. Must be called once before any other Char function and before any thread is started,
+/// the tables are read without synchronization.
+/// </summary>
+void Char_InitializeTables();
+
 int Char_GetByteCount(const char* character);
 
 int Char_GetByteCountCodepoint(int codepoint);
@@ -38,6 +44,14 @@ int Char_GetCodepoint(const char* character);
 
 void Char_SetCodePoint(char* character, int codepoint);
 
+int Char_ToLowerCodepoint(int codepoint);
+
+int Char_ToUpperCodepoint(int codepoint);
+
+int Char_ToSearchCodepoint(int codepoint, bool foldDiacritics);
+
+bool Char_IsLetterCodepoint(int codepoint);
+
 void Char_ToUpper(char* character);
 
 void Char_ToLower(char* character);
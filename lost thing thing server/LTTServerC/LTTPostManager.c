@@ -5,12 +5,23 @@
 #include "File.h"
 #include <time.h>
 #include "Logger.h"
+#include "LTTTime.h"
 #include "Memory.h"
 #include "Image.h"
 #include "LTTString.h"
 #include "LTTChar.h"
 #include <limits.h>
 #include "LTTServerResourceManager.h"
+#include "ConfigFile.h"
+#include "LTTSchema.h"
+#include "LTTBase64.h"
+#include "BulkLoader.h"
+#include "AccessLog.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "LTTProbes.h"
+#include <stdlib.h>
+#include <stdint.h>
 
 // Macros.
 #define CACHED_POST_COUNT 128
@@ -21,18 +32,35 @@
 
 #define UNFINISHED_POST_LIFETIME 60
 
+#define FLUSHER_INTERVAL_MILLISECONDS 1000
+
 
 /* Directories and paths. */
 #define ENTRY_FOLDER_NAME_DIVIDER 1000
 #define DIR_NAME_POSTS "posts"
 #define DIR_NAME_ENTRIES "entries"
 #define POST_METAINFO_FILENAME "post_meta" GHDF_FILE_EXTENSION
+#define DIR_NAME_STORE "store"
+#define FILE_NAME_SEGMENT "posts" GHDF_SEGMENT_FILE_EXTENSION
 #define FILE_NAME_THUMBNAIL "thumbnail" FILE_EXTENSION_PNG
+#define FILE_NAME_MUTATION_LOG "post_mutations.wal"
+#define FILE_NAME_INDEX_SNAPSHOT "post_index.snapshot"
+
+
+/* Mutation log. */
+#define MUTATION_LOG_CHECKPOINT_LENGTH (16 * 1024 * 1024)
+#define MUTATION_RECORD_POST 1 // Whole post record.
+#define MUTATION_RECORD_POST_DELETED 2 // No data.
+
+/* Indexes whose removals an index build may defer. */
+#define INDEX_TITLE_MAP 0
+#define INDEX_TITLE_TERMS 1
 
 
 /* Meta-info */
 #define DEFAULT_AVAILABLE_POST_ID 1
 #define ENTRY_ID_METAINFO_AVAIlABLE_POST_ID 1 // ulong
+#define ENTRY_ID_METAINFO_INDEX_GENERATION 2 // ulong, MAY NOT EXIST
 
 
 
@@ -69,6 +97,27 @@
 #define ENTRY_ID_COMMENT_CREATION_TIME 6 // Long
 #define ENTRY_ID_COMMENT_LAST_EDIT_TIME 7 // Long
 
+/* Record schemas, see LTTSchema.h. Comments are nested records and are encoded by hand next to the post's fields. */
+#define COMMENT_SCHEMA(FIELD, LIST) \
+	FIELD(ULong, ID, ENTRY_ID_COMMENT_ID, "id", SCHEMA_GHDF_JSON) \
+	FIELD(ULong, PostID, ENTRY_ID_COMMENT_POST_ID, "post_id", SCHEMA_GHDF) \
+	FIELD(ULong, AuthorID, ENTRY_ID_COMMENT_AUTHOR_ID, "author_id", SCHEMA_GHDF_JSON) \
+	FIELD(ULong, ParentCommentID, ENTRY_ID_COMMENT_PARENT_COMMENT_ID, "parent_comment_id", SCHEMA_GHDF_JSON) \
+	FIELD(String, Contents, ENTRY_ID_COMMENT_CONTENTS, "contents", SCHEMA_GHDF_JSON) \
+	FIELD(Long, CreationTime, ENTRY_ID_COMMENT_CREATION_TIME, "creation_time", SCHEMA_GHDF_JSON) \
+	FIELD(Long, LastEditTime, ENTRY_ID_COMMENT_LAST_EDIT_TIME, "edit_time", SCHEMA_GHDF_JSON)
+
+#define POST_SCHEMA(FIELD, LIST) \
+	FIELD(ULong, ID, ENTRY_ID_POST_ID, "id", SCHEMA_GHDF_JSON) \
+	FIELD(ULong, AuthorID, ENTRY_ID_POST_AUTHOR_ID, "author_id", SCHEMA_GHDF_JSON) \
+	FIELD(String, Title, ENTRY_ID_POST_TITLE, "title", SCHEMA_GHDF_JSON) \
+	FIELD(String, Description, ENTRY_ID_POST_DESCRIPTION, "description", SCHEMA_GHDF_JSON) \
+	FIELD(Long, CreationTime, ENTRY_ID_POST_CREATION_TIME, "creation_time", SCHEMA_GHDF_JSON) \
+	FIELD(Int, Tags, ENTRY_ID_POST_TAGS, "tags", SCHEMA_GHDF_JSON) \
+	FIELD(ULong, ImageCount, ENTRY_ID_POST_IMAGE_COUNT, "image_count", SCHEMA_GHDF_JSON) \
+	FIELD(ULong, ClaimerID, ENTRY_ID_POST_CLAIMER_ID, "claimer", SCHEMA_GHDF_JSON) \
+	LIST(ULong, RequesterIDs, RequesterCount, ENTRY_ID_POST_REQUESTER_IDS, "requesters", SCHEMA_GHDF_JSON | SCHEMA_OPTIONAL)
+
 
 
 // Types.
@@ -76,8 +125,34 @@ typedef struct CachedPostStruct
 {
 	time_t LastAccessTime;
 	Post TargetPost;
+
+	/* Set when the post is changed, the post is only written once it is dirty. */
+	bool IsDirty;
+	time_t DirtyTime;
 } CachedPost;
 
+typedef struct FlushedRecordStruct
+{
+	unsigned long long ID;
+	char* Data;
+	size_t Length;
+} FlushedRecord;
+
+/* Indexes of the posts read by a single loader worker, merged into the context's indexes once all are read. */
+typedef struct PostIndexPartStruct
+{
+	IDCodepointHashMap TitleMap;
+	IDTermDictionary TitleTerms;
+	GHDFArena Arena;
+	size_t ReadPostCount;
+} PostIndexPart;
+
+typedef struct PostIndexBuildStruct
+{
+	DBPostContext* Context;
+	PostIndexPart* Parts;
+} PostIndexBuild;
+
 typedef struct UnfinishedPostImageStruct
 {
 	const char* Data;
@@ -251,6 +326,13 @@ static void PostDeconstruct(Post* post)
 	}
 }
 
+/* For posts read with ReadIndexedPostFromDatabase, the strings belong to the arena they were decoded into. */
+static void PostDeconstructArenaDecoded(Post* post)
+{
+	post->Title = NULL;
+	PostDeconstruct(post);
+}
+
 static void PostSetDefaultValues(Post* post)
 {
 	Memory_Set((char*)post, sizeof(Post), 0);
@@ -315,7 +397,7 @@ static void PostRemoveRequesterIDByIndex(Post* post, size_t index)
 	{
 		post->RequesterIDs[i - 1] = post->RequesterIDs[i];
 	}
-	post->RequesterIDs -= 1;
+	post->RequesterCount -= 1;
 }
 
 static bool PostRemoveRequesterID(Post* post, unsigned long long id)
@@ -540,109 +622,94 @@ static void UnfinishedPostsRefresh(DBPostContext* context)
 
 
 /* Loading and saving posts. */
-static void WriteSingleCommentToCompound(PostComment* comment, GHDFCompound* compound)
+static void WriteCommentGHDF(PostComment* record, GHDFBuffer* buffer)
 {
-	GHDFPrimitive Value;
-
-	Value.ULong = comment->ID;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_ULong, ENTRY_ID_COMMENT_ID, Value);
-	Value.ULong = comment->PostID;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_ULong, ENTRY_ID_COMMENT_POST_ID, Value);
-	Value.ULong = comment->AuthorID;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_ULong, ENTRY_ID_COMMENT_AUTHOR_ID, Value);
-	Value.ULong = comment->ParentCommentID;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_ULong, ENTRY_ID_COMMENT_PARENT_COMMENT_ID, Value);
-	Value.String = String_CreateCopy(comment->Contents);
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_String, ENTRY_ID_COMMENT_CONTENTS, Value);
-	Value.Long = comment->CreationTime;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_Long, ENTRY_ID_COMMENT_CREATION_TIME, Value);
-	Value.Long = comment->LastEditTime;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_Long, ENTRY_ID_COMMENT_LAST_EDIT_TIME, Value);
+	GHDFBuffer_WriteCompoundHeader(buffer, 0 COMMENT_SCHEMA(SCHEMA_COUNT_FIELD, SCHEMA_COUNT_LIST));
+	COMMENT_SCHEMA(SCHEMA_WRITE_FIELD, SCHEMA_WRITE_LIST)
 }
 
-static void WriteCommentsToCompound(Post* post, GHDFCompound* baseCompound)
+static void WritePostGHDF(Post* record, GHDFBuffer* buffer)
 {
-	if (post->CommentCount == 0)
-	{
-		return;
-	}
+	unsigned int EntryCount = 0 POST_SCHEMA(SCHEMA_COUNT_FIELD, SCHEMA_COUNT_LIST);
+	GHDFBuffer_WriteCompoundHeader(buffer, EntryCount + ((record->CommentCount > 0) ? 1 : 0));
+	POST_SCHEMA(SCHEMA_WRITE_FIELD, SCHEMA_WRITE_LIST)
 
-	GHDFPrimitive* CompoundArray = (GHDFPrimitive*)Memory_SafeMalloc(sizeof(GHDFPrimitive) * post->CommentCount);
-	for (size_t i = 0; i < post->CommentCount; i++)
+	if (record->CommentCount > 0)
 	{
-		GHDFCompound* CommentCompound = (GHDFCompound*)Memory_SafeMalloc(sizeof(GHDFCompound));
-		CompoundArray[i].Compound = CommentCompound;
-		GHDFCompound_Construct(CommentCompound, COMPOUND_DEFAULT_CAPACITY);
-		WriteSingleCommentToCompound(post->Comments + i, CommentCompound);
+		size_t EntryStart = GHDFBuffer_BeginArrayEntry(buffer, GHDFType_Compound, ENTRY_ID_POST_COMMENT_ARRAY,
+			(unsigned int)record->CommentCount);
+		for (size_t i = 0; i < record->CommentCount; i++)
+		{
+			WriteCommentGHDF(record->Comments + i, buffer);
+		}
+		GHDFBuffer_EndEntry(buffer, EntryStart);
 	}
-
-	GHDFCompound_AddArrayEntry(baseCompound, GHDFType_Compound, ENTRY_ID_POST_COMMENT_ARRAY,
-		CompoundArray, (unsigned int)post->CommentCount);
 }
 
-static void WriteRequestersToCompound(Post* post, GHDFCompound* compound)
+/* Store writes only last once flushed, until then the mutation log holds the changes. Called with the write lock held. */
+static Error WritePostData(DBPostContext* context, unsigned long long id, const char* data, size_t dataLength)
 {
-	if (post->RequesterCount == 0)
+	unsigned long long StorageStartTime = AccessLog_BeginStorage();
+	const char* FilePath = GetPathToIDFile(context, id, GHDF_FILE_EXTENSION);
+	Error ReturnedError;
+	if (context->RecordStore)
 	{
-		return;
+		ReturnedError = Store_Put(context->RecordStore, id, data, dataLength);
+		if ((ReturnedError.Code == ErrorCode_Success) && File_Exists(FilePath))
+		{
+			// Posts still in their own file from before the store was enabled are moved over once written.
+			RecordIDList_Add(&context->_movedRecordIDs, id);
+		}
 	}
-
-	GHDFPrimitive* ValueArray = (GHDFPrimitive*)Memory_SafeMalloc(sizeof(GHDFPrimitive) * post->RequesterCount);
-	for (unsigned int i = 0; i < (unsigned int)post->RequesterCount; i++)
+	else
 	{
-		ValueArray[i].ULong = post->RequesterIDs[i];
+		GHDFBuffer Buffer = { (char*)data, dataLength, dataLength };
+		ReturnedError = GHDFBuffer_WriteToFile(&Buffer, FilePath, context->SyncWrites);
 	}
-
-	GHDFCompound_AddArrayEntry(compound, GHDFType_ULong, ENTRY_ID_POST_REQUESTER_IDS, ValueArray,
-		(unsigned int)post->RequesterCount);
+	Memory_Free((char*)FilePath);
+	AccessLog_EndStorage(StorageStartTime);
+	return ReturnedError;
 }
 
-static void WritePostToCompound(Post* post, GHDFCompound* compound)
-{
-	GHDFPrimitive Value;
-	Value.ULong = post->ID;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_ULong, ENTRY_ID_POST_ID, Value);
-	Value.ULong = post->AuthorID;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_ULong, ENTRY_ID_POST_AUTHOR_ID, Value);
-	Value.String = String_CreateCopy(post->Title);
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_String, ENTRY_ID_POST_TITLE, Value);
-	Value.String = String_CreateCopy(post->Description);
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_String, ENTRY_ID_POST_DESCRIPTION, Value);
-	Value.Long = post->CreationTime;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_Long, ENTRY_ID_POST_CREATION_TIME, Value);
-	Value.Int = post->Tags;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_Int, ENTRY_ID_POST_TAGS, Value);
-	Value.ULong = post->ImageCount;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_ULong, ENTRY_ID_POST_IMAGE_COUNT, Value);
-	Value.ULong = post->ClaimerID;
-	GHDFCompound_AddSingleValueEntry(compound, GHDFType_ULong, ENTRY_ID_POST_CLAIMER_ID, Value);
-
-	WriteRequestersToCompound(post, compound);
-	WriteCommentsToCompound(post, compound);
-}
-
-static Error WritePostToDatabase(DBPostContext* context, Post* post)
+static Error WritePostRecord(DBPostContext* context, Post* post)
 {
-	GHDFCompound Compound;
-	GHDFCompound_Construct(&Compound, COMPOUND_DEFAULT_CAPACITY);
-	WritePostToCompound(post, &Compound);
+	GHDFBuffer* Buffer = GHDFBuffer_GetThreadBuffer();
+	GHDFBuffer_BeginFile(Buffer);
+	WritePostGHDF(post, Buffer);
+	return WritePostData(context, post->ID, Buffer->Data, Buffer->Length);
+}
 
-	const char* FilePath = GetPathToIDFile(context, post->ID, GHDF_FILE_EXTENSION);
-	const char* DirectoryPath = Directory_GetParentDirectory(FilePath);
-	Directory_CreateAll(DirectoryPath);
-	Memory_Free((char*)DirectoryPath);
+static Error FlushPostRecords(DBPostContext* context)
+{
+	if (!context->RecordStore)
+	{
+		return Error_CreateSuccess();
+	}
 
-	Error ReturnedError = GHDFCompound_WriteToFile(FilePath, &Compound);
-	Memory_Free((char*)FilePath);
-	GHDFCompound_Deconstruct(&Compound);
+	unsigned long long StorageStartTime = AccessLog_BeginStorage();
+	Error ReturnedError = Store_Flush(context->RecordStore);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		for (size_t i = 0; i < context->_movedRecordIDs.Count; i++)
+		{
+			const char* FilePath = GetPathToIDFile(context, context->_movedRecordIDs.IDs[i], GHDF_FILE_EXTENSION);
+			File_Delete(FilePath);
+			Memory_Free((char*)FilePath);
+		}
+		context->_movedRecordIDs.Count = 0;
+	}
+	AccessLog_EndStorage(StorageStartTime);
 	return ReturnedError;
 }
 
 static Error CreatePostThumbnailInDatabase(DBPostContext* context, UnfinishedPostImage* image, unsigned long long postID)
 {
 	Image ReadImage;
+	TraceSpan Span = Trace_BeginSpan("image decode");
 	ReadImage.Data = stbi_load_from_memory((const unsigned char*)image->Data, (int)image->Length, &ReadImage.SizeX,
 		&ReadImage.SizeY, &ReadImage.ColorChannels, STBI_rgb);
+	Trace_EndSpan(Span);
+	LTT_PROBE_IMAGE_DECODE(image->Length, ReadImage.Data ? ReadImage.SizeX : 0, ReadImage.Data ? ReadImage.SizeY : 0);
 
 	if (!ReadImage.Data)
 	{
@@ -653,7 +720,10 @@ static Error CreatePostThumbnailInDatabase(DBPostContext* context, UnfinishedPos
 
 
 	const char* FilePath = GetPathToThumbnail(context, postID);
+	Span = Trace_BeginSpan("image encode");
 	int Result = stbi_write_png(FilePath, ReadImage.SizeX, ReadImage.SizeY, STBI_rgb, ReadImage.Data, 0);
+	Trace_EndSpan(Span);
+	LTT_PROBE_IMAGE_ENCODE(ReadImage.SizeX, ReadImage.SizeY, Result != 0);
 
 	Memory_Free((char*)FilePath);
 	Memory_Free((char*)ReadImage.Data);
@@ -669,8 +739,11 @@ static Error CreatePostThumbnailInDatabase(DBPostContext* context, UnfinishedPos
 static Error SaveSinglePostImageToDatabase(DBPostContext* context, unsigned long long postID, UnfinishedPostImage* image, int imageIndex)
 {
 	Image ReadImage;
+	TraceSpan Span = Trace_BeginSpan("image decode");
 	ReadImage.Data = stbi_load_from_memory((const unsigned char*)image->Data, (int)image->Length, &ReadImage.SizeX,
 		&ReadImage.SizeY, &ReadImage.ColorChannels, STBI_rgb);
+	Trace_EndSpan(Span);
+	LTT_PROBE_IMAGE_DECODE(image->Length, ReadImage.Data ? ReadImage.SizeX : 0, ReadImage.Data ? ReadImage.SizeY : 0);
 
 	if (!ReadImage.Data)
 	{
@@ -683,7 +756,10 @@ static Error SaveSinglePostImageToDatabase(DBPostContext* context, unsigned long
 	}
 
 	const char* FilePath = GetPathToPostImageFile(context, postID, imageIndex);
+	Span = Trace_BeginSpan("image encode");
 	int Result = stbi_write_png(FilePath, ReadImage.SizeX, ReadImage.SizeY, STBI_rgb, ReadImage.Data, 0);
+	Trace_EndSpan(Span);
+	LTT_PROBE_IMAGE_ENCODE(ReadImage.SizeX, ReadImage.SizeY, Result != 0);
 
 	Memory_Free((char*)FilePath);
 	Memory_Free((char*)ReadImage.Data);
@@ -721,184 +797,96 @@ static Error CreatePostImagesInDatabase(DBPostContext* context, unsigned long lo
 	return Error_CreateSuccess();
 }
 
-static Error ReadSingleCommentFromCompound(PostComment* comment, GHDFCompound* compound)
+static Error ReadCommentGHDF(GHDFReader* reader, PostComment* record)
 {
-	GHDFEntry* Entry;
-
-	Error ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_COMMENT_ID, &Entry, GHDFType_ULong, "Comment ID");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	comment->ID = Entry->Value.SingleValue.ULong;
-
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_COMMENT_AUTHOR_ID, &Entry, GHDFType_ULong, "Comment Author ID");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	comment->AuthorID = Entry->Value.SingleValue.ULong;
-
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_COMMENT_POST_ID, &Entry, GHDFType_ULong, "Comment Post ID");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	comment->PostID = Entry->Value.SingleValue.ULong;
-
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_COMMENT_CREATION_TIME, &Entry,
-		GHDFType_Long, "Comment Creation Time");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	comment->CreationTime = Entry->Value.SingleValue.Long;
+	unsigned int EntryCount;
+	Error ReturnedError = GHDFReader_ReadCompoundHeader(reader, &EntryCount);
+	SchemaEntrySet FoundEntries = 0;
 
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_COMMENT_LAST_EDIT_TIME, &Entry,
-		GHDFType_Long, "Comment Last Edit Time");
-	if (ReturnedError.Code != ErrorCode_Success)
+	for (unsigned int i = 0; (i < EntryCount) && (ReturnedError.Code == ErrorCode_Success); i++)
 	{
-		return ReturnedError;
-	}
-	comment->LastEditTime = Entry->Value.SingleValue.Long;
+		GHDFEntryInfo Info;
+		ReturnedError = Schema_ReadEntryInfo(reader, &Info, &FoundEntries);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			break;
+		}
 
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_COMMENT_PARENT_COMMENT_ID, &Entry,
-		GHDFType_ULong, "Comment Parent Comment ID");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
+		COMMENT_SCHEMA(SCHEMA_READ_FIELD, SCHEMA_READ_LIST)
+		{
+			ReturnedError = GHDFReader_SkipValue(reader, &Info);
+		}
 	}
-	comment->ParentCommentID = Entry->Value.SingleValue.ULong;
 
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_COMMENT_CONTENTS, &Entry,
-		GHDFType_String, "Comment Contents");
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
-	comment->Contents = String_CreateCopy(Entry->Value.SingleValue.String);
-
-	return Error_CreateSuccess();
+	return Schema_VerifyRequiredEntries(FoundEntries, 0 COMMENT_SCHEMA(SCHEMA_REQUIRED_FIELD, SCHEMA_REQUIRED_LIST), "Post Comment");
 }
 
-static Error ReadCommentsFromCompound(Post* post, GHDFCompound* compound)
+static Error ReadCommentsGHDF(GHDFReader* reader, GHDFEntryInfo* info, Post* record)
 {
-	GHDFEntry* Entry;
-	Error ReturnedError = GHDFCompound_GetVerifiedOptionalEntry(compound, ENTRY_ID_POST_COMMENT_ARRAY, &Entry,
-		GHDFType_Compound | GHDF_TYPE_ARRAY_BIT, "Post Comments");
-	if (!Entry)
-	{
-		return Error_CreateSuccess();
-	}
+	unsigned int CommentCount;
+	Error ReturnedError = GHDFReader_ReadArrayHeader(reader, info, GHDFType_Compound, &CommentCount);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
 
-	PostEnsureCommentCapacity(post, Entry->Value.ValueArray.Size);
-	post->CommentCount = Entry->Value.ValueArray.Size;
-	for (unsigned int i = 0; i < post->CommentCount; i++)
+	PostEnsureCommentCapacity(record, CommentCount);
+	for (unsigned int i = 0; i < CommentCount; i++)
 	{
-		ReturnedError = ReadSingleCommentFromCompound(post->Comments + i, Entry->Value.ValueArray.Array[i].Compound);
+		// Counted before reading so that the strings of a partially read comment are freed with the post.
+		Memory_Set((char*)(record->Comments + i), sizeof(PostComment), 0);
+		record->CommentCount = i + 1;
+
+		ReturnedError = ReadCommentGHDF(reader, record->Comments + i);
 		if (ReturnedError.Code != ErrorCode_Success)
 		{
 			return ReturnedError;
 		}
 	}
 
-	return Error_CreateSuccess();
-}
-
-static Error ReadRequestersFromCompound(Post* post, GHDFCompound* compound)
-{
-	GHDFEntry* Entry;
-	Error ReturnedError = GHDFCompound_GetVerifiedOptionalEntry(compound, ENTRY_ID_POST_REQUESTER_IDS, &Entry,
-		GHDFType_ULong | GHDF_TYPE_ARRAY_BIT, "Post Requesters");
-	if (!Entry)
-	{
-		return Error_CreateSuccess();
-	}
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-
-	PostEnsureRequesterCapacity(post, Entry->Value.ValueArray.Size);
-	post->RequesterCount = Entry->Value.ValueArray.Size;
-	for (unsigned int i = 0; i < post->RequesterCount; i++)
-	{
-		post->RequesterIDs[i] = Entry->Value.ValueArray.Array[i].ULong;
-	}
-
-	return Error_CreateSuccess();
+	return GHDFReader_EndValue(reader, info);
 }
 
-static Error ReadPostFromCompound(Post* post, GHDFCompound* compound)
+/* Decodes the post's entries straight into the struct, entries outside of the mask are skipped without being decoded.
+* On failure the post may be partially filled and still has to be deconstructed. */
+static Error ReadPostGHDF(GHDFReader* reader, unsigned int entryCount, SchemaEntrySet entryMask, Post* record)
 {
-	GHDFEntry* Entry;
-
-	Error ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_POST_ID, &Entry, GHDFType_ULong, "Post ID");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	post->ID = Entry->Value.SingleValue.ULong;
-
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_POST_AUTHOR_ID, &Entry, GHDFType_ULong, "Post Author ID");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	post->AuthorID = Entry->Value.SingleValue.ULong;
-
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_POST_TITLE, &Entry, GHDFType_String, "Post Title");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	post->Title = String_CreateCopy(Entry->Value.SingleValue.String);
-
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_POST_DESCRIPTION, &Entry, GHDFType_String, "Post Description");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	post->Description = String_CreateCopy(Entry->Value.SingleValue.String);
-
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_POST_IMAGE_COUNT, &Entry, GHDFType_ULong, "Post Image Count");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	post->ImageCount = Entry->Value.SingleValue.ULong;
-
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_POST_TAGS, &Entry, GHDFType_Int, "Post Tags");
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
-	}
-	post->Tags = Entry->Value.SingleValue.Int;
+	Error ReturnedError = Error_CreateSuccess();
+	SchemaEntrySet FoundEntries = 0;
 
-	ReturnedError = GHDFCompound_GetVerifiedEntry(compound, ENTRY_ID_POST_CLAIMER_ID, &Entry, GHDFType_ULong, "Post Claimer ID");
-	if (ReturnedError.Code != ErrorCode_Success)
+	for (unsigned int i = 0; (i < entryCount) && (ReturnedError.Code == ErrorCode_Success); i++)
 	{
-		return ReturnedError;
-	}
-	post->ClaimerID = Entry->Value.SingleValue.ULong;
+		GHDFEntryInfo Info;
+		ReturnedError = Schema_ReadEntryInfo(reader, &Info, &FoundEntries);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			break;
+		}
 
-	ReturnedError = ReadRequestersFromCompound(post, compound);
-	if (ReturnedError.Code != ErrorCode_Success)
-	{
-		return ReturnedError;
+		if (!SchemaEntrySet_Contains(entryMask, Info.ID))
+		{
+			ReturnedError = GHDFReader_SkipValue(reader, &Info);
+		}
+		else if (Info.ID == ENTRY_ID_POST_COMMENT_ARRAY)
+		{
+			ReturnedError = ReadCommentsGHDF(reader, &Info, record);
+		}
+		else POST_SCHEMA(SCHEMA_READ_FIELD, SCHEMA_READ_LIST)
+		{
+			ReturnedError = GHDFReader_SkipValue(reader, &Info);
+		}
 	}
+	record->_requesterCapacity = record->RequesterCount;
 
-	ReturnedError = ReadCommentsFromCompound(post, compound);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
-
-	return Error_CreateSuccess();
+	return Schema_VerifyRequiredEntries(FoundEntries, entryMask & (0 POST_SCHEMA(SCHEMA_REQUIRED_FIELD, SCHEMA_REQUIRED_LIST)), "Post");
 }
 
 static Error ReadPostThumbnailData(DBPostContext* context, Post* post)
@@ -923,9 +911,53 @@ static Error ReadPostThumbnailData(DBPostContext* context, Post* post)
 	return ReturnedError;
 }
 
+static bool DecodePostFromDatabase(DBPostContext* context, Post* post, const char* data, size_t dataLength, Error* error)
+{
+	PostSetDefaultValues(post);
+	GHDFReader Reader;
+	unsigned int EntryCount;
+	*error = GHDFReader_Open(&Reader, data, dataLength, NULL, &EntryCount);
+	if (error->Code == ErrorCode_Success)
+	{
+		*error = ReadPostGHDF(&Reader, EntryCount, SCHEMA_ALL_ENTRIES, post);
+	}
+	if (error->Code != ErrorCode_Success)
+	{
+		PostDeconstruct(post);
+		return false;
+	}
+
+	*error = ReadPostThumbnailData(context, post);
+	if (error->Code != ErrorCode_Success)
+	{
+		PostDeconstruct(post);
+		return false;
+	}
+
+	return true;
+}
+
 static bool ReadPostFromDatabase(DBPostContext* context, Post* post, unsigned long long id, Error* error)
 {
 	*error = Error_CreateSuccess();
+	if (context->RecordStore)
+	{
+		char* Data;
+		size_t DataLength;
+		bool IsFound;
+		*error = Store_Get(context->RecordStore, id, NULL, &Data, &DataLength, &IsFound);
+		if (error->Code != ErrorCode_Success)
+		{
+			return false;
+		}
+		if (IsFound)
+		{
+			bool IsRead = DecodePostFromDatabase(context, post, Data, DataLength, error);
+			Memory_Free(Data);
+			return IsRead;
+		}
+	}
+
 	const char* FilePath = GetPathToIDFile(context, id, GHDF_FILE_EXTENSION);
 	if (!File_Exists(FilePath))
 	{
@@ -933,31 +965,76 @@ static bool ReadPostFromDatabase(DBPostContext* context, Post* post, unsigned lo
 		return false;
 	}
 
-	GHDFCompound Compound;
-	*error = GHDFCompound_ReadFromFile(FilePath, &Compound);
+	FileMapping Mapping;
+	*error = File_MapRead(FilePath, &Mapping);
 	Memory_Free((char*)FilePath);
 	if (error->Code != ErrorCode_Success)
 	{
 		return false;
 	}
 
-	PostSetDefaultValues(post);
-	*error = ReadPostFromCompound(post, &Compound);
-	GHDFCompound_Deconstruct(&Compound);
-	if (error->Code != ErrorCode_Success)
-	{
-		PostDeconstruct(post);
-		return false;
+	bool IsRead = DecodePostFromDatabase(context, post, Mapping.Data, Mapping.Length, error);
+	File_Unmap(&Mapping);
+	return IsRead;
+}
+
+/* Reads only what the search indices need, the rest of the file such as the comments is skipped without being decoded. */
+static bool ReadIndexedPostFromDatabase(DBPostContext* context, Post* post, unsigned long long id, GHDFArena* arena, Error* error)
+{
+	*error = Error_CreateSuccess();
+	GHDFLazyCompound LazyCompound;
+	bool IsFound = false;
+	if (context->RecordStore)
+	{
+		char* Data;
+		size_t DataLength;
+		*error = Store_Get(context->RecordStore, id, arena, &Data, &DataLength, &IsFound);
+		if ((error->Code == ErrorCode_Success) && IsFound)
+		{
+			*error = GHDFLazyCompound_Open(Data, DataLength, arena, &LazyCompound);
+		}
+		if (error->Code != ErrorCode_Success)
+		{
+			return false;
+		}
 	}
 
-	*error = ReadPostThumbnailData(context, post);
-	if (error->Code != ErrorCode_Success)
+	if (!IsFound)
 	{
-		PostDeconstruct(post);
-		return false;
+		const char* FilePath = GetPathToIDFile(context, id, GHDF_FILE_EXTENSION);
+		if (!File_Exists(FilePath))
+		{
+			Memory_Free((char*)FilePath);
+			return false;
+		}
+
+		if (context->UpgradeFileFormat)
+		{
+			// The build may run while the post is being written.
+			bool IsUpgraded;
+			ThreadLock_Lock(&context->_recordWriteLock);
+			*error = GHDFCompound_UpgradeFile(FilePath, context->SyncWrites, &IsUpgraded);
+			ThreadLock_Unlock(&context->_recordWriteLock);
+			if (error->Code != ErrorCode_Success)
+			{
+				Memory_Free((char*)FilePath);
+				return false;
+			}
+		}
+
+		*error = GHDFLazyCompound_OpenFile(FilePath, arena, &LazyCompound);
+		Memory_Free((char*)FilePath);
+		if (error->Code != ErrorCode_Success)
+		{
+			return false;
+		}
 	}
 
-	return true;
+	PostSetDefaultValues(post);
+	GHDFReader Reader;
+	GHDFLazyCompound_BeginReading(&LazyCompound, &Reader);
+	*error = ReadPostGHDF(&Reader, LazyCompound.Count, SchemaEntryBit(ENTRY_ID_POST_ID) | SchemaEntryBit(ENTRY_ID_POST_TITLE), post);
+	return error->Code == ErrorCode_Success;
 }
 
 static void DeletePostFromDatabase(DBPostContext* context, unsigned long long id)
@@ -968,6 +1045,14 @@ static void DeletePostFromDatabase(DBPostContext* context, unsigned long long id
 
 	Directory_Delete(PathBuilder.Data);
 	StringBuilder_Deconstruct(&PathBuilder);
+
+	if (context->RecordStore)
+	{
+		unsigned long long StorageStartTime = AccessLog_BeginStorage();
+		Error ReturnedError = Store_Delete(context->RecordStore, id);
+		AccessLog_EndStorage(StorageStartTime);
+		Error_Deconstruct(&ReturnedError);
+	}
 }
 
 
@@ -978,27 +1063,54 @@ static void InitializePostCache(DBPostContext* context)
 	for (int i = 0; i < CACHED_POST_COUNT; i++)
 	{
 		context->CachedPosts[i].LastAccessTime = CACHED_POST_UNLOADED_TIME;
+		context->CachedPosts[i].IsDirty = false;
+	}
+}
+
+/* Must be called with the cache lock held by everything which changes a cached post.
+* Cached posts are handed out from their cache spot, so the spot is found from the post's address. */
+static void MarkPostDirty(DBPostContext* context, Post* post)
+{
+	uintptr_t Offset = (uintptr_t)post - (uintptr_t)&context->CachedPosts[0].TargetPost;
+	if (((Offset % sizeof(CachedPost)) != 0) || ((Offset / sizeof(CachedPost)) >= CACHED_POST_COUNT))
+	{
+		return;
+	}
+
+	CachedPost* PostCached = context->CachedPosts + (Offset / sizeof(CachedPost));
+	if (!PostCached->IsDirty)
+	{
+		PostCached->IsDirty = true;
+		PostCached->DirtyTime = time(NULL);
 	}
 }
 
 static Error ClearCacheSpotByIndex(DBPostContext* context, int index, bool savePost)
 {
 	CachedPost* PostCached = context->CachedPosts + index;
-	if (PostCached->LastAccessTime != CACHED_POST_UNLOADED_TIME && savePost)
+	Error ReturnedError = Error_CreateSuccess();
+
+	ThreadLock_Lock(&context->_recordWriteLock);
+	ThreadLock_Lock(&context->_cacheLock);
+	if (PostCached->LastAccessTime != CACHED_POST_UNLOADED_TIME)
 	{
-		if (savePost)
+		// Posts which weren't changed since they were last written are dropped without writing anything.
+		if (savePost && PostCached->IsDirty)
 		{
-			Error ReturnedError = WritePostToDatabase(context, &PostCached->TargetPost);
-			if (ReturnedError.Code != ErrorCode_Success)
-			{
-				return ReturnedError;
-			}
+			ReturnedError = WritePostRecord(context, &PostCached->TargetPost);
+		}
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			LTT_PROBE_CACHE_EVICT(LTT_PROBE_CACHE_POST, PostCached->TargetPost.ID, savePost && PostCached->IsDirty);
+			PostDeconstruct(&PostCached->TargetPost);
+			PostCached->LastAccessTime = CACHED_POST_UNLOADED_TIME;
+			PostCached->IsDirty = false;
 		}
-		PostDeconstruct(&PostCached->TargetPost);
-		PostCached->LastAccessTime = CACHED_POST_UNLOADED_TIME;
 	}
+	ThreadLock_Unlock(&context->_cacheLock);
+	ThreadLock_Unlock(&context->_recordWriteLock);
 
-	return Error_CreateSuccess();
+	return ReturnedError;
 }
 
 static CachedPost* GetCacheSpotForPost(DBPostContext* context, Error* error, bool savePost)
@@ -1027,12 +1139,20 @@ static CachedPost* LoadPostIntoCache(DBPostContext* context, unsigned long long
 		return NULL;
 	}
 
-	PostCached->LastAccessTime = time(NULL);
-	if (!ReadPostFromDatabase(context, &PostCached->TargetPost, postID, error))
+	Post LoadedPost;
+	unsigned long long StorageStartTime = AccessLog_BeginStorage();
+	bool IsPostRead = ReadPostFromDatabase(context, &LoadedPost, postID, error);
+	AccessLog_EndStorage(StorageStartTime);
+	if (!IsPostRead)
 	{
 		return NULL;
 	}
 
+	ThreadLock_Lock(&context->_cacheLock);
+	PostCached->TargetPost = LoadedPost;
+	PostCached->LastAccessTime = time(NULL);
+	PostCached->IsDirty = false;
+	ThreadLock_Unlock(&context->_cacheLock);
 	return PostCached;
 }
 
@@ -1052,26 +1172,39 @@ static Post* TryGetPostFromCache(DBPostContext* context, unsigned long long id)
 
 static Error SaveAllCachedPostsToDatabase(DBPostContext* context)
 {
-	for (int i = 0; i < CACHED_POST_COUNT; i++)
+	ThreadLock_Lock(&context->_recordWriteLock);
+	ThreadLock_Lock(&context->_cacheLock);
+
+	Error ReturnedError = Error_CreateSuccess();
+	for (int i = 0; (i < CACHED_POST_COUNT) && (ReturnedError.Code == ErrorCode_Success); i++)
 	{
-		if (context->CachedPosts[i].LastAccessTime != CACHED_POST_UNLOADED_TIME)
+		if ((context->CachedPosts[i].LastAccessTime != CACHED_POST_UNLOADED_TIME) && context->CachedPosts[i].IsDirty)
 		{
-			Error ReturnedError = WritePostToDatabase(context, &context->CachedPosts[i].TargetPost);
-			if (ReturnedError.Code != ErrorCode_Success)
-			{
-				return ReturnedError;
-			}
+			ReturnedError = WritePostRecord(context, &context->CachedPosts[i].TargetPost);
 		}
 	}
-
-	return Error_CreateSuccess();
-}
-
-static Error RemovePostFromCacheByID(DBPostContext* context, unsigned long long id, bool savePost)
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = FlushPostRecords(context);
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		for (int i = 0; i < CACHED_POST_COUNT; i++)
+		{
+			context->CachedPosts[i].IsDirty = false;
+		}
+	}
+
+	ThreadLock_Unlock(&context->_cacheLock);
+	ThreadLock_Unlock(&context->_recordWriteLock);
+	return ReturnedError;
+}
+
+static Error RemovePostFromCacheByID(DBPostContext* context, unsigned long long id, bool savePost)
 {
 	for (int i = 0; i < CACHED_POST_COUNT; i++)
 	{
-		if (context->CachedPosts[i].TargetPost.ID == id)
+		if ((context->CachedPosts[i].TargetPost.ID == id) && (context->CachedPosts[i].LastAccessTime != CACHED_POST_UNLOADED_TIME))
 		{
 			return ClearCacheSpotByIndex(context, i, savePost);
 		}
@@ -1080,44 +1213,501 @@ static Error RemovePostFromCacheByID(DBPostContext* context, unsigned long long
 	return Error_CreateSuccess();
 }
 
+/* Takes every post which has been dirty for too long, then writes them all with a single flush. */
+static Error WriteOldDirtyPosts(DBPostContext* context)
+{
+	FlushedRecord Records[CACHED_POST_COUNT];
+	size_t RecordCount = 0;
+
+	// Holding the write lock keeps evictions from writing a newer version of a post before this older one.
+	ThreadLock_Lock(&context->_recordWriteLock);
+	ThreadLock_Lock(&context->_cacheLock);
+	time_t CurrentTime = time(NULL);
+	for (int i = 0; i < CACHED_POST_COUNT; i++)
+	{
+		CachedPost* PostCached = context->CachedPosts + i;
+		if ((PostCached->LastAccessTime == CACHED_POST_UNLOADED_TIME) || !PostCached->IsDirty
+			|| ((CurrentTime - PostCached->DirtyTime) < context->MaxDirtyAge))
+		{
+			continue;
+		}
+
+		GHDFBuffer* Buffer = GHDFBuffer_GetThreadBuffer();
+		GHDFBuffer_BeginFile(Buffer);
+		WritePostGHDF(&PostCached->TargetPost, Buffer);
+		Records[RecordCount].ID = PostCached->TargetPost.ID;
+		Records[RecordCount].Data = (char*)Memory_SafeMalloc(Buffer->Length);
+		Records[RecordCount].Length = Buffer->Length;
+		Memory_Copy(Buffer->Data, Records[RecordCount].Data, Buffer->Length);
+		RecordCount++;
+		PostCached->IsDirty = false;
+	}
+	ThreadLock_Unlock(&context->_cacheLock);
+
+	Error ReturnedError = Error_CreateSuccess();
+	for (size_t i = 0; (i < RecordCount) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		ReturnedError = WritePostData(context, Records[i].ID, Records[i].Data, Records[i].Length);
+	}
+
+	ThreadLock_Lock(&context->_cacheLock);
+	for (size_t i = 0; i < RecordCount; i++)
+	{
+		Post* FlushedPost = (ReturnedError.Code == ErrorCode_Success) ? NULL : TryGetPostFromCache(context, Records[i].ID);
+		if (FlushedPost)
+		{
+			MarkPostDirty(context, FlushedPost);
+		}
+		Memory_Free(Records[i].Data);
+	}
+	ThreadLock_Unlock(&context->_cacheLock);
+	ThreadLock_Unlock(&context->_recordWriteLock);
+	return ReturnedError;
+}
+
+static void RunFlusher(void* argument)
+{
+	DBPostContext* Context = (DBPostContext*)argument;
+
+	ThreadLock_Lock(&Context->_cacheLock);
+	while (!Atomic_Load(&Context->_isClosing))
+	{
+		ThreadCondition_Wait(&Context->_flushCondition, &Context->_cacheLock, FLUSHER_INTERVAL_MILLISECONDS);
+		ThreadLock_Unlock(&Context->_cacheLock);
+
+		// Failed posts stay dirty and are retried on the next pass.
+		Error ReturnedError = WriteOldDirtyPosts(Context);
+		Error_Deconstruct(&ReturnedError);
+
+		ThreadLock_Lock(&Context->_cacheLock);
+	}
+	ThreadLock_Unlock(&Context->_cacheLock);
+}
+
+static void StopFlusher(DBPostContext* context)
+{
+	ThreadLock_Lock(&context->_cacheLock);
+	Atomic_Store(&context->_isClosing, 1);
+	ThreadCondition_WakeAll(&context->_flushCondition);
+	ThreadLock_Unlock(&context->_cacheLock);
+	Thread_Join(&context->_flushThread);
+}
+
 
 /* ID Hashmap. */
+static Error SaveMetaInfo(DBPostContext* context);
+
+static const char* GetPathToIndexSnapshot(DBPostContext* context)
+{
+	return Directory_CombinePaths(context->PostRootPath, FILE_NAME_INDEX_SNAPSHOT);
+}
+
+/* The saved snapshot no longer matches the indexes, moving to a new generation makes it stale without rewriting it. */
+static void MarkIndexChanged(DBPostContext* context)
+{
+	ThreadLock_Lock(&context->_indexSnapshotLock);
+	if (!context->_isIndexSnapshotCurrent)
+	{
+		ThreadLock_Unlock(&context->_indexSnapshotLock);
+		return;
+	}
+
+	context->_isIndexSnapshotCurrent = false;
+	context->IndexGeneration++;
+	Error ReturnedError = SaveMetaInfo(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		const char* SnapshotPath = GetPathToIndexSnapshot(context);
+		File_Delete(SnapshotPath);
+		Memory_Free((char*)SnapshotPath);
+		Error_Deconstruct(&ReturnedError);
+	}
+	ThreadLock_Unlock(&context->_indexSnapshotLock);
+}
+
+/* Writes the indexes under a new generation, which only becomes current once the meta-info holding it is saved. */
+static Error SaveIndexSnapshot(DBPostContext* context)
+{
+	// Indexes which are still being built would be loaded as if they were whole.
+	ThreadLock_Lock(&context->_indexSnapshotLock);
+	if (context->_isIndexSnapshotCurrent || (IndexBuild_GetState(&context->IndexBuilder) != IndexBuildState_Complete))
+	{
+		ThreadLock_Unlock(&context->_indexSnapshotLock);
+		return Error_CreateSuccess();
+	}
+
+	IndexSnapshotWriter Writer;
+	IndexSnapshotWriter_Construct(&Writer, context->IndexGeneration + 1);
+	IDCodepointHashMap_WriteSnapshot(&context->TitleMap, &Writer);
+	IDTermDictionary_WriteSnapshot(&context->TitleTerms, &Writer);
+
+	const char* SnapshotPath = GetPathToIndexSnapshot(context);
+	Error ReturnedError = IndexSnapshotWriter_WriteToFile(&Writer, SnapshotPath, context->SyncWrites);
+	Memory_Free((char*)SnapshotPath);
+	IndexSnapshotWriter_Deconstruct(&Writer);
+
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		context->IndexGeneration++;
+		ReturnedError = SaveMetaInfo(context);
+		context->_isIndexSnapshotCurrent = ReturnedError.Code == ErrorCode_Success;
+	}
+	ThreadLock_Unlock(&context->_indexSnapshotLock);
+	return ReturnedError;
+}
+
+/* Fills the empty indexes from the snapshot if it matches the meta-info's generation. */
+static bool LoadIndexSnapshot(DBPostContext* context)
+{
+	const char* SnapshotPath = GetPathToIndexSnapshot(context);
+	IndexSnapshotReader Reader;
+	bool IsLoaded = IndexSnapshotReader_Open(&Reader, SnapshotPath, context->IndexGeneration);
+	Memory_Free((char*)SnapshotPath);
+	if (!IsLoaded)
+	{
+		return false;
+	}
+
+	IsLoaded = IDCodepointHashMap_ReadSnapshot(&context->TitleMap, &Reader)
+		&& IDTermDictionary_ReadSnapshot(&context->TitleTerms, &Reader);
+	IsLoaded = IndexSnapshotReader_Close(&Reader) && IsLoaded;
+	if (!IsLoaded)
+	{
+		IDCodepointHashMap_Clear(&context->TitleMap);
+		IDTermDictionary_Clear(&context->TitleTerms);
+	}
+
+	context->_isIndexSnapshotCurrent = IsLoaded;
+	return IsLoaded;
+}
+
 static void GenerateMetaInfoFroSinglePost(DBPostContext* context, Post* post)
 {
+	IndexBuild_BeginRecordChange(&context->IndexBuilder, post->ID);
 	IDCodepointHashMap_AddID(&context->TitleMap, post->Title, post->ID);
+	IDTermDictionary_AddID(&context->TitleTerms, post->Title, post->ID);
+	if (context->_isReindexing)
+	{
+		IDCodepointHashMap_AddID(&context->_reindexTitleMap, post->Title, post->ID);
+		IDTermDictionary_AddID(&context->_reindexTitleTerms, post->Title, post->ID);
+	}
+	IndexBuild_EndRecordChange(&context->IndexBuilder);
+	MarkIndexChanged(context);
+}
+
+/* Deferred removals belong to the indexes the build merges into. */
+static void RemoveDeferredIndexEntry(int index, const char* string, unsigned long long id, void* argument)
+{
+	DBPostContext* Context = (DBPostContext*)argument;
+	if (index == INDEX_TITLE_MAP)
+	{
+		IDCodepointHashMap_RemoveID(Context->_isReindexing ? &Context->_reindexTitleMap : &Context->TitleMap, string, id);
+	}
+	else
+	{
+		IDTermDictionary_RemoveID(Context->_isReindexing ? &Context->_reindexTitleTerms : &Context->TitleTerms, string, id);
+	}
+}
+
+/* Listing stored posts. */
+static void ListPostIDs(DBPostContext* context, RecordIDList* list)
+{
+	char* EntriesPath = Directory_CombinePaths(context->PostRootPath, DIR_NAME_ENTRIES);
+	RecordIDList_ListStored(list, context->RecordStore, EntriesPath, "", ENTRY_FOLDER_NAME_DIVIDER,
+		DEFAULT_AVAILABLE_POST_ID, context->AvailablePostID - 1);
+	Memory_Free(EntriesPath);
 }
 
-static Error GenerateMetaInfoForPosts(DBPostContext* context, size_t* readPostCount)
+static Error LoadPostIntoIndexPart(unsigned long long id, size_t workerIndex, void* argument)
+{
+	PostIndexBuild* Build = (PostIndexBuild*)argument;
+	PostIndexPart* Part = Build->Parts + workerIndex;
+	if (Atomic_Load(&Build->Context->_isClosing))
+	{
+		return Error_CreateError(ErrorCode_IllegalState, "Post index build was stopped by the server closing.");
+	}
+
+	Error ReturnedError;
+	Post TargetPost;
+	if (!ReadIndexedPostFromDatabase(Build->Context, &TargetPost, id, &Part->Arena, &ReturnedError))
+	{
+		GHDFArena_Clear(&Part->Arena);
+		return ReturnedError;
+	}
+	Part->ReadPostCount++;
+
+	// A post changed since the build began is already in the context's indexes.
+	if (IndexBuild_ClaimRecord(&Build->Context->IndexBuilder, id))
+	{
+		IDCodepointHashMap_AddID(&Part->TitleMap, TargetPost.Title, TargetPost.ID);
+		IDTermDictionary_AddID(&Part->TitleTerms, TargetPost.Title, TargetPost.ID);
+	}
+	PostDeconstructArenaDecoded(&TargetPost);
+	GHDFArena_Clear(&Part->Arena);
+	return Error_CreateSuccess();
+}
+
+/* The posts listed when the index build began are read and indexed by a pool of workers, each into its own indexes
+* so that they never wait on each other. */
+static Error GenerateMetaInfoForPosts(DBPostContext* context, size_t workerCount, size_t* readPostCount)
 {
 	*readPostCount = 0;
-	size_t ReadPostCount = 0;
+	bool IsReindex = Atomic_Load(&context->_isReindexing) != 0;
+	IDCodepointHashMap* TitleMap = IsReindex ? &context->_reindexTitleMap : &context->TitleMap;
+	IDTermDictionary* TitleTerms = IsReindex ? &context->_reindexTitleTerms : &context->TitleTerms;
+	PostIndexBuild Build;
+	Build.Context = context;
+	Build.Parts = (PostIndexPart*)Memory_SafeMalloc(sizeof(PostIndexPart) * workerCount);
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		IDCodepointHashMap_Construct(&Build.Parts[i].TitleMap);
+		IDTermDictionary_Construct(&Build.Parts[i].TitleTerms);
+		Build.Parts[i].TitleMap.FoldDiacritics = context->TitleMap.FoldDiacritics;
+		Build.Parts[i].TitleTerms.FoldDiacritics = context->TitleTerms.FoldDiacritics;
+		GHDFArena_Construct(&Build.Parts[i].Arena, GHDF_ARENA_DEFAULT_BLOCK_SIZE);
+		Build.Parts[i].ReadPostCount = 0;
+	}
 
-	for (unsigned long long id = DEFAULT_AVAILABLE_POST_ID; id < context->AvailablePostID; id++)
+	Error ReturnedError = BulkLoader_Run(context->IndexBuilder.IDs, context->IndexBuilder.IDCount, workerCount, LoadPostIntoIndexPart, &Build);
+
+	size_t ReadPostCount = 0;
+	for (size_t i = 0; i < workerCount; i++)
 	{
-		Error ReturnedError;
-		
-		Post TargetPost;
-		if (!ReadPostFromDatabase(context, &TargetPost, id, &ReturnedError))
+		PostIndexPart* Part = Build.Parts + i;
+		if (ReturnedError.Code == ErrorCode_Success)
 		{
-			if (ReturnedError.Code != ErrorCode_Success)
-			{
-				return ReturnedError;
-			}
-			continue;
+			IDCodepointHashMap_Merge(TitleMap, &Part->TitleMap);
+			IDTermDictionary_Merge(TitleTerms, &Part->TitleTerms);
+			ReadPostCount += Part->ReadPostCount;
 		}
-		ReadPostCount++;
-		
-		GenerateMetaInfoFroSinglePost(context, &TargetPost);
-		PostDeconstruct(&TargetPost);
+		IDCodepointHashMap_Deconstruct(&Part->TitleMap);
+		IDTermDictionary_Deconstruct(&Part->TitleTerms);
+		GHDFArena_Deconstruct(&Part->Arena);
 	}
+	Memory_Free(Build.Parts);
 
+	// A failed reindex leaves the live indexes whole.
+	IndexBuild_Finish(&context->IndexBuilder, IsReindex || (ReturnedError.Code == ErrorCode_Success), RemoveDeferredIndexEntry, context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	MarkIndexChanged(context);
 	*readPostCount = ReadPostCount;
 	return Error_CreateSuccess();
 }
 
 static void ClearMetaInfoForSinglePost(DBPostContext* context, Post* post)
 {
+	if (IndexBuild_BeginRecordChange(&context->IndexBuilder, post->ID))
+	{
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_TITLE_MAP, post->Title, post->ID);
+		IndexBuild_DeferRemoval(&context->IndexBuilder, INDEX_TITLE_TERMS, post->Title, post->ID);
+	}
 	IDCodepointHashMap_RemoveID(&context->TitleMap, post->Title, post->ID);
+	IDTermDictionary_RemoveID(&context->TitleTerms, post->Title, post->ID);
+	if (context->_isReindexing)
+	{
+		IDCodepointHashMap_RemoveID(&context->_reindexTitleMap, post->Title, post->ID);
+		IDTermDictionary_RemoveID(&context->_reindexTitleTerms, post->Title, post->ID);
+	}
+	IndexBuild_EndRecordChange(&context->IndexBuilder);
+	MarkIndexChanged(context);
+}
+
+/* Swaps the indexes filled by a reindex in for the live ones, or drops them if the reindex failed. */
+static void EndReindex(DBPostContext* context, bool isSuccessful)
+{
+	IndexBuild_LockChanges(&context->IndexBuilder);
+	if (isSuccessful)
+	{
+		IDCodepointHashMap_Replace(&context->TitleMap, &context->_reindexTitleMap);
+		IDTermDictionary_Replace(&context->TitleTerms, &context->_reindexTitleTerms);
+	}
+	else
+	{
+		IDCodepointHashMap_Deconstruct(&context->_reindexTitleMap);
+		IDTermDictionary_Deconstruct(&context->_reindexTitleTerms);
+	}
+	Atomic_Store(&context->_isReindexing, 0);
+	IndexBuild_UnlockChanges(&context->IndexBuilder);
+
+	if (isSuccessful)
+	{
+		MarkIndexChanged(context);
+	}
+}
+
+/* Builds the indexes while the server is already serving, then saves them so that the next start can load them. */
+static void RunIndexBuild(void* argument)
+{
+	ServerContext* Server = (ServerContext*)argument;
+	DBPostContext* Context = Server->PostContext;
+
+	size_t ReadPostCount;
+	bool IsReindex = Atomic_Load(&Context->_isReindexing) != 0;
+	unsigned long long ReadStartTime = Time_GetMicroseconds();
+	Error ReturnedError = GenerateMetaInfoForPosts(Context, Context->_indexBuildWorkerCount, &ReadPostCount);
+	if (IsReindex)
+	{
+		EndReindex(Context, ReturnedError.Code == ErrorCode_Success);
+	}
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		if (!Atomic_Load(&Context->_isClosing))
+		{
+			Logger_LogError(Server->Logger, ReturnedError.Message);
+			Logger_LogError(Server->Logger, IsReindex ? "Failed to rebuild post indexes, searches keep using the old ones."
+				: "Failed to build post indexes, searching posts stays unavailable.");
+		}
+		Error_Deconstruct(&ReturnedError);
+		return;
+	}
+
+	char Message[128];
+	snprintf(Message, sizeof(Message), "Read %llu posts while %s indexes in the background (%.0f files/s).",
+		(unsigned long long)ReadPostCount, IsReindex ? "rebuilding" : "building", Time_GetRatePerSecond(ReadPostCount, ReadStartTime));
+	Logger_LogInfo(Server->Logger, Message);
+
+	ReturnedError = SaveIndexSnapshot(Context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Logger_LogWarning(Server->Logger, ReturnedError.Message);
+		Error_Deconstruct(&ReturnedError);
+	}
+}
+
+static bool IsPostInArray(Post** posts, size_t postCount, unsigned long long id)
+{
+	for (size_t i = 0; i < postCount; i++)
+	{
+		if (posts[i]->ID == id)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/* Searching. */
+static Post** SearchPostsByTitle(DBPostContext* context, const char* title, size_t* postCount, Error* error)
+{
+	size_t IDCount = 0;
+	unsigned long long* IDs = IDCodepointHashMap_FindByString(&context->TitleMap, title, true, &IDCount);
+	size_t TypoIDCount = 0;
+	unsigned long long* TypoIDs = IDTermDictionary_FindByString(&context->TitleTerms, title,
+		TERM_DICTIONARY_MAX_EDIT_DISTANCE, &TypoIDCount);
+
+	if (IDCount + TypoIDCount == 0)
+	{
+		Memory_Free(IDs);
+		Memory_Free(TypoIDs);
+		return NULL;
+	}
+
+	Post** FoundPosts = (Post**)Memory_SafeMalloc(sizeof(Post*) * (IDCount + TypoIDCount));
+	size_t MatchedPostCount = 0;
+
+	for (size_t i = 0; i < IDCount; i++)
+	{
+		Post* TargetPost = PostManager_GetPostByID(context, IDs[i], error);
+		if (error->Code != ErrorCode_Success)
+		{
+			Memory_Free(FoundPosts);
+			Memory_Free(IDs);
+			Memory_Free(TypoIDs);
+			return NULL;
+		}
+		if(!TargetPost)
+		{
+			continue;
+		}
+		if (String_IsFuzzyMatchedFolded(TargetPost->Title, title, true, context->TitleMap.FoldDiacritics))
+		{
+			FoundPosts[MatchedPostCount] = TargetPost;
+			MatchedPostCount++;
+		}
+	}
+
+	// Posts whose title words are within a few typos of the query go after the exact matches.
+	size_t ExactMatchCount = MatchedPostCount;
+	for (size_t i = 0; i < TypoIDCount; i++)
+	{
+		if (IsPostInArray(FoundPosts, ExactMatchCount, TypoIDs[i]))
+		{
+			continue;
+		}
+
+		Post* TargetPost = PostManager_GetPostByID(context, TypoIDs[i], error);
+		if (error->Code != ErrorCode_Success)
+		{
+			Memory_Free(FoundPosts);
+			Memory_Free(IDs);
+			Memory_Free(TypoIDs);
+			return NULL;
+		}
+		if (TargetPost)
+		{
+			FoundPosts[MatchedPostCount] = TargetPost;
+			MatchedPostCount++;
+		}
+	}
+
+	Memory_Free(IDs);
+	Memory_Free(TypoIDs);
+	if (MatchedPostCount == 0)
+	{
+		Memory_Free(FoundPosts);
+		return NULL;
+	}
+	*postCount = MatchedPostCount;
+	return FoundPosts;
+}
+
+static Post** GetPostsFromCachedIDs(DBPostContext* context, unsigned long long* ids, size_t idCount, size_t* postCount, Error* error)
+{
+	if (idCount == 0)
+	{
+		return NULL;
+	}
+
+	Post** FoundPosts = (Post**)Memory_SafeMalloc(sizeof(Post*) * idCount);
+	size_t FoundPostCount = 0;
+	for (size_t i = 0; i < idCount; i++)
+	{
+		Post* TargetPost = PostManager_GetPostByID(context, ids[i], error);
+		if (error->Code != ErrorCode_Success)
+		{
+			Memory_Free(FoundPosts);
+			return NULL;
+		}
+		if (TargetPost)
+		{
+			FoundPosts[FoundPostCount] = TargetPost;
+			FoundPostCount++;
+		}
+	}
+
+	if (FoundPostCount == 0)
+	{
+		Memory_Free(FoundPosts);
+		return NULL;
+	}
+	*postCount = FoundPostCount;
+	return FoundPosts;
+}
+
+static void CacheFoundPosts(DBPostContext* context, const char* title, unsigned long long generation, Post** posts, size_t postCount)
+{
+	unsigned long long* IDs = postCount > 0 ? (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * postCount) : NULL;
+	for (size_t i = 0; i < postCount; i++)
+	{
+		IDs[i] = posts[i]->ID;
+	}
+
+	SearchCache_Put(&context->SearchResults, SearchCacheType_PostTitle, title, generation, IDs, postCount);
+	Memory_Free(IDs);
 }
 
 
@@ -1125,6 +1715,7 @@ static void ClearMetaInfoForSinglePost(DBPostContext* context, Post* post)
 static void LoadDefaultMetaInfo(DBPostContext* context)
 {
 	context->AvailablePostID = DEFAULT_AVAILABLE_POST_ID;
+	context->IndexGeneration = 0;
 }
 
 static Error LoadMetainfoFromCompound(DBPostContext* context, GHDFCompound* compound)
@@ -1139,6 +1730,17 @@ static Error LoadMetainfoFromCompound(DBPostContext* context, GHDFCompound* comp
 	}
 	context->AvailablePostID = Entry->Value.SingleValue.ULong;
 
+	ReturnedError = GHDFCompound_GetVerifiedOptionalEntry(compound, ENTRY_ID_METAINFO_INDEX_GENERATION,
+		&Entry, GHDFType_ULong, "Index generation");
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	if (Entry)
+	{
+		context->IndexGeneration = Entry->Value.SingleValue.ULong;
+	}
+
 	return Error_CreateSuccess();
 }
 
@@ -1174,10 +1776,14 @@ static Error SaveMetaInfo(DBPostContext* context)
 
 	Value.ULong = context->AvailablePostID;
 	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_ULong, ENTRY_ID_METAINFO_AVAIlABLE_POST_ID, Value);
+	Value.ULong = context->IndexGeneration;
+	GHDFCompound_AddSingleValueEntry(&Compound, GHDFType_ULong, ENTRY_ID_METAINFO_INDEX_GENERATION, Value);
 
 	Directory_CreateAll(context->PostRootPath);
 	const char* FilePath = Directory_CombinePaths(context->PostRootPath, POST_METAINFO_FILENAME);
-	Error ReturnedError = GHDFCompound_WriteToFile(FilePath, &Compound);
+	unsigned long long StorageStartTime = AccessLog_BeginStorage();
+	Error ReturnedError = GHDFCompound_WriteToFile(FilePath, &Compound, context->SyncWrites);
+	AccessLog_EndStorage(StorageStartTime);
 
 	Memory_Free((char*)FilePath);
 	GHDFCompound_Deconstruct(&Compound);
@@ -1186,62 +1792,352 @@ static Error SaveMetaInfo(DBPostContext* context)
 }
 
 
+/* Mutation log. */
+static Error ReplayPostMutation(unsigned char type, unsigned long long id, const char* data, size_t dataLength, void* argument)
+{
+	DBPostContext* Context = (DBPostContext*)argument;
+	switch (type)
+	{
+		case MUTATION_RECORD_POST:
+			// Posts created just before a crash may be newer than the saved meta-info.
+			if (id >= Context->AvailablePostID)
+			{
+				Context->AvailablePostID = id + 1;
+			}
+			return WritePostData(Context, id, data, dataLength);
+
+		case MUTATION_RECORD_POST_DELETED:
+			DeletePostFromDatabase(Context, id);
+			return Error_CreateSuccess();
+
+		default:
+			return Error_CreateError(ErrorCode_DatabaseError, "Unknown post mutation record type.");
+	}
+}
+
+/* Once every cached post is in the database the logged changes are no longer needed. */
+static Error CheckpointMutationLog(DBPostContext* context)
+{
+	Error ReturnedError = SaveAllCachedPostsToDatabase(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	ReturnedError = SaveIndexSnapshot(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	ReturnedError = SaveMetaInfo(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	return WriteAheadLog_Reset(&context->MutationLog);
+}
+
+/* Logs the post's whole record, replaying only the newest one of each post restores it. The record is written by the next commit. */
+static void LogPostMutation(DBPostContext* context, Post* post)
+{
+	GHDFBuffer* Buffer = GHDFBuffer_GetThreadBuffer();
+	GHDFBuffer_BeginFile(Buffer);
+	WritePostGHDF(post, Buffer);
+	WriteAheadLog_Append(&context->MutationLog, MUTATION_RECORD_POST, post->ID, Buffer->Data, Buffer->Length);
+}
+
+static void LogPostDeletion(DBPostContext* context, unsigned long long id)
+{
+	WriteAheadLog_Append(&context->MutationLog, MUTATION_RECORD_POST_DELETED, id, NULL, 0);
+}
+
+/* Replays what the log holds, the log is checkpointed once the indexes are built from the replayed database. */
+static Error OpenMutationLog(DBPostContext* context, bool* hasReplayedMutations)
+{
+	Directory_CreateAll(context->PostRootPath);
+	const char* LogPath = Directory_CombinePaths(context->PostRootPath, FILE_NAME_MUTATION_LOG);
+	Error ReturnedError = WriteAheadLog_Open(&context->MutationLog, LogPath, context->SyncWrites);
+	Memory_Free((char*)LogPath);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	ReturnedError = WriteAheadLog_Replay(&context->MutationLog, ReplayPostMutation, context);
+	*hasReplayedMutations = context->MutationLog.Length > 0;
+	return ReturnedError;
+}
+
+
+/* Segment import. */
+/* Posts were kept in a single segment file before the store replaced it, its posts are moved into the store once. */
+static Error ImportPostSegment(DBPostContext* context, Logger* logger)
+{
+	const char* SegmentPath = Directory_CombinePaths(context->PostRootPath, FILE_NAME_SEGMENT);
+	Error ReturnedError = Error_CreateSuccess();
+	if (File_Exists(SegmentPath) && !context->RecordStore)
+	{
+		ReturnedError = Error_CreateError(ErrorCode_DatabaseError,
+			"Posts are still in a segment file, which is only moved into the store when \"database-use-store\" is enabled.");
+	}
+	else if (File_Exists(SegmentPath))
+	{
+		size_t ImportedCount;
+		ReturnedError = Store_ImportSegment(context->RecordStore, SegmentPath, &ImportedCount);
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			char Message[128];
+			snprintf(Message, sizeof(Message), "Moved %llu posts from the segment file into the store.", (unsigned long long)ImportedCount);
+			Logger_LogInfo(logger, Message);
+		}
+	}
+	Memory_Free((char*)SegmentPath);
+	return ReturnedError;
+}
+
+
 // Functions.
 Error PostManager_Construct(ServerContext* serverContext)
 {
 	DBPostContext* Context = serverContext->PostContext;
 
 	Context->PostRootPath = Directory_CombinePaths(serverContext->Resources->DatabaseRootPath, DIR_NAME_POSTS);
+	Context->SyncWrites = serverContext->Configuration->SyncDatabaseWrites;
+	Context->UpgradeFileFormat = serverContext->Configuration->UpgradeDatabaseFormat;
 
 	Context->_unfinishedPostCapacity = GENERIC_LIST_CAPACITY;
 	Context->UnfinishedPosts = (UnfinishedPost*)Memory_SafeMalloc(sizeof(UnfinishedPost) * Context->_unfinishedPostCapacity);
 	Context->UnfinishedPostCount = 0;
 
 	InitializePostCache(Context);
+	ThreadLock_Construct(&Context->_cacheLock);
+	ThreadLock_Construct(&Context->_recordWriteLock);
+	ThreadCondition_Construct(&Context->_flushCondition);
+	Context->_isClosing = 0;
+	Context->MaxDirtyAge = (time_t)serverContext->Configuration->CacheMaxDirtyAge;
+	ThreadLock_Construct(&Context->_indexSnapshotLock);
+	Context->_isIndexSnapshotCurrent = false;
+	IndexBuild_Construct(&Context->IndexBuilder);
+	Context->_isIndexBuildThreadStarted = false;
+	Context->_isReindexing = 0;
+	Context->_indexBuildWorkerCount = BulkLoader_GetWorkerCount(serverContext->Configuration->IndexLoaderThreads);
+
+	Context->RecordStore = NULL;
+	RecordIDList_Construct(&Context->_movedRecordIDs);
+	if (serverContext->Configuration->UseDatabaseStore)
+	{
+		const char* StorePath = Directory_CombinePaths(Context->PostRootPath, DIR_NAME_STORE);
+		Store* RecordStore = (Store*)Memory_SafeMalloc(sizeof(Store));
+		Error ReturnedError = Store_Open(RecordStore, StorePath, Context->SyncWrites);
+		Memory_Free((char*)StorePath);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			Memory_Free(RecordStore);
+			return ReturnedError;
+		}
+		Context->RecordStore = RecordStore;
+	}
+
+	Error ReturnedError = ImportPostSegment(Context, serverContext->Logger);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
 	
-	Error ReturnedError = LoadMetainfo(Context);
+	ReturnedError = LoadMetainfo(Context);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
 
-	IDCodepointHashMap_Construct(&Context->TitleMap);
-
-	size_t ReadPostCount;
-	ReturnedError = GenerateMetaInfoForPosts(Context, &ReadPostCount);
+	bool HasReplayedMutations;
+	ReturnedError = OpenMutationLog(Context, &HasReplayedMutations);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
+
+	IDCodepointHashMap_Construct(&Context->TitleMap);
+	IDTermDictionary_Construct(&Context->TitleTerms);
+	Context->TitleMap.FoldDiacritics = serverContext->Configuration->FoldSearchDiacritics;
+	Context->TitleTerms.FoldDiacritics = serverContext->Configuration->FoldSearchDiacritics;
+	SearchCache_Construct(&Context->SearchResults);
+
+	// Replayed changes may not be in the snapshot, only a clean shutdown or checkpoint leaves the log empty.
 	char Message[128];
-	snprintf(Message, sizeof(Message), "Read %llu posts while creating ID hashes.", ReadPostCount);
+	unsigned long long ReadStartTime = Time_GetMicroseconds();
+	bool IsIndexBuildLazy = false;
+	if (!HasReplayedMutations && LoadIndexSnapshot(Context))
+	{
+		snprintf(Message, sizeof(Message), "Loaded post indexes from snapshot in %llu ms.", (Time_GetMicroseconds() - ReadStartTime) / 1000);
+	}
+	else
+	{
+		RecordIDList IDs;
+		ListPostIDs(Context, &IDs);
+		IndexBuild_LockChanges(&Context->IndexBuilder);
+		IndexBuild_Begin(&Context->IndexBuilder, IDs.IDs, IDs.Count);
+		IndexBuild_UnlockChanges(&Context->IndexBuilder);
+		if (serverContext->Configuration->LazyIndexStartup)
+		{
+			// The snapshot may still match the meta-info while missing the replayed changes, and the log is emptied below.
+			Context->IndexGeneration++;
+			IsIndexBuildLazy = true;
+			snprintf(Message, sizeof(Message), "Building indexes of %llu posts in the background.", (unsigned long long)IDs.Count);
+		}
+		else
+		{
+			size_t ReadPostCount;
+			ReturnedError = GenerateMetaInfoForPosts(Context, Context->_indexBuildWorkerCount, &ReadPostCount);
+			if (ReturnedError.Code != ErrorCode_Success)
+			{
+				return ReturnedError;
+			}
+			snprintf(Message, sizeof(Message), "Read %llu posts while creating ID hashes (%.0f files/s).", ReadPostCount, Time_GetRatePerSecond(ReadPostCount, ReadStartTime));
+		}
+	}
 	Logger_LogInfo(serverContext->Logger, Message);
 
+	ReturnedError = CheckpointMutationLog(Context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	if (!Thread_Start(&Context->_flushThread, RunFlusher, Context))
+	{
+		return Error_CreateError(ErrorCode_IO, "PostManager_Construct: Failed to start cache flusher thread.");
+	}
+	if (IsIndexBuildLazy)
+	{
+		Context->_isIndexBuildThreadStarted = Thread_Start(&Context->_indexBuildThread, RunIndexBuild, serverContext);
+		if (!Context->_isIndexBuildThreadStarted)
+		{
+			return Error_CreateError(ErrorCode_IO, "PostManager_Construct: Failed to start index build thread.");
+		}
+	}
 	return ReturnedError;
 }
 
 Error PostManager_Deconstruct(DBPostContext* context)
 {
+	// Stopping the flusher also stops the index build, whose indexes are then never saved.
+	StopFlusher(context);
+	if (context->_isIndexBuildThreadStarted)
+	{
+		Thread_Join(&context->_indexBuildThread);
+		context->_isIndexBuildThreadStarted = false;
+	}
 	Error ReturnedError = SaveAllCachedPostsToDatabase(context);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
 
+	ReturnedError = SaveIndexSnapshot(context);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
 	ReturnedError = SaveMetaInfo(context);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
 
+	ReturnedError = WriteAheadLog_Reset(&context->MutationLog);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	ReturnedError = WriteAheadLog_Close(&context->MutationLog);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	if (context->RecordStore)
+	{
+		ReturnedError = Store_Close(context->RecordStore);
+		Memory_Free(context->RecordStore);
+		context->RecordStore = NULL;
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			return ReturnedError;
+		}
+	}
+
+	Memory_Free(context->_movedRecordIDs.IDs);
 	Memory_Free((char*)context->PostRootPath);
 	IDCodepointHashMap_Deconstruct(&context->TitleMap);
+	IDTermDictionary_Deconstruct(&context->TitleTerms);
+	IndexBuild_Deconstruct(&context->IndexBuilder);
+	SearchCache_Deconstruct(&context->SearchResults);
 	Memory_Free(context->CachedPosts);
 	Memory_Free(context->UnfinishedPosts);
 
 	return Error_CreateSuccess();
 }
 
+Error PostManager_CommitMutations(DBPostContext* context)
+{
+	Error ReturnedError = WriteAheadLog_CommitAll(&context->MutationLog);
+	if ((ReturnedError.Code == ErrorCode_Success) && (context->MutationLog.Length >= MUTATION_LOG_CHECKPOINT_LENGTH))
+	{
+		ReturnedError = CheckpointMutationLog(context);
+	}
+	return ReturnedError;
+}
+
+
+/* Indexes. */
+Error PostManager_Reindex(ServerContext* serverContext)
+{
+	DBPostContext* Context = serverContext->PostContext;
+	IndexBuildState State = IndexBuild_GetState(&Context->IndexBuilder);
+	if ((State == IndexBuildState_Running) || Atomic_Load(&Context->_isReindexing))
+	{
+		return Error_CreateError(ErrorCode_IllegalState, "The post indexes are already being built.");
+	}
+	if (State == IndexBuildState_Failed)
+	{
+		return Error_CreateError(ErrorCode_IllegalState, "The post indexes failed to build at startup, the server must be restarted.");
+	}
+
+	// A finished build may still be saving its snapshot.
+	if (Context->_isIndexBuildThreadStarted)
+	{
+		Thread_Join(&Context->_indexBuildThread);
+		Context->_isIndexBuildThreadStarted = false;
+	}
+
+	IDCodepointHashMap_Construct(&Context->_reindexTitleMap);
+	IDTermDictionary_Construct(&Context->_reindexTitleTerms);
+	Context->_reindexTitleMap.FoldDiacritics = Context->TitleMap.FoldDiacritics;
+	Context->_reindexTitleTerms.FoldDiacritics = Context->TitleTerms.FoldDiacritics;
+
+	// Posts created while listing would otherwise be either missed or indexed twice by the fresh indexes.
+	RecordIDList IDs;
+	IndexBuild_LockChanges(&Context->IndexBuilder);
+	ListPostIDs(Context, &IDs);
+	Atomic_Store(&Context->_isReindexing, 1);
+	IndexBuild_Begin(&Context->IndexBuilder, IDs.IDs, IDs.Count);
+	IndexBuild_UnlockChanges(&Context->IndexBuilder);
+
+	Context->_isIndexBuildThreadStarted = Thread_Start(&Context->_indexBuildThread, RunIndexBuild, serverContext);
+	if (!Context->_isIndexBuildThreadStarted)
+	{
+		IndexBuild_Finish(&Context->IndexBuilder, true, RemoveDeferredIndexEntry, Context);
+		EndReindex(Context, false);
+		return Error_CreateError(ErrorCode_IO, "PostManager_Reindex: Failed to start index build thread.");
+	}
+
+	char Message[128];
+	snprintf(Message, sizeof(Message), "Rebuilding indexes of %llu posts in the background.", (unsigned long long)IDs.Count);
+	Logger_LogInfo(serverContext->Logger, Message);
+	return Error_CreateSuccess();
+}
+
 
 /* Creating posts. */
 bool PostManager_BeginPostCreation(DBPostContext* context,
@@ -1294,7 +2190,9 @@ Post* PostManager_FinishPostCreation(DBPostContext* context, unsigned long long
 	PostCreateNew(context, &CreatedPost, UnfPost->Title, UnfPost->Description, UnfPost->AuthorID,
 		UnfPost->Tags, UnfPost->ImageCount);
 
-	*error = WritePostToDatabase(context, &CreatedPost);
+	ThreadLock_Lock(&context->_recordWriteLock);
+	*error = WritePostRecord(context, &CreatedPost);
+	ThreadLock_Unlock(&context->_recordWriteLock);
 	if (error->Code != ErrorCode_Success)
 	{
 		PostDeconstruct(&CreatedPost);
@@ -1308,6 +2206,7 @@ Post* PostManager_FinishPostCreation(DBPostContext* context, unsigned long long
 		PostDeconstruct(&CreatedPost);
 		return NULL;
 	}
+	LogPostMutation(context, &CreatedPost);
 
 	GenerateMetaInfoFroSinglePost(context, &CreatedPost);
 
@@ -1331,14 +2230,17 @@ Error PostManager_DeletePost(ServerContext* serverContext, Post* post)
 	snprintf(Message, sizeof(Message), "Deleting post with ID %llu (author id %llu)", post->ID, post->AuthorID);
 	Logger_LogInfo(serverContext->Logger, Message);
 
-	
-	Error ReturnedError = RemovePostFromCacheByID(serverContext->PostContext, post->ID, false);
+	unsigned long long PostID = post->ID;
+	LogPostDeletion(serverContext->PostContext, PostID);
+
+	// The post is freed once it leaves the cache, and must leave it so the flusher can't write it back.
+	ClearMetaInfoForSinglePost(serverContext->PostContext, post);
+	Error ReturnedError = RemovePostFromCacheByID(serverContext->PostContext, PostID, false);
 	if (ReturnedError.Code != ErrorCode_Success)
 	{
 		return ReturnedError;
 	}
-	DeletePostFromDatabase(serverContext->PostContext, post->ID);
-	ClearMetaInfoForSinglePost(serverContext->PostContext, post);
+	DeletePostFromDatabase(serverContext->PostContext, PostID);
 	return Error_CreateSuccess();
 }
 
@@ -1370,55 +2272,51 @@ Post* PostManager_GetPostByID(DBPostContext* context, unsigned long long id, Err
 	Post* CreatedPost = TryGetPostFromCache(context, id);
 	if (CreatedPost)
 	{
+		Metrics_Increment(MetricCounter_PostCacheHits);
+		LTT_PROBE_CACHE_HIT(LTT_PROBE_CACHE_POST, id);
 		return CreatedPost;
 	}
 
+	Metrics_Increment(MetricCounter_PostCacheMisses);
+	LTT_PROBE_CACHE_MISS(LTT_PROBE_CACHE_POST, id);
+	TraceSpan Span = Trace_BeginSpan("post cache load");
 	CachedPost* PostCached = LoadPostIntoCache(context, id, error);
+	Trace_EndSpan(Span);
 	return PostCached ? &PostCached->TargetPost : NULL;
 }
 
+bool PostManager_IsSearchReady(DBPostContext* context)
+{
+	return (IndexBuild_GetState(&context->IndexBuilder) == IndexBuildState_Complete) || Atomic_Load(&context->_isReindexing);
+}
+
 Post** PostManager_GetPostsByTitle(DBPostContext* context, const char* title, size_t* postCount, Error* error)
 {
 	*error = Error_CreateSuccess();
 	*postCount = 0;
-	size_t IDCount;
-	unsigned long long* IDs = IDCodepointHashMap_FindByString(&context->TitleMap, title, true, &IDCount);
-
-	if (IDCount == 0)
+	if (!PostManager_IsSearchReady(context))
 	{
 		return NULL;
 	}
 
-	Post** FoundPosts = (Post**)Memory_SafeMalloc(sizeof(Post*) * IDCount);
-	size_t MatchedPostCount = 0;
-
-	for (size_t i = 0; i < IDCount; i++)
+	// Read before searching so that a result computed against older meta info is never stored as current.
+	unsigned long long Generation = IDCodepointHashMap_GetGeneration(&context->TitleMap);
+	unsigned long long* CachedIDs;
+	size_t CachedIDCount;
+	if (SearchCache_TryGet(&context->SearchResults, SearchCacheType_PostTitle, title, Generation, &CachedIDs, &CachedIDCount))
 	{
-		Post* TargetPost = PostManager_GetPostByID(context, IDs[i], error);
-		if (error->Code != ErrorCode_Success)
-		{
-			Memory_Free(FoundPosts);
-			Memory_Free(IDs);
-			return NULL;
-		}
-		if(!TargetPost)
-		{
-			continue;
-		}
-		if (String_IsFuzzyMatched(TargetPost->Title, title, true))
-		{
-			FoundPosts[MatchedPostCount] = TargetPost;
-			MatchedPostCount++;
-		}
+		Post** CachedPosts = GetPostsFromCachedIDs(context, CachedIDs, CachedIDCount, postCount, error);
+		Memory_Free(CachedIDs);
+		return CachedPosts;
 	}
 
-	Memory_Free(IDs);
-	if (MatchedPostCount == 0)
+	TraceSpan Span = Trace_BeginSpan("post title index query");
+	Post** FoundPosts = SearchPostsByTitle(context, title, postCount, error);
+	Trace_EndSpan(Span);
+	if (error->Code == ErrorCode_Success)
 	{
-		Memory_Free(FoundPosts);
-		return NULL;
+		CacheFoundPosts(context, title, Generation, FoundPosts, *postCount);
 	}
-	*postCount = MatchedPostCount;
 	return FoundPosts;
 }
 
@@ -1444,16 +2342,20 @@ char* PostManager_GetImageFromPost(DBPostContext* context, Post* post, int image
 	return Data;
 }
 
-bool PostManager_AddComment(Post* post,
+bool PostManager_AddComment(DBPostContext* context,
+	Post* post,
 	unsigned long long commentAuthorID,
 	unsigned long long parentCommentID,
-	const char* commentContents)
+	const char* commentContents,
+	Error* error)
 {
+	*error = Error_CreateSuccess();
 	if (!VerifyComment(commentContents))
 	{
 		return false;
 	}
 
+	ThreadLock_Lock(&context->_cacheLock);
 	PostEnsureCommentCapacity(post, post->CommentCount + 1);
 	PostComment* Comment = post->Comments + post->CommentCount;
 
@@ -1466,6 +2368,10 @@ bool PostManager_AddComment(Post* post,
 	Comment->Contents = String_CreateCopy(commentContents);
 
 	post->CommentCount += 1;
+	MarkPostDirty(context, post);
+	ThreadLock_Unlock(&context->_cacheLock);
+
+	LogPostMutation(context, post);
 	return true;
 }
 
@@ -1474,14 +2380,40 @@ PostComment* PostManager_GetComment(Post* post, unsigned long long commentID)
 	return PostGetCommentByID(post, commentID);
 }
 
-bool PostManager_RemoveComment(Post* post, unsigned long long commentID)
+bool PostManager_RemoveComment(DBPostContext* context, Post* post, unsigned long long commentID, Error* error)
 {
-	return RemovePostCommentByID(post, commentID);
+	ThreadLock_Lock(&context->_cacheLock);
+	bool IsRemoved = RemovePostCommentByID(post, commentID);
+	if (IsRemoved)
+	{
+		MarkPostDirty(context, post);
+	}
+	ThreadLock_Unlock(&context->_cacheLock);
+
+	if (IsRemoved)
+	{
+		LogPostMutation(context, post);
+	}
+	*error = Error_CreateSuccess();
+	return IsRemoved;
 }
 
-bool PostManager_AddRequesterID(Post* post, unsigned long long requesterID)
+bool PostManager_AddRequesterID(DBPostContext* context, Post* post, unsigned long long requesterID, Error* error)
 {
-	return PostAddRequesterID(post, requesterID);
+	ThreadLock_Lock(&context->_cacheLock);
+	bool IsAdded = PostAddRequesterID(post, requesterID);
+	if (IsAdded)
+	{
+		MarkPostDirty(context, post);
+	}
+	ThreadLock_Unlock(&context->_cacheLock);
+
+	if (IsAdded)
+	{
+		LogPostMutation(context, post);
+	}
+	*error = Error_CreateSuccess();
+	return IsAdded;
 }
 
 bool PostManager_HasRequesterID(Post* post, unsigned long long id)
@@ -1489,12 +2421,58 @@ bool PostManager_HasRequesterID(Post* post, unsigned long long id)
 	return PostHasRequesterID(post, id);
 }
 
-bool PostManager_RemoveRequesterID(Post* post, unsigned long long requesterID)
+bool PostManager_RemoveRequesterID(DBPostContext* context, Post* post, unsigned long long requesterID, Error* error)
 {
-	return PostRemoveRequesterID(post, requesterID);
+	ThreadLock_Lock(&context->_cacheLock);
+	bool IsRemoved = PostRemoveRequesterID(post, requesterID);
+	if (IsRemoved)
+	{
+		MarkPostDirty(context, post);
+	}
+	ThreadLock_Unlock(&context->_cacheLock);
+
+	if (IsRemoved)
+	{
+		LogPostMutation(context, post);
+	}
+	*error = Error_CreateSuccess();
+	return IsRemoved;
 }
 
-void PostManager_RemoveAllRequesterIDs(Post* post)
+Error PostManager_RemoveAllRequesterIDs(DBPostContext* context, Post* post)
 {
+	ThreadLock_Lock(&context->_cacheLock);
 	PostClearRequesterIDs(post);
+	MarkPostDirty(context, post);
+	ThreadLock_Unlock(&context->_cacheLock);
+
+	LogPostMutation(context, post);
+	return Error_CreateSuccess();
+}
+
+
+/* JSON. */
+void PostManager_AppendPostJSON(Post* record, StringBuilder* builder)
+{
+	bool IsFirstField;
+	Schema_BeginJSONObject(builder, &IsFirstField);
+	POST_SCHEMA(SCHEMA_APPEND_JSON_FIELD, SCHEMA_APPEND_JSON_LIST)
+
+	char* EncodedThumbnail = record->ThumbnailData
+		? Base64_Encode((const unsigned char*)record->ThumbnailData, record->ThumbnailDataLength) : NULL;
+	Schema_AppendJSONString(builder, "thumbnail", EncodedThumbnail, &IsFirstField);
+	if (EncodedThumbnail)
+	{
+		Memory_Free(EncodedThumbnail);
+	}
+
+	Schema_EndJSONObject(builder);
+}
+
+void PostManager_AppendCommentJSON(PostComment* record, StringBuilder* builder)
+{
+	bool IsFirstField;
+	Schema_BeginJSONObject(builder, &IsFirstField);
+	COMMENT_SCHEMA(SCHEMA_APPEND_JSON_FIELD, SCHEMA_APPEND_JSON_LIST)
+	Schema_EndJSONObject(builder);
 }
\ No newline at end of file
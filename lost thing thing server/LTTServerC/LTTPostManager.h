@@ -1,9 +1,18 @@
 #pragma once
 #include <stddef.h>
 #include <stdbool.h>
+#include <time.h>
 #include "LTTErrors.h"
 #include "LTTAccountManager.h"
 #include "IDCodePointHashMap.h"
+#include "IDTermDictionary.h"
+#include "SearchCache.h"
+#include "Store.h"
+#include "RecordIDList.h"
+#include "WriteAheadLog.h"
+#include "IndexBuild.h"
+#include "LTTThread.h"
+#include "LttString.h"
 
 // Macros.
 // Types.
@@ -60,12 +69,46 @@ typedef struct DBPostContextStruct
 	unsigned long long AvailablePostID;
 
 	IDCodepointHashMap TitleMap;
+	IDTermDictionary TitleTerms;
+	SearchCache SearchResults;
+	/* The index snapshot is only loaded if it was written with the generation saved in the meta-info.
+	* The first index change after a snapshot moves to the next generation. */
+	unsigned long long IndexGeneration;
+	bool _isIndexSnapshotCurrent;
+	ThreadLock _indexSnapshotLock;
+	/* Tracks the rebuild of the indexes, which runs on its own thread when the server starts serving before it is done. */
+	IndexBuild IndexBuilder;
+	Thread _indexBuildThread;
+	bool _isIndexBuildThreadStarted;
+	size_t _indexBuildWorkerCount;
+	/* Fresh indexes filled by a reindex while searches keep using the live ones. Changes made meanwhile go to both,
+	* the fresh indexes then replace the live ones at once. */
+	IDCodepointHashMap _reindexTitleMap;
+	IDTermDictionary _reindexTitleTerms;
+	volatile long long _isReindexing;
+	bool SyncWrites;
+	bool UpgradeFileFormat;
+
+	/* Holds the post records when the store is enabled, NULL when each post has its own file. */
+	Store* RecordStore;
+	/* Posts moved into the store from their own files, which are only deleted once the store is flushed. Guarded by the write lock. */
+	RecordIDList _movedRecordIDs;
+	/* Every change to a post is logged here until a checkpoint has flushed it to the database. */
+	WriteAheadLog MutationLog;
 
 	struct UnfinishedPostStruct* UnfinishedPosts;
 	size_t UnfinishedPostCount;
 	size_t _unfinishedPostCapacity;
 
 	struct CachedPostStruct* CachedPosts;
+	/* Held while cached posts are changed, loaded or evicted. Changed posts are written by a background thread
+	* once they've been dirty for MaxDirtyAge seconds, database writes of records are serialized by the write lock. */
+	ThreadLock _cacheLock;
+	ThreadLock _recordWriteLock;
+	ThreadCondition _flushCondition;
+	Thread _flushThread;
+	volatile long long _isClosing;
+	time_t MaxDirtyAge;
 } DBPostContext;
 
 
@@ -75,6 +118,12 @@ Error PostManager_Construct(ServerContext* serverContext);
 
 Error PostManager_Deconstruct(DBPostContext* context);
 
+/// <summary>
+/// Writes the logged changes with a single sync, after which they last through a crash.
+/// The log is checkpointed once it has grown large.
+/// </summary>
+Error PostManager_CommitMutations(DBPostContext* context);
+
 
 /* Creating posts. */
 bool PostManager_BeginPostCreation(DBPostContext* context,
@@ -96,28 +145,55 @@ Error PostManager_DeletePost(ServerContext* context, Post* post);
 Error PostManager_DeleteAllPosts(ServerContext* serverContext);
 
 
+/* Indexes. */
+/// <summary>
+/// Rebuilds the title indexes from the stored posts in the background, searches use the old indexes until the new ones replace them.
+/// </summary>
+/// <returns>An error if the indexes are already being built or failed to build at startup.</returns>
+Error PostManager_Reindex(ServerContext* serverContext);
+
+
 /* Retrieving data. */
 Post* PostManager_GetPostByID(DBPostContext* context, unsigned long long id, Error* error);
 
+/// <summary>
+/// Whether the title index is fully built. Until it is, searching by title finds nothing. A reindex doesn't make it unready.
+/// </summary>
+bool PostManager_IsSearchReady(DBPostContext* context);
+
 Post** PostManager_GetPostsByTitle(DBPostContext* context, const char* title, size_t* postCount, Error* error);
 
 char* PostManager_GetImageFromPost(DBPostContext* context, Post* post, int imageIndex, size_t* dataLength, Error* error);
 
 
 /* Managing posts. */
-bool PostManager_AddComment(Post* post,
+/// <summary>
+/// Changes to posts are logged and last through a crash once PostManager_CommitMutations has returned.
+/// </summary>
+bool PostManager_AddComment(DBPostContext* context,
+	Post* post,
 	unsigned long long commentAuthorID,
 	unsigned long long parentCommentID,
-	const char* commentContents);
+	const char* commentContents,
+	Error* error);
 
 PostComment* PostManager_GetComment(Post* post, unsigned long long commentID);
 
-bool PostManager_RemoveComment(Post* post, unsigned long long commentID);
+bool PostManager_RemoveComment(DBPostContext* context, Post* post, unsigned long long commentID, Error* error);
 
-bool PostManager_AddRequesterID(Post* post, unsigned long long requesterID);
+bool PostManager_AddRequesterID(DBPostContext* context, Post* post, unsigned long long requesterID, Error* error);
 
 bool PostManager_HasRequesterID(Post* post, unsigned long long id);
 
-bool PostManager_RemoveRequesterID(Post* post, unsigned long long requesterID);
+bool PostManager_RemoveRequesterID(DBPostContext* context, Post* post, unsigned long long requesterID, Error* error);
+
+Error PostManager_RemoveAllRequesterIDs(DBPostContext* context, Post* post);
+
+
+/* JSON. */
+/// <summary>
+/// Appends the post's public fields as a JSON object, including the base64 encoded thumbnail.
+/// </summary>
+void PostManager_AppendPostJSON(Post* post, StringBuilder* builder);
 
-void PostManager_RemoveAllRequesterIDs(Post* post);
\ No newline at end of file
+void PostManager_AppendCommentJSON(PostComment* comment, StringBuilder* builder);
\ No newline at end of file
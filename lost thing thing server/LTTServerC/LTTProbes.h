@@ -0,0 +1,54 @@
+#pragma once
+
+
+// Macros.
+/* Static tracepoints for bpftrace and perf, under the "lttserver" provider. They are compiled in by Linux builds which
+* define LTT_ENABLE_PROBES and have sys/sdt.h, a probe is then a single nop until a tracer attaches to it.
+* Any other build expands them to nothing and doesn't evaluate their arguments. */
+#if defined(LTT_ENABLE_PROBES) && defined(__linux__)
+#include <sys/sdt.h>
+
+#define LTT_PROBE1(name, a1) DTRACE_PROBE1(lttserver, name, a1)
+#define LTT_PROBE2(name, a1, a2) DTRACE_PROBE2(lttserver, name, a1, a2)
+#define LTT_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(lttserver, name, a1, a2, a3)
+#define LTT_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(lttserver, name, a1, a2, a3, a4)
+#define LTT_PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(lttserver, name, a1, a2, a3, a4, a5)
+#else
+#define LTT_PROBE1(name, a1) ((void)0)
+#define LTT_PROBE2(name, a1, a2) ((void)0)
+#define LTT_PROBE3(name, a1, a2, a3) ((void)0)
+#define LTT_PROBE4(name, a1, a2, a3, a4) ((void)0)
+#define LTT_PROBE5(name, a1, a2, a3, a4, a5) ((void)0)
+#endif
+
+/* Cache kinds of the cache probes. */
+#define LTT_PROBE_CACHE_ACCOUNT 0
+#define LTT_PROBE_CACHE_POST 1
+
+/* Requests, identified by their number since the server started. Routes are those of AccessLog_FindRoute. */
+#define LTT_PROBE_REQUEST_ACCEPT(requestID, bytesIn) \
+	LTT_PROBE2(request__accept, (unsigned long long)(requestID), (unsigned int)(bytesIn))
+#define LTT_PROBE_REQUEST_PARSE_DONE(requestID, method) \
+	LTT_PROBE2(request__parse__done, (unsigned long long)(requestID), (int)(method))
+#define LTT_PROBE_REQUEST_DISPATCH(requestID, route, method) \
+	LTT_PROBE3(request__dispatch, (unsigned long long)(requestID), (unsigned int)(route), (int)(method))
+#define LTT_PROBE_RESPONSE_SENT(requestID, route, status, bytesOut, accountID) \
+	LTT_PROBE5(response__sent, (unsigned long long)(requestID), (unsigned int)(route), (unsigned int)(status), \
+		(unsigned int)(bytesOut), (unsigned long long)(accountID))
+
+/* Account and post caches, by record ID. */
+#define LTT_PROBE_CACHE_HIT(cache, id) LTT_PROBE2(cache__hit, (int)(cache), (unsigned long long)(id))
+#define LTT_PROBE_CACHE_MISS(cache, id) LTT_PROBE2(cache__miss, (int)(cache), (unsigned long long)(id))
+#define LTT_PROBE_CACHE_EVICT(cache, id, isWritten) \
+	LTT_PROBE3(cache__evict, (int)(cache), (unsigned long long)(id), (int)(isWritten))
+
+/* GHDF data decoded and files written, in bytes. */
+#define LTT_PROBE_GHDF_READ(bytes) LTT_PROBE1(ghdf__read, (unsigned long long)(bytes))
+#define LTT_PROBE_GHDF_WRITE(bytes) LTT_PROBE1(ghdf__write, (unsigned long long)(bytes))
+
+/* Uploaded images, sizes are in pixels. A failed decode has a size of 0. */
+#define LTT_PROBE_IMAGE_DECODE(bytesIn, sizeX, sizeY) \
+	LTT_PROBE3(image__decode, (unsigned long long)(bytesIn), (int)(sizeX), (int)(sizeY))
+#define LTT_PROBE_IMAGE_RESIZE(sizeX, sizeY, targetSizeX, targetSizeY) \
+	LTT_PROBE4(image__resize, (int)(sizeX), (int)(sizeY), (int)(targetSizeX), (int)(targetSizeY))
+#define LTT_PROBE_IMAGE_ENCODE(sizeX, sizeY, isWritten) LTT_PROBE3(image__encode, (int)(sizeX), (int)(sizeY), (int)(isWritten))
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "LTTSchema.h"
+#include <stdio.h>
+
+
+// Macros.
+#define JSON_QUOTE '"'
+#define JSON_ESCAPE '\\'
+#define JSON_VALUE_ASSIGNMENT ':'
+#define JSON_OBJECT_OPEN '{'
+#define JSON_OBJECT_CLOSE '}'
+#define JSON_ARRAY_OPEN '['
+#define JSON_ARRAY_CLOSE ']'
+#define JSON_DELIMETER ','
+#define JSON_TRUE "true"
+#define JSON_FALSE "false"
+
+/* Characters below this must be escaped. */
+#define JSON_FIRST_UNESCAPED_CHAR 0x20
+
+#define NUMBER_BUFFER_SIZE 32
+
+
+// Static functions.
+static void AppendKey(StringBuilder* builder, const char* key, bool* isFirstField)
+{
+	if (!*isFirstField)
+	{
+		StringBuilder_AppendChar(builder, JSON_DELIMETER);
+	}
+	*isFirstField = false;
+
+	Schema_AppendJSONQuoted(builder, key);
+	StringBuilder_AppendChar(builder, JSON_VALUE_ASSIGNMENT);
+}
+
+static void AppendEscapedChar(StringBuilder* builder, unsigned char character)
+{
+	StringBuilder_AppendChar(builder, JSON_ESCAPE);
+
+	switch (character)
+	{
+		case '\n':
+			StringBuilder_AppendChar(builder, 'n');
+			break;
+
+		case '\r':
+			StringBuilder_AppendChar(builder, 'r');
+			break;
+
+		case '\t':
+			StringBuilder_AppendChar(builder, 't');
+			break;
+
+		case JSON_QUOTE:
+		case JSON_ESCAPE:
+			StringBuilder_AppendChar(builder, (char)character);
+			break;
+
+		default:
+		{
+			char Escaped[8];
+			snprintf(Escaped, sizeof(Escaped), "u%04x", (unsigned int)character);
+			StringBuilder_Append(builder, Escaped);
+			break;
+		}
+	}
+}
+
+
+// Functions.
+/* GHDF. */
+Error Schema_ReadEntryInfo(GHDFReader* reader, GHDFEntryInfo* info, SchemaEntrySet* foundEntries)
+{
+	Error ReturnedError = GHDFReader_ReadEntryInfo(reader, info);
+	if ((ReturnedError.Code != ErrorCode_Success) || (info->ID >= SCHEMA_MAX_ENTRY_ID))
+	{
+		return ReturnedError;
+	}
+
+	if (*foundEntries & SchemaEntryBit(info->ID))
+	{
+		char Message[128];
+		snprintf(Message, sizeof(Message), "Found more than one GHDF entry with id %d.", info->ID);
+		return Error_CreateError(ErrorCode_InvalidGHDFFile, Message);
+	}
+	*foundEntries |= SchemaEntryBit(info->ID);
+	return Error_CreateSuccess();
+}
+
+Error Schema_VerifyRequiredEntries(SchemaEntrySet foundEntries, SchemaEntrySet requiredEntries, const char* recordName)
+{
+	SchemaEntrySet MissingEntries = requiredEntries & ~foundEntries;
+	if (!MissingEntries)
+	{
+		return Error_CreateSuccess();
+	}
+
+	int MissingID = 0;
+	while (!(MissingEntries & SchemaEntryBit(MissingID)))
+	{
+		MissingID++;
+	}
+
+	char Message[256];
+	snprintf(Message, sizeof(Message), "Expected GHDF entry with id %d, found no such entry. %s", MissingID, recordName);
+	return Error_CreateError(ErrorCode_InvalidGHDFFile, Message);
+}
+
+/* JSON. */
+void Schema_BeginJSONObject(StringBuilder* builder, bool* isFirstField)
+{
+	StringBuilder_AppendChar(builder, JSON_OBJECT_OPEN);
+	*isFirstField = true;
+}
+
+void Schema_EndJSONObject(StringBuilder* builder)
+{
+	StringBuilder_AppendChar(builder, JSON_OBJECT_CLOSE);
+}
+
+void Schema_AppendJSONQuoted(StringBuilder* builder, const char* string)
+{
+	StringBuilder_AppendChar(builder, JSON_QUOTE);
+
+	// Runs of plain characters are appended at once, only the characters which need escaping are handled one by one.
+	const char* RunStart = string;
+	for (const char* Character = string; *Character != '\0'; Character++)
+	{
+		unsigned char Value = (unsigned char)*Character;
+		if ((Value >= JSON_FIRST_UNESCAPED_CHAR) && (Value != JSON_QUOTE) && (Value != JSON_ESCAPE))
+		{
+			continue;
+		}
+
+		for (const char* Plain = RunStart; Plain < Character; Plain++)
+		{
+			StringBuilder_AppendChar(builder, *Plain);
+		}
+		AppendEscapedChar(builder, Value);
+		RunStart = Character + 1;
+	}
+	StringBuilder_Append(builder, RunStart);
+
+	StringBuilder_AppendChar(builder, JSON_QUOTE);
+}
+
+void Schema_AppendJSONULong(StringBuilder* builder, const char* key, unsigned long long value, bool* isFirstField)
+{
+	char Number[NUMBER_BUFFER_SIZE];
+	snprintf(Number, sizeof(Number), "%llu", value);
+	AppendKey(builder, key, isFirstField);
+	Schema_AppendJSONQuoted(builder, Number);
+}
+
+void Schema_AppendJSONLong(StringBuilder* builder, const char* key, long long value, bool* isFirstField)
+{
+	char Number[NUMBER_BUFFER_SIZE];
+	snprintf(Number, sizeof(Number), "%lld", value);
+	AppendKey(builder, key, isFirstField);
+	Schema_AppendJSONQuoted(builder, Number);
+}
+
+void Schema_AppendJSONInt(StringBuilder* builder, const char* key, int value, bool* isFirstField)
+{
+	Schema_AppendJSONLong(builder, key, value, isFirstField);
+}
+
+void Schema_AppendJSONBool(StringBuilder* builder, const char* key, bool value, bool* isFirstField)
+{
+	AppendKey(builder, key, isFirstField);
+	StringBuilder_Append(builder, value ? JSON_TRUE : JSON_FALSE);
+}
+
+void Schema_AppendJSONString(StringBuilder* builder, const char* key, const char* value, bool* isFirstField)
+{
+	AppendKey(builder, key, isFirstField);
+	Schema_AppendJSONQuoted(builder, value ? value : "");
+}
+
+void Schema_AppendJSONULongList(StringBuilder* builder, const char* key, const unsigned long long* values, size_t count, bool* isFirstField)
+{
+	AppendKey(builder, key, isFirstField);
+	StringBuilder_AppendChar(builder, JSON_ARRAY_OPEN);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (i != 0)
+		{
+			StringBuilder_AppendChar(builder, JSON_DELIMETER);
+		}
+
+		char Number[NUMBER_BUFFER_SIZE];
+		snprintf(Number, sizeof(Number), "%llu", values[i]);
+		Schema_AppendJSONQuoted(builder, Number);
+	}
+
+	StringBuilder_AppendChar(builder, JSON_ARRAY_CLOSE);
+}
\ No newline at end of file
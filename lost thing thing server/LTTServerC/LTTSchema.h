@@ -0,0 +1,150 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "LttErrors.h"
+#include "LttString.h"
+#include "GHDF.h"
+#include "Memory.h"
+
+
+// Macros.
+/* Field flags. */
+#define SCHEMA_GHDF 1 // Stored in database files.
+#define SCHEMA_JSON 2 // Sent to clients.
+#define SCHEMA_OPTIONAL 4 // May be missing from database files, empty lists aren't stored at all.
+#define SCHEMA_GHDF_JSON (SCHEMA_GHDF | SCHEMA_JSON)
+
+/* Entry sets have one bit per entry ID, so schema entry IDs must be lower than this. */
+#define SCHEMA_MAX_ENTRY_ID 64
+#define SCHEMA_ALL_ENTRIES (~(SchemaEntrySet)0)
+
+#define SchemaEntryBit(entryID) ((SchemaEntrySet)1 << (entryID))
+#define SchemaEntrySet_Contains(set, entryID) (((entryID) < SCHEMA_MAX_ENTRY_ID) && ((set) & SchemaEntryBit(entryID)))
+
+/* A schema lists a record's fields as an X-macro taking two macros:
+*  FIELD(Kind, Member, EntryID, JSONKey, Flags) for single values, Kind being ULong, Long, Int, Bool or String.
+*  LIST(Kind, Member, CountMember, EntryID, JSONKey, Flags) for heap arrays of a fixed size Kind with a separate count.
+* The macros below turn each field into code working on the surrounding function's record, buffer, reader, Info,
+* builder, IsFirstField and ReturnedError, so encoders and decoders go straight between structs and data. */
+
+/* Amount of entries written, expands to a sum: 0 RECORD_SCHEMA(SCHEMA_COUNT_FIELD, SCHEMA_COUNT_LIST) */
+#define SCHEMA_COUNT_FIELD(Kind, Member, EntryID, JSONKey, Flags) \
+	+ (((Flags) & SCHEMA_GHDF) ? 1 : 0)
+
+#define SCHEMA_COUNT_LIST(Kind, Member, CountMember, EntryID, JSONKey, Flags) \
+	+ ((((Flags) & SCHEMA_GHDF) && (!((Flags) & SCHEMA_OPTIONAL) || (record->CountMember > 0))) ? 1 : 0)
+
+/* Entries which must be present, expands to a union: 0 RECORD_SCHEMA(SCHEMA_REQUIRED_FIELD, SCHEMA_REQUIRED_LIST) */
+#define SCHEMA_REQUIRED_FIELD(Kind, Member, EntryID, JSONKey, Flags) \
+	| ((((Flags) & SCHEMA_GHDF) && !((Flags) & SCHEMA_OPTIONAL)) ? SchemaEntryBit(EntryID) : 0)
+
+#define SCHEMA_REQUIRED_LIST(Kind, Member, CountMember, EntryID, JSONKey, Flags) \
+	SCHEMA_REQUIRED_FIELD(Kind, Member, EntryID, JSONKey, Flags)
+
+/* GHDF encoding. */
+#define SCHEMA_WRITE_FIELD(Kind, Member, EntryID, JSONKey, Flags) \
+	if ((Flags) & SCHEMA_GHDF) \
+	{ \
+		GHDFPrimitive Value; \
+		Value.Kind = (SchemaType_##Kind)record->Member; \
+		GHDFBuffer_WriteValueEntry(buffer, GHDFType_##Kind, (EntryID), Value); \
+	}
+
+#define SCHEMA_WRITE_LIST(Kind, Member, CountMember, EntryID, JSONKey, Flags) \
+	if (((Flags) & SCHEMA_GHDF) && (!((Flags) & SCHEMA_OPTIONAL) || (record->CountMember > 0))) \
+	{ \
+		GHDFBuffer_WriteArrayEntry(buffer, GHDFType_##Kind, (EntryID), record->Member, (unsigned int)record->CountMember); \
+	}
+
+/* GHDF decoding, expands to an if-else chain over Info.ID which has to be completed with a final block for unknown entries. */
+#define SCHEMA_READ_FIELD(Kind, Member, EntryID, JSONKey, Flags) \
+	if (((Flags) & SCHEMA_GHDF) && (Info.ID == (EntryID))) \
+	{ \
+		GHDFPrimitive Value; \
+		ReturnedError = GHDFReader_ReadValue(reader, &Info, GHDFType_##Kind, &Value); \
+		if (ReturnedError.Code == ErrorCode_Success) \
+		{ \
+			record->Member = Value.Kind; \
+		} \
+	} \
+	else
+
+/* Lists are always allocated on the heap and owned by the record, even when strings are decoded into an arena. */
+#define SCHEMA_READ_LIST(Kind, Member, CountMember, EntryID, JSONKey, Flags) \
+	if (((Flags) & SCHEMA_GHDF) && (Info.ID == (EntryID))) \
+	{ \
+		unsigned int ElementCount; \
+		ReturnedError = GHDFReader_ReadArrayHeader(reader, &Info, GHDFType_##Kind, &ElementCount); \
+		if ((ReturnedError.Code == ErrorCode_Success) && (ElementCount > 0)) \
+		{ \
+			record->Member = Memory_SafeMalloc(sizeof(*record->Member) * ElementCount); \
+			record->CountMember = ElementCount; \
+			ReturnedError = GHDFReader_ReadArrayElements(reader, GHDFType_##Kind, record->Member, ElementCount); \
+		} \
+		if (ReturnedError.Code == ErrorCode_Success) \
+		{ \
+			ReturnedError = GHDFReader_EndValue(reader, &Info); \
+		} \
+	} \
+	else
+
+/* JSON encoding. */
+#define SCHEMA_APPEND_JSON_FIELD(Kind, Member, EntryID, JSONKey, Flags) \
+	if ((Flags) & SCHEMA_JSON) \
+	{ \
+		Schema_AppendJSON##Kind(builder, (JSONKey), (SchemaType_##Kind)record->Member, &IsFirstField); \
+	}
+
+#define SCHEMA_APPEND_JSON_LIST(Kind, Member, CountMember, EntryID, JSONKey, Flags) \
+	if ((Flags) & SCHEMA_JSON) \
+	{ \
+		Schema_AppendJSON##Kind##List(builder, (JSONKey), record->Member, (size_t)record->CountMember, &IsFirstField); \
+	}
+
+
+// Types.
+typedef unsigned long long SchemaEntrySet;
+
+/* C types of the field kinds, named after the matching GHDFType and GHDFPrimitive member. */
+typedef unsigned long long SchemaType_ULong;
+typedef long long SchemaType_Long;
+typedef int SchemaType_Int;
+typedef bool SchemaType_Bool;
+typedef char* SchemaType_String;
+
+
+// Functions.
+/* GHDF. */
+/// <summary>
+/// Reads an entry's header and records its ID in the found entries, failing if the entry was already found.
+/// </summary>
+Error Schema_ReadEntryInfo(GHDFReader* reader, GHDFEntryInfo* info, SchemaEntrySet* foundEntries);
+
+/// <summary>
+/// Fails with the ID of the first required entry which wasn't found.
+/// </summary>
+/// <param name="recordName">Name of the record for the error message.</param>
+Error Schema_VerifyRequiredEntries(SchemaEntrySet foundEntries, SchemaEntrySet requiredEntries, const char* recordName);
+
+/* JSON. */
+void Schema_BeginJSONObject(StringBuilder* builder, bool* isFirstField);
+
+void Schema_EndJSONObject(StringBuilder* builder);
+
+/// <summary>
+/// Appends a quoted string, escaping quotes, backslashes and control characters.
+/// </summary>
+void Schema_AppendJSONQuoted(StringBuilder* builder, const char* string);
+
+/* Numbers are sent as strings since 64-bit IDs don't fit into JavaScript numbers, the same goes for numbers in lists. */
+void Schema_AppendJSONULong(StringBuilder* builder, const char* key, unsigned long long value, bool* isFirstField);
+
+void Schema_AppendJSONLong(StringBuilder* builder, const char* key, long long value, bool* isFirstField);
+
+void Schema_AppendJSONInt(StringBuilder* builder, const char* key, int value, bool* isFirstField);
+
+void Schema_AppendJSONBool(StringBuilder* builder, const char* key, bool value, bool* isFirstField);
+
+void Schema_AppendJSONString(StringBuilder* builder, const char* key, const char* value, bool* isFirstField);
+
+void Schema_AppendJSONULongList(StringBuilder* builder, const char* key, const unsigned long long* values, size_t count, bool* isFirstField);
\ No newline at end of file
@@ -14,6 +14,16 @@
 #include "Logger.h"
 #include "LTTPostManager.h"
 #include "LTTSMTP.h"
+#include "Epoch.h"
+#include "AccessLog.h"
+#include "Trace.h"
+#include "LTTChar.h"
+#include "LttString.h"
+
+
+// Macros.
+#define ARGUMENT_SUMMARIZE_ACCESS_LOG "--summarize-access-log"
+#define BYTES_IN_MEGABYTE (1024ull * 1024ull)
 
 
 // Static variables.
@@ -28,11 +38,30 @@ static void CloseContext(ServerContext* context)
 		AccountManager_Deconstruct(context->AccountContext);
 		Memory_Free(context->AccountContext);
 	}
+	// Closing the post context waits for its index build, which may still log.
+	if (context->PostContext)
+	{
+		PostManager_Deconstruct(context->PostContext);
+		Memory_Free(context->PostContext);
+	}
 	if (context->Resources)
 	{
 		ResourceManager_Deconstruct(context->Resources);
 		Memory_Free(context->Resources);
 	}
+	if (context->AccessLog)
+	{
+		if (context->AccessLog->DroppedCount > 0)
+		{
+			char Message[128];
+			snprintf(Message, sizeof(Message), "Access log dropped %lld records while its ring was full.", context->AccessLog->DroppedCount);
+			Logger_LogWarning(context->Logger, Message);
+		}
+		Error ReturnedError = AccessLog_Deconstruct(context->AccessLog);
+		Error_Deconstruct(&ReturnedError);
+		Memory_Free(context->AccessLog);
+	}
+	Trace_Close();
 	if (context->Configuration)
 	{
 		ServerConfig_Deconstruct(context->Configuration);
@@ -48,11 +77,7 @@ static void CloseContext(ServerContext* context)
 	{
 		Memory_Free((char*)context->ServerRootPath);
 	}
-	if (context->PostContext)
-	{
-		PostManager_Deconstruct(context->PostContext);
-		Memory_Free(context->PostContext);
-	}
+	Epoch_ReclaimAll();
 }
 
 static Error CreateContext(ServerContext* context, const char* serverExecutablePath)
@@ -83,6 +108,26 @@ static Error CreateContext(ServerContext* context, const char* serverExecutableP
 	}
 	Logger_LogInfo(context->Logger, "Read configuration.");
 
+	LogRotation Rotation =
+	{
+		context->Configuration->LogMaxFileMegabytes * BYTES_IN_MEGABYTE,
+		context->Configuration->LogRotateDaily,
+		context->Configuration->LogCompressOld,
+		context->Configuration->LogMaxOldFiles
+	};
+	Logger_SetRotation(context->Logger, &Rotation);
+
+	// Access log.
+	context->AccessLog = (AccessLog*)Memory_SafeMalloc(sizeof(AccessLog));
+	ReturnedError = AccessLog_Construct(context->AccessLog, context->ServerRootPath, context->Configuration->AccessLogSampleInterval,
+		&Rotation);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		CloseContext(context);
+		return ReturnedError;
+	}
+	Trace_Configure(context->ServerRootPath, context->Configuration->TraceSlowRequestMilliseconds);
+
 	// Database.
 	context->Resources = (ServerResourceContext*)Memory_SafeMalloc(sizeof(ServerResourceContext));
 	ResourceManager_Construct(context->Resources, context->ServerRootPath);
@@ -172,8 +217,26 @@ static int RunServer(const char* executablePath)
 	return EXIT_SUCCESS;
 }
 
+static int SummarizeAccessLog(const char* const* paths, size_t pathCount)
+{
+	Error ReturnedError = AccessLog_Summarize(paths, pathCount, stdout);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		printf("Failed to summarize access log: %s\n", ReturnedError.Message);
+		Error_Deconstruct(&ReturnedError);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
 // Functions.
 int main(int argc, const char** argv)
 {
+	Char_InitializeTables();
+	// Takes access log files or directories, such as the log directory and its old log directory together.
+	if ((argc >= 3) && String_Equals(argv[1], ARGUMENT_SUMMARIZE_ACCESS_LOG))
+	{
+		return SummarizeAccessLog(argv + 2, (size_t)(argc - 2));
+	}
 	return RunServer(argv[0]);
 }
\ No newline at end of file
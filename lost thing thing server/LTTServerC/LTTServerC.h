@@ -7,6 +7,7 @@ typedef struct ServerContextStruct
 	const char* ServerRootPath;
 	struct LoggerStruct* Logger;
 	struct ServerConfigStruct* Configuration;
+	struct AccessLogStruct* AccessLog;
 	struct ServerResourceContextStruct* Resources;
 	struct DBAccountContextStruct* AccountContext;
 	struct DBPostContextStruct* PostContext;
@@ -12,6 +12,8 @@
 #include "LTTPostManager.h"
 #include "Logger.h"
 #include "LTTBase64.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 
 // Macros.
@@ -197,22 +199,94 @@ static void JSONAppendQuoted(StringBuilder* builder, const char* string)
 	StringBuilder_AppendChar(builder, JSON_QUOTE);
 }
 
-static void JSONAppendString(StringBuilder* builder, const char* key, const char* value)
+/* Index builds. */
+static void AppendIndexBuildJSON(StringBuilder* builder, const char* name, IndexBuild* build, bool isReindexing)
 {
-	JSONAppendQuoted(builder, key);
+	JSONAppendQuoted(builder, name);
 	StringBuilder_AppendChar(builder, JSON_VALUE_ASSIGNMENT);
-	JSONAppendQuoted(builder, value);
-}
+	StringBuilder_AppendChar(builder, JSON_OBJECT_OPEN);
+
+	JSONAppendQuoted(builder, "state");
+	StringBuilder_AppendChar(builder, JSON_VALUE_ASSIGNMENT);
+	switch (IndexBuild_GetState(build))
+	{
+		case IndexBuildState_Complete:
+			JSONAppendQuoted(builder, "complete");
+			break;
+
+		case IndexBuildState_Running:
+			JSONAppendQuoted(builder, "running");
+			break;
+
+		default:
+			JSONAppendQuoted(builder, "failed");
+			break;
+	}
 
-static void JSONAppendInt(StringBuilder* builder, const char* key, long long integer)
-{
 	char Number[32];
-	snprintf(Number, sizeof(Number), "ll", integer);
-	JSONAppendQuoted(builder, key);
+	StringBuilder_AppendChar(builder, JSON_DELIMETER);
+	JSONAppendQuoted(builder, "indexed");
+	StringBuilder_AppendChar(builder, JSON_VALUE_ASSIGNMENT);
+	snprintf(Number, sizeof(Number), "%lld", Atomic_Load(&build->IndexedCount));
+	StringBuilder_Append(builder, Number);
+
+	StringBuilder_AppendChar(builder, JSON_DELIMETER);
+	JSONAppendQuoted(builder, "total");
 	StringBuilder_AppendChar(builder, JSON_VALUE_ASSIGNMENT);
-	JSONAppendQuoted(builder, Number);
+	snprintf(Number, sizeof(Number), "%llu", (unsigned long long)build->IDCount);
+	StringBuilder_Append(builder, Number);
+
+	// A reindex runs next to the live indexes, which stay searchable.
+	StringBuilder_AppendChar(builder, JSON_DELIMETER);
+	JSONAppendQuoted(builder, "reindexing");
+	StringBuilder_AppendChar(builder, JSON_VALUE_ASSIGNMENT);
+	StringBuilder_Append(builder, isReindexing ? "true" : "false");
+
+	StringBuilder_AppendChar(builder, JSON_OBJECT_CLOSE);
+}
+
+/* Progress of the background index builds, also the body of searches made while they run. */
+static void BuildIndexBuildJSONString(ServerContext* context, StringBuilder* builder)
+{
+	StringBuilder_AppendChar(builder, JSON_OBJECT_OPEN);
+	AppendIndexBuildJSON(builder, "accounts", &context->AccountContext->IndexBuilder, Atomic_Load(&context->AccountContext->_isReindexing));
+	StringBuilder_AppendChar(builder, JSON_DELIMETER);
+	AppendIndexBuildJSON(builder, "posts", &context->PostContext->IndexBuilder, Atomic_Load(&context->PostContext->_isReindexing));
+	StringBuilder_AppendChar(builder, JSON_OBJECT_CLOSE);
+}
+
+/* Metrics. */
+static void UpdateMetricGauges(ServerContext* context)
+{
+	// Read without their locks, a gauge may be off by changes made during the export.
+	DBAccountContext* AccountContext = context->AccountContext;
+	DBPostContext* PostContext = context->PostContext;
+	Metrics_SetGauge(MetricGauge_SessionCount, (long long)AccountContext->SessionCount);
+	Metrics_SetGauge(MetricGauge_UnfinishedPostCount, (long long)PostContext->UnfinishedPostCount);
+	Metrics_SetGauge(MetricGauge_AccountNameTermCount, (long long)AccountContext->NameTerms.TermCount);
+	Metrics_SetGauge(MetricGauge_PostTitleTermCount, (long long)PostContext->TitleTerms.TermCount);
+
+	Metrics_SetGauge(MetricGauge_AccountIndexRecordCount, (long long)AccountContext->IndexBuilder.IDCount);
+	Metrics_SetGauge(MetricGauge_AccountIndexIndexedCount, Atomic_Load(&AccountContext->IndexBuilder.IndexedCount));
+	Metrics_SetGauge(MetricGauge_AccountIndexState, (long long)IndexBuild_GetState(&AccountContext->IndexBuilder));
+	Metrics_SetGauge(MetricGauge_PostIndexRecordCount, (long long)PostContext->IndexBuilder.IDCount);
+	Metrics_SetGauge(MetricGauge_PostIndexIndexedCount, Atomic_Load(&PostContext->IndexBuilder.IndexedCount));
+	Metrics_SetGauge(MetricGauge_PostIndexState, (long long)IndexBuild_GetState(&PostContext->IndexBuilder));
+}
+
+/* Metrics are open to scrapers, which have no session. They only hold counts. */
+static ResourceResult ExecuteGetSpecialAction(ServerContext* context, ServerResourceRequest* request, char* action)
+{
+	if (String_Equals(action, "metrics"))
+	{
+		UpdateMetricGauges(context);
+		Metrics_WritePrometheus(request->ResultStringBuilder);
+		return ResourceResult_Successful;
+	}
+	return ResourceResult_Invalid;
 }
 
+
 /* Accounts. */
 static bool DoSessionsMatch(unsigned int* session1, unsigned int* session2)
 {
@@ -299,43 +373,11 @@ static void BuildFoundAccountJSONString(UserAccount** accounts, size_t accountCo
 		{
 			StringBuilder_AppendChar(builder, JSON_DELIMETER);
 		}
-		StringBuilder_AppendChar(builder, JSON_OBJECT_OPEN);
-
-		JSONAppendInt(builder, "id", (long long)accounts[i]->ID);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendString(builder, "name", accounts[i]->Name);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendString(builder, "surname", accounts[i]->Surname);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendString(builder, "email", accounts[i]->Email);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-		
-		JSONAppendInt(builder, "creation_time", accounts[i]->CreationTime);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendQuoted(builder, "posts");
-		StringBuilder_AppendChar(builder, JSON_VALUE_ASSIGNMENT);
-		StringBuilder_AppendChar(builder, JSON_ARRAY_OPEN);
-		for (size_t PostIndex = 0; PostIndex < accounts[i]->PostCount; i++)
-		{
-			char Number[32];
-			if (PostIndex != 0)
-			{
-				StringBuilder_AppendChar(builder, JSON_DELIMETER);
-			}
-			snprintf(Number, sizeof(Number), "%llu", accounts[i]->Posts[PostIndex]);
-			StringBuilder_Append(builder, Number);
-		}
-		StringBuilder_AppendChar(builder, JSON_ARRAY_CLOSE);
-
-		StringBuilder_AppendChar(builder, JSON_OBJECT_CLOSE);
+		AccountManager_AppendAccountJSON(accounts[i], builder);
 	}
 
 	StringBuilder_AppendChar(builder, JSON_ARRAY_CLOSE);
-	StringBuilder_AppendChar(builder, JSON_OBJECT_OPEN);
+	StringBuilder_AppendChar(builder, JSON_OBJECT_CLOSE);
 }
 
 static ResourceResult CreateAccount(ServerContext* context, ParsedArguments* arguments, Error* error)
@@ -410,8 +452,8 @@ static ResourceResult LoginAccount(ServerContext* context, ParsedArguments* argu
 		return ResourceResult_Invalid;
 	}
 
-	SessionID* Session = AccountManager_TryCreateSession(context->AccountContext, TargetAccount, Password);
-	if (!Session)
+	SessionID* Session = AccountManager_TryCreateSession(context->AccountContext, TargetAccount, Password, error);
+	if ((error->Code != ErrorCode_Success) || !Session)
 	{
 		return ResourceResult_Invalid;
 	}
@@ -430,14 +472,21 @@ static UserAccount* GetAccountFromRequest(ServerContext* context, ServerResource
 		return NULL;
 	}
 	
+	TraceSpan Span = Trace_BeginSpan("GetAccountFromRequest");
 	unsigned int* SessionInRequest = ParseSession(SessionValueString);
 	if (!SessionInRequest)
 	{
+		Trace_EndSpan(Span);
 		return ResourceResult_Invalid;
 	}
 
 	UserAccount* TargetAccount = AccountManager_GetAccountBySession(context->AccountContext, SessionInRequest, error);
 	Memory_Free(SessionInRequest);
+	if (TargetAccount)
+	{
+		request->AccountID = TargetAccount->ID;
+	}
+	Trace_EndSpan(Span);
 	return TargetAccount;
 }
 
@@ -487,6 +536,12 @@ static ResourceResult GetAccounts(ServerContext* context, ServerResourceRequest*
 	{
 		return ResourceResult_Invalid;
 	}
+	if (!AccountManager_IsSearchReady(context->AccountContext))
+	{
+		// The client may retry once the background index build is done.
+		BuildIndexBuildJSONString(context, request->ResultStringBuilder);
+		return ResourceResult_Unavailable;
+	}
 	size_t AccountCount;
 	UserAccount** FoundAccounts = AccountManager_GetAccountsByName(context->AccountContext, Name, &AccountCount, error);
 	if (error->Code != ErrorCode_Success)
@@ -516,7 +571,11 @@ static ResourceResult EditAccount(ServerContext* context, ServerResourceRequest*
 		return ResourceResult_Invalid;
 	}
 	
-	return AccountManager_SetName(TargetAccount, Name) && AccountManager_SetSurname(TargetAccount, Surname) ?
+	if (!AccountManager_SetName(context->AccountContext, TargetAccount, Name, error) || (error->Code != ErrorCode_Success))
+	{
+		return ResourceResult_Invalid;
+	}
+	return AccountManager_SetSurname(context->AccountContext, TargetAccount, Surname, error) && (error->Code == ErrorCode_Success) ?
 		ResourceResult_Successful : ResourceResult_Invalid;
 }
 
@@ -536,55 +595,7 @@ static void BuildPostsJSONString(Post** posts, size_t postCount, StringBuilder*
 		{
 			StringBuilder_AppendChar(builder, JSON_DELIMETER);
 		}
-		
-		StringBuilder_AppendChar(builder, JSON_OBJECT_OPEN);
-
-		JSONAppendInt(builder, "id", posts[i]->ID);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendInt(builder, "author_id", posts[i]->AuthorID);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendString(builder, "title", posts[i]->Title);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendString(builder, "description", posts[i]->Description);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		const char* EncodedThumbnail = Base64_Encode(posts[i]->ThumbnailData, posts[i]->ThumbnailDataLength);
-		JSONAppendString(builder, "thumbnail", EncodedThumbnail);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-		Memory_Free(EncodedThumbnail);
-
-		JSONAppendInt(builder, "creation_time", posts[i]->CreationTime);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendInt(builder, "image_count", posts[i]->ImageCount);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendInt(builder, "claimer", posts[i]->ClaimerID);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendInt(builder, "tags", posts[i]->Tags);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendQuoted(builder, "requesters");
-		StringBuilder_AppendChar(builder, JSON_VALUE_ASSIGNMENT);
-		StringBuilder_AppendChar(builder, JSON_ARRAY_OPEN);
-		for (size_t reqIndex = 0; reqIndex < posts[i]->RequesterCount; i++)
-		{
-			if (reqIndex != 0)
-			{
-				StringBuilder_AppendChar(builder, JSON_DELIMETER);
-			}
-
-			char Number[32];
-			snprintf(Number, sizeof(Number), "%llu", posts[i]->RequesterIDs[i]);
-			StringBuilder_Append(builder, Number);
-		}
-		StringBuilder_AppendChar(builder, JSON_ARRAY_CLOSE);
-
-		StringBuilder_AppendChar(builder, JSON_OBJECT_CLOSE);
+		PostManager_AppendPostJSON(posts[i], builder);
 	}
 
 	StringBuilder_AppendChar(builder, JSON_ARRAY_CLOSE);
@@ -604,28 +615,7 @@ static void BuildCommentsJSONString(PostComment** comments, size_t commentCount,
 		{
 			StringBuilder_AppendChar(builder, JSON_DELIMETER);
 		}
-
-		StringBuilder_AppendChar(builder, JSON_OBJECT_OPEN);
-
-		JSONAppendInt(builder, "id", comments[i]->ID);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendInt(builder, "author_id", comments[i]->AuthorID);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-
-		JSONAppendInt(builder, "parent_comment_id", comments[i]->ParentCommentID);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendInt(builder, "creation_time", comments[i]->CreationTime);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendInt(builder, "edit_time", comments[i]->LastEditTime);
-		StringBuilder_AppendChar(builder, JSON_DELIMETER);
-
-		JSONAppendString(builder, "contents", comments[i]->Contents);
-
-		StringBuilder_AppendChar(builder, JSON_OBJECT_CLOSE);
+		PostManager_AppendCommentJSON(comments[i], builder);
 	}
 
 	StringBuilder_AppendChar(builder, JSON_ARRAY_CLOSE);
@@ -771,8 +761,8 @@ static ResourceResult CreateComment(ServerContext* context,
 	}
 	unsigned long long ParentCommentID = strtoul(ParentCommentIDString, NULL, 10);
 
-	return PostManager_AddComment(TargetPost, TargetAccount->ID, ParentCommentID, Contents) ? 
-		ResourceResult_Successful : ResourceResult_Invalid;
+	return PostManager_AddComment(context->PostContext, TargetPost, TargetAccount->ID, ParentCommentID, Contents, error)
+		&& (error->Code == ErrorCode_Success) ? ResourceResult_Successful : ResourceResult_Invalid;
 }
 
 static ResourceResult EditComment(ServerContext* context,
@@ -929,6 +919,17 @@ static ResourceResult ExecutePostPostAction(ServerContext* context,
 	}
 }
 
+/* Indexes which are already being built are left to finish, the returned progress shows them either way. */
+static Error IgnoreReindexInProgress(Error reindexError)
+{
+	if (reindexError.Code == ErrorCode_IllegalState)
+	{
+		Error_Deconstruct(&reindexError);
+		return Error_CreateSuccess();
+	}
+	return reindexError;
+}
+
 static ResourceResult ExecuteSpecialAction(ServerContext* context,
 	ServerResourceRequest* request,
 	ParsedArguments* arguments,
@@ -946,6 +947,27 @@ static ResourceResult ExecuteSpecialAction(ServerContext* context,
 	{
 		return ResourceResult_ShutDownServer;
 	}
+	else if (String_Equals(action, "index-status"))
+	{
+		BuildIndexBuildJSONString(context, request->ResultStringBuilder);
+		return ResourceResult_Successful;
+	}
+	else if (String_Equals(action, "reindex"))
+	{
+		*error = IgnoreReindexInProgress(AccountManager_Reindex(context));
+		if (error->Code != ErrorCode_Success)
+		{
+			return ResourceResult_Invalid;
+		}
+		*error = IgnoreReindexInProgress(PostManager_Reindex(context));
+		if (error->Code != ErrorCode_Success)
+		{
+			return ResourceResult_Invalid;
+		}
+
+		BuildIndexBuildJSONString(context, request->ResultStringBuilder);
+		return ResourceResult_Successful;
+	}
 	return ResourceResult_Invalid;
 }
 
@@ -971,7 +993,22 @@ ResourceResult ResourceManager_Get(ServerContext* context, ServerResourceRequest
 	ParsedArguments Arguments;
 	ParseArgumentsFromBody(&Arguments, request->Data);
 
-	return ResourceResult_Successful;
+	size_t PathCount;
+	char** Paths = GetPathAsParts(request->Target, &PathCount);
+
+	ResourceResult Result = ResourceResult_Successful;
+	if ((PathCount == 2) && String_Equals(Paths[0], "special"))
+	{
+		Result = ExecuteGetSpecialAction(context, request, Paths[1]);
+	}
+
+	ArgumentsDeconstruct(&Arguments);
+	if (PathCount > 0)
+	{
+		Memory_Free(Paths[0]);
+	}
+	Memory_Free(Paths);
+	return Result;
 }
 
 ResourceResult ResourceManager_Post(ServerContext* context, ServerResourceRequest* request)
@@ -1017,4 +1054,17 @@ ResourceResult ResourceManager_Post(ServerContext* context, ServerResourceReques
 	Memory_Free(Paths[0]);
 	Memory_Free(Paths);
 	return Result;
+}
+
+Error ResourceManager_CommitChanges(ServerContext* context)
+{
+	// Both are committed even if one fails, the changes of either don't depend on the other's.
+	Error AccountError = AccountManager_CommitMutations(context->AccountContext);
+	Error PostError = PostManager_CommitMutations(context->PostContext);
+	if (AccountError.Code != ErrorCode_Success)
+	{
+		Error_Deconstruct(&PostError);
+		return AccountError;
+	}
+	return PostError;
 }
\ No newline at end of file
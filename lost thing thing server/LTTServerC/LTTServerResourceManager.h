@@ -13,6 +13,7 @@ typedef enum ResourceResultEnum
 	ResourceResult_Invalid,
 	ResourceResult_Unauthorized,
 	ResourceResult_ShutDownServer,
+	ResourceResult_Unavailable,
 } ResourceResult;
 
 typedef struct ServerResourceContextStruct
@@ -29,6 +30,8 @@ typedef struct ServerResourceRequestStruct
 	HttpCookie* CookieArray;
 	size_t CookieCount;
 	StringBuilder* ResultStringBuilder;
+	/* Account the request's session belongs to, set once the session is looked up, 0 if it isn't. */
+	unsigned long long AccountID;
 } ServerResourceRequest;
 
 
@@ -39,4 +42,10 @@ void ResourceManager_Deconstruct(ServerResourceContext* context);
 
 ResourceResult ResourceManager_Get(ServerContext* serverContext, ServerResourceRequest* request);
 
-ResourceResult ResourceManager_Post(ServerContext* serverContext, ServerResourceRequest* request);
\ No newline at end of file
+ResourceResult ResourceManager_Post(ServerContext* serverContext, ServerResourceRequest* request);
+
+/// <summary>
+/// Makes the changes of all requests handled since the last call last through a crash, requests which changed
+/// something must not be answered before this has succeeded.
+/// </summary>
+Error ResourceManager_CommitChanges(ServerContext* serverContext);
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "LTTThread.h"
+#include "Memory.h"
+#include "Epoch.h"
+#include "Metrics.h"
+#include <Windows.h>
+#include <process.h>
+
+
+// Macros.
+_Static_assert(sizeof(ThreadLock) == sizeof(SRWLOCK), "ThreadLock must be able to hold an SRWLOCK.");
+_Static_assert(sizeof(ThreadCondition) == sizeof(CONDITION_VARIABLE), "ThreadCondition must be able to hold a CONDITION_VARIABLE.");
+
+
+// Types.
+typedef struct ThreadStartStruct
+{
+	ThreadFunction Function;
+	void* Argument;
+} ThreadStart;
+
+
+// Static functions.
+static unsigned int __stdcall RunThread(void* argument)
+{
+	ThreadStart Start = *(ThreadStart*)argument;
+	Memory_Free(argument);
+
+	Start.Function(Start.Argument);
+	Epoch_UnregisterThread();
+	Metrics_UnregisterThread();
+	return 0;
+}
+
+
+// Functions.
+/* Threads. */
+bool Thread_Start(Thread* thread, ThreadFunction function, void* argument)
+{
+	ThreadStart* Start = (ThreadStart*)Memory_SafeMalloc(sizeof(ThreadStart));
+	Start->Function = function;
+	Start->Argument = argument;
+
+	thread->_handle = (void*)_beginthreadex(NULL, 0, RunThread, Start, 0, NULL);
+	if (!thread->_handle)
+	{
+		Memory_Free(Start);
+		return false;
+	}
+	return true;
+}
+
+void Thread_Join(Thread* thread)
+{
+	if (!thread->_handle)
+	{
+		return;
+	}
+
+	WaitForSingleObject((HANDLE)thread->_handle, INFINITE);
+	CloseHandle((HANDLE)thread->_handle);
+	thread->_handle = NULL;
+}
+
+unsigned int Thread_GetProcessorCount()
+{
+	SYSTEM_INFO Info;
+	GetSystemInfo(&Info);
+	return Info.dwNumberOfProcessors > 0 ? (unsigned int)Info.dwNumberOfProcessors : 1;
+}
+
+/* Locks. */
+void ThreadLock_Construct(ThreadLock* lock)
+{
+	InitializeSRWLock((PSRWLOCK)lock);
+}
+
+void ThreadLock_Lock(ThreadLock* lock)
+{
+	AcquireSRWLockExclusive((PSRWLOCK)lock);
+}
+
+void ThreadLock_Unlock(ThreadLock* lock)
+{
+	ReleaseSRWLockExclusive((PSRWLOCK)lock);
+}
+
+void ThreadLock_LockShared(ThreadLock* lock)
+{
+	AcquireSRWLockShared((PSRWLOCK)lock);
+}
+
+void ThreadLock_UnlockShared(ThreadLock* lock)
+{
+	ReleaseSRWLockShared((PSRWLOCK)lock);
+}
+
+/* Conditions. */
+void ThreadCondition_Construct(ThreadCondition* condition)
+{
+	InitializeConditionVariable((PCONDITION_VARIABLE)condition);
+}
+
+bool ThreadCondition_Wait(ThreadCondition* condition, ThreadLock* lock, unsigned int timeoutMilliseconds)
+{
+	return SleepConditionVariableSRW((PCONDITION_VARIABLE)condition, (PSRWLOCK)lock,
+		(timeoutMilliseconds == THREAD_WAIT_INFINITE) ? INFINITE : timeoutMilliseconds, 0);
+}
+
+void ThreadCondition_WakeOne(ThreadCondition* condition)
+{
+	WakeConditionVariable((PCONDITION_VARIABLE)condition);
+}
+
+void ThreadCondition_WakeAll(ThreadCondition* condition)
+{
+	WakeAllConditionVariable((PCONDITION_VARIABLE)condition);
+}
+
+/* Atomics. */
+long long Atomic_Load(volatile long long* target)
+{
+	return ReadAcquire64((LONG64 const volatile*)target);
+}
+
+void Atomic_Store(volatile long long* target, long long value)
+{
+	WriteRelease64((LONG64 volatile*)target, value);
+}
+
+long long Atomic_Exchange(volatile long long* target, long long value)
+{
+	return InterlockedExchange64(target, value);
+}
+
+long long Atomic_Increment(volatile long long* target)
+{
+	return InterlockedIncrement64(target);
+}
+
+bool Atomic_CompareExchange(volatile long long* target, long long expectedValue, long long newValue)
+{
+	return InterlockedCompareExchange64(target, newValue, expectedValue) == expectedValue;
+}
+
+void Atomic_Fence()
+{
+	MemoryBarrier();
+}
+
+void* Atomic_LoadPointer(void* volatile* target)
+{
+	return ReadPointerAcquire(target);
+}
+
+void Atomic_StorePointer(void* volatile* target, void* value)
+{
+	WritePointerRelease(target, value);
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+#include <stdbool.h>
+
+
+// Macros.
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+#define THREAD_WAIT_INFINITE 0xFFFFFFFFu
+
+
+// Types.
+/* Holds an SRWLOCK, which is pointer sized. Kept opaque so that this header doesn't pull in Windows.h ahead of WinSock2.h. */
+typedef struct ThreadLockStruct
+{
+	void* _handle;
+} ThreadLock;
+
+/* Holds a CONDITION_VARIABLE, which is pointer sized. */
+typedef struct ThreadConditionStruct
+{
+	void* _handle;
+} ThreadCondition;
+
+typedef void (*ThreadFunction)(void* argument);
+
+typedef struct ThreadStruct
+{
+	void* _handle;
+} Thread;
+
+
+// Functions.
+/* Threads. */
+/// <summary>
+/// Starts a thread running the function. The thread leaves its epoch participant slot when the function returns.
+/// </summary>
+/// <returns>false if the thread couldn't be created.</returns>
+bool Thread_Start(Thread* thread, ThreadFunction function, void* argument);
+
+/// <summary>
+/// Waits for the thread to finish and releases its handle.
+/// </summary>
+void Thread_Join(Thread* thread);
+
+/// <summary>
+/// Number of logical processors the process can run threads on.
+/// </summary>
+unsigned int Thread_GetProcessorCount();
+
+/* Locks. */
+void ThreadLock_Construct(ThreadLock* lock);
+
+void ThreadLock_Lock(ThreadLock* lock);
+
+void ThreadLock_Unlock(ThreadLock* lock);
+
+void ThreadLock_LockShared(ThreadLock* lock);
+
+void ThreadLock_UnlockShared(ThreadLock* lock);
+
+/* Conditions. */
+void ThreadCondition_Construct(ThreadCondition* condition);
+
+/// <summary>
+/// Releases the exclusively held lock while waiting, the lock is held again once this returns.
+/// Wake-ups may be spurious, so the waited for state has to be checked again.
+/// </summary>
+/// <param name="timeoutMilliseconds">Time to wait for at most, THREAD_WAIT_INFINITE to wait until woken.</param>
+/// <returns>false if the wait timed out.</returns>
+bool ThreadCondition_Wait(ThreadCondition* condition, ThreadLock* lock, unsigned int timeoutMilliseconds);
+
+void ThreadCondition_WakeOne(ThreadCondition* condition);
+
+void ThreadCondition_WakeAll(ThreadCondition* condition);
+
+/* Atomics. */
+/// <summary>
+/// Reads the value with acquire semantics, writes made before the matching Atomic_Store are visible afterwards.
+/// </summary>
+long long Atomic_Load(volatile long long* target);
+
+/// <summary>
+/// Writes the value with release semantics, all prior writes become visible before the value does.
+/// </summary>
+void Atomic_Store(volatile long long* target, long long value);
+
+/// <summary>
+/// Swaps in the value with a full memory barrier.
+/// </summary>
+/// <returns>The previous value.</returns>
+long long Atomic_Exchange(volatile long long* target, long long value);
+
+/// <returns>The incremented value.</returns>
+long long Atomic_Increment(volatile long long* target);
+
+/// <returns>true if the target held the expected value and was replaced, otherwise false.</returns>
+bool Atomic_CompareExchange(volatile long long* target, long long expectedValue, long long newValue);
+
+/// <summary>
+/// Full memory barrier, no load or store is reordered across it.
+/// </summary>
+void Atomic_Fence();
+
+void* Atomic_LoadPointer(void* volatile* target);
+
+void Atomic_StorePointer(void* volatile* target, void* value);
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "LTTTime.h"
+#include <Windows.h>
+
+
+// Macros.
+#define MICROSECONDS_IN_SECOND 1000000ull
+
+
+// Static variables.
+static volatile long long s_counterFrequency = 0;
+
+
+// Functions.
+unsigned long long Time_GetMicroseconds()
+{
+	if (s_counterFrequency == 0)
+	{
+		LARGE_INTEGER Frequency;
+		QueryPerformanceFrequency(&Frequency);
+		s_counterFrequency = Frequency.QuadPart;
+	}
+
+	LARGE_INTEGER Counter;
+	QueryPerformanceCounter(&Counter);
+
+	// Split to avoid overflowing the multiplication on machines which have been running for a long time.
+	unsigned long long Ticks = (unsigned long long)Counter.QuadPart;
+	unsigned long long Frequency = (unsigned long long)s_counterFrequency;
+	return ((Ticks / Frequency) * MICROSECONDS_IN_SECOND) + (((Ticks % Frequency) * MICROSECONDS_IN_SECOND) / Frequency);
+}
+
+double Time_GetRatePerSecond(unsigned long long itemCount, unsigned long long startMicroseconds)
+{
+	unsigned long long ElapsedMicroseconds = Time_GetMicroseconds() - startMicroseconds;
+	if (ElapsedMicroseconds == 0)
+	{
+		ElapsedMicroseconds = 1;
+	}
+	return (double)itemCount * MICROSECONDS_IN_SECOND / (double)ElapsedMicroseconds;
+}
\ No newline at end of file
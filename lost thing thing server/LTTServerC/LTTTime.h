@@ -0,0 +1,15 @@
+#pragma once
+
+
+// Functions.
+/// <summary>
+/// Reads a monotonic high resolution clock, only useful for measuring elapsed time.
+/// </summary>
+/// <returns>Microseconds since an unspecified starting point.</returns>
+unsigned long long Time_GetMicroseconds();
+
+/// <summary>
+/// Calculates how many items were handled per second.
+/// </summary>
+/// <param name="startMicroseconds">Value of Time_GetMicroseconds before the work was started.</param>
+double Time_GetRatePerSecond(unsigned long long itemCount, unsigned long long startMicroseconds);
\ No newline at end of file
@@ -3,9 +3,12 @@
 #include "LTTErrors.h"
 #include "Directory.h"
 #include "Memory.h"
+#include "LTTBytes.h"
 #include <stdbool.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <stdlib.h>
+#include <limits.h>
 #include "LTTServerC.h"
 
 
@@ -17,6 +20,34 @@
 #define LOG_FILE_EXTENSION ".log"
 #define NEW_LOG_FILE_NAME "latest" LOG_FILE_EXTENSION
 
+#define LOG_WRITE_INTERVAL_MILLISECONDS 200
+#define LOG_FULL_WAIT_MILLISECONDS 10
+#define LOG_TRUNCATION_MARK "..."
+
+#define DAY_YEAR_MULTIPLIER 1000
+
+#define GZIP_FILE_EXTENSION ".gz"
+#define GZIP_HEADER_SIZE 10
+#define GZIP_TRAILER_SIZE 8
+#define ZLIB_HEADER_SIZE 2
+#define ZLIB_TRAILER_SIZE 4
+#define LOG_COMPRESSION_QUALITY 8
+#define CRC32_POLYNOMIAL 0xEDB88320u
+
+
+// Types.
+typedef struct OldLogFileStruct
+{
+	unsigned long long Date;
+	unsigned int Number;
+	const char* Name;
+} OldLogFile;
+
+
+// External functions.
+/* Defined along with the rest of stb_image_write in Image.c, its header doesn't declare it. */
+unsigned char* stbi_zlib_compress(unsigned char* data, int dataLength, int* outLength, int quality);
+
 
 // Static functions.
 static void AddTwoDigitNumber(StringBuilder* builder, int number, char separator)
@@ -37,10 +68,9 @@ static void AddTwoDigitNumber(StringBuilder* builder, int number, char separator
 	}
 }
 
-static void AddDateTime(StringBuilder* builder)
+static void AddDateTime(StringBuilder* builder, time_t time)
 {
-	time_t CurrentTime = time(NULL);
-	struct tm* DateTime = localtime(&CurrentTime);
+	struct tm* DateTime = localtime(&time);
 
 	StringBuilder_AppendChar(builder, '[');
 
@@ -99,6 +129,28 @@ static int CountDigitsInInt(int number)
 }
 
 
+static char* CreateCompressedLogPath(const char* logPath)
+{
+	StringBuilder PathBuilder;
+	StringBuilder_Construct(&PathBuilder, DEFAULT_STRING_BUILDER_CAPACITY);
+	StringBuilder_Append(&PathBuilder, logPath);
+	StringBuilder_Append(&PathBuilder, GZIP_FILE_EXTENSION);
+	return PathBuilder.Data;
+}
+
+static bool IsBackupLogPathTaken(const char* path)
+{
+	if (File_Exists(path))
+	{
+		return true;
+	}
+
+	char* CompressedPath = CreateCompressedLogPath(path);
+	bool IsTaken = File_Exists(CompressedPath);
+	Memory_Free(CompressedPath);
+	return IsTaken;
+}
+
 static const char* CreateBackupLogFileName(const char* oldLogDirectory, const char* oldLogFilePath)
 {
 	// Create file name.
@@ -125,7 +177,7 @@ static const char* CreateBackupLogFileName(const char* oldLogDirectory, const ch
 
 	int LogNumber = 1;
 
-	while (File_Exists(FileNameBuilder.Data))
+	while (IsBackupLogPathTaken(FileNameBuilder.Data))
 	{
 		StringBuilder_Remove(&FileNameBuilder, LogNumberCharIndex, LogNumberCharIndex + CountDigitsInInt(LogNumber));
 		LogNumber++;
@@ -155,6 +207,393 @@ static void BackupLog(const char* oldLogFilePath, const char* logRootDirectoryPa
 	Memory_Free((char*)OldLogDirectory);
 }
 
+/* Old logs. */
+static unsigned int ComputeCRC32(const unsigned char* data, size_t length)
+{
+	unsigned int Table[256];
+	for (unsigned int i = 0; i < 256; i++)
+	{
+		unsigned int Value = i;
+		for (int j = 0; j < 8; j++)
+		{
+			Value = (Value & 1) ? (CRC32_POLYNOMIAL ^ (Value >> 1)) : (Value >> 1);
+		}
+		Table[i] = Value;
+	}
+
+	unsigned int CRC = 0xFFFFFFFFu;
+	for (size_t i = 0; i < length; i++)
+	{
+		CRC = Table[(CRC ^ data[i]) & 0xFF] ^ (CRC >> 8);
+	}
+	return CRC ^ 0xFFFFFFFFu;
+}
+
+/* Writes the log as a .gz file next to it and deletes it. stb's zlib stream is rewrapped, the deflate data is the same. */
+static void CompressLogFile(const char* path)
+{
+	FileMapping Mapping;
+	Error ReturnedError = File_MapRead(path, &Mapping);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Error_Deconstruct(&ReturnedError);
+		return;
+	}
+	if (Mapping.Length > INT_MAX)
+	{
+		File_Unmap(&Mapping);
+		return;
+	}
+
+	unsigned char* Data = (unsigned char*)(Mapping.Data ? Mapping.Data : "");
+	int ZlibLength;
+	unsigned char* Zlib = stbi_zlib_compress(Data, (int)Mapping.Length, &ZlibLength, LOG_COMPRESSION_QUALITY);
+	if (!Zlib || (ZlibLength < (ZLIB_HEADER_SIZE + ZLIB_TRAILER_SIZE)))
+	{
+		Memory_Free(Zlib);
+		File_Unmap(&Mapping);
+		return;
+	}
+
+	size_t DeflateLength = (size_t)ZlibLength - ZLIB_HEADER_SIZE - ZLIB_TRAILER_SIZE;
+	size_t GzipLength = GZIP_HEADER_SIZE + DeflateLength + GZIP_TRAILER_SIZE;
+	unsigned char* Gzip = (unsigned char*)Memory_SafeMalloc(GzipLength);
+	const unsigned char Header[GZIP_HEADER_SIZE] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+	Memory_Copy((const char*)Header, (char*)Gzip, GZIP_HEADER_SIZE);
+	Memory_Copy((const char*)Zlib + ZLIB_HEADER_SIZE, (char*)Gzip + GZIP_HEADER_SIZE, DeflateLength);
+	Bytes_EncodeUInt(Gzip + GZIP_HEADER_SIZE + DeflateLength, ComputeCRC32(Data, Mapping.Length));
+	Bytes_EncodeUInt(Gzip + GZIP_HEADER_SIZE + DeflateLength + 4, (unsigned int)Mapping.Length);
+	Memory_Free(Zlib);
+	File_Unmap(&Mapping);
+
+	char* CompressedPath = CreateCompressedLogPath(path);
+	ReturnedError = File_WriteAtomic(CompressedPath, (const char*)Gzip, GzipLength, false);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		File_Delete(path);
+	}
+	Error_Deconstruct(&ReturnedError);
+	Memory_Free(CompressedPath);
+	Memory_Free(Gzip);
+}
+
+static void CompressOldLogs(const char* oldLogDirectory)
+{
+	size_t NameCount;
+	char** Names = Directory_List(oldLogDirectory, &NameCount);
+	for (size_t i = 0; i < NameCount; i++)
+	{
+		if (String_EndsWith(Names[i], LOG_FILE_EXTENSION))
+		{
+			char* Path = Directory_CombinePaths(oldLogDirectory, Names[i]);
+			CompressLogFile(Path);
+			Memory_Free(Path);
+		}
+	}
+	Directory_FreeList(Names, NameCount);
+}
+
+/* Old logs are named by the date of their last record and a number counting up within that date. */
+static bool ParseOldLogFileName(const char* name, OldLogFile* file)
+{
+	int Year, Month, Day, Number, NameLength;
+	if ((sscanf(name, "%dy%dm%dd %d%n", &Year, &Month, &Day, &Number, &NameLength) != 4)
+		|| (!String_Equals(name + NameLength, LOG_FILE_EXTENSION) && !String_Equals(name + NameLength, LOG_FILE_EXTENSION GZIP_FILE_EXTENSION)))
+	{
+		return false;
+	}
+
+	file->Date = ((unsigned long long)Year * 10000) + ((unsigned long long)Month * 100) + (unsigned long long)Day;
+	file->Number = (unsigned int)Number;
+	file->Name = name;
+	return true;
+}
+
+static int CompareOldLogFiles(const void* file1, const void* file2)
+{
+	const OldLogFile* File1 = (const OldLogFile*)file1;
+	const OldLogFile* File2 = (const OldLogFile*)file2;
+	if (File1->Date != File2->Date)
+	{
+		return File1->Date < File2->Date ? -1 : 1;
+	}
+	return (File1->Number > File2->Number) - (File1->Number < File2->Number);
+}
+
+static void DeleteOldestLogs(const char* oldLogDirectory, unsigned int maxCount)
+{
+	size_t NameCount;
+	char** Names = Directory_List(oldLogDirectory, &NameCount);
+	if (!Names)
+	{
+		return;
+	}
+
+	OldLogFile* Files = (OldLogFile*)Memory_SafeMalloc(sizeof(OldLogFile) * NameCount);
+	size_t FileCount = 0;
+	for (size_t i = 0; i < NameCount; i++)
+	{
+		if (ParseOldLogFileName(Names[i], Files + FileCount))
+		{
+			FileCount++;
+		}
+	}
+
+	qsort(Files, FileCount, sizeof(OldLogFile), CompareOldLogFiles);
+	for (size_t i = 0; (i + maxCount) < FileCount; i++)
+	{
+		char* Path = Directory_CombinePaths(oldLogDirectory, Files[i].Name);
+		File_Delete(Path);
+		Memory_Free(Path);
+	}
+
+	Memory_Free(Files);
+	Directory_FreeList(Names, NameCount);
+}
+
+static void MaintainOldLogs(Logger* logger, const LogRotation* rotation)
+{
+	char* OldLogDirectory = Directory_CombinePaths(logger->_logDirPath, OLD_LOG_DIR_NAME);
+	if (rotation->CompressOldLogs)
+	{
+		CompressOldLogs(OldLogDirectory);
+	}
+	if (rotation->MaxOldLogCount > 0)
+	{
+		DeleteOldestLogs(OldLogDirectory, rotation->MaxOldLogCount);
+	}
+	Memory_Free(OldLogDirectory);
+}
+
+static void RunMaintenance(void* argument)
+{
+	Logger* Self = (Logger*)argument;
+	ThreadLock_Lock(&Self->_lock);
+	while (true)
+	{
+		if (!Self->_isMaintenancePending && !Self->_isMaintenanceStopping)
+		{
+			ThreadCondition_Wait(&Self->_maintenanceCondition, &Self->_lock, THREAD_WAIT_INFINITE);
+			continue;
+		}
+		if (!Self->_isMaintenancePending)
+		{
+			break;
+		}
+
+		LogRotation Rotation = Self->_maintenanceRotation;
+		Self->_isMaintenancePending = false;
+		ThreadLock_Unlock(&Self->_lock);
+		MaintainOldLogs(Self, &Rotation);
+		ThreadLock_Lock(&Self->_lock);
+	}
+	ThreadLock_Unlock(&Self->_lock);
+}
+
+/* Called by the writer, which only hands the request over. The maintenance thread is started by the first request. */
+static void StartMaintenance(Logger* logger, const LogRotation* rotation)
+{
+	if (!rotation->CompressOldLogs && (rotation->MaxOldLogCount == 0))
+	{
+		return;
+	}
+
+	if (!logger->_isMaintenanceThreadStarted)
+	{
+		logger->_isMaintenanceThreadStarted = Thread_Start(&logger->_maintenanceThread, RunMaintenance, logger);
+		if (!logger->_isMaintenanceThreadStarted)
+		{
+			return;
+		}
+	}
+
+	ThreadLock_Lock(&logger->_lock);
+	logger->_maintenanceRotation = *rotation;
+	logger->_isMaintenancePending = true;
+	ThreadCondition_WakeOne(&logger->_maintenanceCondition);
+	ThreadLock_Unlock(&logger->_lock);
+}
+
+/* Rotation. */
+static int GetDay(time_t time)
+{
+	struct tm* DateTime = localtime(&time);
+	return (DateTime->tm_year * DAY_YEAR_MULTIPLIER) + DateTime->tm_yday;
+}
+
+static void RotateLog(Logger* logger, const LogRotation* rotation)
+{
+	if (logger->LogFile)
+	{
+		File_Close(logger->LogFile);
+	}
+	BackupLog(logger->_logFilePath, logger->_logDirPath);
+
+	Error ReturnedError;
+	logger->LogFile = File_Open(logger->_logFilePath, FileOpenMode_Write, &ReturnedError);
+	if (!logger->LogFile)
+	{
+		// Records only reach the standard output until a later rotation manages to open the file.
+		fputs("Failed to open a new log file after rotating the log.\n", stdout);
+	}
+	Error_Deconstruct(&ReturnedError);
+
+	logger->_fileLength = 0;
+	logger->_fileDay = logger->_timestampDay;
+	StartMaintenance(logger, rotation);
+}
+
+/* Ring. */
+static bool TryQueueRecord(Logger* logger, Logger_LogLevel level, time_t time, const char* string)
+{
+	long long Position = Atomic_Load(&logger->_enqueuePosition);
+	LogRecord* Record;
+	while (true)
+	{
+		Record = logger->_records + (Position & (LOG_RING_CAPACITY - 1));
+		long long Sequence = Atomic_Load(&Record->Sequence);
+		if ((Sequence == Position) && Atomic_CompareExchange(&logger->_enqueuePosition, Position, Position + 1))
+		{
+			break;
+		}
+		if (Sequence < Position)
+		{
+			// The writer hasn't taken the record written a whole ring ago yet.
+			return false;
+		}
+		Position = Atomic_Load(&logger->_enqueuePosition);
+	}
+
+	size_t Length = 0;
+	while ((string[Length] != '\0') && (Length < (LOG_RECORD_TEXT_CAPACITY - 1)))
+	{
+		Length++;
+	}
+	Memory_Copy(string, Record->Text, Length);
+	Record->Text[Length] = '\0';
+	Record->IsTruncated = string[Length] != '\0';
+	Record->Time = time;
+	Record->Level = level;
+	Atomic_Store(&Record->Sequence, Position + 1);
+	return true;
+}
+
+static void UpdateTimestamp(Logger* logger, time_t time)
+{
+	if (time == logger->_timestampTime)
+	{
+		return;
+	}
+
+	StringBuilder_Clear(&logger->_timestampBuilder);
+	AddDateTime(&logger->_timestampBuilder, time);
+	logger->_timestampTime = time;
+	logger->_timestampDay = GetDay(time);
+}
+
+static void AddRecord(Logger* logger, LogRecord* record)
+{
+	StringBuilder_Append(&logger->_logTextBuilder, logger->_timestampBuilder.Data);
+	AddLevel(&logger->_logTextBuilder, record->Level);
+	StringBuilder_AppendChar(&logger->_logTextBuilder, ' ');
+	StringBuilder_Append(&logger->_logTextBuilder, record->Text);
+	if (record->IsTruncated)
+	{
+		StringBuilder_Append(&logger->_logTextBuilder, LOG_TRUNCATION_MARK);
+	}
+	StringBuilder_AppendChar(&logger->_logTextBuilder, '\n');
+}
+
+static void WriteText(Logger* logger)
+{
+	if (logger->_logTextBuilder.Length == 0)
+	{
+		return;
+	}
+
+	if (logger->LogFile)
+	{
+		File_WriteText(logger->LogFile, logger->_logTextBuilder.Data);
+		File_Flush(logger->LogFile);
+	}
+	fputs(logger->_logTextBuilder.Data, stdout);
+	logger->_fileLength += logger->_logTextBuilder.Length;
+	StringBuilder_Clear(&logger->_logTextBuilder);
+}
+
+/* Takes every ready record off the ring, then writes and flushes them together, rotating the log where needed. */
+static void WriteQueuedRecords(Logger* logger, const LogRotation* rotation)
+{
+	while (true)
+	{
+		LogRecord* Record = logger->_records + (logger->_dequeuePosition & (LOG_RING_CAPACITY - 1));
+		if (Atomic_Load(&Record->Sequence) != (logger->_dequeuePosition + 1))
+		{
+			break;
+		}
+
+		UpdateTimestamp(logger, Record->Time);
+		if (rotation->RotateDaily && (logger->_timestampDay != logger->_fileDay))
+		{
+			// Records of the previous day stay in its file.
+			WriteText(logger);
+			RotateLog(logger, rotation);
+		}
+		AddRecord(logger, Record);
+		Atomic_Store(&Record->Sequence, logger->_dequeuePosition + LOG_RING_CAPACITY);
+		logger->_dequeuePosition++;
+	}
+
+	if (logger->_logTextBuilder.Length == 0)
+	{
+		return;
+	}
+
+	WriteText(logger);
+	if ((rotation->MaxFileSize > 0) && (logger->_fileLength >= rotation->MaxFileSize))
+	{
+		RotateLog(logger, rotation);
+	}
+
+	ThreadLock_Lock(&logger->_lock);
+	ThreadCondition_WakeAll(&logger->_spaceCondition);
+	ThreadLock_Unlock(&logger->_lock);
+}
+
+static void RunWriter(void* argument)
+{
+	Logger* Self = (Logger*)argument;
+	ThreadLock_Lock(&Self->_lock);
+	while (!Atomic_Load(&Self->_isClosing))
+	{
+		// Producers of ordinary records don't wake the writer, their records wait for the next interval.
+		ThreadCondition_Wait(&Self->_writeCondition, &Self->_lock, LOG_WRITE_INTERVAL_MILLISECONDS);
+		LogRotation Rotation = Self->_rotation;
+		bool IsMaintenanceRequested = Self->_isMaintenanceRequested;
+		Self->_isMaintenanceRequested = false;
+		ThreadLock_Unlock(&Self->_lock);
+
+		if (IsMaintenanceRequested)
+		{
+			StartMaintenance(Self, &Rotation);
+		}
+		WriteQueuedRecords(Self, &Rotation);
+		ThreadLock_Lock(&Self->_lock);
+	}
+	LogRotation Rotation = Self->_rotation;
+	ThreadLock_Unlock(&Self->_lock);
+
+	WriteQueuedRecords(Self, &Rotation);
+}
+
+static void WakeWriter(Logger* logger)
+{
+	ThreadLock_Lock(&logger->_lock);
+	ThreadCondition_WakeOne(&logger->_writeCondition);
+	ThreadLock_Unlock(&logger->_lock);
+}
+
+
 // Functions.
 Error Logger_Construct(Logger* logger, const char* rootDirectoryPath)
 {
@@ -180,10 +619,39 @@ Error Logger_Construct(Logger* logger, const char* rootDirectoryPath)
 	}
 
 	StringBuilder_Construct(&logger->_logTextBuilder, DEFAULT_STRING_BUILDER_CAPACITY);
+	StringBuilder_Construct(&logger->_timestampBuilder, DEFAULT_STRING_BUILDER_CAPACITY);
+	logger->_timestampTime = (time_t)-1;
+	logger->_timestampDay = 0;
+	logger->_fileDay = GetDay(time(NULL));
+	logger->_fileLength = 0;
+	Memory_Set((char*)&logger->_rotation, sizeof(LogRotation), 0);
+	logger->_isMaintenanceRequested = false;
+	logger->_isMaintenanceThreadStarted = false;
+	logger->_isMaintenancePending = false;
+	logger->_isMaintenanceStopping = false;
+	ThreadLock_Construct(&logger->_lock);
+	ThreadCondition_Construct(&logger->_writeCondition);
+	ThreadCondition_Construct(&logger->_spaceCondition);
+	ThreadCondition_Construct(&logger->_maintenanceCondition);
+	logger->_isClosing = 0;
+
+	logger->_records = (LogRecord*)Memory_SafeMalloc(sizeof(LogRecord) * LOG_RING_CAPACITY);
+	for (long long i = 0; i < LOG_RING_CAPACITY; i++)
+	{
+		logger->_records[i].Sequence = i;
+	}
+	logger->_enqueuePosition = 0;
+	logger->_dequeuePosition = 0;
 
-	// Free memory.
-	Memory_Free((char*)LogFilePath);
-	Memory_Free(LogDirPath);
+	// The writer reopens the log file with these when rotating it.
+	logger->_logDirPath = LogDirPath;
+	logger->_logFilePath = LogFilePath;
+
+	if (!Thread_Start(&logger->_writerThread, RunWriter, logger))
+	{
+		File_Close(logger->LogFile);
+		return Error_CreateError(ErrorCode_IO, "Failed to start log writer thread.");
+	}
 
 	return Error_CreateSuccess();
 }
@@ -191,26 +659,58 @@ Error Logger_Construct(Logger* logger, const char* rootDirectoryPath)
 
 Error Logger_Deconstruct(Logger* logger)
 {
-	File_Close(logger->LogFile);
+	// The writer drains the ring before it returns.
+	Atomic_Store(&logger->_isClosing, 1);
+	WakeWriter(logger);
+	Thread_Join(&logger->_writerThread);
+
+	// Only stopped once the writer can't ask for more, a pending request still runs first.
+	if (logger->_isMaintenanceThreadStarted)
+	{
+		ThreadLock_Lock(&logger->_lock);
+		logger->_isMaintenanceStopping = true;
+		ThreadCondition_WakeOne(&logger->_maintenanceCondition);
+		ThreadLock_Unlock(&logger->_lock);
+		Thread_Join(&logger->_maintenanceThread);
+	}
+
+	if (logger->LogFile)
+	{
+		File_Close(logger->LogFile);
+	}
+	Memory_Free((char*)logger->_logFilePath);
+	Memory_Free((char*)logger->_logDirPath);
 	StringBuilder_Deconstruct(&logger->_logTextBuilder);
+	StringBuilder_Deconstruct(&logger->_timestampBuilder);
+	Memory_Free(logger->_records);
 
 	return Error_CreateSuccess();
 }
 
-Error Logger_Log(Logger* logger, Logger_LogLevel level, const char* string)
+void Logger_SetRotation(Logger* logger, const LogRotation* rotation)
 {
-	AddDateTime(&logger->_logTextBuilder);
-	AddLevel(&logger->_logTextBuilder, level);
-	StringBuilder_AppendChar(&logger->_logTextBuilder, ' ');
-	StringBuilder_Append(&logger->_logTextBuilder, string);
-	StringBuilder_AppendChar(&logger->_logTextBuilder, '\n');
-
-	File_WriteText(logger->LogFile, logger->_logTextBuilder.Data);
-	File_Flush(logger->LogFile);
-	printf(logger->_logTextBuilder.Data);
+	ThreadLock_Lock(&logger->_lock);
+	logger->_rotation = *rotation;
+	logger->_isMaintenanceRequested = true;
+	ThreadCondition_WakeOne(&logger->_writeCondition);
+	ThreadLock_Unlock(&logger->_lock);
+}
 
-	StringBuilder_Clear(&logger->_logTextBuilder);
+Error Logger_Log(Logger* logger, Logger_LogLevel level, const char* string)
+{
+	time_t CurrentTime = time(NULL);
+	while (!TryQueueRecord(logger, level, CurrentTime, string))
+	{
+		ThreadLock_Lock(&logger->_lock);
+		ThreadCondition_WakeOne(&logger->_writeCondition);
+		ThreadCondition_Wait(&logger->_spaceCondition, &logger->_lock, LOG_FULL_WAIT_MILLISECONDS);
+		ThreadLock_Unlock(&logger->_lock);
+	}
 
+	if (level >= LogLevel_Error)
+	{
+		WakeWriter(logger);
+	}
 	return Error_CreateSuccess();
 }
 
@@ -2,7 +2,15 @@
 
 #include "LttString.h"
 #include "LTTErrors.h"
+#include "LTTThread.h"
 #include <stdio.h>
+#include <time.h>
+
+
+// Macros.
+/* Must be a power of two. */
+#define LOG_RING_CAPACITY 1024
+#define LOG_RECORD_TEXT_CAPACITY 488
 
 // Structures.
 enum Logger_LogLevelEnum
@@ -15,10 +23,67 @@ enum Logger_LogLevelEnum
 
 typedef enum Logger_LogLevelEnum Logger_LogLevel;
 
+/* When the log file is moved to the old log directory and a new one started. */
+typedef struct LogRotationStruct
+{
+	/* Bytes the log file may grow to, 0 doesn't rotate by size. */
+	unsigned long long MaxFileSize;
+	/* Starts a new log file with the first record of each day. */
+	bool RotateDaily;
+	/* Replaces old log files with gzip compressed ones. */
+	bool CompressOldLogs;
+	/* Old log files kept, the oldest ones past this are deleted. 0 keeps all of them. */
+	unsigned int MaxOldLogCount;
+} LogRotation;
+
+/* A ring slot, ready for the writer once its sequence is one past its position. Longer messages are cut short. */
+typedef struct LogRecordStruct
+{
+	volatile long long Sequence;
+	time_t Time;
+	Logger_LogLevel Level;
+	bool IsTruncated;
+	char Text[LOG_RECORD_TEXT_CAPACITY];
+} LogRecord;
+
+/* Any thread copies its message into a free slot of the ring without locking, a background thread formats
+* the queued records in batches, writes each batch at once and flushes it. Errors wake the writer right away.
+* The writer also rotates the log file, compressing and deleting old log files is left to a thread of its own. */
 typedef struct LoggerStruct
 {
 	FILE* LogFile;
+	LogRecord* _records;
+	volatile long long _enqueuePosition;
+	long long _dequeuePosition;
+
+	Thread _writerThread;
+	ThreadLock _lock;
+	ThreadCondition _writeCondition;
+	ThreadCondition _spaceCondition;
+	volatile long long _isClosing;
+
+	/* Changed under the lock, the writer takes a copy each time it wakes. */
+	LogRotation _rotation;
+	bool _isMaintenanceRequested;
+
+	/* Only used by the writer. The timestamp is formatted once per second. */
 	StringBuilder _logTextBuilder;
+	StringBuilder _timestampBuilder;
+	time_t _timestampTime;
+	int _timestampDay;
+	int _fileDay;
+	unsigned long long _fileLength;
+	const char* _logDirPath;
+	const char* _logFilePath;
+
+	/* Compresses and deletes old log files when the writer asks for it after rotating, so the writer never waits for it.
+	* Requests made while a run is going are merged into a single later run. Requests are changed under the lock. */
+	Thread _maintenanceThread;
+	ThreadCondition _maintenanceCondition;
+	bool _isMaintenanceThreadStarted;
+	bool _isMaintenancePending;
+	bool _isMaintenanceStopping;
+	LogRotation _maintenanceRotation;
 } Logger;
 
 
@@ -27,6 +92,14 @@ Error Logger_Construct(Logger* logger, const char* serverRootPath);
 
 Error Logger_Deconstruct(Logger* logger);
 
+/// <summary>
+/// Sets when the log is rotated. Old log files already present are compressed and pruned by the new settings.
+/// </summary>
+void Logger_SetRotation(Logger* logger, const LogRotation* rotation);
+
+/// <summary>
+/// Queues the message, it is written by the logger's thread shortly after. Only waits if the ring is full.
+/// </summary>
 Error Logger_Log(Logger* logger, Logger_LogLevel level, const char* string);
 
 Error Logger_LogInfo(Logger* logger, const char* string);
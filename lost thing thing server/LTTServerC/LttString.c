@@ -7,10 +7,26 @@
 #include <stdio.h>
 #include "LTTChar.h"
 
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define STRING_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 
 // Macros.
 #define STRING_BUILDER_CAPACITY_GROWTH 4
 
+#define SIMD_LANE_COUNT 16
+#define SIMD_LANE_MASK 0xFFFFu
+
+#define FUZZY_FAST_PATH_MAX_PATTERN_LENGTH 256
+#define FUZZY_FAST_PATH_MAX_CODEPOINT 0x17F
+#define ASCII_CASE_BIT 0x20
+
 #define STRING_LIST_CAPACITY 4
 #define STRING_LIST_CAPACITY_GROWTH 2
 
@@ -40,13 +56,266 @@ static void StringListEnsureCapacity(StringList* stringList, size_t capacity)
 }
 
 
+/* SIMD. */
+#ifdef STRING_SIMD_SSE2
+static inline int CountTrailingZeros(unsigned int value)
+{
+#ifdef _MSC_VER
+	unsigned long Index;
+	_BitScanForward(&Index, value);
+	return (int)Index;
+#else
+	return __builtin_ctz(value);
+#endif
+}
+
+static inline __m128i GetLanesInRange(__m128i lanes, char lower, char upper)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(lanes, _mm_set1_epi8(lower - 1)), _mm_cmplt_epi8(lanes, _mm_set1_epi8(upper + 1)));
+}
+
+static inline __m128i FoldASCIILanes(__m128i lanes)
+{
+	return _mm_or_si128(lanes, _mm_and_si128(GetLanesInRange(lanes, 'A', 'Z'), _mm_set1_epi8(ASCII_CASE_BIT)));
+}
+
+static inline __m128i UnfoldASCIILanes(__m128i lanes)
+{
+	return _mm_andnot_si128(_mm_and_si128(GetLanesInRange(lanes, 'a', 'z'), _mm_set1_epi8(ASCII_CASE_BIT)), lanes);
+}
+#endif
+
+/* Converts whole ASCII blocks at once, returns the index from which the string must be converted per character. */
+static size_t ChangeCaseASCIIBlocks(char* string, size_t length, bool toLower)
+{
+	size_t Index = 0;
+#ifdef STRING_SIMD_SSE2
+	for (; Index + SIMD_LANE_COUNT <= length; Index += SIMD_LANE_COUNT)
+	{
+		__m128i Lanes = _mm_loadu_si128((const __m128i*)(string + Index));
+		if (_mm_movemask_epi8(Lanes) != 0)
+		{
+			break;
+		}
+		_mm_storeu_si128((__m128i*)(string + Index), toLower ? FoldASCIILanes(Lanes) : UnfoldASCIILanes(Lanes));
+	}
+#endif
+	return Index;
+}
+
+static size_t SkipEqualASCIIBlocksCaseInsensitive(const char* string1, const char* string2, size_t length)
+{
+	size_t Index = 0;
+#ifdef STRING_SIMD_SSE2
+	for (; Index + SIMD_LANE_COUNT <= length; Index += SIMD_LANE_COUNT)
+	{
+		__m128i Lanes1 = _mm_loadu_si128((const __m128i*)(string1 + Index));
+		__m128i Lanes2 = _mm_loadu_si128((const __m128i*)(string2 + Index));
+		if ((_mm_movemask_epi8(_mm_or_si128(Lanes1, Lanes2)) != 0)
+			|| (_mm_movemask_epi8(_mm_cmpeq_epi8(FoldASCIILanes(Lanes1), FoldASCIILanes(Lanes2))) != SIMD_LANE_MASK))
+		{
+			break;
+		}
+	}
+#endif
+	return Index;
+}
+
+
+/* Fuzzy matching. */
+static inline bool IsIgnoredPatternByte(char character)
+{
+	return (character > 0) && (character <= ' ');
+}
+
+static inline unsigned char FoldASCIIByte(unsigned char character)
+{
+	return ((character >= 'A') && (character <= 'Z')) ? (character | ASCII_CASE_BIT) : character;
+}
+
+static bool IsFuzzyMatchedGeneric(const char* stringToSearchIn, const char* stringToMatch, bool ignoreWhitespace, bool foldDiacritics)
+{
+	size_t MatchIndex = 0;
+	for (size_t OriginIndex = 0; stringToSearchIn[OriginIndex] != '\0';
+		OriginIndex += Char_GetByteCount(stringToSearchIn + OriginIndex))
+	{
+		while (ignoreWhitespace && IsIgnoredPatternByte(stringToMatch[MatchIndex]))
+		{
+			MatchIndex++;
+		}
+		if (stringToMatch[MatchIndex] == '\0')
+		{
+			return true;
+		}
+
+		if (Char_ToSearchCodepoint(Char_GetCodepoint(stringToSearchIn + OriginIndex), foldDiacritics)
+			== Char_ToSearchCodepoint(Char_GetCodepoint(stringToMatch + MatchIndex), foldDiacritics))
+		{
+			MatchIndex += Char_GetByteCount(stringToMatch + MatchIndex);
+		}
+	}
+
+	while (ignoreWhitespace && IsIgnoredPatternByte(stringToMatch[MatchIndex]))
+	{
+		MatchIndex++;
+	}
+	return stringToMatch[MatchIndex] == '\0';
+}
+
+/* Folds the pattern into codepoints, returns -1 if it doesn't fit the fast path. */
+static int FoldFuzzyPattern(const char* pattern, bool ignoreWhitespace, bool foldDiacritics, unsigned short* foldedPattern, bool* isASCII)
+{
+	int Length = 0;
+	*isASCII = true;
+
+	for (size_t Index = 0; pattern[Index] != '\0'; Index += Char_GetByteCount(pattern + Index))
+	{
+		if (ignoreWhitespace && IsIgnoredPatternByte(pattern[Index]))
+		{
+			continue;
+		}
+
+		int Codepoint = Char_ToSearchCodepoint(Char_GetCodepoint(pattern + Index), foldDiacritics);
+		if ((Codepoint > FUZZY_FAST_PATH_MAX_CODEPOINT) || (Length >= FUZZY_FAST_PATH_MAX_PATTERN_LENGTH))
+		{
+			return -1;
+		}
+
+		*isASCII &= Codepoint <= UTF8_MAX_CODEPOINT_ONE_BYTE;
+		foldedPattern[Length] = (unsigned short)Codepoint;
+		Length++;
+	}
+
+	return Length;
+}
+
+static bool IsASCIIString(const unsigned char* string, size_t length)
+{
+	size_t Index = 0;
+#ifdef STRING_SIMD_SSE2
+	for (; Index + SIMD_LANE_COUNT <= length; Index += SIMD_LANE_COUNT)
+	{
+		if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(string + Index))) != 0)
+		{
+			return false;
+		}
+	}
+#endif
+	for (; Index < length; Index++)
+	{
+		if (string[Index] > UTF8_MAX_CODEPOINT_ONE_BYTE)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool IsFuzzyMatchedASCII(const unsigned char* string, size_t length, const unsigned short* pattern, int patternLength)
+{
+	int MatchIndex = 0;
+	size_t Index = 0;
+
+#ifdef STRING_SIMD_SSE2
+	// Each block is folded once, the equality masks of the lanes then advance the pattern many characters at once.
+	for (; (Index + SIMD_LANE_COUNT <= length) && (MatchIndex < patternLength); Index += SIMD_LANE_COUNT)
+	{
+		__m128i Lanes = FoldASCIILanes(_mm_loadu_si128((const __m128i*)(string + Index)));
+		unsigned int RemainingLanes = SIMD_LANE_MASK;
+
+		while (MatchIndex < patternLength)
+		{
+			unsigned int EqualLanes = (unsigned int)_mm_movemask_epi8(
+				_mm_cmpeq_epi8(Lanes, _mm_set1_epi8((char)pattern[MatchIndex]))) & RemainingLanes;
+			if (EqualLanes == 0)
+			{
+				break;
+			}
+
+			RemainingLanes &= (SIMD_LANE_MASK << (CountTrailingZeros(EqualLanes) + 1));
+			MatchIndex++;
+		}
+	}
+#endif
+
+	for (; (Index < length) && (MatchIndex < patternLength); Index++)
+	{
+		if (FoldASCIIByte(string[Index]) == pattern[MatchIndex])
+		{
+			MatchIndex++;
+		}
+	}
+
+	return MatchIndex == patternLength;
+}
+
+/* Returns 1 for a match, 0 for no match and -1 if the string doesn't fit the fast path. */
+static int IsFuzzyMatchedLatin(const unsigned char* string, const unsigned short* pattern, int patternLength, bool foldDiacritics)
+{
+	int MatchIndex = 0;
+	for (size_t Index = 0; string[Index] != '\0';)
+	{
+		int Codepoint;
+		if (string[Index] <= UTF8_MAX_CODEPOINT_ONE_BYTE)
+		{
+			Codepoint = FoldASCIIByte(string[Index]);
+			Index++;
+		}
+		else
+		{
+			if (Char_GetByteCount((const char*)string + Index) != 2)
+			{
+				return -1;
+			}
+			Codepoint = Char_ToSearchCodepoint(Char_GetCodepoint((const char*)string + Index), foldDiacritics);
+			if (Codepoint > FUZZY_FAST_PATH_MAX_CODEPOINT)
+			{
+				return -1;
+			}
+			Index += 2;
+		}
+
+		if (Codepoint == pattern[MatchIndex])
+		{
+			MatchIndex++;
+			if (MatchIndex == patternLength)
+			{
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+
 // Functions.
 /* String */
 size_t String_LengthCodepointsUTF8(const char* string)
 {
 	size_t Length = 0;
+	size_t Index = 0;
+
+#ifdef STRING_SIMD_SSE2
+	size_t ByteCount = strlen(string);
+	for (; Index + SIMD_LANE_COUNT <= ByteCount; Index += SIMD_LANE_COUNT)
+	{
+		/* Every byte except trailing bytes (0x80 - 0xBF, signed -128 - -65) starts a codepoint. */
+		__m128i Lanes = _mm_loadu_si128((const __m128i*)(string + Index));
+		unsigned int LeadingMask = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(Lanes, _mm_set1_epi8(-65)));
+		for (; LeadingMask != 0; LeadingMask &= LeadingMask - 1)
+		{
+			Length++;
+		}
+	}
+	/* The codepoint cut by the last block was already counted by its leading byte. */
+	while ((string[Index] & UTF8_TRAILING_BYTE_COMBINED) == UTF8_TRAILING_BYTE)
+	{
+		Index++;
+	}
+#endif
 
-	for (size_t i = 0; string[i] != '\0'; i += Char_GetByteCount(string + i))
+	for (; string[Index] != '\0'; Index += Char_GetByteCount(string + Index))
 	{
 		Length++;
 	}
@@ -57,7 +326,17 @@ size_t String_LengthCodepointsUTF8(const char* string)
 _Bool String_IsValidUTF8String(const char* string)
 {
 	int ExpectedByteCount;
-	for (size_t Index = 0; string[Index] != '\0'; Index++)
+	size_t Index = 0;
+
+#ifdef STRING_SIMD_SSE2
+	size_t ByteCount = strlen(string);
+	while ((Index + SIMD_LANE_COUNT <= ByteCount) && (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(string + Index))) == 0))
+	{
+		Index += SIMD_LANE_COUNT;
+	}
+#endif
+
+	for (; string[Index] != '\0'; Index++)
 	{
 		ExpectedByteCount = Char_GetByteCount(string + Index);
 
@@ -228,7 +507,7 @@ char* String_Trim(const char* string)
 
 void String_ToLowerUTF8(char* string)
 {
-	for (int i = 0; string[i] != '\0'; i += Char_GetByteCount(string + i))
+	for (size_t i = ChangeCaseASCIIBlocks(string, strlen(string), true); string[i] != '\0'; i += Char_GetByteCount(string + i))
 	{
 		Char_ToLower(string + i);
 	}
@@ -236,7 +515,7 @@ void String_ToLowerUTF8(char* string)
 
 void String_ToUpperUTF8(char* string)
 {
-	for (int i = 0; string[i] != '\0';)
+	for (size_t i = ChangeCaseASCIIBlocks(string, strlen(string), false); string[i] != '\0';)
 	{
 		Char_ToUpper(string + i);
 		i += Char_GetByteCount(string + i);
@@ -337,8 +616,15 @@ bool String_Equals(const char* string1, const char* string2)
 
 _Bool String_EqualsCaseInsensitive(const char* string1, const char* string2)
 {
+	/* Case mapping never changes a supported letter's byte count, so lengths must match. */
+	size_t Length = strlen(string1);
+	if (Length != strlen(string2))
+	{
+		return false;
+	}
+
 	size_t Index;
-	for (Index = 0; (string1[Index] != '\0') && (string2[Index] != '\0'); Index += Char_GetByteCount(string1 + Index))
+	for (Index = SkipEqualASCIIBlocksCaseInsensitive(string1, string2, Length); (string1[Index] != '\0') && (string2[Index] != '\0'); Index += Char_GetByteCount(string1 + Index))
 	{
 		if (!Char_EqualsCaseInsensitive(string1 + Index, string2 + Index))
 		{
@@ -435,31 +721,38 @@ char** String_Split(char* string, const char* delimeter, size_t* stringCount)
 }
 
 _Bool String_IsFuzzyMatched(const char* stringToSearchIn, const char* stringToMatch, _Bool ignoreWhitespace)
+{
+	return String_IsFuzzyMatchedFolded(stringToSearchIn, stringToMatch, ignoreWhitespace, false);
+}
+
+_Bool String_IsFuzzyMatchedFolded(const char* stringToSearchIn, const char* stringToMatch, _Bool ignoreWhitespace, _Bool foldDiacritics)
 {
 	if (stringToMatch[0] == '\0')
 	{
 		return stringToSearchIn[0] == '\0';
 	}
 
-	for (size_t OriginIndex = 0, MatchIndex = 0; stringToSearchIn[OriginIndex] != '\0';
-		OriginIndex += Char_GetByteCount(stringToSearchIn + OriginIndex))
+	unsigned short FoldedPattern[FUZZY_FAST_PATH_MAX_PATTERN_LENGTH];
+	bool IsPatternASCII;
+	int PatternLength = FoldFuzzyPattern(stringToMatch, ignoreWhitespace, foldDiacritics, FoldedPattern, &IsPatternASCII);
+	// A pattern of only ignored whitespace matches nothing, like an empty one matches only an empty string.
+	if (PatternLength == 0)
 	{
-		while (ignoreWhitespace && Char_IsWhitespace(stringToMatch + MatchIndex))
-		{
-			MatchIndex += Char_GetByteCount(stringToMatch + MatchIndex);
-		}
+		return false;
+	}
+	if (PatternLength < 0)
+	{
+		return IsFuzzyMatchedGeneric(stringToSearchIn, stringToMatch, ignoreWhitespace, foldDiacritics);
+	}
 
-		if (Char_EqualsCaseInsensitive(stringToSearchIn + OriginIndex, stringToMatch + MatchIndex))
-		{
-			MatchIndex += Char_GetByteCount(stringToMatch + MatchIndex);
-			if (stringToMatch[MatchIndex] == '\0')
-			{
-				return true;
-			}
-		}
+	size_t Length = strlen(stringToSearchIn);
+	if (IsASCIIString((const unsigned char*)stringToSearchIn, Length))
+	{
+		return IsPatternASCII && IsFuzzyMatchedASCII((const unsigned char*)stringToSearchIn, Length, FoldedPattern, PatternLength);
 	}
 
-	return false;
+	int Result = IsFuzzyMatchedLatin((const unsigned char*)stringToSearchIn, FoldedPattern, PatternLength, foldDiacritics);
+	return Result < 0 ? IsFuzzyMatchedGeneric(stringToSearchIn, stringToMatch, ignoreWhitespace, foldDiacritics) : Result == 1;
 }
 
 // StringBuilder
@@ -172,6 +172,13 @@ char** String_Split(char* string, const char* delimeter, size_t* stringCount);
 
 _Bool String_IsFuzzyMatched(const char* stringToSearchIn, const char* stringToMatch, _Bool ignoreWhitespace);
 
+/// <summary>
+/// Same as String_IsFuzzyMatched, but can optionally treat Latvian diacritic letters as their base letters (ā as a, š as s).
+/// </summary>
+/// <param name="foldDiacritics">Whether diacritic letters should match their base letters.</param>
+/// <returns>true if the pattern's characters appear in the string in order, otherwise false.</returns>
+_Bool String_IsFuzzyMatchedFolded(const char* stringToSearchIn, const char* stringToMatch, _Bool ignoreWhitespace, _Bool foldDiacritics);
+
 
 // StringBuilder
 void StringBuilder_Construct(StringBuilder* builder, size_t capacity);
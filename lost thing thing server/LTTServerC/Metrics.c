@@ -0,0 +1,366 @@
+#include "Metrics.h"
+#include "AccessLog.h"
+#include "LTTThread.h"
+#include "Memory.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+
+// Macros.
+/* Codes in s_statusCodes, any other code is counted in the slot after them. */
+#define STATUS_CODE_COUNT 9
+#define STATUS_SLOT_OTHER STATUS_CODE_COUNT
+#define STATUS_SLOT_COUNT (STATUS_CODE_COUNT + 1)
+
+#define QUANTILE_COUNT (sizeof(s_quantiles) / sizeof(*s_quantiles))
+
+#define METRIC_NUMBER_LENGTH 64
+
+
+// Types.
+/* Counts of one thread. The owner updates them with plain increments, the exporter only reads them,
+* which leaves at most the counts of a few in-flight requests out of an export. */
+typedef struct MetricsShardStruct
+{
+	volatile long long IsClaimed;
+	volatile unsigned long long Counters[MetricCounter_Count];
+	volatile unsigned long long Requests[METRICS_ROUTE_CAPACITY][STATUS_SLOT_COUNT];
+	volatile unsigned long long HistogramBuckets[MetricHistogram_Count][METRICS_HISTOGRAM_BUCKET_COUNT];
+	volatile unsigned long long HistogramSums[MetricHistogram_Count];
+} MetricsShard;
+
+typedef struct MetricDescriptionStruct
+{
+	const char* Name;
+	const char* Help;
+} MetricDescription;
+
+
+// Static variables.
+static const unsigned int s_statusCodes[STATUS_CODE_COUNT] = { 200, 201, 400, 401, 403, 404, 418, 500, 503 };
+
+static const MetricDescription s_counterDescriptions[MetricCounter_Count] =
+{
+	{ "ltt_account_cache_hits_total", "Account lookups by ID served from the cache." },
+	{ "ltt_account_cache_misses_total", "Account lookups by ID which loaded the account from the database." },
+	{ "ltt_post_cache_hits_total", "Post lookups by ID served from the cache." },
+	{ "ltt_post_cache_misses_total", "Post lookups by ID which loaded the post from the database." },
+	{ "ltt_ghdf_read_bytes_total", "Bytes of GHDF data decoded." },
+	{ "ltt_ghdf_written_bytes_total", "Bytes of GHDF data written to files." }
+};
+
+static const MetricDescription s_gaugeDescriptions[MetricGauge_Count] =
+{
+	{ "ltt_sessions", "Active account sessions." },
+	{ "ltt_unfinished_posts", "Posts which are being created." },
+	{ "ltt_account_name_terms", "Terms in the account name search index." },
+	{ "ltt_post_title_terms", "Terms in the post title search index." },
+	{ "ltt_account_index_records", "Accounts the last account index build started with." },
+	{ "ltt_account_index_indexed_records", "Accounts indexed by the last account index build." },
+	{ "ltt_account_index_state", "State of the last account index build, 0 complete, 1 running, 2 failed." },
+	{ "ltt_post_index_records", "Posts the last post index build started with." },
+	{ "ltt_post_index_indexed_records", "Posts indexed by the last post index build." },
+	{ "ltt_post_index_state", "State of the last post index build, 0 complete, 1 running, 2 failed." }
+};
+
+static const MetricDescription s_histogramDescriptions[MetricHistogram_Count] =
+{
+	{ "ltt_request_parse_microseconds", "Time spent parsing requests." },
+	{ "ltt_request_dispatch_microseconds", "Time spent handling parsed requests, including storage access." },
+	{ "ltt_request_storage_microseconds", "Time requests spent reading and writing the database." },
+	{ "ltt_request_commit_microseconds", "Time requests waited for the changes of their batch to be committed." },
+	{ "ltt_request_write_microseconds", "Time spent sending responses." }
+};
+
+static const char* const s_quantiles[] = { "0.5", "0.9", "0.99" };
+static const unsigned int s_quantilePerMille[] = { 500, 900, 990 };
+
+static MetricsShard s_shards[METRICS_MAX_SHARDS];
+/* Shared by threads which find every shard claimed, so some of their counts may be lost. */
+static MetricsShard s_overflowShard;
+static volatile long long s_gauges[MetricGauge_Count];
+
+static THREAD_LOCAL MetricsShard* s_threadShard = NULL;
+
+
+// Static functions.
+static MetricsShard* GetThreadShard()
+{
+	if (s_threadShard)
+	{
+		return s_threadShard;
+	}
+
+	for (int i = 0; i < METRICS_MAX_SHARDS; i++)
+	{
+		if (Atomic_CompareExchange(&s_shards[i].IsClaimed, 0, 1))
+		{
+			s_threadShard = &s_shards[i];
+			return s_threadShard;
+		}
+	}
+
+	s_threadShard = &s_overflowShard;
+	return s_threadShard;
+}
+
+static unsigned int GetStatusSlot(unsigned int statusCode)
+{
+	for (unsigned int i = 0; i < STATUS_CODE_COUNT; i++)
+	{
+		if (s_statusCodes[i] == statusCode)
+		{
+			return i;
+		}
+	}
+	return STATUS_SLOT_OTHER;
+}
+
+static unsigned int GetBucketIndex(unsigned long long value)
+{
+	if (value < METRICS_HISTOGRAM_SUB_BUCKET_COUNT)
+	{
+		return (unsigned int)value;
+	}
+	if (value >= (1ull << METRICS_HISTOGRAM_MAX_EXPONENT))
+	{
+		return METRICS_HISTOGRAM_BUCKET_COUNT - 1;
+	}
+
+	// Value is in [2^Exponent, 2^(Exponent + 1)), the three bits below the highest one select the sub-bucket.
+	unsigned int Exponent = 3;
+	while ((value >> (Exponent + 1)) != 0)
+	{
+		Exponent++;
+	}
+	return ((Exponent - 2) * METRICS_HISTOGRAM_SUB_BUCKET_COUNT) + (unsigned int)((value >> (Exponent - 3)) & 7);
+}
+
+/* Largest value which lands in the bucket. */
+static unsigned long long GetBucketUpperBound(unsigned int index)
+{
+	if (index < METRICS_HISTOGRAM_SUB_BUCKET_COUNT)
+	{
+		return index;
+	}
+
+	unsigned int Exponent = (index / METRICS_HISTOGRAM_SUB_BUCKET_COUNT) + 2;
+	unsigned long long SubBucket = index % METRICS_HISTOGRAM_SUB_BUCKET_COUNT;
+	return ((METRICS_HISTOGRAM_SUB_BUCKET_COUNT + SubBucket + 1) << (Exponent - 3)) - 1;
+}
+
+static void SumShard(MetricsShard* sum, MetricsShard* shard)
+{
+	for (int i = 0; i < MetricCounter_Count; i++)
+	{
+		sum->Counters[i] += shard->Counters[i];
+	}
+	for (int Route = 0; Route < METRICS_ROUTE_CAPACITY; Route++)
+	{
+		for (unsigned int Slot = 0; Slot < STATUS_SLOT_COUNT; Slot++)
+		{
+			sum->Requests[Route][Slot] += shard->Requests[Route][Slot];
+		}
+	}
+	for (int i = 0; i < MetricHistogram_Count; i++)
+	{
+		for (int Bucket = 0; Bucket < METRICS_HISTOGRAM_BUCKET_COUNT; Bucket++)
+		{
+			sum->HistogramBuckets[i][Bucket] += shard->HistogramBuckets[i][Bucket];
+		}
+		sum->HistogramSums[i] += shard->HistogramSums[i];
+	}
+}
+
+/* Writing. */
+static void AppendDescription(StringBuilder* builder, const char* name, const char* help, const char* type)
+{
+	StringBuilder_Append(builder, "# HELP ");
+	StringBuilder_Append(builder, name);
+	StringBuilder_AppendChar(builder, ' ');
+	StringBuilder_Append(builder, help);
+	StringBuilder_Append(builder, "\n# TYPE ");
+	StringBuilder_Append(builder, name);
+	StringBuilder_AppendChar(builder, ' ');
+	StringBuilder_Append(builder, type);
+	StringBuilder_AppendChar(builder, '\n');
+}
+
+static void AppendUnsignedSample(StringBuilder* builder, const char* name, const char* suffix, unsigned long long value)
+{
+	char Number[METRIC_NUMBER_LENGTH];
+	snprintf(Number, sizeof(Number), " %llu\n", value);
+	StringBuilder_Append(builder, name);
+	StringBuilder_Append(builder, suffix);
+	StringBuilder_Append(builder, Number);
+}
+
+static void WriteRequests(StringBuilder* builder, MetricsShard* sum)
+{
+	AppendDescription(builder, "ltt_requests_total", "Handled requests by route and response status code.", "counter");
+
+	char Line[METRIC_NUMBER_LENGTH * 2];
+	for (unsigned int Route = 0; Route < METRICS_ROUTE_CAPACITY; Route++)
+	{
+		for (unsigned int Slot = 0; Slot < STATUS_SLOT_COUNT; Slot++)
+		{
+			if (sum->Requests[Route][Slot] == 0)
+			{
+				continue;
+			}
+
+			StringBuilder_Append(builder, "ltt_requests_total{route=\"");
+			StringBuilder_Append(builder, AccessLog_GetRouteName(Route));
+			if (Slot == STATUS_SLOT_OTHER)
+			{
+				snprintf(Line, sizeof(Line), "\",code=\"other\"} %llu\n", sum->Requests[Route][Slot]);
+			}
+			else
+			{
+				snprintf(Line, sizeof(Line), "\",code=\"%u\"} %llu\n", s_statusCodes[Slot], sum->Requests[Route][Slot]);
+			}
+			StringBuilder_Append(builder, Line);
+		}
+	}
+}
+
+static void WriteHistogram(StringBuilder* builder, MetricsShard* sum, MetricHistogram histogram)
+{
+	const char* Name = s_histogramDescriptions[histogram].Name;
+	volatile unsigned long long* Buckets = sum->HistogramBuckets[histogram];
+	AppendDescription(builder, Name, s_histogramDescriptions[histogram].Help, "histogram");
+
+	// Exported bounds are the last values below each power of two, where the fine buckets line up.
+	char Line[METRIC_NUMBER_LENGTH * 2];
+	unsigned long long CumulativeCount = 0;
+	unsigned int Bucket = 0;
+	for (unsigned int Exponent = 0; Exponent <= METRICS_HISTOGRAM_MAX_EXPONENT; Exponent++)
+	{
+		unsigned long long Bound = (1ull << Exponent) - 1;
+		while ((Bucket < (METRICS_HISTOGRAM_BUCKET_COUNT - 1)) && (GetBucketUpperBound(Bucket) <= Bound))
+		{
+			CumulativeCount += Buckets[Bucket];
+			Bucket++;
+		}
+
+		snprintf(Line, sizeof(Line), "_bucket{le=\"%llu\"} %llu\n", Bound, CumulativeCount);
+		StringBuilder_Append(builder, Name);
+		StringBuilder_Append(builder, Line);
+	}
+	for (; Bucket < METRICS_HISTOGRAM_BUCKET_COUNT; Bucket++)
+	{
+		CumulativeCount += Buckets[Bucket];
+	}
+
+	snprintf(Line, sizeof(Line), "_bucket{le=\"+Inf\"} %llu\n", CumulativeCount);
+	StringBuilder_Append(builder, Name);
+	StringBuilder_Append(builder, Line);
+	AppendUnsignedSample(builder, Name, "_sum", sum->HistogramSums[histogram]);
+	AppendUnsignedSample(builder, Name, "_count", CumulativeCount);
+
+	// Quantiles are read from the fine buckets, so they are more precise than ones estimated from the exported bounds.
+	StringBuilder_Append(builder, "# TYPE ");
+	StringBuilder_Append(builder, Name);
+	StringBuilder_Append(builder, "_quantile gauge\n");
+	for (unsigned int i = 0; i < QUANTILE_COUNT; i++)
+	{
+		unsigned long long TargetCount = ((CumulativeCount * s_quantilePerMille[i]) + 999) / 1000;
+		unsigned long long Count = 0;
+		unsigned long long Value = 0;
+		for (unsigned int j = 0; (j < METRICS_HISTOGRAM_BUCKET_COUNT) && (TargetCount > 0); j++)
+		{
+			Count += Buckets[j];
+			if (Count >= TargetCount)
+			{
+				Value = GetBucketUpperBound(j);
+				break;
+			}
+		}
+
+		snprintf(Line, sizeof(Line), "_quantile{quantile=\"%s\"} %llu\n", s_quantiles[i], Value);
+		StringBuilder_Append(builder, Name);
+		StringBuilder_Append(builder, Line);
+	}
+}
+
+
+// Functions.
+void Metrics_Add(MetricCounter counter, unsigned long long amount)
+{
+	GetThreadShard()->Counters[counter] += amount;
+}
+
+void Metrics_Increment(MetricCounter counter)
+{
+	GetThreadShard()->Counters[counter]++;
+}
+
+void Metrics_AddRequest(unsigned int route, unsigned int statusCode)
+{
+	if (route >= METRICS_ROUTE_CAPACITY)
+	{
+		route = ACCESS_ROUTE_OTHER;
+	}
+	GetThreadShard()->Requests[route][GetStatusSlot(statusCode)]++;
+}
+
+void Metrics_Record(MetricHistogram histogram, unsigned long long value)
+{
+	MetricsShard* Shard = GetThreadShard();
+	Shard->HistogramBuckets[histogram][GetBucketIndex(value)]++;
+	Shard->HistogramSums[histogram] += value;
+}
+
+void Metrics_SetGauge(MetricGauge gauge, long long value)
+{
+	Atomic_Store(&s_gauges[gauge], value);
+}
+
+void Metrics_WritePrometheus(StringBuilder* builder)
+{
+	MetricsShard* Sum = (MetricsShard*)Memory_SafeMalloc(sizeof(MetricsShard));
+	Memory_Set((char*)Sum, sizeof(MetricsShard), 0);
+
+	// Released shards keep the counts of the threads which used them.
+	for (int i = 0; i < METRICS_MAX_SHARDS; i++)
+	{
+		SumShard(Sum, &s_shards[i]);
+	}
+	SumShard(Sum, &s_overflowShard);
+
+	WriteRequests(builder, Sum);
+	for (int i = 0; i < MetricHistogram_Count; i++)
+	{
+		WriteHistogram(builder, Sum, (MetricHistogram)i);
+	}
+
+	for (int i = 0; i < MetricCounter_Count; i++)
+	{
+		AppendDescription(builder, s_counterDescriptions[i].Name, s_counterDescriptions[i].Help, "counter");
+		AppendUnsignedSample(builder, s_counterDescriptions[i].Name, "", Sum->Counters[i]);
+	}
+
+	char Number[METRIC_NUMBER_LENGTH];
+	for (int i = 0; i < MetricGauge_Count; i++)
+	{
+		AppendDescription(builder, s_gaugeDescriptions[i].Name, s_gaugeDescriptions[i].Help, "gauge");
+		snprintf(Number, sizeof(Number), " %lld\n", Atomic_Load(&s_gauges[i]));
+		StringBuilder_Append(builder, s_gaugeDescriptions[i].Name);
+		StringBuilder_Append(builder, Number);
+	}
+
+	Memory_Free(Sum);
+}
+
+void Metrics_UnregisterThread()
+{
+	if (!s_threadShard || (s_threadShard == &s_overflowShard))
+	{
+		s_threadShard = NULL;
+		return;
+	}
+
+	// The store publishes the shard's counts to the thread which claims it next.
+	Atomic_Store(&s_threadShard->IsClaimed, 0);
+	s_threadShard = NULL;
+}
\ No newline at end of file
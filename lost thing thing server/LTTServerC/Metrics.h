@@ -0,0 +1,86 @@
+#pragma once
+#include "LttString.h"
+
+
+// Macros.
+#define METRICS_MAX_SHARDS 128
+
+/* Routes are those of AccessLog_FindRoute, higher routes are counted as ACCESS_ROUTE_OTHER. */
+#define METRICS_ROUTE_CAPACITY 32
+
+/* Values below 8 get a bucket each, every power of two above is split into 8 buckets up to 2^32 microseconds,
+* larger values land in the last bucket. Bucket bounds are at most 12.5% apart. */
+#define METRICS_HISTOGRAM_SUB_BUCKET_COUNT 8
+#define METRICS_HISTOGRAM_MAX_EXPONENT 32
+#define METRICS_HISTOGRAM_BUCKET_COUNT ((METRICS_HISTOGRAM_MAX_EXPONENT - 2) * METRICS_HISTOGRAM_SUB_BUCKET_COUNT)
+
+
+// Types.
+typedef enum MetricCounterEnum
+{
+	MetricCounter_AccountCacheHits,
+	MetricCounter_AccountCacheMisses,
+	MetricCounter_PostCacheHits,
+	MetricCounter_PostCacheMisses,
+	MetricCounter_GHDFBytesRead,
+	MetricCounter_GHDFBytesWritten,
+	MetricCounter_Count
+} MetricCounter;
+
+typedef enum MetricGaugeEnum
+{
+	MetricGauge_SessionCount,
+	MetricGauge_UnfinishedPostCount,
+	MetricGauge_AccountNameTermCount,
+	MetricGauge_PostTitleTermCount,
+	MetricGauge_AccountIndexRecordCount,
+	MetricGauge_AccountIndexIndexedCount,
+	MetricGauge_AccountIndexState,
+	MetricGauge_PostIndexRecordCount,
+	MetricGauge_PostIndexIndexedCount,
+	MetricGauge_PostIndexState,
+	MetricGauge_Count
+} MetricGauge;
+
+/* Latencies in microseconds. */
+typedef enum MetricHistogramEnum
+{
+	MetricHistogram_ParseTime,
+	MetricHistogram_DispatchTime,
+	MetricHistogram_StorageTime,
+	MetricHistogram_CommitTime,
+	MetricHistogram_WriteTime,
+	MetricHistogram_Count
+} MetricHistogram;
+
+
+// Functions.
+/// <summary>
+/// Adds to a counter in the calling thread's shard. Shards are only written by their own thread, so no atomics are used.
+/// </summary>
+void Metrics_Add(MetricCounter counter, unsigned long long amount);
+
+void Metrics_Increment(MetricCounter counter);
+
+/// <summary>
+/// Counts a handled request by its route and response status code.
+/// </summary>
+void Metrics_AddRequest(unsigned int route, unsigned int statusCode);
+
+void Metrics_Record(MetricHistogram histogram, unsigned long long value);
+
+/// <summary>
+/// Sets a gauge, gauges are global and are usually refreshed right before the metrics are exported.
+/// </summary>
+void Metrics_SetGauge(MetricGauge gauge, long long value);
+
+/// <summary>
+/// Sums all shards and appends the metrics in the Prometheus text format.
+/// Values written by other threads during the export may be missing from it.
+/// </summary>
+void Metrics_WritePrometheus(StringBuilder* builder);
+
+/// <summary>
+/// Releases the calling thread's shard for threads started later, its counts are kept.
+/// </summary>
+void Metrics_UnregisterThread();
\ No newline at end of file
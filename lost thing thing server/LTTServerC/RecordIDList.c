@@ -0,0 +1,137 @@
+#include "RecordIDList.h"
+#include "Directory.h"
+#include "LttString.h"
+#include "LTTChar.h"
+#include "Memory.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+
+// Macros.
+#define ID_LIST_CAPACITY 8
+#define ID_LIST_GROWTH 2
+
+#define MAX_ID_DIGITS 19
+#define GROUP_NAME_SUFFIX "k"
+
+
+// Static functions.
+static bool AddStoredID(unsigned long long key, void* argument)
+{
+	RecordIDList_Add((RecordIDList*)argument, key);
+	return true;
+}
+
+static int CompareIDs(const void* id1, const void* id2)
+{
+	unsigned long long ID1 = *(const unsigned long long*)id1;
+	unsigned long long ID2 = *(const unsigned long long*)id2;
+	return (ID1 > ID2) - (ID1 < ID2);
+}
+
+static bool ParseEntryName(const char* name, const char* suffix, unsigned long long* id)
+{
+	unsigned long long ID = 0;
+	size_t Index = 0;
+	for (; Char_IsDigit(name + Index) && (Index < MAX_ID_DIGITS); Index++)
+	{
+		ID = (ID * 10) + (unsigned long long)(name[Index] - '0');
+	}
+
+	if ((Index == 0) || !String_Equals(name + Index, suffix))
+	{
+		return false;
+	}
+	*id = ID;
+	return true;
+}
+
+static void AddEntryIDs(RecordIDList* list, const char* entriesPath, const char* entrySuffix,
+	unsigned long long groupSize, unsigned long long firstID, unsigned long long lastID)
+{
+	size_t GroupCount;
+	char** GroupNames = Directory_List(entriesPath, &GroupCount);
+	for (size_t GroupIndex = 0; GroupIndex < GroupCount; GroupIndex++)
+	{
+		unsigned long long GroupNumber;
+		if (!ParseEntryName(GroupNames[GroupIndex], GROUP_NAME_SUFFIX, &GroupNumber) || (GroupNumber < (firstID / groupSize))
+			|| (GroupNumber > (lastID / groupSize)))
+		{
+			continue;
+		}
+
+		char* GroupPath = Directory_CombinePaths(entriesPath, GroupNames[GroupIndex]);
+		size_t EntryCount;
+		char** EntryNames = Directory_List(GroupPath, &EntryCount);
+		for (size_t EntryIndex = 0; EntryIndex < EntryCount; EntryIndex++)
+		{
+			unsigned long long ID;
+			if (ParseEntryName(EntryNames[EntryIndex], entrySuffix, &ID) && (ID >= firstID) && (ID <= lastID))
+			{
+				RecordIDList_Add(list, ID);
+			}
+		}
+		Directory_FreeList(EntryNames, EntryCount);
+		Memory_Free(GroupPath);
+	}
+	Directory_FreeList(GroupNames, GroupCount);
+}
+
+static void SortUniqueIDs(RecordIDList* list)
+{
+	if (list->Count <= 1)
+	{
+		return;
+	}
+
+	qsort(list->IDs, list->Count, sizeof(unsigned long long), CompareIDs);
+	size_t UniqueCount = 1;
+	for (size_t i = 1; i < list->Count; i++)
+	{
+		if (list->IDs[i] != list->IDs[UniqueCount - 1])
+		{
+			list->IDs[UniqueCount] = list->IDs[i];
+			UniqueCount++;
+		}
+	}
+	list->Count = UniqueCount;
+}
+
+
+// Functions.
+void RecordIDList_Construct(RecordIDList* list)
+{
+	list->IDs = NULL;
+	list->Count = 0;
+	list->_capacity = 0;
+}
+
+void RecordIDList_Add(RecordIDList* list, unsigned long long id)
+{
+	if (list->Count + 1 > list->_capacity)
+	{
+		list->_capacity = list->_capacity == 0 ? ID_LIST_CAPACITY : list->_capacity * ID_LIST_GROWTH;
+		list->IDs = (unsigned long long*)Memory_SafeRealloc(list->IDs, sizeof(unsigned long long) * list->_capacity);
+	}
+	list->IDs[list->Count] = id;
+	list->Count += 1;
+}
+
+void RecordIDList_ListStored(RecordIDList* list, Store* store, const char* entriesPath, const char* entrySuffix,
+	unsigned long long groupSize, unsigned long long firstID, unsigned long long lastID)
+{
+	RecordIDList_Construct(list);
+	if (lastID < firstID)
+	{
+		return;
+	}
+
+	if (store)
+	{
+		Store_ScanKeys(store, firstID, lastID, AddStoredID, list);
+	}
+	AddEntryIDs(list, entriesPath, entrySuffix, groupSize, firstID, lastID);
+
+	// Records may be both in the store and in a not yet removed entry.
+	SortUniqueIDs(list);
+}
\ No newline at end of file
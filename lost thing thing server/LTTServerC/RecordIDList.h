@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+#include "Store.h"
+
+
+// Types.
+typedef struct RecordIDListStruct
+{
+	unsigned long long* IDs;
+	size_t Count;
+	size_t _capacity;
+} RecordIDList;
+
+
+// Functions.
+void RecordIDList_Construct(RecordIDList* list);
+
+void RecordIDList_Add(RecordIDList* list, unsigned long long id);
+
+/// <summary>
+/// Lists the IDs of the stored records within the inclusive range in ascending order, from the store's keys and the
+/// entry directories, so that IDs which were never used or were deleted aren't probed one at a time.
+/// Entries are named by their ID followed by the suffix and are grouped in directories named by ID / groupSize followed by "k",
+/// anything else in the directories is skipped.
+/// </summary>
+/// <param name="store">Store of the records, NULL if records are only kept in entries.</param>
+/// <param name="list">List which is constructed with the IDs, the caller frees its IDs with Memory_Free.</param>
+void RecordIDList_ListStored(RecordIDList* list, Store* store, const char* entriesPath, const char* entrySuffix,
+	unsigned long long groupSize, unsigned long long firstID, unsigned long long lastID);
\ No newline at end of file
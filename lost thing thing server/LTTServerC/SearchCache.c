@@ -0,0 +1,276 @@
+#include "SearchCache.h"
+#include "Memory.h"
+#include "LTTBytes.h"
+#include "LTTChar.h"
+#include "LttString.h"
+#include <string.h>
+
+
+// Macros.
+#define BUCKET_COUNT 256
+#define NO_ENTRY -1
+
+
+// Types.
+typedef struct SearchCacheEntryStruct
+{
+	char Query[SEARCH_CACHE_MAX_QUERY_LENGTH + 1];
+	SearchCacheType Type;
+	unsigned int Hash;
+	unsigned long long Generation;
+
+	unsigned long long* IDs;
+	size_t IDCount;
+
+	int NextInBucket;
+	int MoreRecentIndex;
+	int LessRecentIndex;
+} SearchCacheEntry;
+
+
+// Static functions.
+/* Query normalization. */
+static bool NormalizeQuery(const char* query, char* normalizedQuery)
+{
+	size_t Length = 0;
+	bool IsWhitespacePending = false;
+
+	for (size_t Index = 0; query[Index] != '\0'; Index += Char_GetByteCount(query + Index))
+	{
+		if (Char_IsWhitespace(query + Index))
+		{
+			IsWhitespacePending = Length > 0;
+			continue;
+		}
+
+		int ByteCount = Char_GetByteCount(query + Index);
+		if ((Length + ByteCount + (IsWhitespacePending ? 1 : 0)) > SEARCH_CACHE_MAX_QUERY_LENGTH)
+		{
+			return false;
+		}
+
+		if (IsWhitespacePending)
+		{
+			normalizedQuery[Length] = ' ';
+			Length++;
+			IsWhitespacePending = false;
+		}
+		Memory_Copy(query + Index, normalizedQuery + Length, ByteCount);
+		Length += ByteCount;
+	}
+
+	normalizedQuery[Length] = '\0';
+	String_ToLowerUTF8(normalizedQuery);
+	return true;
+}
+
+static unsigned int HashQuery(SearchCacheType type, const char* normalizedQuery)
+{
+	return Bytes_HashMore(BYTES_HASH_OFFSET_BASIS ^ (unsigned int)type, (const unsigned char*)normalizedQuery,
+		String_LengthBytes(normalizedQuery));
+}
+
+/* Entry lists. */
+static int FindEntry(SearchCache* self, SearchCacheType type, const char* normalizedQuery, unsigned int hash)
+{
+	for (int Index = self->Buckets[hash % BUCKET_COUNT]; Index != NO_ENTRY; Index = self->Entries[Index].NextInBucket)
+	{
+		SearchCacheEntry* Entry = self->Entries + Index;
+		if ((Entry->Hash == hash) && (Entry->Type == type) && String_Equals(Entry->Query, normalizedQuery))
+		{
+			return Index;
+		}
+	}
+	return NO_ENTRY;
+}
+
+static void UnlinkFromBucket(SearchCache* self, int entryIndex)
+{
+	int* Link = &self->Buckets[self->Entries[entryIndex].Hash % BUCKET_COUNT];
+	while (*Link != entryIndex)
+	{
+		Link = &self->Entries[*Link].NextInBucket;
+	}
+	*Link = self->Entries[entryIndex].NextInBucket;
+}
+
+static void UnlinkFromRecentList(SearchCache* self, int entryIndex)
+{
+	SearchCacheEntry* Entry = self->Entries + entryIndex;
+
+	if (Entry->MoreRecentIndex != NO_ENTRY)
+	{
+		self->Entries[Entry->MoreRecentIndex].LessRecentIndex = Entry->LessRecentIndex;
+	}
+	else
+	{
+		self->MostRecentIndex = Entry->LessRecentIndex;
+	}
+
+	if (Entry->LessRecentIndex != NO_ENTRY)
+	{
+		self->Entries[Entry->LessRecentIndex].MoreRecentIndex = Entry->MoreRecentIndex;
+	}
+	else
+	{
+		self->LeastRecentIndex = Entry->MoreRecentIndex;
+	}
+}
+
+static void PushMostRecent(SearchCache* self, int entryIndex)
+{
+	SearchCacheEntry* Entry = self->Entries + entryIndex;
+	Entry->MoreRecentIndex = NO_ENTRY;
+	Entry->LessRecentIndex = self->MostRecentIndex;
+
+	if (self->MostRecentIndex != NO_ENTRY)
+	{
+		self->Entries[self->MostRecentIndex].MoreRecentIndex = entryIndex;
+	}
+	else
+	{
+		self->LeastRecentIndex = entryIndex;
+	}
+	self->MostRecentIndex = entryIndex;
+}
+
+static unsigned long long* CopyIDs(const unsigned long long* ids, size_t idCount)
+{
+	if (idCount == 0)
+	{
+		return NULL;
+	}
+
+	unsigned long long* Copy = (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * idCount);
+	Memory_Copy((const char*)ids, (char*)Copy, sizeof(unsigned long long) * idCount);
+	return Copy;
+}
+
+static int AcquireEntry(SearchCache* self)
+{
+	if (self->EntryCount < SEARCH_CACHE_CAPACITY)
+	{
+		int Index = (int)self->EntryCount;
+		self->EntryCount += 1;
+		return Index;
+	}
+
+	int Index = self->LeastRecentIndex;
+	UnlinkFromBucket(self, Index);
+	UnlinkFromRecentList(self, Index);
+	Memory_Free(self->Entries[Index].IDs);
+	return Index;
+}
+
+static void ResetLists(SearchCache* self)
+{
+	for (int i = 0; i < BUCKET_COUNT; i++)
+	{
+		self->Buckets[i] = NO_ENTRY;
+	}
+	self->EntryCount = 0;
+	self->MostRecentIndex = NO_ENTRY;
+	self->LeastRecentIndex = NO_ENTRY;
+}
+
+
+// Functions.
+void SearchCache_Construct(SearchCache* self)
+{
+	self->Entries = (SearchCacheEntry*)Memory_SafeMalloc(sizeof(SearchCacheEntry) * SEARCH_CACHE_CAPACITY);
+	self->Buckets = (int*)Memory_SafeMalloc(sizeof(int) * BUCKET_COUNT);
+	ResetLists(self);
+	ThreadLock_Construct(&self->Lock);
+}
+
+bool SearchCache_TryGet(SearchCache* self,
+	SearchCacheType type,
+	const char* query,
+	unsigned long long generation,
+	unsigned long long** ids,
+	size_t* idCount)
+{
+	*ids = NULL;
+	*idCount = 0;
+
+	char NormalizedQuery[SEARCH_CACHE_MAX_QUERY_LENGTH + 1];
+	if (!NormalizeQuery(query, NormalizedQuery))
+	{
+		return false;
+	}
+
+	ThreadLock_Lock(&self->Lock);
+	int Index = FindEntry(self, type, NormalizedQuery, HashQuery(type, NormalizedQuery));
+	if ((Index == NO_ENTRY) || (self->Entries[Index].Generation != generation))
+	{
+		ThreadLock_Unlock(&self->Lock);
+		return false;
+	}
+
+	UnlinkFromRecentList(self, Index);
+	PushMostRecent(self, Index);
+
+	*ids = CopyIDs(self->Entries[Index].IDs, self->Entries[Index].IDCount);
+	*idCount = self->Entries[Index].IDCount;
+	ThreadLock_Unlock(&self->Lock);
+	return true;
+}
+
+void SearchCache_Put(SearchCache* self,
+	SearchCacheType type,
+	const char* query,
+	unsigned long long generation,
+	const unsigned long long* ids,
+	size_t idCount)
+{
+	char NormalizedQuery[SEARCH_CACHE_MAX_QUERY_LENGTH + 1];
+	if (!NormalizeQuery(query, NormalizedQuery))
+	{
+		return;
+	}
+
+	unsigned int Hash = HashQuery(type, NormalizedQuery);
+	ThreadLock_Lock(&self->Lock);
+	int Index = FindEntry(self, type, NormalizedQuery, Hash);
+	if (Index != NO_ENTRY)
+	{
+		// Stale entries are refreshed in place.
+		UnlinkFromRecentList(self, Index);
+		Memory_Free(self->Entries[Index].IDs);
+	}
+	else
+	{
+		Index = AcquireEntry(self);
+		SearchCacheEntry* Entry = self->Entries + Index;
+		String_CopyTo(NormalizedQuery, Entry->Query);
+		Entry->Type = type;
+		Entry->Hash = Hash;
+		Entry->NextInBucket = self->Buckets[Hash % BUCKET_COUNT];
+		self->Buckets[Hash % BUCKET_COUNT] = Index;
+	}
+
+	SearchCacheEntry* Entry = self->Entries + Index;
+	Entry->Generation = generation;
+	Entry->IDs = CopyIDs(ids, idCount);
+	Entry->IDCount = idCount;
+	PushMostRecent(self, Index);
+	ThreadLock_Unlock(&self->Lock);
+}
+
+void SearchCache_Clear(SearchCache* self)
+{
+	ThreadLock_Lock(&self->Lock);
+	for (size_t i = 0; i < self->EntryCount; i++)
+	{
+		Memory_Free(self->Entries[i].IDs);
+	}
+	ResetLists(self);
+	ThreadLock_Unlock(&self->Lock);
+}
+
+void SearchCache_Deconstruct(SearchCache* self)
+{
+	SearchCache_Clear(self);
+	Memory_Free(self->Entries);
+	Memory_Free(self->Buckets);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+#include "LTTThread.h"
+
+
+// Macros.
+#define SEARCH_CACHE_CAPACITY 128
+#define SEARCH_CACHE_MAX_QUERY_LENGTH 128
+
+
+// Types.
+typedef enum SearchCacheTypeEnum
+{
+	SearchCacheType_PostTitle,
+	SearchCacheType_AccountName
+} SearchCacheType;
+
+typedef struct SearchCacheStruct
+{
+	struct SearchCacheEntryStruct* Entries;
+	int* Buckets;
+	size_t EntryCount;
+	int MostRecentIndex;
+	int LeastRecentIndex;
+	ThreadLock Lock;
+} SearchCache;
+
+
+// Functions.
+void SearchCache_Construct(SearchCache* self);
+
+/// <summary>
+/// Looks up the ranked ID list of a previous search. Entries created under a different generation are stale and count as a miss.
+/// </summary>
+/// <param name="ids">Receives a copy of the cached IDs which must be freed by the caller, NULL if the cached result is empty.</param>
+/// <returns>true if a valid cached result was found, otherwise false.</returns>
+bool SearchCache_TryGet(SearchCache* self,
+	SearchCacheType type,
+	const char* query,
+	unsigned long long generation,
+	unsigned long long** ids,
+	size_t* idCount);
+
+/// <summary>
+/// Stores the ranked ID list of a search, evicting the least recently used entry if the cache is full.
+/// </summary>
+void SearchCache_Put(SearchCache* self,
+	SearchCacheType type,
+	const char* query,
+	unsigned long long generation,
+	const unsigned long long* ids,
+	size_t idCount);
+
+void SearchCache_Clear(SearchCache* self);
+
+void SearchCache_Deconstruct(SearchCache* self);
\ No newline at end of file
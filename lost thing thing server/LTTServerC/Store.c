@@ -0,0 +1,1152 @@
+#include "Store.h"
+#include "File.h"
+#include "Directory.h"
+#include "Memory.h"
+#include "LttString.h"
+#include <stdio.h>
+#include <string.h>
+
+
+// Macros.
+#define STORE_MANIFEST_FILE_NAME "store_manifest" GHDF_FILE_EXTENSION
+#define RUN_FILE_NAME_FORMAT "run_%llu" GHDF_SEGMENT_FILE_EXTENSION
+#define RUN_FILE_NAME_BUFFER_SIZE 64
+
+#define ENTRY_ID_MANIFEST_NEXT_RUN_NUMBER 1 // ulong
+#define ENTRY_ID_MANIFEST_RUN_NUMBERS 2 // ulong array, newest first
+
+#define MEMTABLE_CAPACITY 64
+#define RUN_LIST_CAPACITY 8
+#define LIST_GROWTH 2
+
+/* Handed to the background thread early so that the memtable stays small even if nobody flushes. */
+#define MEMTABLE_FLUSH_SIZE (4 * 1024 * 1024)
+
+/* Counted for every entry on top of its value, so that deletions alone also fill the memtable. */
+#define MEMTABLE_ENTRY_OVERHEAD 32
+
+/* Runs are merged by size tiers: once this many neighbouring runs are of a similar size, they are merged into one run
+* of the next tier. Each byte is rewritten about once per tier instead of on every merge, while the amount of runs
+* a read may have to check only grows with the logarithm of the store's size. */
+#define COMPACTION_RUN_COUNT 4
+#define COMPACTION_SIZE_RATIO 2
+
+/* Runs below this size are all in the lowest tier, so that small flushes don't each start their own tier. */
+#define COMPACTION_MIN_TIER_SIZE MEMTABLE_FLUSH_SIZE
+
+/* About 1% false positives. */
+#define BLOOM_BITS_PER_KEY 10
+#define BLOOM_HASH_COUNT 7
+#define BLOOM_WORD_BITS 64
+
+#define MEMTABLE_SOURCE -1
+
+/* The memtable and the immutable memtable, newest first. */
+#define MEMTABLE_SOURCE_COUNT 2
+
+
+// Types.
+/* Walks the memtables and a list of runs at once, yielding each key once from the newest source holding it. */
+typedef struct MergeCursorStruct
+{
+	StoreMemtable* Memtables[MEMTABLE_SOURCE_COUNT];
+	size_t MemtableIndices[MEMTABLE_SOURCE_COUNT];
+	size_t MemtableCount;
+
+	StoreRun** Runs;
+	size_t RunCount;
+	size_t* RunIndices;
+} MergeCursor;
+
+
+// Static functions.
+/* Paths. */
+static const char* GetRunPath(Store* self, unsigned long long number)
+{
+	char FileName[RUN_FILE_NAME_BUFFER_SIZE];
+	snprintf(FileName, sizeof(FileName), RUN_FILE_NAME_FORMAT, number);
+	return Directory_CombinePaths(self->_directory, FileName);
+}
+
+/* Bloom filters. */
+static unsigned long long MixKey(unsigned long long key)
+{
+	key += 0x9E3779B97F4A7C15ull;
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+	return key ^ (key >> 31);
+}
+
+static void BloomAdd(StoreRun* run, unsigned long long key)
+{
+	unsigned long long Hash = MixKey(key);
+	unsigned long long Step = (Hash >> 32) | 1;
+	for (int i = 0; i < BLOOM_HASH_COUNT; i++, Hash += Step)
+	{
+		size_t Bit = (size_t)(Hash % run->_bloomBitCount);
+		run->_bloomBits[Bit / BLOOM_WORD_BITS] |= 1ull << (Bit % BLOOM_WORD_BITS);
+	}
+}
+
+static bool BloomMayContain(StoreRun* run, unsigned long long key)
+{
+	unsigned long long Hash = MixKey(key);
+	unsigned long long Step = (Hash >> 32) | 1;
+	for (int i = 0; i < BLOOM_HASH_COUNT; i++, Hash += Step)
+	{
+		size_t Bit = (size_t)(Hash % run->_bloomBitCount);
+		if (!(run->_bloomBits[Bit / BLOOM_WORD_BITS] & (1ull << (Bit % BLOOM_WORD_BITS))))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Runs. */
+static Error OpenRun(Store* self, unsigned long long number, StoreRun** run)
+{
+	StoreRun* Run = (StoreRun*)Memory_SafeMalloc(sizeof(StoreRun));
+	Run->Number = number;
+
+	const char* Path = GetRunPath(self, number);
+	Error ReturnedError = GHDFSegment_Open(&Run->Segment, Path, self->_syncWrites);
+	Memory_Free((char*)Path);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Memory_Free(Run);
+		return ReturnedError;
+	}
+
+	// Filters aren't stored, building one from the run's offset table is cheap compared to reading the table.
+	size_t RecordCount = Run->Segment.RecordCount;
+	size_t WordCount = ((RecordCount * BLOOM_BITS_PER_KEY) / BLOOM_WORD_BITS) + 1;
+	Run->_bloomBitCount = WordCount * BLOOM_WORD_BITS;
+	Run->_bloomBits = (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * WordCount);
+	Memory_Set((char*)Run->_bloomBits, sizeof(unsigned long long) * WordCount, 0);
+
+	Run->MinKey = STORE_LAST_KEY;
+	Run->MaxKey = STORE_FIRST_KEY;
+	Run->Size = 0;
+	for (size_t i = 0; i < RecordCount; i++)
+	{
+		GHDFSegmentRecord Record = GHDFSegment_GetRecord(&Run->Segment, i);
+		BloomAdd(Run, Record.ID);
+		Run->Size += Record.Length + MEMTABLE_ENTRY_OVERHEAD;
+	}
+	if (RecordCount > 0)
+	{
+		Run->MinKey = GHDFSegment_GetRecord(&Run->Segment, 0).ID;
+		Run->MaxKey = GHDFSegment_GetRecord(&Run->Segment, RecordCount - 1).ID;
+	}
+
+	*run = Run;
+	return Error_CreateSuccess();
+}
+
+static void CloseRun(StoreRun* run, bool deleteFile, Store* owner)
+{
+	Error ReturnedError = GHDFSegment_Close(&run->Segment);
+	Error_Deconstruct(&ReturnedError);
+	if (deleteFile)
+	{
+		const char* Path = GetRunPath(owner, run->Number);
+		File_Delete(Path);
+		Memory_Free((char*)Path);
+	}
+	Memory_Free(run->_bloomBits);
+	Memory_Free(run);
+}
+
+static void EnsureRunCapacity(Store* self, size_t capacity)
+{
+	if (self->_runCapacity >= capacity)
+	{
+		return;
+	}
+
+	while (self->_runCapacity < capacity)
+	{
+		self->_runCapacity *= LIST_GROWTH;
+	}
+	self->_runs = (StoreRun**)Memory_SafeRealloc(self->_runs, sizeof(StoreRun*) * self->_runCapacity);
+}
+
+/* Looks a key up in a single run, a found empty record means the key was deleted. */
+static bool FindInRun(StoreRun* run, unsigned long long key, GHDFSegmentRecord* record)
+{
+	if ((key < run->MinKey) || (key > run->MaxKey) || !BloomMayContain(run, key))
+	{
+		return false;
+	}
+	return GHDFSegment_Find(&run->Segment, key, record);
+}
+
+static size_t FindFirstRunRecord(StoreRun* run, unsigned long long key)
+{
+	size_t Low = 0;
+	size_t High = run->Segment.RecordCount;
+	while (Low < High)
+	{
+		size_t Middle = Low + ((High - Low) / 2);
+		if (GHDFSegment_GetRecord(&run->Segment, Middle).ID < key)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+	return Low;
+}
+
+/* Manifest. */
+static Error WriteManifest(Store* self)
+{
+	unsigned long long* RunNumbers = (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * (self->RunCount + 1));
+	for (size_t i = 0; i < self->RunCount; i++)
+	{
+		RunNumbers[i] = self->_runs[i]->Number;
+	}
+
+	GHDFBuffer* Buffer = GHDFBuffer_GetThreadBuffer();
+	GHDFBuffer_BeginFile(Buffer);
+	GHDFBuffer_WriteCompoundHeader(Buffer, 2);
+	GHDFPrimitive Value;
+	Value.ULong = self->_nextRunNumber;
+	GHDFBuffer_WriteValueEntry(Buffer, GHDFType_ULong, ENTRY_ID_MANIFEST_NEXT_RUN_NUMBER, Value);
+	GHDFBuffer_WriteArrayEntry(Buffer, GHDFType_ULong, ENTRY_ID_MANIFEST_RUN_NUMBERS, RunNumbers, (unsigned int)self->RunCount);
+	Memory_Free(RunNumbers);
+
+	const char* Path = Directory_CombinePaths(self->_directory, STORE_MANIFEST_FILE_NAME);
+	Error ReturnedError = GHDFBuffer_WriteToFile(Buffer, Path, self->_syncWrites);
+	Memory_Free((char*)Path);
+	return ReturnedError;
+}
+
+static Error ReadManifestRunNumbers(GHDFReader* reader, GHDFEntryInfo* info, unsigned long long** runNumbers, size_t* runCount)
+{
+	unsigned int Count;
+	Error ReturnedError = GHDFReader_ReadArrayHeader(reader, info, GHDFType_ULong, &Count);
+	if ((ReturnedError.Code == ErrorCode_Success) && (Count > 0))
+	{
+		*runNumbers = (unsigned long long*)Memory_SafeMalloc(sizeof(unsigned long long) * Count);
+		*runCount = Count;
+		ReturnedError = GHDFReader_ReadArrayElements(reader, GHDFType_ULong, *runNumbers, Count);
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = GHDFReader_EndValue(reader, info);
+	}
+	return ReturnedError;
+}
+
+static Error LoadManifest(Store* self)
+{
+	const char* Path = Directory_CombinePaths(self->_directory, STORE_MANIFEST_FILE_NAME);
+	if (!File_Exists(Path))
+	{
+		Memory_Free((char*)Path);
+		return WriteManifest(self);
+	}
+
+	FileMapping Mapping;
+	Error ReturnedError = File_MapRead(Path, &Mapping);
+	Memory_Free((char*)Path);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	unsigned long long* RunNumbers = NULL;
+	size_t RunCount = 0;
+	GHDFReader Reader;
+	unsigned int EntryCount;
+	ReturnedError = GHDFReader_Open(&Reader, Mapping.Data, Mapping.Length, NULL, &EntryCount);
+	for (unsigned int i = 0; (i < EntryCount) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		GHDFEntryInfo Info;
+		ReturnedError = GHDFReader_ReadEntryInfo(&Reader, &Info);
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			break;
+		}
+
+		if (Info.ID == ENTRY_ID_MANIFEST_NEXT_RUN_NUMBER)
+		{
+			GHDFPrimitive Value;
+			ReturnedError = GHDFReader_ReadValue(&Reader, &Info, GHDFType_ULong, &Value);
+			self->_nextRunNumber = Value.ULong;
+		}
+		else if ((Info.ID == ENTRY_ID_MANIFEST_RUN_NUMBERS) && !RunNumbers)
+		{
+			ReturnedError = ReadManifestRunNumbers(&Reader, &Info, &RunNumbers, &RunCount);
+		}
+		else
+		{
+			ReturnedError = GHDFReader_SkipValue(&Reader, &Info);
+		}
+	}
+	File_Unmap(&Mapping);
+
+	EnsureRunCapacity(self, RunCount);
+	for (size_t i = 0; (i < RunCount) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		ReturnedError = OpenRun(self, RunNumbers[i], self->_runs + i);
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			self->RunCount++;
+		}
+	}
+	Memory_Free(RunNumbers);
+	return ReturnedError;
+}
+
+/* Memtable. */
+static void ConstructMemtable(StoreMemtable* memtable)
+{
+	memtable->Capacity = MEMTABLE_CAPACITY;
+	memtable->Entries = (StoreEntry*)Memory_SafeMalloc(sizeof(StoreEntry) * memtable->Capacity);
+	memtable->Count = 0;
+	memtable->Bytes = 0;
+}
+
+static size_t FindMemtableIndex(StoreMemtable* memtable, unsigned long long key, bool* isFound)
+{
+	size_t Low = 0;
+	size_t High = memtable->Count;
+	while (Low < High)
+	{
+		size_t Middle = Low + ((High - Low) / 2);
+		if (memtable->Entries[Middle].Key < key)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+
+	*isFound = (Low < memtable->Count) && (memtable->Entries[Low].Key == key);
+	return Low;
+}
+
+/* Finds the key's newest entry in either memtable, NULL if neither holds it. */
+static StoreEntry* FindMemtableEntry(Store* self, unsigned long long key)
+{
+	bool IsFound;
+	size_t Index = FindMemtableIndex(&self->_memtable, key, &IsFound);
+	if (IsFound)
+	{
+		return self->_memtable.Entries + Index;
+	}
+	Index = FindMemtableIndex(&self->_immutableMemtable, key, &IsFound);
+	return IsFound ? self->_immutableMemtable.Entries + Index : NULL;
+}
+
+static void SetMemtableEntry(StoreMemtable* memtable, unsigned long long key, const char* value, size_t valueLength)
+{
+	char* Value = NULL;
+	if (value)
+	{
+		Value = (char*)Memory_SafeMalloc(valueLength);
+		Memory_Copy(value, Value, valueLength);
+	}
+
+	bool IsFound;
+	size_t Index = FindMemtableIndex(memtable, key, &IsFound);
+	if (IsFound)
+	{
+		memtable->Bytes -= memtable->Entries[Index].ValueLength;
+		Memory_Free(memtable->Entries[Index].Value);
+	}
+	else
+	{
+		if (memtable->Count == memtable->Capacity)
+		{
+			memtable->Capacity *= LIST_GROWTH;
+			memtable->Entries = (StoreEntry*)Memory_SafeRealloc(memtable->Entries, sizeof(StoreEntry) * memtable->Capacity);
+		}
+		memmove(memtable->Entries + Index + 1, memtable->Entries + Index, sizeof(StoreEntry) * (memtable->Count - Index));
+		memtable->Count++;
+		memtable->Bytes += MEMTABLE_ENTRY_OVERHEAD;
+	}
+
+	memtable->Entries[Index].Key = key;
+	memtable->Entries[Index].Value = Value;
+	memtable->Entries[Index].ValueLength = value ? valueLength : 0;
+	memtable->Bytes += memtable->Entries[Index].ValueLength;
+}
+
+static void ClearMemtable(StoreMemtable* memtable)
+{
+	for (size_t i = 0; i < memtable->Count; i++)
+	{
+		Memory_Free(memtable->Entries[i].Value);
+	}
+	memtable->Count = 0;
+	memtable->Bytes = 0;
+}
+
+static void DeconstructMemtable(StoreMemtable* memtable)
+{
+	ClearMemtable(memtable);
+	Memory_Free(memtable->Entries);
+}
+
+/* Merging. */
+static void MergeCursorConstruct(MergeCursor* cursor, Store* owner, bool includeMemtables, StoreRun** runs, size_t runCount,
+	unsigned long long firstKey)
+{
+	cursor->MemtableCount = 0;
+	if (includeMemtables)
+	{
+		cursor->Memtables[0] = &owner->_memtable;
+		cursor->Memtables[1] = &owner->_immutableMemtable;
+		cursor->MemtableCount = MEMTABLE_SOURCE_COUNT;
+	}
+	for (size_t i = 0; i < cursor->MemtableCount; i++)
+	{
+		bool IsFound;
+		cursor->MemtableIndices[i] = FindMemtableIndex(cursor->Memtables[i], firstKey, &IsFound);
+	}
+
+	cursor->Runs = runs;
+	cursor->RunCount = runCount;
+	cursor->RunIndices = (size_t*)Memory_SafeMalloc(sizeof(size_t) * (runCount + 1));
+	for (size_t i = 0; i < runCount; i++)
+	{
+		cursor->RunIndices[i] = FindFirstRunRecord(runs[i], firstKey);
+	}
+}
+
+/// <summary>
+/// Moves to the next key up to the last key. The source is MEMTABLE_SOURCE, with the entry set, or the index of the newest
+/// run holding the key.
+/// </summary>
+static bool MergeCursorNext(MergeCursor* cursor, unsigned long long lastKey, unsigned long long* key, int* source,
+	StoreEntry** entry, GHDFSegmentRecord* record)
+{
+	// Newer sources are checked first and only replaced by strictly lower keys, so ties go to the newest.
+	bool IsFound = false;
+	unsigned long long LowestKey = 0;
+	for (size_t i = 0; i < cursor->MemtableCount; i++)
+	{
+		StoreMemtable* Memtable = cursor->Memtables[i];
+		if ((cursor->MemtableIndices[i] < Memtable->Count) && (!IsFound || (Memtable->Entries[cursor->MemtableIndices[i]].Key < LowestKey)))
+		{
+			*entry = Memtable->Entries + cursor->MemtableIndices[i];
+			LowestKey = (*entry)->Key;
+			*source = MEMTABLE_SOURCE;
+			IsFound = true;
+		}
+	}
+
+	for (size_t i = 0; i < cursor->RunCount; i++)
+	{
+		if (cursor->RunIndices[i] >= cursor->Runs[i]->Segment.RecordCount)
+		{
+			continue;
+		}
+
+		GHDFSegmentRecord Record = GHDFSegment_GetRecord(&cursor->Runs[i]->Segment, cursor->RunIndices[i]);
+		if (!IsFound || (Record.ID < LowestKey))
+		{
+			LowestKey = Record.ID;
+			*source = (int)i;
+			*record = Record;
+			IsFound = true;
+		}
+	}
+	if (!IsFound || (LowestKey > lastKey))
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < cursor->MemtableCount; i++)
+	{
+		StoreMemtable* Memtable = cursor->Memtables[i];
+		if ((cursor->MemtableIndices[i] < Memtable->Count) && (Memtable->Entries[cursor->MemtableIndices[i]].Key == LowestKey))
+		{
+			cursor->MemtableIndices[i]++;
+		}
+	}
+	for (size_t i = 0; i < cursor->RunCount; i++)
+	{
+		if ((cursor->RunIndices[i] < cursor->Runs[i]->Segment.RecordCount)
+			&& (GHDFSegment_GetRecord(&cursor->Runs[i]->Segment, cursor->RunIndices[i]).ID == LowestKey))
+		{
+			cursor->RunIndices[i]++;
+		}
+	}
+
+	*key = LowestKey;
+	return true;
+}
+
+static void MergeCursorDeconstruct(MergeCursor* cursor)
+{
+	Memory_Free(cursor->RunIndices);
+}
+
+/* Flushing. */
+static Error WriteMemtableRun(Store* self, StoreMemtable* memtable, unsigned long long number)
+{
+	const char* Path = GetRunPath(self, number);
+	// A crash between writing a run and the manifest leaves a run which isn't listed anywhere, its number is reused.
+	File_Delete(Path);
+
+	GHDFSegment Segment;
+	Error ReturnedError = GHDFSegment_Open(&Segment, Path, self->_syncWrites);
+	Memory_Free((char*)Path);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	for (size_t i = 0; (i < memtable->Count) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		StoreEntry* Entry = memtable->Entries + i;
+		ReturnedError = GHDFSegment_Write(&Segment, Entry->Key, Entry->Value, Entry->ValueLength);
+	}
+
+	Error CloseError = GHDFSegment_Close(&Segment);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Error_Deconstruct(&CloseError);
+		return ReturnedError;
+	}
+	return CloseError;
+}
+
+/* Lists the run as the newest one, holding the lock. The run only counts once the manifest lists it. */
+static Error AddRun(Store* self, StoreRun* run)
+{
+	EnsureRunCapacity(self, self->RunCount + 1);
+	memmove(self->_runs + 1, self->_runs, sizeof(StoreRun*) * self->RunCount);
+	self->_runs[0] = run;
+	self->RunCount++;
+
+	Error ReturnedError = WriteManifest(self);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		self->RunCount--;
+		memmove(self->_runs, self->_runs + 1, sizeof(StoreRun*) * self->RunCount);
+		CloseRun(run, true, self);
+	}
+	return ReturnedError;
+}
+
+/// <summary>
+/// Writes the queued immutable memtable into a new run, holding the lock. The lock is let go of while the run is written,
+/// reads keep finding the entries in the immutable memtable until the run replaces it. A failed memtable stays in place.
+/// </summary>
+static Error FlushImmutableMemtable(Store* self)
+{
+	Atomic_Store(&self->_flushState, StoreFlushState_Writing);
+	unsigned long long Number = self->_nextRunNumber;
+	self->_nextRunNumber++;
+	ThreadLock_Unlock(&self->_lock);
+
+	// Only this flush uses the immutable memtable while it is being written, besides readers.
+	Error ReturnedError = WriteMemtableRun(self, &self->_immutableMemtable, Number);
+	StoreRun* Run = NULL;
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = OpenRun(self, Number, &Run);
+	}
+
+	ThreadLock_Lock(&self->_lock);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = AddRun(self, Run);
+	}
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ClearMemtable(&self->_immutableMemtable);
+		if (self->RunCount >= COMPACTION_RUN_COUNT)
+		{
+			ThreadCondition_WakeOne(&self->_compactionCondition);
+		}
+	}
+	Atomic_Store(&self->_flushState, (ReturnedError.Code == ErrorCode_Success) ? StoreFlushState_None : StoreFlushState_Failed);
+	ThreadCondition_WakeAll(&self->_flushCondition);
+	return ReturnedError;
+}
+
+/* Waits until the immutable memtable is free, holding the lock. A memtable whose flush failed, or which the closed
+* background thread won't flush anymore, is flushed by the caller. */
+static Error WaitForFlush(Store* self)
+{
+	while (true)
+	{
+		long long State = Atomic_Load(&self->_flushState);
+		if (State == StoreFlushState_None)
+		{
+			return Error_CreateSuccess();
+		}
+		if ((State == StoreFlushState_Failed) || ((State == StoreFlushState_Queued) && Atomic_Load(&self->_isClosing)))
+		{
+			return FlushImmutableMemtable(self);
+		}
+		ThreadCondition_Wait(&self->_flushCondition, &self->_lock, THREAD_WAIT_INFINITE);
+	}
+}
+
+/* Swaps the memtable for the free immutable one and queues it to be flushed, holding the lock. */
+static void FreezeMemtable(Store* self)
+{
+	StoreMemtable Emptied = self->_immutableMemtable;
+	self->_immutableMemtable = self->_memtable;
+	self->_memtable = Emptied;
+	Atomic_Store(&self->_flushState, StoreFlushState_Queued);
+}
+
+/* Sets an entry, holding the lock. A full memtable is left to the background thread to flush. */
+static Error AddMemtableEntry(Store* self, unsigned long long key, const char* value, size_t valueLength)
+{
+	SetMemtableEntry(&self->_memtable, key, value, valueLength);
+	if (self->_memtable.Bytes < MEMTABLE_FLUSH_SIZE)
+	{
+		return Error_CreateSuccess();
+	}
+
+	// Another writer may have frozen the memtable while this one waited.
+	Error ReturnedError = WaitForFlush(self);
+	if ((ReturnedError.Code == ErrorCode_Success) && (self->_memtable.Bytes >= MEMTABLE_FLUSH_SIZE))
+	{
+		FreezeMemtable(self);
+		ThreadCondition_WakeOne(&self->_compactionCondition);
+	}
+	return ReturnedError;
+}
+
+/* Compaction. */
+/* Flushes the immutable memtable if it is still queued, so that writers don't wait for a merge. */
+static void FlushQueuedMemtable(Store* self)
+{
+	ThreadLock_Lock(&self->_lock);
+	if (Atomic_Load(&self->_flushState) == StoreFlushState_Queued)
+	{
+		Error ReturnedError = FlushImmutableMemtable(self);
+		Error_Deconstruct(&ReturnedError);
+	}
+	ThreadLock_Unlock(&self->_lock);
+}
+
+static unsigned long long GetTierSize(StoreRun* run)
+{
+	return run->Size < COMPACTION_MIN_TIER_SIZE ? COMPACTION_MIN_TIER_SIZE : run->Size;
+}
+
+/// <summary>
+/// Finds the newest neighbouring runs of a similar size which are worth merging, holding the lock.
+/// Only neighbours are merged, so that the runs stay ordered from newest to oldest.
+/// </summary>
+static bool FindCompactionRuns(Store* self, size_t* firstRun, size_t* runCount)
+{
+	for (size_t First = 0; (First + COMPACTION_RUN_COUNT) <= self->RunCount; First++)
+	{
+		unsigned long long MinSize = GetTierSize(self->_runs[First]);
+		unsigned long long MaxSize = MinSize;
+		size_t End = First + 1;
+		for (; End < self->RunCount; End++)
+		{
+			unsigned long long Size = GetTierSize(self->_runs[End]);
+			unsigned long long NewMinSize = Size < MinSize ? Size : MinSize;
+			unsigned long long NewMaxSize = Size > MaxSize ? Size : MaxSize;
+			if (NewMaxSize > (NewMinSize * COMPACTION_SIZE_RATIO))
+			{
+				break;
+			}
+			MinSize = NewMinSize;
+			MaxSize = NewMaxSize;
+		}
+
+		if ((End - First) >= COMPACTION_RUN_COUNT)
+		{
+			*firstRun = First;
+			*runCount = End - First;
+			return true;
+		}
+	}
+	return false;
+}
+
+/// <summary>
+/// Merges the runs into a new run.
+/// </summary>
+/// <param name="isOldestIncluded">Whether the oldest run is part of the merge, only then nothing older can hold
+/// a deleted key's value and deleted keys are dropped for good. Otherwise they are kept as empty records.</param>
+static Error MergeRuns(Store* self, StoreRun** runs, size_t runCount, bool isOldestIncluded, unsigned long long number,
+	bool* isRunCreated)
+{
+	*isRunCreated = false;
+	const char* Path = GetRunPath(self, number);
+	File_Delete(Path);
+
+	GHDFSegment Segment;
+	Error ReturnedError = GHDFSegment_Open(&Segment, Path, self->_syncWrites);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Memory_Free((char*)Path);
+		return ReturnedError;
+	}
+
+	MergeCursor Cursor;
+	MergeCursorConstruct(&Cursor, self, false, runs, runCount, STORE_FIRST_KEY);
+	unsigned long long Key;
+	int Source;
+	StoreEntry* Entry;
+	GHDFSegmentRecord Record;
+	size_t WrittenCount = 0;
+	while ((ReturnedError.Code == ErrorCode_Success) && MergeCursorNext(&Cursor, STORE_LAST_KEY, &Key, &Source, &Entry, &Record))
+	{
+		if (Atomic_Load(&self->_isClosing))
+		{
+			ReturnedError = Error_CreateError(ErrorCode_IllegalState, "MergeRuns: Store is closing.");
+			break;
+		}
+		if (Atomic_Load(&self->_flushState) == StoreFlushState_Queued)
+		{
+			FlushQueuedMemtable(self);
+		}
+		if (Record.Length == 0)
+		{
+			if (!isOldestIncluded)
+			{
+				ReturnedError = GHDFSegment_Write(&Segment, Key, NULL, 0);
+				WrittenCount++;
+			}
+			continue;
+		}
+
+		char* Data;
+		size_t DataLength;
+		bool IsFound;
+		ReturnedError = GHDFSegment_Read(&runs[Source]->Segment, Key, NULL, &Data, &DataLength, &IsFound);
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			ReturnedError = GHDFSegment_Write(&Segment, Key, Data, DataLength);
+			Memory_Free(Data);
+			WrittenCount++;
+		}
+	}
+	MergeCursorDeconstruct(&Cursor);
+
+	Error CloseError = GHDFSegment_Close(&Segment);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = CloseError;
+	}
+	else
+	{
+		Error_Deconstruct(&CloseError);
+	}
+
+	if ((ReturnedError.Code != ErrorCode_Success) || (WrittenCount == 0))
+	{
+		File_Delete(Path);
+	}
+	else
+	{
+		*isRunCreated = true;
+	}
+	Memory_Free((char*)Path);
+	return ReturnedError;
+}
+
+/* Swaps the merged runs for their replacement, holding the lock. */
+static Error ReplaceMergedRuns(Store* self, StoreRun** mergedRuns, size_t mergedCount, StoreRun* replacement)
+{
+	// Flushes may have added runs to the front while merging, nothing else changes the list.
+	size_t FirstMerged = 0;
+	while (self->_runs[FirstMerged] != mergedRuns[0])
+	{
+		FirstMerged++;
+	}
+
+	size_t ReplacementCount = replacement ? 1 : 0;
+	size_t FollowingCount = self->RunCount - FirstMerged - mergedCount;
+	memmove(self->_runs + FirstMerged + ReplacementCount, self->_runs + FirstMerged + mergedCount, sizeof(StoreRun*) * FollowingCount);
+	if (replacement)
+	{
+		self->_runs[FirstMerged] = replacement;
+	}
+	self->RunCount = FirstMerged + ReplacementCount + FollowingCount;
+
+	Error ReturnedError = WriteManifest(self);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		EnsureRunCapacity(self, FirstMerged + mergedCount + FollowingCount);
+		memmove(self->_runs + FirstMerged + mergedCount, self->_runs + FirstMerged + ReplacementCount, sizeof(StoreRun*) * FollowingCount);
+		Memory_Copy((const char*)mergedRuns, (char*)(self->_runs + FirstMerged), sizeof(StoreRun*) * mergedCount);
+		self->RunCount = FirstMerged + mergedCount + FollowingCount;
+		if (replacement)
+		{
+			CloseRun(replacement, true, self);
+		}
+	}
+	else
+	{
+		// Readers hold the lock while they use a run, so nobody can still be reading the merged runs.
+		for (size_t i = 0; i < mergedCount; i++)
+		{
+			CloseRun(mergedRuns[i], true, self);
+		}
+	}
+	return ReturnedError;
+}
+
+static void RunCompaction(void* argument)
+{
+	Store* Self = (Store*)argument;
+	size_t FailedRunCount = 0;
+
+	ThreadLock_Lock(&Self->_lock);
+	while (!Atomic_Load(&Self->_isClosing))
+	{
+		// A failed flush is left to the next writer which needs the immutable memtable, or to Store_Flush.
+		if (Atomic_Load(&Self->_flushState) == StoreFlushState_Queued)
+		{
+			Error ReturnedError = FlushImmutableMemtable(Self);
+			Error_Deconstruct(&ReturnedError);
+			continue;
+		}
+
+		// After a failure the same runs aren't retried until another flush adds a run.
+		size_t FirstMerged;
+		size_t MergedCount;
+		if ((Self->RunCount == FailedRunCount) || !FindCompactionRuns(Self, &FirstMerged, &MergedCount))
+		{
+			ThreadCondition_Wait(&Self->_compactionCondition, &Self->_lock, THREAD_WAIT_INFINITE);
+			continue;
+		}
+
+		// Flushes only ever add runs to the front, so the runs taken here stay next to each other while merging.
+		bool IsOldestIncluded = (FirstMerged + MergedCount) == Self->RunCount;
+		StoreRun** MergedRuns = (StoreRun**)Memory_SafeMalloc(sizeof(StoreRun*) * MergedCount);
+		Memory_Copy((const char*)(Self->_runs + FirstMerged), (char*)MergedRuns, sizeof(StoreRun*) * MergedCount);
+		unsigned long long Number = Self->_nextRunNumber;
+		Self->_nextRunNumber++;
+		ThreadLock_Unlock(&Self->_lock);
+
+		bool IsRunCreated;
+		StoreRun* Replacement = NULL;
+		Error ReturnedError = MergeRuns(Self, MergedRuns, MergedCount, IsOldestIncluded, Number, &IsRunCreated);
+		if ((ReturnedError.Code == ErrorCode_Success) && IsRunCreated)
+		{
+			ReturnedError = OpenRun(Self, Number, &Replacement);
+		}
+
+		ThreadLock_Lock(&Self->_lock);
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			ReturnedError = ReplaceMergedRuns(Self, MergedRuns, MergedCount, Replacement);
+		}
+		Memory_Free(MergedRuns);
+		FailedRunCount = (ReturnedError.Code == ErrorCode_Success) ? 0 : Self->RunCount;
+		Error_Deconstruct(&ReturnedError);
+	}
+	ThreadLock_Unlock(&Self->_lock);
+}
+
+
+/* Importing. */
+/* Whether the key has a value or a deletion anywhere in the store, holding the lock. */
+static bool HasEntry(Store* self, unsigned long long key)
+{
+	bool IsInMemtable = FindMemtableEntry(self, key) != NULL;
+	for (size_t i = 0; !IsInMemtable && (i < self->RunCount); i++)
+	{
+		GHDFSegmentRecord Record;
+		if (FindInRun(self->_runs[i], key, &Record))
+		{
+			return true;
+		}
+	}
+	return IsInMemtable;
+}
+
+static Error ImportSegmentRecords(Store* self, GHDFSegment* segment, size_t* importedCount)
+{
+	Error ReturnedError = Error_CreateSuccess();
+	for (size_t i = 0; (i < segment->RecordCount) && (ReturnedError.Code == ErrorCode_Success); i++)
+	{
+		GHDFSegmentRecord Record = GHDFSegment_GetRecord(segment, i);
+		char* Data;
+		size_t DataLength;
+		bool IsFound;
+		ReturnedError = GHDFSegment_Read(segment, Record.ID, NULL, &Data, &DataLength, &IsFound);
+		if ((ReturnedError.Code != ErrorCode_Success) || !IsFound || (DataLength == 0))
+		{
+			Memory_Free(Data);
+			continue;
+		}
+
+		ThreadLock_Lock(&self->_lock);
+		if (!HasEntry(self, Record.ID))
+		{
+			ReturnedError = AddMemtableEntry(self, Record.ID, Data, DataLength);
+			*importedCount += 1;
+		}
+		ThreadLock_Unlock(&self->_lock);
+		Memory_Free(Data);
+	}
+	return ReturnedError;
+}
+
+
+// Functions.
+Error Store_Open(Store* self, const char* directoryPath, bool syncWrites)
+{
+	Memory_Set((char*)self, sizeof(Store), 0);
+	self->_directory = String_CreateCopy(directoryPath);
+	self->_syncWrites = syncWrites;
+	ThreadLock_Construct(&self->_lock);
+	ThreadCondition_Construct(&self->_compactionCondition);
+	ThreadCondition_Construct(&self->_flushCondition);
+
+	ConstructMemtable(&self->_memtable);
+	ConstructMemtable(&self->_immutableMemtable);
+	self->_runCapacity = RUN_LIST_CAPACITY;
+	self->_runs = (StoreRun**)Memory_SafeMalloc(sizeof(StoreRun*) * self->_runCapacity);
+
+	Directory_CreateAll(directoryPath);
+	Error ReturnedError = LoadManifest(self);
+	if ((ReturnedError.Code == ErrorCode_Success) && !Thread_Start(&self->_compactionThread, RunCompaction, self))
+	{
+		ReturnedError = Error_CreateError(ErrorCode_IO, "Store_Open: Failed to start compaction thread.");
+	}
+
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		for (size_t i = 0; i < self->RunCount; i++)
+		{
+			CloseRun(self->_runs[i], false, self);
+		}
+		Memory_Free(self->_runs);
+		DeconstructMemtable(&self->_memtable);
+		DeconstructMemtable(&self->_immutableMemtable);
+		Memory_Free((char*)self->_directory);
+		return ReturnedError;
+	}
+	return Error_CreateSuccess();
+}
+
+Error Store_Get(Store* self, unsigned long long key, GHDFArena* arena, char** value, size_t* valueLength, bool* isFound)
+{
+	*value = NULL;
+	*valueLength = 0;
+	*isFound = false;
+
+	ThreadLock_LockShared(&self->_lock);
+	StoreEntry* Entry = FindMemtableEntry(self, key);
+	if (Entry)
+	{
+		if (Entry->Value)
+		{
+			*value = arena ? (char*)GHDFArena_Allocate(arena, Entry->ValueLength) : (char*)Memory_SafeMalloc(Entry->ValueLength);
+			Memory_Copy(Entry->Value, *value, Entry->ValueLength);
+			*valueLength = Entry->ValueLength;
+			*isFound = true;
+		}
+		ThreadLock_UnlockShared(&self->_lock);
+		return Error_CreateSuccess();
+	}
+
+	Error ReturnedError = Error_CreateSuccess();
+	for (size_t i = 0; i < self->RunCount; i++)
+	{
+		GHDFSegmentRecord Record;
+		if (!FindInRun(self->_runs[i], key, &Record))
+		{
+			continue;
+		}
+
+		if (Record.Length > 0)
+		{
+			ReturnedError = GHDFSegment_Read(&self->_runs[i]->Segment, key, arena, value, valueLength, isFound);
+		}
+		break;
+	}
+	ThreadLock_UnlockShared(&self->_lock);
+	return ReturnedError;
+}
+
+bool Store_Contains(Store* self, unsigned long long key)
+{
+	ThreadLock_LockShared(&self->_lock);
+	StoreEntry* Entry = FindMemtableEntry(self, key);
+	bool IsFound = Entry && Entry->Value;
+
+	for (size_t i = 0; !Entry && (i < self->RunCount); i++)
+	{
+		GHDFSegmentRecord Record;
+		if (FindInRun(self->_runs[i], key, &Record))
+		{
+			IsFound = Record.Length > 0;
+			break;
+		}
+	}
+	ThreadLock_UnlockShared(&self->_lock);
+	return IsFound;
+}
+
+Error Store_Put(Store* self, unsigned long long key, const char* value, size_t valueLength)
+{
+	if (valueLength == 0)
+	{
+		return Error_CreateError(ErrorCode_InvalidArgument, "Store_Put: Empty values can't be stored.");
+	}
+
+	ThreadLock_Lock(&self->_lock);
+	Error ReturnedError = AddMemtableEntry(self, key, value, valueLength);
+	ThreadLock_Unlock(&self->_lock);
+	return ReturnedError;
+}
+
+Error Store_Delete(Store* self, unsigned long long key)
+{
+	ThreadLock_Lock(&self->_lock);
+	Error ReturnedError = AddMemtableEntry(self, key, NULL, 0);
+	ThreadLock_Unlock(&self->_lock);
+	return ReturnedError;
+}
+
+Error Store_Scan(Store* self, unsigned long long firstKey, unsigned long long lastKey, StoreScanFunction function, void* argument)
+{
+	ThreadLock_LockShared(&self->_lock);
+	MergeCursor Cursor;
+	MergeCursorConstruct(&Cursor, self, true, self->_runs, self->RunCount, firstKey);
+
+	Error ReturnedError = Error_CreateSuccess();
+	unsigned long long Key;
+	int Source;
+	StoreEntry* Entry;
+	GHDFSegmentRecord Record;
+	while (MergeCursorNext(&Cursor, lastKey, &Key, &Source, &Entry, &Record))
+	{
+		bool IsContinued = true;
+		if (Source == MEMTABLE_SOURCE)
+		{
+			IsContinued = !Entry->Value || function(Key, Entry->Value, Entry->ValueLength, argument);
+		}
+		else if (Record.Length > 0)
+		{
+			char* Data;
+			size_t DataLength;
+			bool IsFound;
+			ReturnedError = GHDFSegment_Read(&self->_runs[Source]->Segment, Key, NULL, &Data, &DataLength, &IsFound);
+			if (ReturnedError.Code != ErrorCode_Success)
+			{
+				break;
+			}
+			IsContinued = function(Key, Data, DataLength, argument);
+			Memory_Free(Data);
+		}
+
+		if (!IsContinued)
+		{
+			break;
+		}
+	}
+
+	MergeCursorDeconstruct(&Cursor);
+	ThreadLock_UnlockShared(&self->_lock);
+	return ReturnedError;
+}
+
+Error Store_ScanKeys(Store* self, unsigned long long firstKey, unsigned long long lastKey, StoreKeyScanFunction function, void* argument)
+{
+	ThreadLock_LockShared(&self->_lock);
+	MergeCursor Cursor;
+	MergeCursorConstruct(&Cursor, self, true, self->_runs, self->RunCount, firstKey);
+
+	unsigned long long Key;
+	int Source;
+	StoreEntry* Entry;
+	GHDFSegmentRecord Record;
+	while (MergeCursorNext(&Cursor, lastKey, &Key, &Source, &Entry, &Record))
+	{
+		bool HasValue = (Source == MEMTABLE_SOURCE) ? (Entry->Value != NULL) : (Record.Length > 0);
+		if (HasValue && !function(Key, argument))
+		{
+			break;
+		}
+	}
+
+	MergeCursorDeconstruct(&Cursor);
+	ThreadLock_UnlockShared(&self->_lock);
+	return Error_CreateSuccess();
+}
+
+Error Store_Flush(Store* self)
+{
+	// The memtable is written by the caller rather than queued, the caller waits for it either way.
+	ThreadLock_Lock(&self->_lock);
+	Error ReturnedError = WaitForFlush(self);
+	if ((ReturnedError.Code == ErrorCode_Success) && (self->_memtable.Count > 0))
+	{
+		FreezeMemtable(self);
+		ReturnedError = FlushImmutableMemtable(self);
+	}
+	ThreadLock_Unlock(&self->_lock);
+	return ReturnedError;
+}
+
+Error Store_ImportSegment(Store* self, const char* segmentPath, size_t* importedCount)
+{
+	*importedCount = 0;
+	GHDFSegment Segment;
+	Error ReturnedError = GHDFSegment_Open(&Segment, segmentPath, self->_syncWrites);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+
+	ReturnedError = ImportSegmentRecords(self, &Segment, importedCount);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		ReturnedError = Store_Flush(self);
+	}
+
+	Error CloseError = GHDFSegment_Close(&Segment);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		Error_Deconstruct(&CloseError);
+		return ReturnedError;
+	}
+	if (CloseError.Code != ErrorCode_Success)
+	{
+		return CloseError;
+	}
+
+	// A file which couldn't be deleted is imported again on the next start, which changes nothing.
+	File_Delete(segmentPath);
+	return Error_CreateSuccess();
+}
+
+Error Store_Close(Store* self)
+{
+	ThreadLock_Lock(&self->_lock);
+	Atomic_Store(&self->_isClosing, 1);
+	ThreadCondition_WakeAll(&self->_compactionCondition);
+	ThreadLock_Unlock(&self->_lock);
+	Thread_Join(&self->_compactionThread);
+
+	Error ReturnedError = Store_Flush(self);
+	for (size_t i = 0; i < self->RunCount; i++)
+	{
+		CloseRun(self->_runs[i], false, self);
+	}
+
+	Memory_Free(self->_runs);
+	DeconstructMemtable(&self->_memtable);
+	DeconstructMemtable(&self->_immutableMemtable);
+	Memory_Free((char*)self->_directory);
+	Memory_Set((char*)self, sizeof(Store), 0);
+	return ReturnedError;
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "LttErrors.h"
+#include "LTTThread.h"
+#include "GHDF.h"
+#include "GHDFSegment.h"
+
+
+// Macros.
+#define STORE_FIRST_KEY 0ull
+#define STORE_LAST_KEY (~0ull)
+
+
+// Types.
+/// <summary>
+/// Called for each key in a scan, in ascending order. The value is only valid during the call.
+/// </summary>
+/// <returns>false to stop the scan.</returns>
+typedef bool (*StoreScanFunction)(unsigned long long key, const char* value, size_t valueLength, void* argument);
+
+/// <summary>
+/// Called for each key in a key scan, in ascending order.
+/// </summary>
+/// <returns>false to stop the scan.</returns>
+typedef bool (*StoreKeyScanFunction)(unsigned long long key, void* argument);
+
+/* A memtable entry, a NULL value marks a deleted key. */
+typedef struct StoreEntryStruct
+{
+	unsigned long long Key;
+	char* Value;
+	size_t ValueLength;
+} StoreEntry;
+
+/* Sorted by key. */
+typedef struct StoreMemtableStruct
+{
+	StoreEntry* Entries;
+	size_t Count;
+	size_t Capacity;
+	size_t Bytes;
+} StoreMemtable;
+
+/* What happens to the immutable memtable. */
+typedef enum StoreFlushStateEnum
+{
+	StoreFlushState_None,
+	StoreFlushState_Queued,
+	StoreFlushState_Writing,
+	StoreFlushState_Failed
+} StoreFlushState;
+
+/* An immutable sorted run, stored as a segment whose offset table serves as the run's index.
+* Deleted keys are kept as empty records until a compaction merges in the oldest run. */
+typedef struct StoreRunStruct
+{
+	unsigned long long Number;
+	GHDFSegment Segment;
+
+	unsigned long long MinKey;
+	unsigned long long MaxKey;
+	/* Bytes of the run's records, which decide its compaction tier. */
+	unsigned long long Size;
+	unsigned long long* _bloomBits;
+	size_t _bloomBitCount;
+} StoreRun;
+
+/* Log-structured key-value store. Writes collect in a sorted memtable, a full one is swapped for an empty one and
+* a background thread flushes it into a new run, which it also merges with runs of a similar size once there are enough
+* of them. Reads check both memtables and then the runs from newest to oldest, the bloom filter of each run skips most runs
+* which don't hold the key. */
+typedef struct StoreStruct
+{
+	const char* _directory;
+	bool _syncWrites;
+	ThreadLock _lock;
+
+	StoreMemtable _memtable;
+	/* The previous memtable, read until its run is listed in the manifest. Writers only wait for it when the next memtable
+	* fills up before it is written. The state is a StoreFlushState, changed under the lock. */
+	StoreMemtable _immutableMemtable;
+	volatile long long _flushState;
+	ThreadCondition _flushCondition;
+
+	/* Newest first. */
+	StoreRun** _runs;
+	size_t RunCount;
+	size_t _runCapacity;
+	unsigned long long _nextRunNumber;
+
+	Thread _compactionThread;
+	ThreadCondition _compactionCondition;
+	volatile long long _isClosing;
+} Store;
+
+
+// Functions.
+/// <summary>
+/// Opens the store in the directory, creating an empty one if there is none, and starts its compaction thread.
+/// </summary>
+/// <param name="syncWrites">Waits for flushed runs to reach the disk.</param>
+Error Store_Open(Store* self, const char* directoryPath, bool syncWrites);
+
+/// <summary>
+/// Reads the value stored under the key.
+/// </summary>
+/// <param name="arena">Arena which the value is placed into, NULL to allocate it normally and leave freeing it to the caller.</param>
+/// <param name="isFound">Set to false if the key has no value.</param>
+Error Store_Get(Store* self, unsigned long long key, GHDFArena* arena, char** value, size_t* valueLength, bool* isFound);
+
+bool Store_Contains(Store* self, unsigned long long key);
+
+/// <summary>
+/// Stores a copy of the value under the key, replacing the previous one. The change survives a restart once flushed.
+/// </summary>
+Error Store_Put(Store* self, unsigned long long key, const char* value, size_t valueLength);
+
+/// <summary>
+/// Removes the key's value if there is one. The change survives a restart once flushed.
+/// </summary>
+Error Store_Delete(Store* self, unsigned long long key);
+
+/// <summary>
+/// Calls the function for every key with a value in the inclusive range, in ascending key order.
+/// The function must not modify the store.
+/// </summary>
+Error Store_Scan(Store* self, unsigned long long firstKey, unsigned long long lastKey, StoreScanFunction function, void* argument);
+
+/// <summary>
+/// Calls the function for every key with a value in the inclusive range, in ascending key order. Keys come from the memtable
+/// and the runs' offset tables, no values are read. The function must not modify the store.
+/// </summary>
+Error Store_ScanKeys(Store* self, unsigned long long firstKey, unsigned long long lastKey, StoreKeyScanFunction function, void* argument);
+
+/// <summary>
+/// Writes the memtables into new runs, making all changes so far survive a restart. Reads go on meanwhile.
+/// </summary>
+Error Store_Flush(Store* self);
+
+/// <summary>
+/// Moves the records of a GHDF segment file into the store and deletes the file once they last. Keys which already have
+/// a value or a deletion in the store keep it, the store's entries are newer than the segment's.
+/// </summary>
+/// <param name="importedCount">Set to the amount of records which were moved.</param>
+Error Store_ImportSegment(Store* self, const char* segmentPath, size_t* importedCount);
+
+/// <summary>
+/// Stops compaction, flushes the memtable and closes all runs.
+/// </summary>
+Error Store_Close(Store* self);
\ No newline at end of file
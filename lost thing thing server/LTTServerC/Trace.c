@@ -0,0 +1,234 @@
+#include "Trace.h"
+#include "LTTThread.h"
+#include "LTTTime.h"
+#include "LttString.h"
+#include "Directory.h"
+#include "File.h"
+#include "Memory.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+
+
+// Macros.
+#define TRACE_LOG_DIR_NAME "logs"
+#define TRACE_FILE_NAME_LENGTH 64
+
+#define MICROSECONDS_IN_MILLISECOND 1000ull
+
+#define TRACE_JSON_CAPACITY 16384
+#define TRACE_NUMBER_LENGTH 128
+
+/* Chrome trace events need a process, there is only one. */
+#define TRACE_PROCESS_ID 1
+
+
+// Types.
+typedef struct TraceSpanRecordStruct
+{
+	const char* Name;
+	unsigned long long StartTime;
+	unsigned long long Duration;
+	bool IsEnded;
+} TraceSpanRecord;
+
+
+// Static variables.
+static volatile long long s_slowRequestMicroseconds = 0;
+static char* s_traceDirPath = NULL;
+static volatile long long s_lastWriteTime = 0;
+static volatile long long s_threadCount = 0;
+
+static THREAD_LOCAL TraceSpanRecord s_spans[TRACE_RING_CAPACITY];
+static THREAD_LOCAL unsigned long long s_nextPosition = TRACE_NO_SPAN + 1;
+static THREAD_LOCAL unsigned long long s_requestStartPosition = TRACE_NO_SPAN + 1;
+static THREAD_LOCAL unsigned long long s_requestStartTime = 0;
+static THREAD_LOCAL bool s_isTracing = false;
+static THREAD_LOCAL long long s_threadNumber = 0;
+
+
+// Static functions.
+static TraceSpanRecord* GetSpanRecord(unsigned long long position)
+{
+	return &s_spans[position & (TRACE_RING_CAPACITY - 1)];
+}
+
+static void AppendJSONString(StringBuilder* builder, const char* string)
+{
+	StringBuilder_AppendChar(builder, '"');
+	for (; *string != '\0'; string++)
+	{
+		if ((*string == '"') || (*string == '\\'))
+		{
+			StringBuilder_AppendChar(builder, '\\');
+			StringBuilder_AppendChar(builder, *string);
+		}
+		else if ((unsigned char)*string < ' ')
+		{
+			char Escaped[8];
+			snprintf(Escaped, sizeof(Escaped), "\\u%04x", (unsigned int)(unsigned char)*string);
+			StringBuilder_Append(builder, Escaped);
+		}
+		else
+		{
+			StringBuilder_AppendChar(builder, *string);
+		}
+	}
+	StringBuilder_AppendChar(builder, '"');
+}
+
+/* A complete event, which trace viewers nest by time. */
+static void AppendEvent(StringBuilder* builder, const char* name, unsigned long long startTime, unsigned long long duration)
+{
+	char Number[TRACE_NUMBER_LENGTH];
+	StringBuilder_Append(builder, "{\"name\":");
+	AppendJSONString(builder, name);
+	snprintf(Number, sizeof(Number), ",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%lld",
+		startTime, duration, TRACE_PROCESS_ID, s_threadNumber);
+	StringBuilder_Append(builder, Number);
+}
+
+static void BuildTraceJSON(StringBuilder* builder, const char* target, unsigned long long endTime)
+{
+	unsigned long long FirstPosition = s_requestStartPosition;
+	if ((s_nextPosition - FirstPosition) > TRACE_RING_CAPACITY)
+	{
+		FirstPosition = s_nextPosition - TRACE_RING_CAPACITY;
+	}
+
+	StringBuilder_Append(builder, "{\"traceEvents\":[");
+	AppendEvent(builder, "request", s_requestStartTime, endTime - s_requestStartTime);
+	StringBuilder_Append(builder, ",\"args\":{\"target\":");
+	AppendJSONString(builder, target);
+	char Number[TRACE_NUMBER_LENGTH];
+	snprintf(Number, sizeof(Number), ",\"droppedSpans\":%llu}}", FirstPosition - s_requestStartPosition);
+	StringBuilder_Append(builder, Number);
+
+	for (unsigned long long Position = FirstPosition; Position < s_nextPosition; Position++)
+	{
+		TraceSpanRecord* Span = GetSpanRecord(Position);
+		StringBuilder_AppendChar(builder, ',');
+
+		// Spans still open when the request ended, for example ones left by an early return, end with it.
+		AppendEvent(builder, Span->Name, Span->StartTime, Span->IsEnded ? Span->Duration : endTime - Span->StartTime);
+		StringBuilder_AppendChar(builder, '}');
+	}
+	StringBuilder_Append(builder, "],\"displayTimeUnit\":\"ms\"}");
+}
+
+static Error WriteTrace(const char* target, unsigned long long endTime)
+{
+	if (s_threadNumber == 0)
+	{
+		s_threadNumber = Atomic_Increment(&s_threadCount);
+	}
+
+	StringBuilder Builder;
+	StringBuilder_Construct(&Builder, TRACE_JSON_CAPACITY);
+	BuildTraceJSON(&Builder, target, endTime);
+
+	char FileName[TRACE_FILE_NAME_LENGTH];
+	snprintf(FileName, sizeof(FileName), "trace %llu-%lld.json", (unsigned long long)time(NULL), s_threadNumber);
+	char* FilePath = Directory_CombinePaths(s_traceDirPath, FileName);
+
+	Error ReturnedError = File_WriteAtomic(FilePath, Builder.Data, Builder.Length, false);
+	Memory_Free(FilePath);
+	StringBuilder_Deconstruct(&Builder);
+	return ReturnedError;
+}
+
+/* Keeps a burst of slow requests from filling the disk with traces. */
+static bool TryClaimWrite()
+{
+	long long CurrentTime = (long long)time(NULL);
+	long long LastWriteTime = Atomic_Load(&s_lastWriteTime);
+	return (LastWriteTime != CurrentTime) && Atomic_CompareExchange(&s_lastWriteTime, LastWriteTime, CurrentTime);
+}
+
+
+// Functions.
+void Trace_Configure(const char* rootDirectoryPath, unsigned int slowRequestMilliseconds)
+{
+	Trace_Close();
+	if (slowRequestMilliseconds == 0)
+	{
+		return;
+	}
+
+	char* LogDirPath = Directory_CombinePaths(rootDirectoryPath, TRACE_LOG_DIR_NAME);
+	s_traceDirPath = Directory_CombinePaths(LogDirPath, TRACE_DIR_NAME);
+	Memory_Free(LogDirPath);
+	Directory_CreateAll(s_traceDirPath);
+
+	Atomic_Store(&s_slowRequestMicroseconds, slowRequestMilliseconds * MICROSECONDS_IN_MILLISECOND);
+}
+
+void Trace_Close()
+{
+	Atomic_Store(&s_slowRequestMicroseconds, 0);
+	if (s_traceDirPath)
+	{
+		Memory_Free(s_traceDirPath);
+		s_traceDirPath = NULL;
+	}
+}
+
+void Trace_BeginRequest()
+{
+	s_isTracing = Atomic_Load(&s_slowRequestMicroseconds) != 0;
+	if (!s_isTracing)
+	{
+		return;
+	}
+
+	s_requestStartPosition = s_nextPosition;
+	s_requestStartTime = Time_GetMicroseconds();
+}
+
+Error Trace_EndRequest(const char* target)
+{
+	if (!s_isTracing)
+	{
+		return Error_CreateSuccess();
+	}
+	s_isTracing = false;
+
+	unsigned long long EndTime = Time_GetMicroseconds();
+	long long SlowRequestMicroseconds = Atomic_Load(&s_slowRequestMicroseconds);
+	if ((SlowRequestMicroseconds == 0) || ((EndTime - s_requestStartTime) < (unsigned long long)SlowRequestMicroseconds)
+		|| !TryClaimWrite())
+	{
+		return Error_CreateSuccess();
+	}
+	return WriteTrace(target, EndTime);
+}
+
+TraceSpan Trace_BeginSpan(const char* name)
+{
+	if (!s_isTracing)
+	{
+		return TRACE_NO_SPAN;
+	}
+
+	TraceSpan Position = s_nextPosition;
+	s_nextPosition++;
+
+	TraceSpanRecord* Span = GetSpanRecord(Position);
+	Span->Name = name;
+	Span->IsEnded = false;
+	Span->StartTime = Time_GetMicroseconds();
+	return Position;
+}
+
+void Trace_EndSpan(TraceSpan span)
+{
+	// The span's slot may have been taken by a newer span once the ring wrapped around.
+	if ((span == TRACE_NO_SPAN) || !s_isTracing || ((s_nextPosition - span) > TRACE_RING_CAPACITY))
+	{
+		return;
+	}
+
+	TraceSpanRecord* Span = GetSpanRecord(span);
+	Span->Duration = Time_GetMicroseconds() - Span->StartTime;
+	Span->IsEnded = true;
+}
\ No newline at end of file
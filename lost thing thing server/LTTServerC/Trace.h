@@ -0,0 +1,46 @@
+#pragma once
+#include "LttErrors.h"
+
+
+// Macros.
+/* Spans kept for each thread's current request, must be a power of two. Older spans are overwritten. */
+#define TRACE_RING_CAPACITY 256
+
+#define TRACE_DIR_NAME "traces"
+
+#define TRACE_NO_SPAN 0
+
+
+// Types.
+/* Position of a span in its thread's ring, TRACE_NO_SPAN when nothing was recorded. */
+typedef unsigned long long TraceSpan;
+
+
+// Functions.
+/// <summary>
+/// Turns tracing on. Requests slower than the threshold are written to the traces directory in the log directory
+/// as Chrome trace event JSON, at most one each second.
+/// </summary>
+/// <param name="slowRequestMilliseconds">Threshold above which a request is written, 0 turns tracing off.</param>
+void Trace_Configure(const char* rootDirectoryPath, unsigned int slowRequestMilliseconds);
+
+void Trace_Close();
+
+/// <summary>
+/// Starts tracing a request on the calling thread, spans are only recorded between this and Trace_EndRequest.
+/// </summary>
+void Trace_BeginRequest();
+
+/// <summary>
+/// Writes the request's spans if it was slow, and stops tracing on the calling thread.
+/// </summary>
+/// <param name="target">Request target, stored with the trace.</param>
+Error Trace_EndRequest(const char* target);
+
+/// <summary>
+/// Starts a span, spans may be nested.
+/// </summary>
+/// <param name="name">Name shown in the trace, must stay valid for as long as the server runs.</param>
+TraceSpan Trace_BeginSpan(const char* name);
+
+void Trace_EndSpan(TraceSpan span);
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include "WriteAheadLog.h"
+#include "File.h"
+#include "Memory.h"
+#include "LTTBytes.h"
+#include "LttString.h"
+#include <string.h>
+
+
+// Macros.
+/* Length and checksum of the rest of the record. */
+#define RECORD_HEADER_SIZE (4 + 4)
+/* Type and ID. */
+#define RECORD_BODY_HEADER_SIZE (1 + 8)
+
+#define PENDING_BUFFER_CAPACITY 4096
+#define PENDING_BUFFER_GROWTH 2
+
+
+// Static functions.
+static void EnsurePendingCapacity(WriteAheadLog* self, size_t capacity)
+{
+	if (self->_pendingCapacity >= capacity)
+	{
+		return;
+	}
+
+	if (self->_pendingCapacity == 0)
+	{
+		self->_pendingCapacity = PENDING_BUFFER_CAPACITY;
+	}
+	while (self->_pendingCapacity < capacity)
+	{
+		self->_pendingCapacity *= PENDING_BUFFER_GROWTH;
+	}
+	self->_pendingData = (char*)Memory_SafeRealloc(self->_pendingData, self->_pendingCapacity);
+}
+
+/* Puts data whose write failed back in front of the records appended since, so the next commit writes it again. */
+static void RestorePendingData(WriteAheadLog* self, char* data, size_t dataLength)
+{
+	EnsurePendingCapacity(self, self->_pendingLength + dataLength);
+	memmove(self->_pendingData + dataLength, self->_pendingData, self->_pendingLength);
+	Memory_Copy(data, self->_pendingData, dataLength);
+	self->_pendingLength += dataLength;
+}
+
+static Error WriteCommittedData(WriteAheadLog* self, unsigned long long offset, const char* data, size_t dataLength)
+{
+	Error ReturnedError = File_WriteAt(self->_file, offset, data, dataLength);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		return ReturnedError;
+	}
+	return self->_syncWrites ? File_Sync(self->_file) : File_Flush(self->_file);
+}
+
+
+// Functions.
+Error WriteAheadLog_Open(WriteAheadLog* self, const char* path, bool syncWrites)
+{
+	Memory_Set((char*)self, sizeof(WriteAheadLog), 0);
+	self->_syncWrites = syncWrites;
+	ThreadLock_Construct(&self->_lock);
+	ThreadCondition_Construct(&self->_commitCondition);
+
+	Error ReturnedError;
+	if (!File_Exists(path))
+	{
+		FILE* File = File_Open(path, FileOpenMode_WriteBinary, &ReturnedError);
+		if (!File)
+		{
+			return ReturnedError;
+		}
+		File_Close(File);
+	}
+
+	self->_file = File_Open(path, FileOpenMode_ReadUpdateBinary, &ReturnedError);
+	if (!self->_file)
+	{
+		return ReturnedError;
+	}
+
+	// Replaying finds where the intact records end, until then appends go after everything in the file.
+	ReturnedError = File_GetLength(self->_file, &self->Length);
+	if (ReturnedError.Code != ErrorCode_Success)
+	{
+		File_Close(self->_file);
+		self->_file = NULL;
+		return ReturnedError;
+	}
+
+	return Error_CreateSuccess();
+}
+
+Error WriteAheadLog_Replay(WriteAheadLog* self, WriteAheadLogReplayFunction function, void* argument)
+{
+	unsigned long long FileLength;
+	Error ReturnedError = File_GetLength(self->_file, &FileLength);
+	if ((ReturnedError.Code != ErrorCode_Success) || (FileLength == 0))
+	{
+		self->Length = 0;
+		return ReturnedError;
+	}
+
+	unsigned char* Data = (unsigned char*)Memory_SafeMalloc((size_t)FileLength);
+	ReturnedError = File_ReadAt(self->_file, 0, (char*)Data, (size_t)FileLength);
+
+	size_t Offset = 0;
+	while ((ReturnedError.Code == ErrorCode_Success) && ((FileLength - Offset) >= (RECORD_HEADER_SIZE + RECORD_BODY_HEADER_SIZE)))
+	{
+		size_t BodyLength = Bytes_DecodeUInt(Data + Offset);
+		const unsigned char* Body = Data + Offset + RECORD_HEADER_SIZE;
+		if ((BodyLength < RECORD_BODY_HEADER_SIZE) || (BodyLength > (FileLength - Offset - RECORD_HEADER_SIZE))
+			|| (Bytes_Hash(Body, BodyLength) != Bytes_DecodeUInt(Data + Offset + 4)))
+		{
+			break;
+		}
+
+		ReturnedError = function(Body[0], Bytes_DecodeULong(Body + 1), (const char*)Body + RECORD_BODY_HEADER_SIZE,
+			BodyLength - RECORD_BODY_HEADER_SIZE, argument);
+		Offset += RECORD_HEADER_SIZE + BodyLength;
+	}
+
+	Memory_Free(Data);
+	self->Length = Offset;
+	return ReturnedError;
+}
+
+unsigned long long WriteAheadLog_Append(WriteAheadLog* self, unsigned char type, unsigned long long id, const char* data, size_t dataLength)
+{
+	ThreadLock_Lock(&self->_lock);
+	size_t BodyLength = RECORD_BODY_HEADER_SIZE + dataLength;
+	EnsurePendingCapacity(self, self->_pendingLength + RECORD_HEADER_SIZE + BodyLength);
+
+	unsigned char* Record = (unsigned char*)self->_pendingData + self->_pendingLength;
+	unsigned char* Body = Record + RECORD_HEADER_SIZE;
+	Body[0] = type;
+	Bytes_EncodeULong(Body + 1, id);
+	Memory_Copy(data, (char*)Body + RECORD_BODY_HEADER_SIZE, dataLength);
+	Bytes_EncodeUInt(Record, (unsigned int)BodyLength);
+	Bytes_EncodeUInt(Record + 4, Bytes_Hash(Body, BodyLength));
+
+	self->_pendingLength += RECORD_HEADER_SIZE + BodyLength;
+	self->_appendedSequence++;
+	unsigned long long Sequence = self->_appendedSequence;
+	ThreadLock_Unlock(&self->_lock);
+	return Sequence;
+}
+
+Error WriteAheadLog_Commit(WriteAheadLog* self, unsigned long long sequence)
+{
+	ThreadLock_Lock(&self->_lock);
+	if (!self->_file)
+	{
+		ThreadLock_Unlock(&self->_lock);
+		return Error_CreateError(ErrorCode_IllegalState, "WriteAheadLog_Commit: The log is closed.");
+	}
+
+	while (self->_committedSequence < sequence)
+	{
+		if (self->_isCommitting)
+		{
+			// The running commit may not include this record, if so the loop commits again once it is done.
+			ThreadCondition_Wait(&self->_commitCondition, &self->_lock, THREAD_WAIT_INFINITE);
+			continue;
+		}
+
+		char* Data = self->_pendingData;
+		size_t DataLength = self->_pendingLength;
+		unsigned long long CommittedSequence = self->_appendedSequence;
+		unsigned long long Offset = self->Length;
+		self->_pendingData = NULL;
+		self->_pendingLength = 0;
+		self->_pendingCapacity = 0;
+		self->_isCommitting = true;
+		ThreadLock_Unlock(&self->_lock);
+
+		// Records appended by other threads while this one writes go into the next commit.
+		Error ReturnedError = WriteCommittedData(self, Offset, Data, DataLength);
+
+		ThreadLock_Lock(&self->_lock);
+		self->_isCommitting = false;
+		if (ReturnedError.Code == ErrorCode_Success)
+		{
+			self->Length += DataLength;
+			self->_committedSequence = CommittedSequence;
+		}
+		else
+		{
+			RestorePendingData(self, Data, DataLength);
+		}
+		Memory_Free(Data);
+		ThreadCondition_WakeAll(&self->_commitCondition);
+
+		if (ReturnedError.Code != ErrorCode_Success)
+		{
+			ThreadLock_Unlock(&self->_lock);
+			return ReturnedError;
+		}
+	}
+	ThreadLock_Unlock(&self->_lock);
+	return Error_CreateSuccess();
+}
+
+Error WriteAheadLog_CommitAll(WriteAheadLog* self)
+{
+	ThreadLock_Lock(&self->_lock);
+	unsigned long long Sequence = self->_appendedSequence;
+	ThreadLock_Unlock(&self->_lock);
+	return WriteAheadLog_Commit(self, Sequence);
+}
+
+Error WriteAheadLog_Reset(WriteAheadLog* self)
+{
+	ThreadLock_Lock(&self->_lock);
+	while (self->_isCommitting)
+	{
+		ThreadCondition_Wait(&self->_commitCondition, &self->_lock, THREAD_WAIT_INFINITE);
+	}
+	if (!self->_file)
+	{
+		ThreadLock_Unlock(&self->_lock);
+		return Error_CreateError(ErrorCode_IllegalState, "WriteAheadLog_Reset: The log is closed.");
+	}
+
+	// Truncated in place, so a failure leaves the file open either at its old length or at none.
+	// Records appended but not yet committed stay pending.
+	Error ReturnedError = File_Truncate(self->_file, 0);
+	if (ReturnedError.Code == ErrorCode_Success)
+	{
+		self->Length = 0;
+		ReturnedError = self->_syncWrites ? File_Sync(self->_file) : Error_CreateSuccess();
+	}
+
+	ThreadLock_Unlock(&self->_lock);
+	return ReturnedError;
+}
+
+Error WriteAheadLog_Close(WriteAheadLog* self)
+{
+	Error ReturnedError = WriteAheadLog_CommitAll(self);
+	if (self->_file)
+	{
+		File_Close(self->_file);
+	}
+	Memory_Free(self->_pendingData);
+	Memory_Set((char*)self, sizeof(WriteAheadLog), 0);
+	return ReturnedError;
+}
\ No newline at end of file
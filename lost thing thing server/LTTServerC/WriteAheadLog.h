@@ -0,0 +1,73 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "LttErrors.h"
+#include "LTTThread.h"
+
+
+// Types.
+/// <summary>
+/// Called for each intact record while replaying, in the order they were appended. The data is only valid during the call.
+/// </summary>
+typedef Error (*WriteAheadLogReplayFunction)(unsigned char type, unsigned long long id, const char* data, size_t dataLength, void* argument);
+
+/* Append-only log of binary mutation records: [length][checksum][type][id][data].
+* Appended records are buffered in memory until a commit writes them, all records appended up to that point
+* share its single sync. Committing threads wait for a commit which is already running instead of starting another. */
+typedef struct WriteAheadLogStruct
+{
+	FILE* _file;
+	bool _syncWrites;
+	ThreadLock _lock;
+	ThreadCondition _commitCondition;
+
+	char* _pendingData;
+	size_t _pendingLength;
+	size_t _pendingCapacity;
+
+	/* Sequence numbers of the last appended record and the last one which reached the file. */
+	unsigned long long _appendedSequence;
+	unsigned long long _committedSequence;
+	bool _isCommitting;
+
+	unsigned long long Length;
+} WriteAheadLog;
+
+
+// Functions.
+/// <summary>
+/// Opens the log, creating an empty one if it doesn't exist. Records should be replayed before new ones are appended.
+/// </summary>
+/// <param name="syncWrites">Waits for each commit to reach the disk.</param>
+Error WriteAheadLog_Open(WriteAheadLog* self, const char* path, bool syncWrites);
+
+/// <summary>
+/// Calls the function for each intact record. A torn record at the end of the log and everything after it is dropped.
+/// </summary>
+Error WriteAheadLog_Replay(WriteAheadLog* self, WriteAheadLogReplayFunction function, void* argument);
+
+/// <summary>
+/// Buffers a record, it is written by the next commit.
+/// </summary>
+/// <returns>The record's sequence number to commit up to.</returns>
+unsigned long long WriteAheadLog_Append(WriteAheadLog* self, unsigned char type, unsigned long long id, const char* data, size_t dataLength);
+
+/// <summary>
+/// Waits until the record with the sequence number and all before it are written, writing them if no other thread already is.
+/// Records whose write failed stay pending for the next commit. Fails if the log isn't open.
+/// </summary>
+Error WriteAheadLog_Commit(WriteAheadLog* self, unsigned long long sequence);
+
+/// <summary>
+/// Commits every record appended so far.
+/// </summary>
+Error WriteAheadLog_CommitAll(WriteAheadLog* self);
+
+/// <summary>
+/// Empties the log, to be called once everything it holds has been written to the database.
+/// The file is truncated in place and stays open, so the log remains usable if this fails.
+/// </summary>
+Error WriteAheadLog_Reset(WriteAheadLog* self);
+
+Error WriteAheadLog_Close(WriteAheadLog* self);
\ No newline at end of file